@@ -30,6 +30,7 @@
 #include "log.h"
 #include "platform.h"
 #include "power_tracking_file.h"
+#include "sched_profiling.h"
 
 static bool forward_over_serial = false;
 
@@ -44,6 +45,7 @@ void bootstrap()
     alp_layer_init(NULL, forward_over_serial);
 
     power_tracking_file_initialize();
+    sched_profiling_file_initialize();
 
     uint8_t uid[8];
     d7ap_fs_read_uid(uid);
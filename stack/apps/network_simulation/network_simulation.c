@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Capacity test of a network in the simulator of the NATIVE platform (build with PLATFORM_NATIVE_SIMULATOR).
+// Node 0 is a gateway which continuously scans for foreground frames (access class 0x01), all other nodes are
+// sensors which periodically push a message to it and request an acknowledgement. At the end of the simulation the
+// delivery ratio over all sensors is printed. Like sensor_without_alp, this app does not use the ALP layer.
+//
+// The gateway answers a request without a unicast address after a random delay within the response period Tc of the
+// request (RAIND, see dll.c), and does not listen until it has answered. Tc grows with the number of responders
+// announced in the request: 1 with the default APP_NETWORK_SIMULATION_RESPONDERS, while a request without ID (NOID)
+// makes d7atp.c assume 32 responders, so the gateway is deaf for up to about 1.6 s after every request and misses
+// most of the requests of the other sensors in that period.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "scheduler.h"
+#include "timer.h"
+#include "debug.h"
+#include "random.h"
+#include "ng.h"
+#include "d7ap_fs.h"
+#include "d7ap.h"
+
+#include "platform.h"
+#include "native_sim.h"
+
+#include "modules_defs.h"
+#include "app_defs.h"
+
+#ifndef PLATFORM_NATIVE_SIMULATOR
+#error "This app should be build for the NATIVE platform with PLATFORM_NATIVE_SIMULATOR=y"
+#endif
+
+#ifdef MODULE_ALP
+#error "This app should be build with MODULE_ALP=n"
+#endif
+
+#if APP_NETWORK_SIMULATION_RESPONDERS > 31
+#error "APP_NETWORK_SIMULATION_RESPONDERS should be less than 32"
+#endif
+
+#define GATEWAY_NODE_ID 0
+#define SENSOR_INTERVAL (TIMER_TICKS_PER_SEC * APP_NETWORK_SIMULATION_INTERVAL)
+
+// Define the D7 interface configuration used for sending payload on
+static d7ap_session_config_t d7ap_session_config = (d7ap_session_config_t){
+    .qos = {
+        .qos_resp_mode = SESSION_RESP_MODE_ANY,
+        .qos_retry_mode = SESSION_RETRY_MODE_NO
+    },
+    .dormant_timeout = 0,
+    .addressee = {
+        .ctrl = {
+            .nls_method = AES_NONE,
+            .id_type = APP_NETWORK_SIMULATION_RESPONDERS ? ID_TYPE_NBID : ID_TYPE_NOID,
+        },
+        .access_class = 0x01,
+        .id = { APP_NETWORK_SIMULATION_RESPONDERS } // the number of responders, compressed (CT) with exponent 0
+    }
+};
+
+void on_receive(uint16_t trans_id, uint8_t* payload, uint8_t len, d7ap_session_result_t result);
+void on_transmitted(uint16_t trans_id, error_t error);
+bool on_unsolicited_response(uint8_t* payload, uint8_t len, d7ap_session_result_t result, bool response_expected);
+
+d7ap_resource_desc_t callbacks = {
+    .receive_cb = &on_receive,
+    .transmitted_cb = &on_transmitted,
+    .unsolicited_cb = &on_unsolicited_response
+};
+
+static uint8_t NGDEF(d7_client_id);
+
+static uint16_t NGDEF(sequence_number);
+
+// sensor statistics
+static uint32_t NGDEF(messages_sent);
+static uint32_t NGDEF(messages_acked);
+
+// gateway statistics
+static uint32_t NGDEF(messages_received);
+
+void send_message()
+{
+    uint8_t payload[6];
+    uint32_t node_id = __builtin_bswap32(get_node_global_id());
+    uint16_t sequence = __builtin_bswap16(NG(sequence_number)++);
+    memcpy(payload, &node_id, sizeof(node_id));
+    memcpy(payload + sizeof(node_id), &sequence, sizeof(sequence));
+
+    uint16_t trans_id;
+    NG(messages_sent)++;
+    if(d7ap_send(NG(d7_client_id), &d7ap_session_config, payload, sizeof(payload), 0, &trans_id) != SUCCESS)
+        timer_post_task_delay(&send_message, SENSOR_INTERVAL);
+}
+
+void on_receive(uint16_t trans_id, uint8_t* payload, uint8_t len, d7ap_session_result_t result)
+{
+}
+
+void on_transmitted(uint16_t trans_id, error_t error)
+{
+    if(error == SUCCESS)
+        NG(messages_acked)++;
+
+    timer_post_task_delay(&send_message, SENSOR_INTERVAL);
+}
+
+bool on_unsolicited_response(uint8_t* payload, uint8_t len, d7ap_session_result_t result, bool response_expected)
+{
+    NG(messages_received)++;
+    return false; // let the stack acknowledge the request
+}
+
+void native_sim_report()
+{
+    uint32_t sent = 0, acked = 0, received = 0;
+    for(uint32_t node = 0; node < native_sim_get_node_count(); node++)
+    {
+        set_node_global_id(node);
+        sent += NG(messages_sent);
+        acked += NG(messages_acked);
+        received += NG(messages_received);
+    }
+
+    printf("sensors: %u messages sent, %u acknowledged (%.1f%%), gateway: %u received (%.1f%%)\n",
+           sent, acked, sent ? 100.0 * acked / sent : 0.0, received, sent ? 100.0 * received / sent : 0.0);
+}
+
+void bootstrap()
+{
+    d7ap_fs_init();
+    d7ap_init();
+    NG(d7_client_id) = d7ap_register(&callbacks);
+
+    if(get_node_global_id() == GATEWAY_NODE_ID)
+    {
+        d7ap_set_access_class(0x01); // continuous FG scan, visible in d7ap_fs_data.c
+        return;
+    }
+
+    // the sensors keep the default access class, without scanning. They start at a random moment in the interval
+    sched_register_task(&send_message);
+    timer_post_task_delay(&send_message, get_rnd() % SENSOR_INTERVAL);
+}
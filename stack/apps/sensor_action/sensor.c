@@ -74,7 +74,7 @@ void execute_sensor_measurement()
   temperature = __builtin_bswap16(temperature); // need to store in big endian in fs
   d7ap_fs_write_file(SENSOR_FILE_ID, 0, (uint8_t*)&temperature, SENSOR_FILE_SIZE, ROOT_AUTH);
 
-  timer_post_task_delay(&execute_sensor_measurement, SENSOR_INTERVAL_SEC);
+  timer_post_task_delay_slack(&execute_sensor_measurement, SENSOR_INTERVAL_SEC, TIMER_TICKS_PER_SEC / 5);
 }
 
 void init_user_files()
@@ -167,5 +167,5 @@ void bootstrap()
 #endif
 
     sched_register_task(&execute_sensor_measurement);
-    timer_post_task_delay(&execute_sensor_measurement, SENSOR_INTERVAL_SEC);
+    timer_post_task_delay_slack(&execute_sensor_measurement, SENSOR_INTERVAL_SEC, TIMER_TICKS_PER_SEC / 5);
 }
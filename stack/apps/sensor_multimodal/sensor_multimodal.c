@@ -187,7 +187,7 @@ static void execute_sensor_measurement()
   timer_tick_t delay = (current_network == D7_ACTIVE) ? SENSOR_INTERVAL_D7AP_SEC : SENSOR_INTERVAL_LORAWAN_SEC;
 
   DEBUG_PRINTF("sensor measurement executed with temperature %i, now waiting %i ticks to measure again", temperature, delay);
-  timer_post_task_delay(&execute_sensor_measurement, delay);
+  timer_post_task_delay_slack(&execute_sensor_measurement, delay, delay / 10);
 }
 
 void bootstrap() {
@@ -85,7 +85,7 @@ void execute_sensor_measurement()
   assert(rc == 0);
   temperature = __builtin_bswap16(temperature); // revert to make sure we're working with the right value
 
-  timer_post_task_delay(&execute_sensor_measurement, SENSOR_INTERVAL_SEC);
+  timer_post_task_delay_slack(&execute_sensor_measurement, SENSOR_INTERVAL_SEC, TIMER_TICKS_PER_SEC);
 }
 
 void init_user_files()
@@ -133,7 +133,7 @@ void on_alp_command_completed_cb(uint8_t tag_id, bool success)
 
     // reschedule sensor measurement
     if(!timer_is_task_scheduled(&execute_sensor_measurement))
-      timer_post_task_delay(&execute_sensor_measurement, SENSOR_INTERVAL_SEC);
+      timer_post_task_delay_slack(&execute_sensor_measurement, SENSOR_INTERVAL_SEC, 3 * TIMER_TICKS_PER_SEC);
 }
 
 void on_alp_command_result_cb(alp_command_t *alp_command, alp_interface_status_t* origin_itf_status)
@@ -113,7 +113,7 @@ void on_alp_command_completed_cb(uint8_t tag_id, bool success)
       log_print_string("Command failed, no ack received");
 
     // reschedule sensor measurement
-    timer_post_task_delay(&execute_sensor_measurement, SENSOR_INTERVAL_SEC);
+    timer_post_task_delay_slack(&execute_sensor_measurement, SENSOR_INTERVAL_SEC, 6 * TIMER_TICKS_PER_SEC);
 }
 
 static alp_init_args_t alp_init_args;
@@ -105,7 +105,7 @@ void on_receive(uint16_t trans_id, uint8_t* payload, uint8_t len, d7ap_session_r
 void on_transmitted(uint16_t trans_id, error_t error)
 {
     log_print_string("Transmitted (with error: %i)\n", error);
-    timer_post_task_delay(&execute_sensor_measurement, SENSOR_INTERVAL_SEC);
+    timer_post_task_delay_slack(&execute_sensor_measurement, SENSOR_INTERVAL_SEC, 3 * TIMER_TICKS_PER_SEC);
 }
 
 bool on_unsolicited_response(uint8_t* payload, uint8_t len, d7ap_session_result_t result, bool response_expected)
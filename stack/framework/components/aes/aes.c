@@ -60,8 +60,9 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 #include <string.h> // CBC mode, for memset
 #include "stdbool.h"
 #include "aes.h"
+#include "aes_backend.h"
 
-#ifdef HAL_SUPPORT_HW_AES
+#if AES_BACKEND == AES_BACKEND_HW
 #include "hwaes.h"
 #endif
 
@@ -89,21 +90,9 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 /*****************************************************************************/
 // state - array holding the intermediate results during decryption.
 typedef uint8_t state_t[4][4];
-static state_t *state;
 
-// The array that stores the round keys.
-static uint8_t RoundKey[176];
-
-// The array that stores the 128 bits key
-static uint8_t AES128_key[16];
-
-// The Key input to the AES Program
-static const uint8_t *Key;
-
-#if defined(CBC) && CBC
-    // Initial Vector used only for CBC mode
-    static uint8_t *Iv;
-#endif
+// Context used by the API without explicit context, all its users share the same key
+aes128_ctx_t NGDEF(aes_default_ctx);
 
 // The lookup-tables are marked const so they can be placed in read-only storage instead of RAM
 // The numbers below can be computed dynamically trading ROM for RAM -
@@ -182,74 +171,41 @@ static uint8_t getSBoxInvert(uint8_t num)
 }
 
 // This function produces Nb(Nr+1) round keys. The round keys are used in each round to decrypt the states.
-static void KeyExpansion(void)
+// Each round key word holds one column, with the first byte in the LSB.
+static void KeyExpansion(uint32_t *RoundKey, const uint8_t *Key)
 {
-    uint32_t i, j, k;
-    uint8_t tempa[4]; // Used for the column/row operations
+    uint32_t i;
+    uint32_t tempa; // Used for the column/row operations
 
     // The first round key is the key itself.
     for (i = 0; i < Nk; ++i)
     {
-        RoundKey[(i * 4) + 0] = Key[(i * 4) + 0];
-        RoundKey[(i * 4) + 1] = Key[(i * 4) + 1];
-        RoundKey[(i * 4) + 2] = Key[(i * 4) + 2];
-        RoundKey[(i * 4) + 3] = Key[(i * 4) + 3];
+        RoundKey[i] = (uint32_t)Key[(i * 4) + 0] | ((uint32_t)Key[(i * 4) + 1] << 8) |
+                      ((uint32_t)Key[(i * 4) + 2] << 16) | ((uint32_t)Key[(i * 4) + 3] << 24);
     }
 
     // All other round keys are found from the previous round keys.
     for (; (i < (Nb * (Nr + 1))); ++i)
     {
-        for (j = 0; j < 4; ++j)
-        {
-            tempa[j] = RoundKey[(i-1) * 4 + j];
-        }
+        tempa = RoundKey[i - 1];
         if (i % Nk == 0)
         {
-            // This function rotates the 4 bytes in a word to the left once.
-            // [a0,a1,a2,a3] becomes [a1,a2,a3,a0]
-
-            // Function RotWord()
-            {
-                k = tempa[0];
-                tempa[0] = tempa[1];
-                tempa[1] = tempa[2];
-                tempa[2] = tempa[3];
-                tempa[3] = k;
-            }
-
-            // SubWord() is a function that takes a four-byte input word and
-            // applies the S-box to each of the four bytes to produce an output word.
-
-            // Function Subword()
-            {
-                tempa[0] = getSBoxValue(tempa[0]);
-                tempa[1] = getSBoxValue(tempa[1]);
-                tempa[2] = getSBoxValue(tempa[2]);
-                tempa[3] = getSBoxValue(tempa[3]);
-            }
-
-            tempa[0] =  tempa[0] ^ Rcon[i/Nk];
-        }
-        else if (Nk > 6 && i % Nk == 4)
-        {
-            // Function Subword()
-            {
-                tempa[0] = getSBoxValue(tempa[0]);
-                tempa[1] = getSBoxValue(tempa[1]);
-                tempa[2] = getSBoxValue(tempa[2]);
-                tempa[3] = getSBoxValue(tempa[3]);
-            }
+            // RotWord() rotates the 4 bytes in a word to the left once: [a0,a1,a2,a3] becomes [a1,a2,a3,a0]
+            tempa = (tempa >> 8) | (tempa << 24);
+
+            // SubWord() applies the S-box to each of the four bytes to produce an output word.
+            tempa = (uint32_t)getSBoxValue(tempa & 0xFF) | ((uint32_t)getSBoxValue((tempa >> 8) & 0xFF) << 8) |
+                    ((uint32_t)getSBoxValue((tempa >> 16) & 0xFF) << 16) | ((uint32_t)getSBoxValue(tempa >> 24) << 24);
+
+            tempa ^= Rcon[i/Nk];
         }
-        RoundKey[i * 4 + 0] = RoundKey[(i - Nk) * 4 + 0] ^ tempa[0];
-        RoundKey[i * 4 + 1] = RoundKey[(i - Nk) * 4 + 1] ^ tempa[1];
-        RoundKey[i * 4 + 2] = RoundKey[(i - Nk) * 4 + 2] ^ tempa[2];
-        RoundKey[i * 4 + 3] = RoundKey[(i - Nk) * 4 + 3] ^ tempa[3];
+        RoundKey[i] = RoundKey[i - Nk] ^ tempa;
     }
 }
 
 // This function adds the round key to state.
 // The round key is added to the state by an XOR function.
-static void AddRoundKey(uint8_t round)
+static void AddRoundKey(state_t *state, const uint32_t *RoundKey, uint8_t round)
 {
     uint8_t i, j;
 
@@ -257,14 +213,14 @@ static void AddRoundKey(uint8_t round)
     {
         for (j = 0; j < 4; ++j)
         {
-            (*state)[i][j] ^= RoundKey[round * Nb * 4 + i * Nb + j];
+            (*state)[i][j] ^= RoundKey[round * Nb + i] >> (8 * j);
         }
     }
 }
 
 // The SubBytes Function Substitutes the values in the
 // state matrix with values in an S-box.
-static void SubBytes(void)
+static void SubBytes(state_t *state)
 {
     uint8_t i, j;
 
@@ -280,7 +236,7 @@ static void SubBytes(void)
 // The ShiftRows() function shifts the rows in the state to the left.
 // Each row is shifted with different offset.
 // Offset = Row number. So the first row is not shifted.
-static void ShiftRows(void)
+static void ShiftRows(state_t *state)
 {
     uint8_t temp;
 
@@ -314,7 +270,7 @@ static uint8_t xtime(uint8_t x)
 }
 
 // MixColumns function mixes the columns of the state matrix
-static void MixColumns(void)
+static void MixColumns(state_t *state)
 {
     uint8_t i;
     uint8_t Tmp, Tm, t;
@@ -353,7 +309,7 @@ static uint8_t Multiply(uint8_t x, uint8_t y)
 // MixColumns function mixes the columns of the state matrix.
 // The method used to multiply may be difficult to understand for the inexperienced.
 // Please use the references to gain more information.
-static void InvMixColumns(void)
+static void InvMixColumns(state_t *state)
 {
     int i;
     uint8_t a, b, c, d;
@@ -375,7 +331,7 @@ static void InvMixColumns(void)
 
 // The SubBytes Function Substitutes the values in the
 // state matrix with values in an S-box.
-static void InvSubBytes(void)
+static void InvSubBytes(state_t *state)
 {
     uint8_t i, j;
 
@@ -388,7 +344,7 @@ static void InvSubBytes(void)
     }
 }
 
-static void InvShiftRows(void)
+static void InvShiftRows(state_t *state)
 {
     uint8_t temp;
 
@@ -418,57 +374,57 @@ static void InvShiftRows(void)
 
 
 // Cipher is the main function that encrypts the PlainText.
-static void Cipher(void)
+static void Cipher(state_t *state, const uint32_t *RoundKey)
 {
     uint8_t round = 0;
 
     // Add the First round key to the state before starting the rounds.
-    AddRoundKey(0);
+    AddRoundKey(state, RoundKey, 0);
 
     // There will be Nr rounds.
     // The first Nr-1 rounds are identical.
     // These Nr-1 rounds are executed in the loop below.
     for (round = 1; round < Nr; ++round)
     {
-      SubBytes();
-      ShiftRows();
-      MixColumns();
-      AddRoundKey(round);
+      SubBytes(state);
+      ShiftRows(state);
+      MixColumns(state);
+      AddRoundKey(state, RoundKey, round);
     }
 
     // The last round is given below.
     // The MixColumns function is not here in the last round.
-    SubBytes();
-    ShiftRows();
-    AddRoundKey(Nr);
+    SubBytes(state);
+    ShiftRows(state);
+    AddRoundKey(state, RoundKey, Nr);
 }
 
-static void InvCipher(void)
+static void InvCipher(state_t *state, const uint32_t *RoundKey)
 {
     uint8_t round = 0;
 
     // Add the First round key to the state before starting the rounds.
-    AddRoundKey(Nr);
+    AddRoundKey(state, RoundKey, Nr);
 
     // There will be Nr rounds.
     // The first Nr-1 rounds are identical.
     // These Nr-1 rounds are executed in the loop below.
     for (round = Nr-1; round > 0; round--)
     {
-      InvShiftRows();
-      InvSubBytes();
-      AddRoundKey(round);
-      InvMixColumns();
+      InvShiftRows(state);
+      InvSubBytes(state);
+      AddRoundKey(state, RoundKey, round);
+      InvMixColumns(state);
     }
 
     // The last round is given below.
     // The MixColumns function is not here in the last round.
-    InvShiftRows();
-    InvSubBytes();
-    AddRoundKey(0);
+    InvShiftRows(state);
+    InvSubBytes(state);
+    AddRoundKey(state, RoundKey, 0);
 }
 
-static void BlockCopy(uint8_t *output, uint8_t *input)
+static void BlockCopy(uint8_t *output, const uint8_t *input)
 {
     uint8_t i;
 
@@ -478,65 +434,82 @@ static void BlockCopy(uint8_t *output, uint8_t *input)
     }
 }
 
+void aes_tiny_encrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output)
+{
+    // Copy input to output, and work in-memory on output
+    BlockCopy(output, input);
+    Cipher((state_t *)output, ctx->round_keys);
+}
+
+void aes_tiny_decrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output)
+{
+    // Copy input to output, and work in-memory on output
+    BlockCopy(output, input);
+    InvCipher((state_t *)output, ctx->round_keys);
+}
+
+#if AES_BACKEND == AES_BACKEND_HW
+/*
+ * Hardware engines (see hwaes.h) take the plain key and do the key expansion themselves.
+ * The functions expect inputs of 128 bit length = 16 bytes.
+ */
+static void aes_hw_encrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output)
+{
+    hw_aes_ecb128(output, input, AES_BLOCK_SIZE, ctx->key, true);
+}
 
+static void aes_hw_decrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output)
+{
+    hw_aes_ecb128(output, input, AES_BLOCK_SIZE, ctx->key, false);
+}
+#endif
 
 /*****************************************************************************/
 /* Public functions:                                                         */
 /*****************************************************************************/
 
+void AES128_ctx_init(aes128_ctx_t *ctx, const uint8_t *key)
+{
+    memcpy(ctx->key, key, KEYLEN);
+#if AES_BACKEND != AES_BACKEND_HW
+    KeyExpansion(ctx->round_keys, key);
+#endif
+}
+
 void AES128_init(const uint8_t *key)
 {
-    memcpy(AES128_key, key, KEYLEN);
-    Key = AES128_key;
-    KeyExpansion();
+    AES128_ctx_init(&NG(aes_default_ctx), key);
 }
 
 #if defined(ECB) && ECB
 
+void AES128_ECB_encrypt_ctx(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output)
+{
+    aes_backend_encrypt_block(ctx, input, output);
+}
 
-void AES128_ECB_encrypt(uint8_t *input, uint8_t *output)
+void AES128_ECB_decrypt_ctx(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output)
 {
-#ifdef HAL_SUPPORT_HW_AES
-    /*
-     * Hardware AES support for ECB through the low level peripheral library EMLIB
-     * The functions AES128_ECB_encrypt() expects inputs of 128 bit length = 16 bytes.
-     */
-    hw_aes_ecb128(output, input, 16, Key, true);
-#else
-    // Copy input to output, and work in-memory on output
-    BlockCopy(output, input);
-    state = (state_t *)output;
+    aes_backend_decrypt_block(ctx, input, output);
+}
 
-    // The next function call encrypts the PlainText with the Key using AES algorithm.
-    Cipher();
-#endif // HAL_SUPPORT_HW_AES
+void AES128_ECB_encrypt(uint8_t *input, uint8_t *output)
+{
+    aes_backend_encrypt_block(&NG(aes_default_ctx), input, output);
 }
 
 void AES128_ECB_decrypt(uint8_t *input, uint8_t *output)
 {
-#ifdef HAL_SUPPORT_HW_AES
-    /*
-     * Hardware AES support for ECB through the low level peripheral library EMLIB
-     * The functions AES128_ECB_decrypt() expects inputs of 128 bit length = 16 bytes.
-     */
-    hw_aes_ecb128(output, input, 16, Key, false);
-#else
-    // Copy input to output, and work in-memory on output
-    BlockCopy(output, input);
-    state = (state_t *)output;
-
-    InvCipher();
-#endif // HAL_SUPPORT_HW_AES
+    aes_backend_decrypt_block(&NG(aes_default_ctx), input, output);
 }
 
-
 #endif // #if defined(ECB) && ECB
 
 
 #if defined(CBC) && CBC
 
 
-static void XorWithIv(uint8_t *buf)
+static void XorWithIv(uint8_t *buf, const uint8_t *Iv)
 {
     uint8_t i;
 
@@ -546,26 +519,21 @@ static void XorWithIv(uint8_t *buf)
     }
 }
 
-void AES128_CBC_encrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length, const uint8_t *iv)
+void AES128_CBC_encrypt_buffer_ctx(const aes128_ctx_t *ctx, uint8_t *output, const uint8_t *input, uint32_t length, const uint8_t *iv)
 {
-#ifdef HAL_SUPPORT_HW_AES
+#if AES_BACKEND == AES_BACKEND_HW
     // Hardware AES support for CBC through the low level peripheral library EMLIB
-    hw_aes_cbc128(output, input, length, Key, iv, true);
+    hw_aes_cbc128(output, input, length, ctx->key, iv, true);
 #else
     uintptr_t i;
     uint8_t remainders = length % KEYLEN; /* Remaining bytes in the last non-full block */
-
-    if (iv != 0)
-    {
-        Iv = (uint8_t *)iv;
-    }
+    const uint8_t *Iv = iv;
 
     for(i = KEYLEN; i <= length; i += KEYLEN)
     {
         BlockCopy(output, input);
-        XorWithIv(output);
-        state = (state_t *)output;
-        Cipher();
+        XorWithIv(output, Iv);
+        aes_backend_encrypt_block(ctx, output, output);
         Iv = output;
         input += KEYLEN;
         output += KEYLEN;
@@ -575,40 +543,45 @@ void AES128_CBC_encrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length,
     {
         BlockCopy(output, input);
         memset(output + remainders, 0, KEYLEN - remainders); /* add 0-padding */
-        XorWithIv(output);
-        state = (state_t *)output;
-        Cipher();
+        XorWithIv(output, Iv);
+        aes_backend_encrypt_block(ctx, output, output);
     }
-#endif // HAL_SUPPORT_HW_AES
+#endif
 }
 
-void AES128_CBC_decrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length, const uint8_t *iv)
+void AES128_CBC_decrypt_buffer_ctx(const aes128_ctx_t *ctx, uint8_t *output, const uint8_t *input, uint32_t length, const uint8_t *iv)
 {
-#ifdef HAL_SUPPORT_HW_AES
+#if AES_BACKEND == AES_BACKEND_HW
     // Hardware AES support for CBC through the low level peripheral library EMLIB
-    hw_aes_cbc128(output, input, length, Key, iv, false);
+    hw_aes_cbc128(output, input, length, ctx->key, iv, false);
 #else
     uintptr_t i;
+    uint8_t Iv[KEYLEN];
+    uint8_t next_iv[KEYLEN];
 
-    // If iv is passed as 0, we continue to encrypt without re-setting the Iv
-    if (iv != 0)
-    {
-        Iv = (uint8_t *)iv;
-    }
-
+    BlockCopy(Iv, iv);
     for(i = KEYLEN; i <= length; i += KEYLEN)
     {
-        BlockCopy(output, input);
-        state = (state_t *)output;
-        InvCipher();
-        XorWithIv(output);
-        Iv = input;
+        // keep the cipher text as it is the next IV, output may overlap input
+        BlockCopy(next_iv, input);
+        aes_backend_decrypt_block(ctx, input, output);
+        XorWithIv(output, Iv);
+        BlockCopy(Iv, next_iv);
         input += KEYLEN;
         output += KEYLEN;
     }
-#endif // HAL_SUPPORT_HW_AES
+#endif
 }
 
+void AES128_CBC_encrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length, const uint8_t *iv)
+{
+    AES128_CBC_encrypt_buffer_ctx(&NG(aes_default_ctx), output, input, length, iv);
+}
+
+void AES128_CBC_decrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length, const uint8_t *iv)
+{
+    AES128_CBC_decrypt_buffer_ctx(&NG(aes_default_ctx), output, input, length, iv);
+}
 
 #endif // #if defined(CBC) && CBC
 
@@ -631,25 +604,21 @@ void AES128_CBC_decrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length,
  * the most significant bits.
  */
 
-void AES128_CTR_encrypt(uint8_t *output, uint8_t *input, uint32_t length, uint8_t *ctr_blk)
+void AES128_CTR_encrypt_ctx(const aes128_ctx_t *ctx, uint8_t *output, const uint8_t *input, uint32_t length, uint8_t *ctr_blk)
 {
-#ifdef HAL_SUPPORT_HW_AES
+#if AES_BACKEND == AES_BACKEND_HW
     // Hardware AES support for CTR through the low level peripheral library EMLIB
-    hw_aes_ctr128(output, input, length, Key, ctr_blk);
+    hw_aes_ctr128(output, input, length, ctx->key, ctr_blk);
 #else
     uintptr_t i, j;
     uint8_t remainders = length % KEYLEN; /* Remaining bytes in the last non-full block */
     uint8_t ctr[KEYLEN];
 
-    BlockCopy(ctr, ctr_blk);
-    state = (state_t *)ctr;
-
     for(i = KEYLEN; i <= length; i += KEYLEN)
     {
-        Cipher();
-        BlockCopy(output, input);
+        aes_backend_encrypt_block(ctx, ctr_blk, ctr);
         for (j = 0; j < KEYLEN; j++)
-            output[j] ^= ctr[j];
+            output[j] = input[j] ^ ctr[j];
 
         /* Increment block counter */
         for (j = 0; j < KEYLEN; j++)
@@ -661,16 +630,20 @@ void AES128_CTR_encrypt(uint8_t *output, uint8_t *input, uint32_t length, uint8_
 
         input += KEYLEN;
         output += KEYLEN;
-        BlockCopy(ctr, ctr_blk);
     }
 
     if(remainders)
     {
-        Cipher();
+        aes_backend_encrypt_block(ctx, ctr_blk, ctr);
         for (i=0; i < remainders; ++i)
             output[i] = input[i] ^ ctr[i];
     }
 #endif
 }
 
+void AES128_CTR_encrypt(uint8_t *output, uint8_t *input, uint32_t length, uint8_t *ctr_blk)
+{
+    AES128_CTR_encrypt_ctx(&NG(aes_default_ctx), output, input, length, ctr_blk);
+}
+
 #endif // #if defined(CTR) && CTR
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file aes_aesni.c
+ *
+ * AES-128 block encryption and decryption using the AES-NI instructions, for NATIVE builds on x86.
+ * The expanded key layout of aes128_ctx_t matches the byte order of the round keys in memory.
+ * The functions are compiled for AES-NI using the target attribute, so the rest of the build
+ * does not depend on it, and fall back to the TINY code when the CPU does not support AES-NI.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "aes.h"
+#include "aes_backend.h"
+
+#if AES_BACKEND == AES_BACKEND_AESNI
+
+#include <wmmintrin.h>
+
+static bool aesni_supported(void)
+{
+    static int supported = -1;
+
+    if (supported < 0)
+        supported = __builtin_cpu_supports("aes") ? 1 : 0;
+
+    return supported;
+}
+
+__attribute__((target("aes,sse2")))
+static void aesni_encrypt(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output)
+{
+    const __m128i *rk = (const __m128i *)ctx->round_keys;
+    __m128i block = _mm_xor_si128(_mm_loadu_si128((const __m128i *)input), _mm_loadu_si128(&rk[0]));
+
+    for (uint8_t round = 1; round < AES128_ROUNDS; round++)
+        block = _mm_aesenc_si128(block, _mm_loadu_si128(&rk[round]));
+
+    block = _mm_aesenclast_si128(block, _mm_loadu_si128(&rk[AES128_ROUNDS]));
+    _mm_storeu_si128((__m128i *)output, block);
+}
+
+__attribute__((target("aes,sse2")))
+static void aesni_decrypt(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output)
+{
+    const __m128i *rk = (const __m128i *)ctx->round_keys;
+    __m128i block = _mm_xor_si128(_mm_loadu_si128((const __m128i *)input), _mm_loadu_si128(&rk[AES128_ROUNDS]));
+
+    // equivalent inverse cipher, the round keys are transformed with InvMixColumns on the fly
+    for (uint8_t round = AES128_ROUNDS - 1; round > 0; round--)
+        block = _mm_aesdec_si128(block, _mm_aesimc_si128(_mm_loadu_si128(&rk[round])));
+
+    block = _mm_aesdeclast_si128(block, _mm_loadu_si128(&rk[0]));
+    _mm_storeu_si128((__m128i *)output, block);
+}
+
+void aes_aesni_encrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output)
+{
+    if (aesni_supported())
+        aesni_encrypt(ctx, input, output);
+    else
+        aes_tiny_encrypt_block(ctx, input, output);
+}
+
+void aes_aesni_decrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output)
+{
+    if (aesni_supported())
+        aesni_decrypt(ctx, input, output);
+    else
+        aes_tiny_decrypt_block(ctx, input, output);
+}
+
+#endif // AES_BACKEND == AES_BACKEND_AESNI
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file aes_backend.h
+ *
+ * Interface between the AES modes of operation and the block cipher implementations.
+ * The backend is selected at build time using FRAMEWORK_AES_BACKEND:
+ *  - TINY: byte oriented implementation computing MixColumns on the fly, smallest footprint
+ *  - TTABLE: 32 bit implementation using a single 1 KiB table, for 32 bit MCUs and NATIVE
+ *  - AESNI: AES-NI instructions, NATIVE builds on x86 only. Falls back to TINY when the CPU lacks AES-NI
+ *  - HW: the hardware engine of the platform, see hwaes.h
+ * Decryption is not used by CTR and CCM, the TTABLE backend decrypts using the TINY code.
+ */
+
+#ifndef AES_BACKEND_H_
+#define AES_BACKEND_H_
+
+#include "aes.h"
+#include "framework_defs.h"
+#include "ng.h"
+
+#define AES_BACKEND_TINY   0
+#define AES_BACKEND_TTABLE 1
+#define AES_BACKEND_AESNI  2
+#define AES_BACKEND_HW     3
+
+#ifndef FRAMEWORK_AES_BACKEND
+#define FRAMEWORK_AES_BACKEND TINY
+#endif
+
+#define __AES_CONCAT2(a, b) a ## b
+#define __AES_CONCAT(a, b) __AES_CONCAT2(a, b)
+#define AES_BACKEND __AES_CONCAT(AES_BACKEND_, FRAMEWORK_AES_BACKEND)
+
+extern aes128_ctx_t NGDEF(aes_default_ctx);
+
+void aes_tiny_encrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output);
+void aes_tiny_decrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output);
+void aes_ttable_encrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output);
+void aes_aesni_encrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output);
+void aes_aesni_decrypt_block(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output);
+
+#if AES_BACKEND == AES_BACKEND_TINY
+#define aes_backend_encrypt_block aes_tiny_encrypt_block
+#define aes_backend_decrypt_block aes_tiny_decrypt_block
+#elif AES_BACKEND == AES_BACKEND_TTABLE
+#define aes_backend_encrypt_block aes_ttable_encrypt_block
+#define aes_backend_decrypt_block aes_tiny_decrypt_block
+#elif AES_BACKEND == AES_BACKEND_AESNI
+#define aes_backend_encrypt_block aes_aesni_encrypt_block
+#define aes_backend_decrypt_block aes_aesni_decrypt_block
+#elif AES_BACKEND == AES_BACKEND_HW
+#define aes_backend_encrypt_block aes_hw_encrypt_block
+#define aes_backend_decrypt_block aes_hw_decrypt_block
+#else
+#error "Unknown FRAMEWORK_AES_BACKEND"
+#endif
+
+#endif // AES_BACKEND_H_
@@ -29,6 +29,7 @@
 #include <string.h> // CBC mode, for memset
 #include "stdbool.h"
 #include "aes.h"
+#include "aes_backend.h"
 #include "types.h"
 #include "errors.h"
 #include "log.h"
@@ -58,6 +59,156 @@ static void xor_aes_block(uint8_t *dst, const uint8_t *src)
     }
 }
 
+/*
+ * Running state of a CCM operation. The CBC-MAC and the CTR keystream advance
+ * together so each payload block is read and written only once.
+ */
+typedef struct {
+    const aes128_ctx_t *ctx;
+    uint8_t mac[AES_BLOCK_SIZE];       // X_i, the CBC-MAC chaining value
+    uint8_t ctr[AES_BLOCK_SIZE];       // A_i, the next counter block
+    uint8_t keystream[AES_BLOCK_SIZE]; // E(K, A_i) for the current block
+    uint8_t pos;                       // offset in the current block
+} ccm_state_t;
+
+static uint16_t sg_total_len(const aes_sg_t *sg, uint8_t cnt)
+{
+    uint16_t len = 0;
+
+    while (cnt--)
+        len += (sg++)->len;
+
+    return len;
+}
+
+static void ccm_increment_counter(uint8_t *ctr)
+{
+    uint8_t j;
+
+    for (j = 0; j < AES_BLOCK_SIZE; j++)
+    {
+        ctr[j]++;
+        if (ctr[j])
+            break;
+    }
+}
+
+static void ccm_mac_update(ccm_state_t *s, const uint8_t *data, uint16_t len)
+{
+    while (len)
+    {
+        if (s->pos == 0 && len >= AES_BLOCK_SIZE)
+        {
+            /* X_i+1 = E(K, X_i XOR B_i) */
+            xor_aes_block(s->mac, data);
+            AES128_ECB_encrypt_ctx(s->ctx, s->mac, s->mac);
+            data += AES_BLOCK_SIZE;
+            len -= AES_BLOCK_SIZE;
+            continue;
+        }
+
+        s->mac[s->pos++] ^= *data++;
+        len--;
+        if (s->pos == AES_BLOCK_SIZE)
+        {
+            AES128_ECB_encrypt_ctx(s->ctx, s->mac, s->mac);
+            s->pos = 0;
+        }
+    }
+}
+
+/* Zero-pads the current block into the CBC-MAC */
+static void ccm_mac_finish_block(ccm_state_t *s)
+{
+    if (s->pos)
+    {
+        AES128_ECB_encrypt_ctx(s->ctx, s->mac, s->mac);
+        s->pos = 0;
+    }
+}
+
+/*
+ * Encrypts or decrypts data in place and feeds the plain text into the CBC-MAC,
+ * one block at a time.
+ */
+static void ccm_crypt_update(ccm_state_t *s, uint8_t *data, uint16_t len, bool encrypt)
+{
+    uint8_t i;
+
+    while (len)
+    {
+        if (s->pos == 0)
+        {
+            AES128_ECB_encrypt_ctx(s->ctx, s->ctr, s->keystream);
+            ccm_increment_counter(s->ctr);
+
+            if (len >= AES_BLOCK_SIZE)
+            {
+                for (i = 0; i < AES_BLOCK_SIZE; i++)
+                {
+                    uint8_t in = data[i];
+                    uint8_t out = in ^ s->keystream[i];
+
+                    s->mac[i] ^= encrypt ? in : out;
+                    data[i] = out;
+                }
+
+                AES128_ECB_encrypt_ctx(s->ctx, s->mac, s->mac);
+                data += AES_BLOCK_SIZE;
+                len -= AES_BLOCK_SIZE;
+                continue;
+            }
+        }
+
+        uint8_t in = *data;
+        uint8_t out = in ^ s->keystream[s->pos];
+
+        s->mac[s->pos++] ^= encrypt ? in : out;
+        *data++ = out;
+        len--;
+        if (s->pos == AES_BLOCK_SIZE)
+        {
+            AES128_ECB_encrypt_ctx(s->ctx, s->mac, s->mac);
+            s->pos = 0;
+        }
+    }
+}
+
+/*
+ * Computes X_1 = E(K, B_0) and authenticates the additional data.
+ *
+ * For DASH7, the additional data length is encoded in a single octet in front
+ * of the additional data.
+ */
+static error_t ccm_start(ccm_state_t *s, const aes128_ctx_t *ctx, const uint8_t *iv,
+                         const aes_sg_t *add, uint8_t add_cnt)
+{
+    uint16_t add_len = sg_total_len(add, add_cnt);
+    uint8_t add_len_octet = add_len;
+
+    if (add_len > 0xFF)
+        return EINVAL;
+
+    s->ctx = ctx;
+    s->pos = 0;
+
+    /* X_1 = E(K, B_0) */
+    DPRINT("Blk0");
+    DPRINT_DATA((uint8_t *)iv, AES_BLOCK_SIZE);
+    AES128_ECB_encrypt_ctx(ctx, iv, s->mac);
+
+    if (add_len)
+    {
+        ccm_mac_update(s, &add_len_octet, 1);
+        for (; add_cnt; add_cnt--, add++)
+            ccm_mac_update(s, add->data, add->len);
+
+        ccm_mac_finish_block(s);
+    }
+
+    return SUCCESS;
+}
+
 /*
  * Authentication
  *
@@ -66,13 +217,12 @@ static void xor_aes_block(uint8_t *dst, const uint8_t *src)
  * 
  */
 
-error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const uint8_t *iv,
-                        const uint8_t *add, uint8_t add_len, uint8_t auth_len )
+error_t AES128_CBC_MAC_ctx( const aes128_ctx_t *ctx, uint8_t *auth, const uint8_t *payload, uint8_t length,
+                            const uint8_t *iv, const uint8_t *add, uint8_t add_len, uint8_t auth_len )
 {
-    uint8_t blk[AES_BLOCK_SIZE];
-    uint8_t i;
-    uint8_t remainders;
-    uint8_t tag[AES_BLOCK_SIZE];
+    ccm_state_t s;
+    aes_sg_t add_sg = { .data = (uint8_t *)add, .len = add_len };
+    error_t ret;
 
     /* sanity checks */
     if (auth_len != 4 && auth_len != 8 && auth_len != 16)
@@ -91,97 +241,116 @@ error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const u
      * X_i+1 := E( K, X_i XOR B_i )  for i=1, ..., n
      * T := first-M-bytes( X_n+1 )
      */
+    ret = ccm_start(&s, ctx, iv, &add_sg, 1);
+    if (ret != SUCCESS)
+        return ret;
 
-    /* X_1 = E(K, B_0) */
-    DPRINT("Blk0");
-    DPRINT_DATA((uint8_t *)iv, AES_BLOCK_SIZE);
-    AES128_ECB_encrypt((uint8_t *)iv, tag);
-    DPRINT("X_1 = AES(B_0)");
-    DPRINT_DATA(tag, AES_BLOCK_SIZE);
+    ccm_mac_update(&s, payload, length);
+    ccm_mac_finish_block(&s);
 
-    // if add_len > 0, add more blocks of authentication data
-    if (add_len > 0)
-    {
-        uint8_t use_len = add_len < AES_BLOCK_SIZE - 1 ? add_len : AES_BLOCK_SIZE - 1;
-        uint8_t remainders = add_len - use_len;
+    DPRINT("CBC-MAC");
+    DPRINT_DATA(s.mac, AES_BLOCK_SIZE);
 
-        memset(blk, 0, AES_BLOCK_SIZE);
-        // For DASH7, the additional data length shall be encoded in a field of 1 octet.
-        blk[0] = add_len;
+    memcpy(auth, s.mac, auth_len);
 
-        memcpy( blk + 1, add, use_len );
+    return SUCCESS;
+}
 
-        DPRINT("Blk1");
-        DPRINT_DATA(blk, AES_BLOCK_SIZE);
+/*
+ * Authenticated encryption in a single pass
+ *
+ * The counter block A_i is derived from ctr_blk, the lower 4 bits of its first
+ * byte hold the block counter. A_0 is used to encrypt the authentication tag,
+ * the payload is encrypted starting from A_1.
+ */
+error_t AES128_CCM_encrypt_sg( const aes128_ctx_t *ctx, const uint8_t *iv, const uint8_t *ctr_blk,
+                               const aes_sg_t *add, uint8_t add_cnt,
+                               const aes_sg_t *payload, uint8_t payload_cnt,
+                               uint8_t *auth, uint8_t auth_len )
+{
+    ccm_state_t s;
+    error_t ret;
+    uint8_t i;
 
-        xor_aes_block(blk, tag);
-        DPRINT("X_1 XOR B_1");
-        DPRINT_DATA(blk, AES_BLOCK_SIZE);
-        /* X_2 = E(K, X_1 XOR B_1) */
-        AES128_ECB_encrypt(blk, tag);
-        DPRINT("X_2 = AES(X_1 XOR B_1)");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
+    /* sanity checks */
+    if (auth_len != 4 && auth_len != 8 && auth_len != 16)
+        return EINVAL;
 
-        if (remainders)
-        {
-            memset(blk, 0, AES_BLOCK_SIZE);
-            memcpy(blk, add + use_len, remainders);
-
-            DPRINT("blk2");
-            DPRINT_DATA(blk, AES_BLOCK_SIZE);
-
-            DPRINT("X_2 XOR B_2");
-            xor_aes_block(blk, tag);
-             /* X_3 = E(K, X_2 XOR B_2) */
-            AES128_ECB_encrypt(blk, tag);
-            DPRINT("X_3 = AES(X_1 XOR B_1)");
-            DPRINT_DATA(tag, AES_BLOCK_SIZE);
-        }
-    }
+    ret = ccm_start(&s, ctx, iv, add, add_cnt);
+    if (ret != SUCCESS)
+        return ret;
 
-    remainders = length % AES_BLOCK_SIZE; /* Remaining bytes in the last non-full block */
-    DPRINT("Remainders %d length %d", remainders, length);
+    memcpy(s.ctr, ctr_blk, AES_BLOCK_SIZE);
+    s.ctr[0] = (ctr_blk[0] & 0xF0) + 1;
 
-    for (i = 0; i < length / AES_BLOCK_SIZE; i++)
-    {
-        DPRINT("Xi");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
+    for (; payload_cnt; payload_cnt--, payload++)
+        ccm_crypt_update(&s, payload->data, payload->len, true);
+
+    ccm_mac_finish_block(&s);
 
-        DPRINT("B_i");
-        DPRINT_DATA(payload, AES_BLOCK_SIZE);
+    DPRINT("Authentication tag:");
+    DPRINT_DATA(s.mac, auth_len);
 
-        /* X_i+1 = E(K, X_i XOR B_i) */
-        xor_aes_block(tag, payload);
-        DPRINT("X_i XOR B_i");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
+    /* Encryption of the authentication tag with the counter reset to 0 */
+    s.ctr[0] = (ctr_blk[0] & 0xF0);
+    memcpy(s.ctr + 1, ctr_blk + 1, AES_BLOCK_SIZE - 1);
+    AES128_ECB_encrypt_ctx(ctx, s.ctr, s.keystream);
 
-        payload += AES_BLOCK_SIZE;
+    // the 4, 8 or 16 MSB of the MAC are the authentication tag
+    for (i = 0; i < auth_len; i++)
+        auth[i] = s.mac[i] ^ s.keystream[i];
 
-        AES128_ECB_encrypt(tag, tag);
-        DPRINT("X_i+1 = E(K, X_i XOR B_i)");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
-    }
+    DPRINT("Encrypted authentication tag:");
+    DPRINT_DATA(auth, auth_len);
 
-    if (remainders)
-    {
-        /* XOR zero-padded last block */
-        DPRINT("Xi");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
+    return SUCCESS;
+}
+
+/*
+ * Authenticated decryption in a single pass
+ */
+error_t AES128_CCM_decrypt_sg( const aes128_ctx_t *ctx, const uint8_t *iv, const uint8_t *ctr_blk,
+                               const aes_sg_t *add, uint8_t add_cnt,
+                               const aes_sg_t *payload, uint8_t payload_cnt,
+                               const uint8_t *auth, uint8_t auth_len )
+{
+    ccm_state_t s;
+    error_t ret;
+    uint8_t i;
+    uint8_t diff = 0;
+
+    /* sanity checks */
+    if (auth_len != 4 && auth_len != 8 && auth_len != 16)
+        return EINVAL;
 
-        DPRINT("B_i");
-        DPRINT_DATA(payload, AES_BLOCK_SIZE);
+    ret = ccm_start(&s, ctx, iv, add, add_cnt);
+    if (ret != SUCCESS)
+        return ret;
 
-        for (i = 0; i < remainders; i++)
-            tag[i] ^= *payload++;
-        DPRINT("X_i XOR B_i");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
+    memcpy(s.ctr, ctr_blk, AES_BLOCK_SIZE);
+    s.ctr[0] = (ctr_blk[0] & 0xF0) + 1;
 
-        AES128_ECB_encrypt(tag, tag);
-        DPRINT("X_i+1 = E(K, X_i XOR B_i)");
-        DPRINT_DATA(tag, AES_BLOCK_SIZE);
-    }
+    for (; payload_cnt; payload_cnt--, payload++)
+        ccm_crypt_update(&s, payload->data, payload->len, false);
 
-    memcpy(auth, tag, auth_len);
+    ccm_mac_finish_block(&s);
+
+    DPRINT("Computed authentication tag:");
+    DPRINT_DATA(s.mac, auth_len);
+
+    /* Decryption of the encrypted authentication Tag, counter reset to 0 */
+    s.ctr[0] = (ctr_blk[0] & 0xF0);
+    memcpy(s.ctr + 1, ctr_blk + 1, AES_BLOCK_SIZE - 1);
+    AES128_ECB_encrypt_ctx(ctx, s.ctr, s.keystream);
+
+    for (i = 0; i < auth_len; i++)
+        diff |= s.mac[i] ^ s.keystream[i] ^ auth[i];
+
+    if (diff)
+    {
+        DPRINT("CCM: Auth mismatch");
+        return -1;
+    }
 
     return SUCCESS;
 }
@@ -192,13 +361,12 @@ error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const u
  * Ensure that the output is sized to contain the encrypted message payload
  * + the encrypted authentication Tag.
  */
-error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
-                            const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
-                            uint8_t auth_len )
+error_t AES128_CCM_encrypt_ctx( const aes128_ctx_t *ctx, uint8_t *payload, uint8_t length, const uint8_t *iv,
+                                const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
+                                uint8_t auth_len )
 {
-    uint8_t auth[AES_BLOCK_SIZE];
-    uint8_t auth_crypted[AES_BLOCK_SIZE];
-    error_t ret;
+    aes_sg_t add_sg = { .data = (uint8_t *)add, .len = add_len };
+    aes_sg_t payload_sg = { .data = payload, .len = length };
 
     /* sanity checks */
     if (auth_len != 4 && auth_len != 8 && auth_len != 16)
@@ -211,45 +379,19 @@ error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
     if (add_len > (2 * AES_BLOCK_SIZE - 1))
         return EINVAL;
 
-    /* Authentication */
-    ret = AES128_CBC_MAC(auth, payload, length, iv, add, add_len, auth_len);
-    if (ret != SUCCESS)
-        return ret;
-
-    DPRINT("Authentication tag:");
-    DPRINT_DATA(auth, auth_len);
-
-    /* Encryption with Counter (CTR) mode*/
-
-    /* Encryption of the message payload, counter set to 1 */
-    ctr_blk[0] = (ctr_blk[0] & 0xF0) + 1;
-    DPRINT("ctr0");
-    DPRINT_DATA(ctr_blk, AES_BLOCK_SIZE);
-
-    AES128_CTR_encrypt(payload, payload, length, ctr_blk);
-    DPRINT("CTR output:");
-    DPRINT_DATA(payload, length);
-
-    /* Encryption of the authentication tag , reset counter to 0*/
-    ctr_blk[0] = (ctr_blk[0] & 0xF0);
-    AES128_CTR_encrypt(auth_crypted, auth, auth_len, ctr_blk);
-    DPRINT("Encrypted authentication tag:");
-    DPRINT_DATA(auth_crypted, auth_len);
     // the 4, 8 or 16 MSB of the MAC are then appended to the payload
-    memcpy(payload + length, auth_crypted, auth_len);
-
-    return SUCCESS;
+    return AES128_CCM_encrypt_sg(ctx, iv, ctr_blk, &add_sg, 1, &payload_sg, 1, payload + length, auth_len);
 }
 
 /*
  * Authenticated decryption
  */
-error_t AES128_CCM_decrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
-                            const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
-                            const uint8_t *auth, uint8_t auth_len )
+error_t AES128_CCM_decrypt_ctx( const aes128_ctx_t *ctx, uint8_t *payload, uint8_t length, const uint8_t *iv,
+                                const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
+                                const uint8_t *auth, uint8_t auth_len )
 {
-    uint8_t T[AES_BLOCK_SIZE];
-    uint8_t auth_decrypted[AES_BLOCK_SIZE];
+    aes_sg_t add_sg = { .data = (uint8_t *)add, .len = add_len };
+    aes_sg_t payload_sg = { .data = payload, .len = length };
 
     /* sanity checks */
     if (auth_len != 4 && auth_len != 8 && auth_len != 16)
@@ -262,26 +404,25 @@ error_t AES128_CCM_decrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
     if (add_len > (2 * AES_BLOCK_SIZE - 1))
         return EINVAL;
 
-    /* Decryption of the encrypted authentication Tag */
-    ctr_blk[0] = (ctr_blk[0] & 0xF0);
-    AES128_CTR_encrypt(auth_decrypted, (uint8_t *)auth, auth_len, ctr_blk);
-    DPRINT("Decrypted authentication tag:");
-    DPRINT_DATA(auth_decrypted, auth_len);
-
-    /* Decryption of the message payload, counter set to 1 */
-    ctr_blk[0] = (ctr_blk[0] & 0xF0) + 1;
-    AES128_CTR_encrypt(payload, payload, length, ctr_blk);
+    return AES128_CCM_decrypt_sg(ctx, iv, ctr_blk, &add_sg, 1, &payload_sg, 1, auth, auth_len);
+}
 
-    /* Recompute the CBC-MAC and check the authentication Tag */
-    AES128_CBC_MAC(T, payload, length, iv, add, add_len, auth_len);
-    DPRINT("Computed authentication tag:");
-    DPRINT_DATA(T, auth_len);
+error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const uint8_t *iv,
+                        const uint8_t *add, uint8_t add_len, uint8_t auth_len )
+{
+    return AES128_CBC_MAC_ctx(&NG(aes_default_ctx), auth, payload, length, iv, add, add_len, auth_len);
+}
 
-    if (memcmp(T, auth_decrypted, auth_len) != 0)
-    {
-        DPRINT("CCM: Auth mismatch");
-        return -1;
-    }
+error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
+                            const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
+                            uint8_t auth_len )
+{
+    return AES128_CCM_encrypt_ctx(&NG(aes_default_ctx), payload, length, iv, add, add_len, ctr_blk, auth_len);
+}
 
-    return SUCCESS;
+error_t AES128_CCM_decrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
+                            const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
+                            const uint8_t *auth, uint8_t auth_len )
+{
+    return AES128_CCM_decrypt_ctx(&NG(aes_default_ctx), payload, length, iv, add, add_len, ctr_blk, auth, auth_len);
 }
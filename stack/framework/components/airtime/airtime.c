@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "airtime.h"
+
+#define RATE_ONE (1UL << AIRTIME_RATE_FRACTIONAL_BITS)
+
+// the divisions are only done when converting the settings into a rate
+static airtime_rate_t divide_rounding_up(uint64_t dividend, uint32_t divisor)
+{
+    return (airtime_rate_t)((dividend + divisor - 1) / divisor);
+}
+
+static uint32_t to_ticks(airtime_rate_t rate, uint32_t count)
+{
+    return (uint32_t)(((uint64_t)rate * count + RATE_ONE - 1) >> AIRTIME_RATE_FRACTIONAL_BITS);
+}
+
+airtime_rate_t airtime_fsk_rate(uint32_t bitrate, uint32_t ticks_per_sec)
+{
+    return divide_rounding_up((uint64_t)8 * ticks_per_sec * RATE_ONE, bitrate);
+}
+
+uint32_t airtime_fsk_ticks(airtime_rate_t rate, uint16_t length)
+{
+    return to_ticks(rate, length);
+}
+
+void airtime_lora_init(airtime_lora_t* lora, uint32_t ticks_per_sec)
+{
+    // a symbol takes 2^SF / bandwidth seconds
+    lora->rate = divide_rounding_up(((uint64_t)ticks_per_sec * RATE_ONE) << lora->spreading_factor, 4 * lora->bandwidth);
+}
+
+uint32_t airtime_lora_ticks(const airtime_lora_t* lora, uint16_t length)
+{
+    // the payload (and explicit header) is sent in blocks of 4 + CR symbols, carrying 4 * SF bits or 4 * (SF - 2) bits
+    // with the low data rate optimization, the first block is at least 8 symbols:
+    // 8 + max(ceil((8 * length - 4 * SF + 28 + 16 * CRC - 20 * IH) / (4 * (SF - 2 * DE))) * (CR + 4), 0)
+    int32_t payload_bits = 8 * (int32_t)length - 4 * lora->spreading_factor + 28
+                           + (lora->crc ? 16 : 0) - (lora->implicit_header ? 20 : 0);
+    uint32_t payload_symbols = 8;
+    if(payload_bits > 0)
+    {
+        uint32_t block_bits = 4 * (lora->spreading_factor - (lora->low_data_rate_optimize ? 2 : 0));
+        payload_symbols += (payload_bits + block_bits - 1) / block_bits * (lora->coding_rate + 4);
+    }
+
+    // the preamble is followed by 4.25 symbols of sync word and start frame delimiter
+    uint32_t quarter_symbols = 4 * (lora->preamble_length + payload_symbols) + 17;
+    return to_ticks(lora->rate, quarter_symbols);
+}
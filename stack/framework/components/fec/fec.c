@@ -1,64 +1,21 @@
-/*
- * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
- *
- * This file is part of Sub-IoT.
- * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- *     http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- *
- * \author glenn.ergeerts@uantwerpen.be
- * \author maarten.weyn@uantwerpen.be
- *	\author alexanderhoet@gmail.com
- *
- */
 
 #include <stdbool.h>
-#include <stddef.h>
-#include <stdint.h>
-#include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "fec.h"
 
-#define INITIAL_FECSTATE 0x00
 #define TRELLIS_TERMINATOR 0x0B
-#define FEC_BUFFER_SIZE 256
-
-#define INTERLEAVING
-
-//#ifdef D7_PHY_USE_FEC
 
-const static uint8_t fec_lut[16] = {0, 3, 1, 2, 3, 0, 2, 1, 3, 0, 2, 1, 0, 3, 1, 2};
-const static uint8_t trellis0_lut[8] = {0, 1, 3, 2, 3, 2, 0, 1};
-const static uint8_t trellis1_lut[8] = {3, 2, 0, 1, 0, 1, 3, 2};
+// initial cost (per unit of bit cost) of the trellis states the encoder does not start in
+#define UNKNOWN_STATE_COST 100
 
-static uint8_t data_buffer[FEC_BUFFER_SIZE];
-static uint8_t* input_buffer;
-static uint8_t* output_buffer;
-
-static uint16_t packetlength;
-static uint16_t fecpacketlength;
-static uint16_t output_packet_length;
-
-static uint8_t processedbytes;
-static uint16_t fecprocessedbytes;
-
-static uint16_t pn9;
-static uint16_t fecstate;
-static VITERBISTATE vstate;
-
-static bool fec_decode(uint8_t* input);
+// soft decision samples are scaled down to a cost between 0 and SOFT_BIT_COST per bit
+#define SOFT_BIT_COST 15
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_PHY_LOG_ENABLED) // TODO more granular (LOG_PHY_ENABLED)
 #define DPRINT(...) log_print_stack_string(LOG_STACK_PHY, __VA_ARGS__)
@@ -68,339 +25,278 @@ static bool fec_decode(uint8_t* input);
 #define DPRINT_DATA(...)
 #endif
 
-//void print_array(uint8_t* buffer, uint8_t length)
-//	for (i = 0; i < length; i++)
-//void print_array(uint8_t* buffer, uint8_t length)
-//{
-//	int i = 0;
-//	for (; i < length; i++)
-//	{
-//	    printf("%02X", buffer[i]);
-//	}
-//	printf(" ");
-//
-//	for (i = 0; i < length; i++)
-//	{
-//		printf("%s", byte_to_binary(buffer[i]));
-//	}
-//}
-
-const char *int_to_binary(uint16_t x)
-{
-    static char b[17];
-    b[0] = '\0';
-
-    uint16_t z;
-    for (z = 0x8000; z > 0; z >>= 1)
-    {
-        strcat(b, ((x & z) == z) ? "1" : "0");
-    }
-
-    return b;
-}
+// encoder output (4 symbols, first symbol in the MSBs) for an input nibble, indexed by
+// (3 previous input bits << 4) | nibble
+static const uint8_t fec_encode_lut[8 * 16] = {
+    0x00, 0x03, 0x0d, 0x0e, 0x37, 0x34, 0x3a, 0x39, 0xdf, 0xdc, 0xd2, 0xd1, 0xe8, 0xeb, 0xe5, 0xe6,
+    0x7c, 0x7f, 0x71, 0x72, 0x4b, 0x48, 0x46, 0x45, 0xa3, 0xa0, 0xae, 0xad, 0x94, 0x97, 0x99, 0x9a,
+    0xf0, 0xf3, 0xfd, 0xfe, 0xc7, 0xc4, 0xca, 0xc9, 0x2f, 0x2c, 0x22, 0x21, 0x18, 0x1b, 0x15, 0x16,
+    0x8c, 0x8f, 0x81, 0x82, 0xbb, 0xb8, 0xb6, 0xb5, 0x53, 0x50, 0x5e, 0x5d, 0x64, 0x67, 0x69, 0x6a,
+    0xc0, 0xc3, 0xcd, 0xce, 0xf7, 0xf4, 0xfa, 0xf9, 0x1f, 0x1c, 0x12, 0x11, 0x28, 0x2b, 0x25, 0x26,
+    0xbc, 0xbf, 0xb1, 0xb2, 0x8b, 0x88, 0x86, 0x85, 0x63, 0x60, 0x6e, 0x6d, 0x54, 0x57, 0x59, 0x5a,
+    0x30, 0x33, 0x3d, 0x3e, 0x07, 0x04, 0x0a, 0x09, 0xef, 0xec, 0xe2, 0xe1, 0xd8, 0xdb, 0xd5, 0xd6,
+    0x4c, 0x4f, 0x41, 0x42, 0x7b, 0x78, 0x76, 0x75, 0x93, 0x90, 0x9e, 0x9d, 0xa4, 0xa7, 0xa9, 0xaa,
+};
+
+// symbol expected on the branch into state k coming from state k >> 1,
+// the branch coming from state (k >> 1) + 4 carries the inverted symbol
+static const uint8_t trellis_lut[8] = {0, 3, 1, 2, 3, 0, 2, 1};
+
+// hard decision branch costs (hamming distance) into each state from state k >> 1, per received symbol
+static const int16_t hard_branch_cost[4][8] = {
+    {0, 2, 1, 1, 2, 0, 1, 1},
+    {1, 1, 0, 2, 1, 1, 2, 0},
+    {1, 1, 2, 0, 1, 1, 0, 2},
+    {2, 0, 1, 1, 0, 2, 1, 1},
+};
 
-static void print_vstate()
+uint16_t fec_calculated_decoded_length(uint16_t packet_length)
 {
-//	typedef struct {
-//		uint8_t cost;
-//		uint16_t path;
-//	} VITERBIPATH;
-//	typedef struct {
-//		uint8_t path_size;
-//		VITERBIPATH* old;
-//		VITERBIPATH* new;
-//		VITERBIPATH states1[8];
-//		VITERBIPATH states2[8];
-//	} VITERBISTATE;
-
-  DPRINT("VSTATE:\n");
-  DPRINT(" - path_size: %d\n", vstate.path_size);
-	//printf(" - old: %03d - %s\n", vstate.old->cost, int_to_binary(vstate.old->path));
-	//printf(" - new: %03d - %s\n", vstate.new->cost, int_to_binary(vstate.new->path));
-	int i;
-	for (i=0;i<8;i++)
-    DPRINT(" - states - %d: %03d - %s\n", i, vstate.old[i].cost, int_to_binary(vstate.old[i].path));
-
+	return 2* (packet_length + 2 - (packet_length % 2));
 }
 
-
-uint16_t fec_calculated_decoded_length(uint16_t packet_length)
+// The interleaver transposes the 4x4 matrix of 2 bit symbols formed by 4 bytes (byte n in bits 8n),
+// which makes it its own inverse.
+static inline uint32_t interleave(uint32_t w)
 {
-	return 2* (packet_length + 2 - (packet_length % 2));
+    uint32_t t = ((w >> 6) ^ w) & 0x00CC00CC;
+    w ^= t ^ (t << 6);
+    t = ((w >> 12) ^ w) & 0x0000F0F0;
+    w ^= t ^ (t << 12);
+    return w;
 }
 
 /* Convolutional encoder */
 uint16_t fec_encode(uint8_t *data, uint16_t nbytes)
 {
-	memcpy(data_buffer, data, nbytes);
-	uint8_t *input = data_buffer;
-	unsigned int encstate = 0;
-	int i;
-
-	int termintor_bytes = 2 + nbytes%2;
-	//printf("Length %d -> terminator %d\n", nbytes, termintor_bytes);
-	nbytes+=termintor_bytes;
-	uint16_t length = 0;
-	uint8_t fecbuffer[4] = {0,0,0,0};
-
-	int8_t buffer_pointer = 0;
-	while(nbytes-- > 0){
-		if (nbytes < termintor_bytes) *input = TRELLIS_TERMINATOR;
-
-		//printf("%02X:", *input);
-
-		int j = 6;
-		for(i=7;i>=0;i--){
-				encstate = (encstate << 1) | ((*input >> i) & 1);
-				fecbuffer[buffer_pointer] |= fec_lut[encstate & 0x0F] << j;
-				j -=2;
-
-				//printf("%d: %d - %d -> %s\n",j+2, ((*input >> i) & 1), encstate & 0x0F, byte_to_binary(fec_lut[encstate & 0x0F]));
-				if (j < 0)
-				{
-//						//fecbuffer[buffer_pointer] = 0;
-					buffer_pointer++;
-					j = 6;
-//						length++;
-				}
-		}
-
-		if (buffer_pointer == 4)
-		{
-#ifdef INTERLEAVING
-			//printf("Non: "); print_array(fecbuffer, 4); printf("\n");
-			//Interleaving and write to output buffer
-			*data++ = ((fecbuffer[0] & 0x03)) |\
-						((fecbuffer[1] & 0x03) << 2) |\
-						((fecbuffer[2] & 0x03) << 4) |\
-						((fecbuffer[3] & 0x03) << 6);
-			*data++ = (((fecbuffer[0] >> 2) & 0x03)) |\
-							(((fecbuffer[1] >> 2) & 0x03) << 2) |\
-							(((fecbuffer[2] >> 2) & 0x03) << 4) |\
-							(((fecbuffer[3] >> 2) & 0x03) << 6);
-			*data++ = (((fecbuffer[0] >> 4) & 0x03)) |\
-							(((fecbuffer[1] >> 4) & 0x03) << 2) |\
-							(((fecbuffer[2] >> 4) & 0x03) << 4) |\
-							(((fecbuffer[3] >> 4) & 0x03) << 6);
-			*data++ = (((fecbuffer[0] >> 6) & 0x03)) |\
-							(((fecbuffer[1] >> 6) & 0x03) << 2) |\
-							(((fecbuffer[2] >> 6) & 0x03) << 4) |\
-							(((fecbuffer[3] >> 6) & 0x03) << 6);
-			//printf("Int: "); print_array(output-4, 4); printf("\n");
-#else
-			*output++ = fecbuffer[0];
-			*output++ = fecbuffer[1];
-			*output++ = fecbuffer[2];
-			*output++ = fecbuffer[3];
+    uint16_t total = nbytes + 2 + nbytes % 2; // including the trellis terminator bytes
 
-#endif
-			buffer_pointer=0;
-			fecbuffer[0] = 0;
-			fecbuffer[1] = 0;
-			fecbuffer[2] = 0;
-			fecbuffer[3] = 0;
-			length+=4;
-		}
+    // Each pair of input bytes expands to 4 output bytes. Work backwards so this can be done in place,
+    // the encoder state at the start of a byte is formed by the 3 LSBs of the previous input byte.
+    for (int32_t i = total - 2; i >= 0; i -= 2)
+    {
+        uint8_t prev = (i == 0) ? 0 : ((i - 1 < nbytes) ? data[i - 1] : TRELLIS_TERMINATOR);
+        uint8_t in0 = (i < nbytes) ? data[i] : TRELLIS_TERMINATOR;
+        uint8_t in1 = (i + 1 < nbytes) ? data[i + 1] : TRELLIS_TERMINATOR;
+
+        uint32_t w = (uint32_t)fec_encode_lut[((prev & 0x07) << 4) | (in0 >> 4)]
+                   | (uint32_t)fec_encode_lut[(((in0 >> 4) & 0x07) << 4) | (in0 & 0x0F)] << 8
+                   | (uint32_t)fec_encode_lut[((in0 & 0x07) << 4) | (in1 >> 4)] << 16
+                   | (uint32_t)fec_encode_lut[(((in1 >> 4) & 0x07) << 4) | (in1 & 0x0F)] << 24;
+
+        w = interleave(w);
+        data[2 * i] = w;
+        data[2 * i + 1] = w >> 8;
+        data[2 * i + 2] = w >> 16;
+        data[2 * i + 3] = w >> 24;
+    }
 
+    return 2 * total;
+}
 
-		//printf("%02X%02X ", *(output-2), *(output-1));
+static void decoder_init(fec_decoder_t* decoder, int16_t bit_cost)
+{
+    decoder->cost[0] = 0;
+    decoder->path[0] = 0;
+    for (uint8_t i = 1; i < 8; i++)
+    {
+        decoder->cost[i] = UNKNOWN_STATE_COST * bit_cost;
+        decoder->path[i] = 0;
+    }
+}
 
-		input++;
+// Add-compare-select over 8 symbols (one decoded byte). branch_cost[s] holds the cost of the branch into each state
+// coming from state k >> 1, the cost of the inverted symbol from state (k >> 1) + 4 is symbol_cost - branch_cost[s][k].
+static void add_compare_select(fec_decoder_t* decoder, const int16_t* branch_cost[8], int16_t symbol_cost)
+{
+#if defined(__SSE2__)
+    __m128i cost = _mm_loadu_si128((const __m128i*)decoder->cost);
+    __m128i path = _mm_loadu_si128((const __m128i*)decoder->path);
+    const __m128i max = _mm_set1_epi16(symbol_cost);
+    const __m128i decision = _mm_set_epi16(1, 0, 1, 0, 1, 0, 1, 0);
 
-	}
+    for (uint8_t s = 0; s < 8; s++)
+    {
+        __m128i bm0 = _mm_loadu_si128((const __m128i*)branch_cost[s]);
+        __m128i c0 = _mm_add_epi16(_mm_unpacklo_epi16(cost, cost), bm0);
+        __m128i c1 = _mm_add_epi16(_mm_unpackhi_epi16(cost, cost), _mm_sub_epi16(max, bm0));
+        __m128i upper = _mm_cmpgt_epi16(c0, c1); // on equal cost the path from the lower state wins
+        cost = _mm_min_epi16(c0, c1);
+        path = _mm_or_si128(_mm_and_si128(upper, _mm_unpackhi_epi16(path, path)),
+                            _mm_andnot_si128(upper, _mm_unpacklo_epi16(path, path)));
+        path = _mm_or_si128(_mm_slli_epi16(path, 1), decision);
+    }
 
+    _mm_storeu_si128((__m128i*)decoder->cost, cost);
+    _mm_storeu_si128((__m128i*)decoder->path, path);
+#else
+    int16_t cost[2][8];
+    uint16_t path[2][8];
+    uint8_t cur = 0;
+
+    memcpy(cost[0], decoder->cost, sizeof(cost[0]));
+    memcpy(path[0], decoder->path, sizeof(path[0]));
+
+    for (uint8_t s = 0; s < 8; s++)
+    {
+        const int16_t* old_cost = cost[cur];
+        const uint16_t* old_path = path[cur];
+        int16_t* new_cost = cost[cur ^ 1];
+        uint16_t* new_path = path[cur ^ 1];
+
+        // butterfly: states m and m + 4 both lead to states 2m and 2m + 1, with inverted symbols
+        for (uint8_t m = 0; m < 4; m++)
+        {
+            int16_t x = branch_cost[s][2 * m];
+            int16_t y = symbol_cost - x;
+            int16_t c0 = old_cost[m] + x;
+            int16_t c1 = old_cost[m + 4] + y;
+
+            if (c0 <= c1) {
+                new_cost[2 * m] = c0;
+                new_path[2 * m] = old_path[m] << 1;
+            } else {
+                new_cost[2 * m] = c1;
+                new_path[2 * m] = old_path[m + 4] << 1;
+            }
+
+            c0 = old_cost[m] + y;
+            c1 = old_cost[m + 4] + x;
+
+            if (c0 <= c1) {
+                new_cost[2 * m + 1] = c0;
+                new_path[2 * m + 1] = (old_path[m] << 1) | 0x01;
+            } else {
+                new_cost[2 * m + 1] = c1;
+                new_path[2 * m + 1] = (old_path[m + 4] << 1) | 0x01;
+            }
+        }
+
+        cur ^= 1;
+    }
 
-	//printf("\n");
-	return length;
+    memcpy(decoder->cost, cost[cur], sizeof(cost[cur]));
+    memcpy(decoder->path, path[cur], sizeof(path[cur]));
+#endif
 }
 
-uint16_t fec_decode_packet(uint8_t* data, uint16_t packet_length, uint16_t output_length)
+// returns the decisions of the oldest byte in the survivor path with the lowest cost and normalizes the costs
+static uint16_t best_path(fec_decoder_t* decoder)
 {
-	uint8_t* output = data_buffer;
-	if(output_length < packet_length)
-	{
-		DPRINT("FEC decoding error: buffer to small\n");
-		return 0;
-	}
+    uint8_t min_state = 0;
+    for (uint8_t j = 7; j != 0; j--) {
+        if (decoder->cost[j] < decoder->cost[min_state])
+            min_state = j;
+    }
 
-	if(packet_length % 4 != 0)
-	{
-		DPRINT("FEC decoding error: data 32 bit aligned\n");
-		return 0;
-	}
+    int16_t min_cost = decoder->cost[min_state];
+    if (min_cost > 0)
+        for (uint8_t j = 0; j < 8; j++) decoder->cost[j] -= min_cost;
 
-	output_buffer = output;
-	packetlength = packet_length;
-	output_packet_length = output_length;
+    return decoder->path[min_state];
+}
 
-	processedbytes = 0;
-	fecprocessedbytes = 0;
+uint16_t fec_decode(fec_decoder_t* decoder, const uint8_t* input, uint16_t packet_length, uint8_t* output)
+{
+    if (packet_length % 4 != 0)
+    {
+        DPRINT("FEC decoding error: data 32 bit aligned\n");
+        return 0;
+    }
 
-	vstate.path_size = 0;
+    decoder_init(decoder, 1);
 
-	vstate.states1[0].cost = 0;
-	int16_t i;
-	for (i=1;i<8;i++)
-			vstate.states1[i].cost = 100;
+    uint16_t decoded_length = 0;
+    for (uint16_t i = 0; i < packet_length; i += 4)
+    {
+        uint32_t w = interleave((uint32_t)input[i] | (uint32_t)input[i + 1] << 8
+                                | (uint32_t)input[i + 2] << 16 | (uint32_t)input[i + 3] << 24);
+
+        // two decoded bytes, of 8 symbols each (first symbol in the MSBs)
+        for (uint8_t b = 0; b < 2; b++)
+        {
+            uint16_t symbols = ((w >> 8) & 0xFF) | ((w & 0xFF) << 8);
+            const int16_t* branch_cost[8];
+            for (uint8_t s = 0; s < 8; s++)
+                branch_cost[s] = hard_branch_cost[(symbols >> (14 - 2 * s)) & 0x03];
+
+            w >>= 16;
+            add_compare_select(decoder, branch_cost, 2);
+
+            // the decisions are output with a delay of one byte, the input is consumed before writing so this works in place
+            if (decoded_length != 0)
+                output[decoded_length - 1] = best_path(decoder) >> 8;
+            decoded_length++;
+        }
+    }
 
-	vstate.old = vstate.states1;
-	vstate.new = vstate.states2;
+    if (decoded_length != 0)
+        output[decoded_length - 1] = best_path(decoder);
 
-	uint16_t decoded_length = 0;
+    return decoded_length;
+}
 
-	for(i = 0; i < packet_length; i = i + 4)
-	{
-		//printf("FEC encoding i = %d\n", i);
+uint16_t fec_decode_soft(fec_decoder_t* decoder, const uint8_t* samples, uint16_t packet_length, uint8_t* output)
+{
+    if (packet_length % 4 != 0)
+    {
+        DPRINT("FEC decoding error: data 32 bit aligned\n");
+        return 0;
+    }
 
-		bool err = fec_decode(&data[i]);
-		decoded_length+=2;
-		if (!err)
-			DPRINT("FEC encoding error\n");
-	}
+    decoder_init(decoder, SOFT_BIT_COST);
+
+    uint16_t decoded_length = 0;
+    for (uint16_t i = 0; i < packet_length; i += 4)
+    {
+        for (uint8_t b = 0; b < 4; b += 2)
+        {
+            int16_t costs[8][8];
+            const int16_t* branch_cost[8];
+
+            // symbol s of this byte is held in bits (2b' + 1, 2b') of received byte i + u, with b' = b + s / 4 and
+            // u = 3 - s % 4 (see interleave()), samples are in transmission order, so MSB first
+            for (uint8_t s = 0; s < 8; s++)
+            {
+                const uint8_t* sample = &samples[(i + 3 - (s & 0x03)) * 8 + 6 - 2 * (b + (s >> 2))];
+                int16_t msb = sample[0] >> 4;
+                int16_t lsb = sample[1] >> 4;
+                int16_t symbol_cost[4] = {
+                    msb + lsb,
+                    msb + SOFT_BIT_COST - lsb,
+                    SOFT_BIT_COST - msb + lsb,
+                    2 * SOFT_BIT_COST - msb - lsb
+                };
+
+                for (uint8_t k = 0; k < 8; k++)
+                    costs[s][k] = symbol_cost[trellis_lut[k]];
+
+                branch_cost[s] = costs[s];
+            }
+
+            add_compare_select(decoder, branch_cost, 2 * SOFT_BIT_COST);
+
+            if (decoded_length != 0)
+                output[decoded_length - 1] = best_path(decoder) >> 8;
+            decoded_length++;
+        }
+    }
 
-	memcpy(data, data_buffer, decoded_length);
+    if (decoded_length != 0)
+        output[decoded_length - 1] = best_path(decoder);
 
-	return decoded_length;
+    return decoded_length;
 }
 
-static bool fec_decode(uint8_t* input)
+uint16_t fec_decode_packet(uint8_t* data, uint16_t packet_length, uint16_t output_length)
 {
-	uint8_t i, k;
-	int8_t j;
-	uint8_t min_state;
-	uint8_t symbol;
-	uint16_t tmppn9;
-	uint8_t fecbuffer[4];
-	VITERBIPATH* vstate_tmp;
-
-	if(fecprocessedbytes >= packetlength)
-		return false;
-
-	//Deinterleaving (symbols are stored in reverse as this is easier for Viterbi decoding)
-
-#ifdef INTERLEAVING
-	//printf("Int: "); print_array(input, 4); printf("\n");
-	fecbuffer[0] = ((input[0] & 0x03)) |\
-					((input[1] & 0x03) << 2) |\
-					((input[2] & 0x03) << 4) |\
-					((input[3] & 0x03) << 6);
-	fecbuffer[1] = (((input[0] >> 2) & 0x03)) |\
-					(((input[1] >> 2) & 0x03) << 2) |\
-					(((input[2] >> 2) & 0x03) << 4) |\
-					(((input[3] >> 2) & 0x03) << 6);
-	fecbuffer[2] = (((input[0] >> 4) & 0x03)) |\
-					(((input[1] >> 4) & 0x03) << 2) |\
-					(((input[2] >> 4) & 0x03) << 4) |\
-					(((input[3] >> 4) & 0x03) << 6);
-	fecbuffer[3] = (((input[0] >> 6) & 0x03)) |\
-					(((input[1] >> 6) & 0x03) << 2) |\
-					(((input[2] >> 6) & 0x03) << 4) |\
-					(((input[3] >> 6) & 0x03) << 6);
-	//printf("DeI: "); print_array(fecbuffer, 4); printf("\n");
-#else
-	fecbuffer[0] = input[0];
-	fecbuffer[1] = input[1];
-	fecbuffer[2] = input[2];
-	fecbuffer[3] = input[3];
-#endif
-	//printf(" input = %04X%04X\n", fecbuffer[0],fecbuffer[1]);
-	fecprocessedbytes +=4;
-
-	for (i = 0; i < 3; i=i+2) {
-		//Viterbi decoding
-		//printf(" Encode i  %d -> %04X %s\n", i, fecbuffer[i], int_to_binary(fecbuffer[i]));
-
-		// todo: fix for loop
-		for (j = 7; j >= 0; j--) {
-			if (j>3)
-				symbol = (fecbuffer[i] >> (j-4)*2) & 0x03;
-			else
-				symbol = (fecbuffer[i+1] >> j*2) & 0x03;
-			//printf(" Symbol %d %x - %s\n", j, symbol, int_to_binary(symbol));
-			//fecbuffer[i] >>= 2;
-
-			for(k = 0; k < 8; k++) {
-				uint8_t cost0, cost1;
-				uint8_t state0, state1;
-				uint8_t hamming0, hamming1;
-
-				state0 = k >> 1;
-				state1 = state0 + 4;
-
-				cost0  = vstate.old[state0].cost;
-				cost1  = vstate.old[state1].cost;
-
-				//butterfly operation for 0
-				hamming0 = cost0 + (((trellis0_lut[state0] ^ symbol) + 1) >> 1);
-				hamming1 = cost1 + (((trellis0_lut[state1] ^ symbol) + 1) >> 1);
-
-				if(hamming0 <= hamming1) {
-					vstate.new[k].cost = hamming0;
-					vstate.new[k].path = vstate.old[state0].path << 1;
-				} else {
-					vstate.new[k].cost = hamming1;
-					vstate.new[k].path = vstate.old[state1].path << 1;
-				}
-
-				//printf("k %d part 1\n");
-				//print_vstate();
-
-				k++;
-
-				//butterfly operation for 1
-				hamming0 = cost0 + (((trellis1_lut[state0] ^ symbol) + 1) >> 1);
-				hamming1 = cost1 + (((trellis1_lut[state1] ^ symbol) + 1) >> 1);
-
-				if(hamming0 <= hamming1) {
-					vstate.new[k].cost = hamming0;
-					vstate.new[k].path = vstate.old[state0].path << 1 | 0x01;
-				} else {
-					vstate.new[k].cost = hamming1;
-					vstate.new[k].path = vstate.old[state1].path << 1 | 0x01;
-				}
-
-				//printf("k %d part 2\n");
-				//print_vstate();
-			}
-
-			//Swap Viterbi paths
-			vstate_tmp = vstate.new;
-			vstate.new = vstate.old;
-			vstate.old = vstate_tmp;
-
-			//print_vstate();
-		}
-
-		vstate.path_size++;
-
-		//Flush out byte if path is full
-		if ((vstate.path_size == 2) && (processedbytes < packetlength)) {
-			//Calculate path with lowest cost
-			min_state = 0;
-			for (j = 7; j != 0; j--) {
-				if(vstate.old[j].cost < vstate.old[min_state].cost)
-					min_state = j;
-			}
-
-	        //Normalize costs
-			if (vstate.old[min_state].cost > 0)
-				for (j = 0; j < 8; j++) vstate.old[j].cost -= vstate.old[min_state].cost;
-
-			*output_buffer++ = vstate.old[min_state].path >> 8;
-			vstate.path_size--;
-
-			processedbytes++;
-
-			if (processedbytes+ 2 == packetlength)
-				*output_buffer = (uint8_t) (vstate.old[min_state].path);
-		}
-	}
-
-	//print_vstate();
-
+	fec_decoder_t decoder;
 
+	if(output_length < packet_length)
+	{
+		DPRINT("FEC decoding error: buffer to small\n");
+		return 0;
+	}
 
-	return true;
+	return fec_decode(&decoder, data, packet_length, data);
 }
-
-//#endif /* D7_PHY_USE_FEC */
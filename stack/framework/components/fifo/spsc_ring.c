@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file spsc_ring.c
+ *
+ * The indices are free running, the number of contained bytes is always (tail - head) in 16 bit arithmetic.
+ * Each side reads its own index relaxed and the index of the other side with acquire semantics, and publishes its own
+ * index with release semantics, so the buffer contents are visible before the index update is.
+ */
+
+#include "spsc_ring.h"
+#include "string.h"
+#include "errors.h"
+#include "debug.h"
+
+#define LOAD_OWN(idx)           __atomic_load_n(&(idx), __ATOMIC_RELAXED)
+#define LOAD_OTHER(idx)         __atomic_load_n(&(idx), __ATOMIC_ACQUIRE)
+#define PUBLISH(idx, value)     __atomic_store_n(&(idx), (value), __ATOMIC_RELEASE)
+
+error_t spsc_ring_init(spsc_ring_t* ring, uint8_t* buffer, uint16_t size)
+{
+    if(size == 0 || size > 0x8000 || (size & (size - 1)) != 0)
+        return EINVAL;
+
+    ring->buffer = buffer;
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    return SUCCESS;
+}
+
+void spsc_ring_reset(spsc_ring_t* ring)
+{
+    PUBLISH(ring->head, 0);
+    PUBLISH(ring->tail, 0);
+}
+
+// split the len bytes starting at free running index idx in the part up to the end of the buffer and the wrapped part
+static void get_spans(spsc_ring_t* ring, uint16_t idx, uint16_t len, spsc_ring_span_t spans[2])
+{
+    uint16_t start = idx & ring->mask;
+    uint16_t part1 = ring->mask + 1 - start;
+    if(part1 > len)
+        part1 = len;
+
+    spans[0].data = ring->buffer + start;
+    spans[0].len = part1;
+    spans[1].data = ring->buffer;
+    spans[1].len = len - part1;
+}
+
+uint16_t spsc_ring_get_space(spsc_ring_t* ring)
+{
+    return ring->mask + 1 - (uint16_t)(LOAD_OWN(ring->tail) - LOAD_OTHER(ring->head));
+}
+
+uint16_t spsc_ring_get_write_spans(spsc_ring_t* ring, spsc_ring_span_t spans[2])
+{
+    uint16_t space = spsc_ring_get_space(ring);
+    get_spans(ring, LOAD_OWN(ring->tail), space, spans);
+    return space;
+}
+
+error_t spsc_ring_produce(spsc_ring_t* ring, uint16_t len)
+{
+    if(len > spsc_ring_get_space(ring))
+        return ESIZE;
+
+    PUBLISH(ring->tail, (uint16_t)(LOAD_OWN(ring->tail) + len));
+    return SUCCESS;
+}
+
+error_t spsc_ring_put(spsc_ring_t* ring, const uint8_t* data, uint16_t len)
+{
+    spsc_ring_span_t spans[2];
+    if(len > spsc_ring_get_write_spans(ring, spans))
+        return ESIZE;
+
+    if(len <= spans[0].len)
+    {
+        memcpy(spans[0].data, data, len);
+    }
+    else
+    {
+        memcpy(spans[0].data, data, spans[0].len);
+        memcpy(spans[1].data, data + spans[0].len, len - spans[0].len);
+    }
+
+    PUBLISH(ring->tail, (uint16_t)(LOAD_OWN(ring->tail) + len));
+    return SUCCESS;
+}
+
+error_t spsc_ring_put_byte(spsc_ring_t* ring, uint8_t byte)
+{
+    uint16_t tail = LOAD_OWN(ring->tail);
+    if((uint16_t)(tail - LOAD_OTHER(ring->head)) > ring->mask)
+        return ESIZE;
+
+    ring->buffer[tail & ring->mask] = byte;
+    PUBLISH(ring->tail, (uint16_t)(tail + 1));
+    return SUCCESS;
+}
+
+uint16_t spsc_ring_get_size(spsc_ring_t* ring)
+{
+    return LOAD_OTHER(ring->tail) - LOAD_OWN(ring->head);
+}
+
+uint16_t spsc_ring_peek_spans(spsc_ring_t* ring, spsc_ring_span_t spans[2])
+{
+    uint16_t size = spsc_ring_get_size(ring);
+    get_spans(ring, LOAD_OWN(ring->head), size, spans);
+    return size;
+}
+
+error_t spsc_ring_commit(spsc_ring_t* ring, uint16_t len)
+{
+    if(len > spsc_ring_get_size(ring))
+        return ESIZE;
+
+    PUBLISH(ring->head, (uint16_t)(LOAD_OWN(ring->head) + len));
+    return SUCCESS;
+}
+
+error_t spsc_ring_peek(spsc_ring_t* ring, uint8_t* buffer, uint16_t offset, uint16_t len)
+{
+    if((uint32_t)offset + len > spsc_ring_get_size(ring))
+        return ESIZE;
+
+    spsc_ring_span_t spans[2];
+    get_spans(ring, LOAD_OWN(ring->head) + offset, len, spans);
+    memcpy(buffer, spans[0].data, spans[0].len);
+    memcpy(buffer + spans[0].len, spans[1].data, spans[1].len);
+    return SUCCESS;
+}
+
+error_t spsc_ring_pop(spsc_ring_t* ring, uint8_t* buffer, uint16_t len)
+{
+    error_t err = spsc_ring_peek(ring, buffer, 0, len);
+    if(err != SUCCESS)
+        return err;
+
+    PUBLISH(ring->head, (uint16_t)(LOAD_OWN(ring->head) + len));
+    return SUCCESS;
+}
+
+void spsc_ring_flush(spsc_ring_t* ring)
+{
+    PUBLISH(ring->head, LOAD_OTHER(ring->tail));
+}
+
+error_t spsc_ring_init_fifo_view(spsc_ring_t* ring, fifo_t* view, uint16_t offset, uint16_t len)
+{
+    if((uint32_t)offset + len > spsc_ring_get_size(ring))
+        return ESIZE;
+
+    uint16_t start = LOAD_OWN(ring->head) + offset;
+    view->buffer = ring->buffer;
+    view->max_size = ring->mask + 1;
+    view->head_idx = start & ring->mask;
+    view->tail_idx = (uint16_t)(start + len) & ring->mask;
+    view->is_full = (len == view->max_size);
+    view->is_subview = true;
+    return SUCCESS;
+}
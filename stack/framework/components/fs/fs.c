@@ -34,6 +34,7 @@
 #include "errors.h"
 #include "platform.h"
 #include "hwblockdevice.h"
+#include "ng.h"
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_FS_LOG_ENABLED)
   #define DPRINT(...) log_print_string( __VA_ARGS__)
@@ -41,17 +42,17 @@
   #define DPRINT(...)
 #endif
 
-static fs_file_t files[FRAMEWORK_FS_FILE_COUNT] = { 0 }; // TODO do not keep all file metadata in RAM but use smaller MRU cache to save RAM
+static fs_file_t NGDEF(files)[FRAMEWORK_FS_FILE_COUNT]; // TODO do not keep all file metadata in RAM but use smaller MRU cache to save RAM
 
-static bool is_fs_init_completed = false;  //set in _d7a_verify_magic()
+static bool NGDEF(is_fs_init_completed) = NGINIT(false);  //set in _d7a_verify_magic()
 
 #define IS_SYSTEM_FILE(file_id)         (file_id <= 0x3F)
 
-static uint32_t volatile_data_offset = 0;
-static uint32_t permanent_data_offset = 0;
+static uint32_t NGDEF(volatile_data_offset) = NGINIT(0);
+static uint32_t NGDEF(permanent_data_offset) = NGINIT(0);
 
-static uint32_t bd_data_offset[FRAMEWORK_FS_BLOCKDEVICES_COUNT] = { 0 };
-static blockdevice_t* bd[FRAMEWORK_FS_BLOCKDEVICES_COUNT] = { 0 };
+static uint32_t NGDEF(bd_data_offset)[FRAMEWORK_FS_BLOCKDEVICES_COUNT];
+static blockdevice_t* NGDEF(bd)[FRAMEWORK_FS_BLOCKDEVICES_COUNT];
 
 /* forward internal declarations */
 static int _fs_init(void);
@@ -62,7 +63,7 @@ static int _fs_create_file(uint8_t file_id, fs_blockdevice_types_t bd_type, cons
 static inline bool _is_file_defined(uint8_t file_id)
 {
     //return files[file_id].storage == FS_STORAGE_INVALID;
-    return files[file_id].length != 0;
+    return NG(files)[file_id].length != 0;
 }
 
 static inline uint32_t _get_file_header_address(uint8_t file_id)
@@ -75,9 +76,9 @@ error_t fs_register_block_device(blockdevice_t* block_device, uint8_t bd_index)
     //TODO this should be done on a seperate layer and will have to include a metadata block device. This metadata block device should copy all content to the regular meta data device upon initialization.
     //Everytime a file on the registered block device is added, the relevant metadata block device needs to be modified as well.
     //This is to ensure that all apps use the same order of files once they are created somewhere.
-    if(bd_index > 2 && bd[bd_index] == NULL && block_device != NULL && bd_index < FRAMEWORK_FS_BLOCKDEVICES_COUNT)
+    if(bd_index > 2 && NG(bd)[bd_index] == NULL && block_device != NULL && bd_index < FRAMEWORK_FS_BLOCKDEVICES_COUNT)
     {
-        bd[bd_index] = block_device;
+        NG(bd)[bd_index] = block_device;
         return SUCCESS;
     }
     else
@@ -85,24 +86,24 @@ error_t fs_register_block_device(blockdevice_t* block_device, uint8_t bd_index)
     
 }
 
-uint32_t fs_get_address(uint8_t file_id) { return files[file_id].addr; }
+uint32_t fs_get_address(uint8_t file_id) { return NG(files)[file_id].addr; }
 
 void fs_init()
 {
-    if (is_fs_init_completed)
+    if (NG(is_fs_init_completed))
         return /*0*/;
 
-    memset(files,0,sizeof(files));
+    memset(NG(files),0,sizeof(NG(files)));
 
     // inject the mandatory blockdevice types from the platform
     // for now, only metadata, permanent and volatile storage are supported
-    bd[FS_BLOCKDEVICE_TYPE_METADATA] = PLATFORM_METADATA_BLOCKDEVICE;
-    bd[FS_BLOCKDEVICE_TYPE_PERMANENT] = PLATFORM_PERMANENT_BLOCKDEVICE;
-    bd[FS_BLOCKDEVICE_TYPE_VOLATILE] = PLATFORM_VOLATILE_BLOCKDEVICE;
+    NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA] = PLATFORM_METADATA_BLOCKDEVICE;
+    NG(bd)[FS_BLOCKDEVICE_TYPE_PERMANENT] = PLATFORM_PERMANENT_BLOCKDEVICE;
+    NG(bd)[FS_BLOCKDEVICE_TYPE_VOLATILE] = PLATFORM_VOLATILE_BLOCKDEVICE;
 
     _fs_init();
 
-    is_fs_init_completed = true;
+    NG(is_fs_init_completed) = true;
     DPRINT("fs_init OK");
 }
 
@@ -115,12 +116,12 @@ int _fs_init()
         DPRINT("fs_init: no valid magic, recreating fs...");
         _fs_create_magic();
         number_of_files = 0;
-        blockdevice_program(bd[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&number_of_files, FS_NUMBER_OF_FILES_ADDRESS, FS_NUMBER_OF_FILES_SIZE);
+        blockdevice_program(NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&number_of_files, FS_NUMBER_OF_FILES_ADDRESS, FS_NUMBER_OF_FILES_SIZE);
         return 0;
    }
 
     // initialise system file caching
-    blockdevice_read(bd[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&number_of_files, FS_NUMBER_OF_FILES_ADDRESS, FS_NUMBER_OF_FILES_SIZE);
+    blockdevice_read(NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&number_of_files, FS_NUMBER_OF_FILES_ADDRESS, FS_NUMBER_OF_FILES_SIZE);
 #if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
     number_of_files = __builtin_bswap32(number_of_files);
 #endif
@@ -128,22 +129,22 @@ int _fs_init()
     assert(number_of_files < FRAMEWORK_FS_FILE_COUNT);
     for(int file_id = 0; file_id < FRAMEWORK_FS_FILE_COUNT; file_id++)
     {
-        blockdevice_read(bd[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&files[file_id],
+        blockdevice_read(NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&NG(files)[file_id],
                          _get_file_header_address(file_id), FS_FILE_HEADER_SIZE);
 
 #if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
         // FS headers are stored in big endian
-        files[file_id].addr = __builtin_bswap32(files[file_id].addr);
-        files[file_id].length = __builtin_bswap32(files[file_id].length);
+        NG(files)[file_id].addr = __builtin_bswap32(NG(files)[file_id].addr);
+        NG(files)[file_id].length = __builtin_bswap32(NG(files)[file_id].length);
 #endif
 
-        DPRINT("File %i, bd %i, len %i, addr %i", file_id, files[file_id].blockdevice_index, files[file_id].length, files[file_id].addr);
+        DPRINT("File %i, bd %i, len %i, addr %i", file_id, NG(files)[file_id].blockdevice_index, NG(files)[file_id].length, NG(files)[file_id].addr);
         if(_is_file_defined(file_id))
         {
-            if (files[file_id].blockdevice_index == FS_BLOCKDEVICE_TYPE_VOLATILE)
+            if (NG(files)[file_id].blockdevice_index == FS_BLOCKDEVICE_TYPE_VOLATILE)
                 DPRINT("volatile file (%i) will not be initialized", file_id);
             else
-                bd_data_offset[files[file_id].blockdevice_index] += files[file_id].length;
+                NG(bd_data_offset)[NG(files)[file_id].blockdevice_index] += NG(files)[file_id].length;
         }
     }
     
@@ -153,8 +154,9 @@ int _fs_init()
 //TODO: CRC MAGIC
 static int _fs_create_magic()
 {
-    assert(!is_fs_init_completed);
+    assert(!NG(is_fs_init_completed));
     uint8_t magic[] = FS_MAGIC_NUMBER;
+    blockdevice_program(NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA], magic, FS_MAGIC_NUMBER_ADDRESS, FS_MAGIC_NUMBER_SIZE);
 
     /* verify */
     return _fs_verify_magic(magic);
@@ -164,11 +166,11 @@ static int _fs_create_magic()
 /* The magic number allows to check filesystem integrity.*/
 static int _fs_verify_magic(uint8_t* expected_magic_number)
 {
-    is_fs_init_completed = false;
+    NG(is_fs_init_completed) = false;
 
     uint8_t magic_number[FS_MAGIC_NUMBER_SIZE];
     memset(magic_number,0,FS_MAGIC_NUMBER_SIZE);
-    blockdevice_read(bd[FS_BLOCKDEVICE_TYPE_METADATA], magic_number, 0, FS_MAGIC_NUMBER_SIZE);
+    blockdevice_read(NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA], magic_number, 0, FS_MAGIC_NUMBER_SIZE);
     if(memcmp(expected_magic_number, magic_number, FS_MAGIC_NUMBER_SIZE) != 0) // if not the FS on EEPROM is not compatible with the current code
         return -EINVAL;
 
@@ -185,59 +187,59 @@ int _fs_create_file(uint8_t file_id, fs_blockdevice_types_t bd_type, const uint8
         return -EEXIST;
 
     // update file caching for stat lookup
-    files[file_id].blockdevice_index = (uint8_t)bd_type;
-    files[file_id].length = length;
+    NG(files)[file_id].blockdevice_index = (uint8_t)bd_type;
+    NG(files)[file_id].length = length;
 
     if (bd_type == FS_BLOCKDEVICE_TYPE_VOLATILE)
     {
-        files[file_id].addr = bd_data_offset[bd_type];
-        bd_data_offset[bd_type] += length;        
+        NG(files)[file_id].addr = NG(bd_data_offset)[bd_type];
+        NG(bd_data_offset)[bd_type] += length;        
     }
     else
     {
-        files[file_id].addr = bd_data_offset[bd_type];
+        NG(files)[file_id].addr = NG(bd_data_offset)[bd_type];
 
 #if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
         fs_file_t file_header_big_endian;
-        memcpy(&file_header_big_endian, (void*)&files[file_id], sizeof (fs_file_t));
+        memcpy(&file_header_big_endian, (void*)&NG(files)[file_id], sizeof (fs_file_t));
         file_header_big_endian.length = __builtin_bswap32(file_header_big_endian.length);
         file_header_big_endian.addr = __builtin_bswap32(file_header_big_endian.addr);
-        blockdevice_program(bd[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&file_header_big_endian, _get_file_header_address(file_id), FS_FILE_HEADER_SIZE);
+        blockdevice_program(NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&file_header_big_endian, _get_file_header_address(file_id), FS_FILE_HEADER_SIZE);
 #else
-        blockdevice_program(bd[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&files[file_id], _get_file_header_address(file_id), FS_FILE_HEADER_SIZE);
+        blockdevice_program(NG(bd)[FS_BLOCKDEVICE_TYPE_METADATA], (uint8_t*)&NG(files)[file_id], _get_file_header_address(file_id), FS_FILE_HEADER_SIZE);
 #endif
 
-        bd_data_offset[bd_type] += length;
+        NG(bd_data_offset)[bd_type] += length;
     }
 
     if(initial_data != NULL) {
-        uint32_t current_address = files[file_id].addr;
+        uint32_t current_address = NG(files)[file_id].addr;
         uint32_t remaining_length = initial_data_length;
         uint8_t* current_data = (uint8_t*)initial_data;
         do {
             /* if we can write the remaining data in one write-block, program the remaining length */
-            if((remaining_length <= bd[bd_type]->driver->write_block_size) && ((bd[bd_type]->driver->write_block_size == UINT32_MAX) || ((current_address & (0xFFFFFFFF - (bd[bd_type]->driver->write_block_size - 1))) == ((current_address + remaining_length) & (0xFFFFFFFF - (bd[bd_type]->driver->write_block_size - 1)))))) {
+            if((remaining_length <= NG(bd)[bd_type]->driver->write_block_size) && ((NG(bd)[bd_type]->driver->write_block_size == UINT32_MAX) || ((current_address & (0xFFFFFFFF - (NG(bd)[bd_type]->driver->write_block_size - 1))) == ((current_address + remaining_length) & (0xFFFFFFFF - (NG(bd)[bd_type]->driver->write_block_size - 1)))))) {
                 DPRINT("program remaining length of %i", remaining_length);
 
-                blockdevice_program(bd[bd_type], current_data, current_address, remaining_length);
+                blockdevice_program(NG(bd)[bd_type], current_data, current_address, remaining_length);
                 remaining_length = 0;
             /* else if this is the starting block, only write untill the end of the first write_block */
-            } else if(current_address == files[file_id].addr) {
-                remaining_length -= bd[bd_type]->driver->write_block_size - (current_address & (bd[bd_type]->driver->write_block_size - 1));
+            } else if(current_address == NG(files)[file_id].addr) {
+                remaining_length -= NG(bd)[bd_type]->driver->write_block_size - (current_address & (NG(bd)[bd_type]->driver->write_block_size - 1));
 
                 DPRINT("program initial length of %i - %i = %i at address %i", initial_data_length, remaining_length, initial_data_length - remaining_length, current_address);
 
-                blockdevice_program(bd[bd_type], current_data, current_address, initial_data_length - remaining_length);
+                blockdevice_program(NG(bd)[bd_type], current_data, current_address, initial_data_length - remaining_length);
                 current_data += initial_data_length - remaining_length;
                 current_address += initial_data_length - remaining_length;
             /* else this is a block in between, just program the maximum amount of block size */
             } else {
-                DPRINT("program write block size of %lu while remaining_length is %i at address %i", (uint32_t)bd[bd_type]->driver->write_block_size, remaining_length, current_address);
+                DPRINT("program write block size of %lu while remaining_length is %i at address %i", (uint32_t)NG(bd)[bd_type]->driver->write_block_size, remaining_length, current_address);
 
-                remaining_length -= bd[bd_type]->driver->write_block_size;
-                blockdevice_program(bd[bd_type], current_data, current_address, bd[bd_type]->driver->write_block_size);
-                current_data += bd[bd_type]->driver->write_block_size;
-                current_address += bd[bd_type]->driver->write_block_size;
+                remaining_length -= NG(bd)[bd_type]->driver->write_block_size;
+                blockdevice_program(NG(bd)[bd_type], current_data, current_address, NG(bd)[bd_type]->driver->write_block_size);
+                current_data += NG(bd)[bd_type]->driver->write_block_size;
+                current_address += NG(bd)[bd_type]->driver->write_block_size;
             }
         } while (remaining_length > 0);
     } else {
@@ -247,21 +249,21 @@ int _fs_create_file(uint8_t file_id, fs_blockdevice_types_t bd_type, const uint8
         uint32_t remaining_length = length;
         int i = 0;
         while(remaining_length > 64) {
-          blockdevice_program(bd[bd_type], default_data, files[file_id].addr + (i * 64), 64);
+          blockdevice_program(NG(bd)[bd_type], default_data, NG(files)[file_id].addr + (i * 64), 64);
           remaining_length -= 64;
           i++;
         }
 
-        blockdevice_program(bd[bd_type], default_data, files[file_id].addr  + (i * 64), remaining_length);
+        blockdevice_program(NG(bd)[bd_type], default_data, NG(files)[file_id].addr  + (i * 64), remaining_length);
     }
 
-    DPRINT("fs init file(file_id %d, bd_type %d, addr %i, length %d)\n",file_id, bd_type, files[file_id].addr, length);
+    DPRINT("fs init file(file_id %d, bd_type %d, addr %i, length %d)\n",file_id, bd_type, NG(files)[file_id].addr, length);
     return 0;
 }
 
 int fs_init_file(uint8_t file_id, fs_blockdevice_types_t bd_type, const uint8_t* initial_data, uint32_t initial_data_length, uint32_t length)
 {
-    assert(is_fs_init_completed);
+    assert(NG(is_fs_init_completed));
     if(file_id >= FRAMEWORK_FS_FILE_COUNT)
         return -EBADF;
    
@@ -271,32 +273,32 @@ int fs_init_file(uint8_t file_id, fs_blockdevice_types_t bd_type, const uint8_t*
 int fs_read_file(uint8_t file_id, uint32_t offset, uint8_t* buffer, uint32_t length)
 {
     if(!_is_file_defined(file_id)) return -ENOENT;
-    if(bd[files[file_id].blockdevice_index] == NULL) return -EFAULT;
+    if(NG(bd)[NG(files)[file_id].blockdevice_index] == NULL) return -EFAULT;
 
-    if(files[file_id].length < offset + length) return -EINVAL;
+    if(NG(files)[file_id].length < offset + length) return -EINVAL;
     
-    DPRINT("fs read_file(file_id %d, offset %d, addr %p, bd %i, length %d)\n",file_id, offset, files[file_id].addr, files[file_id].blockdevice_index, length);
-    return blockdevice_read(bd[files[file_id].blockdevice_index], buffer, files[file_id].addr + offset, length);
+    DPRINT("fs read_file(file_id %d, offset %d, addr %p, bd %i, length %d)\n",file_id, offset, NG(files)[file_id].addr, NG(files)[file_id].blockdevice_index, length);
+    return blockdevice_read(NG(bd)[NG(files)[file_id].blockdevice_index], buffer, NG(files)[file_id].addr + offset, length);
 }
 
 int fs_write_file(uint8_t file_id, uint32_t offset, const uint8_t* buffer, uint32_t length)
 {
     if(!_is_file_defined(file_id)) return -ENOENT;
-    if(bd[files[file_id].blockdevice_index] == NULL) return -EFAULT;
+    if(NG(bd)[NG(files)[file_id].blockdevice_index] == NULL) return -EFAULT;
 
-    if(files[file_id].length < offset + length) return -ENOBUFS;
+    if(NG(files)[file_id].length < offset + length) return -ENOBUFS;
 
-    uint32_t current_address = files[file_id].addr + offset;
+    uint32_t current_address = NG(files)[file_id].addr + offset;
     uint32_t remaining_length = length;
     uint8_t* current_data = (uint8_t*)buffer;
-    fs_blockdevice_types_t bd_type = files[file_id].blockdevice_index;
+    fs_blockdevice_types_t bd_type = NG(files)[file_id].blockdevice_index;
 
     do {
         // calculate the number of bytes that can be written till the end of the block/page
-        uint32_t bytes_until_end_of_block = bd[bd_type]->driver->write_block_size - ((current_address + bd[bd_type]->offset) % bd[bd_type]->driver->write_block_size);
+        uint32_t bytes_until_end_of_block = NG(bd)[bd_type]->driver->write_block_size - ((current_address + NG(bd)[bd_type]->offset) % NG(bd)[bd_type]->driver->write_block_size);
         uint32_t bytes_to_program = remaining_length > bytes_until_end_of_block ? bytes_until_end_of_block : remaining_length;
         DPRINT("Programming %i bytes", bytes_to_program);
-        blockdevice_program(bd[bd_type], current_data, current_address, bytes_to_program);
+        blockdevice_program(NG(bd)[bd_type], current_data, current_address, bytes_to_program);
         remaining_length -= bytes_to_program;
         current_data += bytes_to_program;
         current_address += bytes_to_program;
@@ -304,20 +306,20 @@ int fs_write_file(uint8_t file_id, uint32_t offset, const uint8_t* buffer, uint3
     } while (remaining_length > 0);
 
     DPRINT("fs write_file (file_id %d, offset %d, addr %lu, length %d)\n",
-           file_id, offset, files[file_id].addr, length);
+           file_id, offset, NG(files)[file_id].addr, length);
 
     return 0;
 }
 
 fs_file_stat_t *fs_file_stat(uint8_t file_id)
 {
-    assert(is_fs_init_completed);
+    assert(NG(is_fs_init_completed));
 
     if(file_id >= FRAMEWORK_FS_FILE_COUNT)
         return NULL;
 
     if (_is_file_defined(file_id))
-        return (fs_file_stat_t*)&files[file_id];
+        return (fs_file_stat_t*)&NG(files)[file_id];
     else
         return NULL;
 }
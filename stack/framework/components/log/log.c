@@ -30,6 +30,7 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <unistd.h>
 #include "framework_defs.h"
 #include "hwsystem.h"
@@ -37,9 +38,264 @@
 
 #ifdef FRAMEWORK_LOG_ENABLED
 
+#ifdef FRAMEWORK_LOG_BINARY
+
+#include "scheduler.h"
+#include "hwatomic.h"
+#include "spsc_ring.h"
+#include "errors.h"
+
+/*
+ * Binary log records, all multi-byte fields are little endian:
+ *
+ * |sync (0xDB)|length|type|payload (length - 1 bytes)|
+ *
+ * STRING, ERROR_STRING:  |format ID (int32)|arguments|
+ * STACK_STRING:          |layer|format ID (int32)|arguments|
+ * DATA, DATA_CONTINUED:  |raw bytes|
+ * DROPPED:               |number of dropped records (uint16)|
+ * COUNTER_RESET:         ||
+ *
+ * The format ID is the address of the format string relative to log_format_base, so the decoder can find the format
+ * string in the ELF file even for position independent executables. The arguments are encoded in the order of the
+ * conversion specifiers of the format string: integers as 4 bytes (8 bytes for the ll and j length modifiers),
+ * floating point values as an 8 byte double, strings as a length byte followed by the characters (without
+ * terminating zero, truncated to LOG_BINARY_MAX_STRING_LEN).
+ */
+
+#define LOG_BINARY_SYNC_BYTE 0xDB
+#define LOG_BINARY_MAX_PAYLOAD_SIZE 64
+#define LOG_BINARY_MAX_STRING_LEN 32
+#define LOG_BINARY_DRAIN_CHUNK_SIZE 64
+
+typedef enum
+{
+    LOG_RECORD_STRING = 0x01,
+    LOG_RECORD_STACK_STRING = 0x02,
+    LOG_RECORD_DATA = 0x03,
+    LOG_RECORD_DATA_CONTINUED = 0x04,
+    LOG_RECORD_ERROR_STRING = 0x05,
+    LOG_RECORD_DROPPED = 0x06,
+    LOG_RECORD_COUNTER_RESET = 0x07,
+} log_record_type_t;
+
+// the decoder searches this string in the ELF file to resolve the format IDs
+__attribute__((used)) static const char log_format_base[] = "SUB-IoT binary log format base";
+
+static uint8_t NGDEF(log_buffer)[FRAMEWORK_LOG_BINARY_BUFFER_SIZE];
+static spsc_ring_t NGDEF(log_ring);
+static uint16_t NGDEF(log_dropped);
+
+static void log_drain(void* arg)
+{
+    spsc_ring_span_t spans[2];
+    uint16_t len = spsc_ring_peek_spans(&NG(log_ring), spans);
+    if(len > LOG_BINARY_DRAIN_CHUNK_SIZE)
+        len = LOG_BINARY_DRAIN_CHUNK_SIZE;
+
+    uint16_t part_len = len < spans[0].len ? len : spans[0].len;
+    fwrite(spans[0].data, 1, part_len, stdout);
+    fwrite(spans[1].data, 1, len - part_len, stdout);
+    fflush(stdout);
+    spsc_ring_commit(&NG(log_ring), len);
+
+    if(spsc_ring_get_size(&NG(log_ring)) > 0)
+        sched_post_task_prio(&log_drain, MIN_PRIORITY, NULL);
+}
+
+// records can be written from any context, the atomic section only covers the copy into the ring
+static void put_record(log_record_type_t type, uint8_t* payload, uint8_t payload_len)
+{
+    uint8_t header[3] = { LOG_BINARY_SYNC_BYTE, payload_len + 1, type };
+
+    start_atomic();
+    if(NG(log_dropped) > 0)
+    {
+        uint8_t dropped[5] = { LOG_BINARY_SYNC_BYTE, 3, LOG_RECORD_DROPPED, NG(log_dropped) & 0xFF, NG(log_dropped) >> 8 };
+        if(spsc_ring_put(&NG(log_ring), dropped, sizeof(dropped)) == SUCCESS)
+            NG(log_dropped) = 0;
+    }
+
+    if(NG(log_dropped) == 0 && spsc_ring_get_space(&NG(log_ring)) >= sizeof(header) + payload_len)
+    {
+        spsc_ring_put(&NG(log_ring), header, sizeof(header));
+        if(payload_len > 0)
+            spsc_ring_put(&NG(log_ring), payload, payload_len);
+    }
+    else if(NG(log_dropped) < UINT16_MAX)
+        NG(log_dropped)++;
+    end_atomic();
+
+    sched_post_task_prio(&log_drain, MIN_PRIORITY, NULL);
+}
+
+static bool put_bytes(uint8_t* buffer, uint8_t* len, const void* data, uint8_t data_len)
+{
+    if(*len + data_len > LOG_BINARY_MAX_PAYLOAD_SIZE)
+        return false;
+
+    memcpy(buffer + *len, data, data_len);
+    *len += data_len;
+    return true;
+}
+
+static bool put_uint32(uint8_t* buffer, uint8_t* len, uint32_t value)
+{
+    uint8_t bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+    return put_bytes(buffer, len, bytes, sizeof(bytes));
+}
+
+static bool put_uint64(uint8_t* buffer, uint8_t* len, uint64_t value)
+{
+    return put_uint32(buffer, len, value) && put_uint32(buffer, len, value >> 32);
+}
+
+// walks the conversion specifiers of the format string to store the raw arguments, without formatting them
+static void put_args(uint8_t* buffer, uint8_t* len, const char* format, va_list args)
+{
+    bool fits = true;
+    for(const char* p = format; *p && fits; p++)
+    {
+        if(*p != '%')
+            continue;
+
+        p++;
+        while(*p && strchr("-+ #0", *p))
+            p++;
+
+        // width and precision, '*' takes an int argument
+        while(*p && (strchr("0123456789.", *p) || *p == '*'))
+        {
+            if(*p == '*')
+                fits = put_uint32(buffer, len, va_arg(args, int));
+            p++;
+        }
+
+        char length_modifier = 0;
+        bool is_long_long = false;
+        while(*p && strchr("hljztL", *p))
+        {
+            is_long_long = (*p == 'j') || (length_modifier == 'l' && *p == 'l');
+            length_modifier = *p;
+            p++;
+        }
+
+        switch(*p)
+        {
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+                if(is_long_long)
+                    fits = put_uint64(buffer, len, va_arg(args, long long));
+                else if(length_modifier == 'l')
+                    fits = put_uint32(buffer, len, va_arg(args, long));
+                else if(length_modifier == 'z')
+                    fits = put_uint32(buffer, len, va_arg(args, size_t));
+                else if(length_modifier == 't')
+                    fits = put_uint32(buffer, len, va_arg(args, ptrdiff_t));
+                else
+                    fits = put_uint32(buffer, len, va_arg(args, int));
+                break;
+            case 'p':
+                fits = put_uint32(buffer, len, (uintptr_t)va_arg(args, void*));
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            {
+                double value = (length_modifier == 'L') ? (double)va_arg(args, long double) : va_arg(args, double);
+                uint64_t raw;
+                memcpy(&raw, &value, sizeof(raw));
+                fits = put_uint64(buffer, len, raw);
+                break;
+            }
+            case 's':
+            {
+                const char* string = va_arg(args, const char*);
+                if(string == NULL)
+                    string = "(null)";
+
+                uint8_t string_len = strnlen(string, LOG_BINARY_MAX_STRING_LEN);
+                fits = put_bytes(buffer, len, &string_len, 1) && put_bytes(buffer, len, string, string_len);
+                break;
+            }
+            case 'n':
+                (void)va_arg(args, void*);
+                break;
+            case 0:
+                return;
+            default: // '%%'
+                break;
+        }
+    }
+}
+
+static void log_binary_string(log_record_type_t type, int16_t layer, const char* format, va_list args)
+{
+    uint8_t payload[LOG_BINARY_MAX_PAYLOAD_SIZE];
+    uint8_t len = 0;
+    if(layer >= 0)
+        payload[len++] = layer;
+
+    put_uint32(payload, &len, (uint32_t)(format - log_format_base));
+    put_args(payload, &len, format, args);
+    put_record(type, payload, len);
+}
+
+__LINK_C void log_init()
+{
+    spsc_ring_init(&NG(log_ring), NG(log_buffer), sizeof(NG(log_buffer)));
+    NG(log_dropped) = 0;
+    sched_register_task(&log_drain);
+    log_counter_reset();
+}
+
+__LINK_C void log_counter_reset()
+{
+    put_record(LOG_RECORD_COUNTER_RESET, NULL, 0);
+}
+
+__LINK_C void log_print_string(char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    log_binary_string(LOG_RECORD_STRING, -1, format, args);
+    va_end(args);
+}
+
+__LINK_C void log_print_stack_string(log_stack_layer_t type, char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    log_binary_string(LOG_RECORD_STACK_STRING, type, format, args);
+    va_end(args);
+}
+
+__LINK_C void log_print_data(uint8_t* message, uint32_t length)
+{
+    log_record_type_t type = LOG_RECORD_DATA;
+    do
+    {
+        uint8_t len = length > LOG_BINARY_MAX_PAYLOAD_SIZE ? LOG_BINARY_MAX_PAYLOAD_SIZE : length;
+        put_record(type, message, len);
+        message += len;
+        length -= len;
+        type = LOG_RECORD_DATA_CONTINUED;
+    } while(length > 0);
+}
+
+void log_print_error_string(char* format,...)
+{
+    va_list args;
+    va_start(args, format);
+    log_binary_string(LOG_RECORD_ERROR_STRING, -1, format, args);
+    va_end(args);
+}
+
+#else
 
 static uint32_t NGDEF(counter);
 
+__LINK_C void log_init()
+{
+    log_counter_reset();
+}
 
 __LINK_C void log_counter_reset()
 {
@@ -85,5 +341,6 @@ void log_print_error_string(char* format,...)
     va_end(args);
 }
 
+#endif //FRAMEWORK_LOG_BINARY
 
 #endif //FRAMEWORK_LOG_ENABLED
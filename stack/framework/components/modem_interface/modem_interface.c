@@ -24,6 +24,7 @@
 #include "framework_defs.h"
 #include "platform_defs.h"
 #include "fifo.h"
+#include "spsc_ring.h"
 #include "scheduler.h"
 #include "modem_interface.h"
 #include "modules_defs.h"
@@ -38,15 +39,22 @@
 #include "crc.h"
 
 #include "ng.h"
-#include "crc.h"
 
 #include "log.h"
 
 
-#define RX_BUFFER_SIZE 256
+#define RX_BUFFER_SIZE FRAMEWORK_MODEM_INTERFACE_RX_BUFFER_SIZE // must be a power of two, see spsc_ring_init()
+
+// Without DMA or interrupt lines only the number of bytes which can be transmitted in 1 ms (10 bits per byte)
+// are sent per invocation, to make sure we don't interfere with critical stack timings
+#define TX_FIFO_FLUSH_CHUNK_SIZE(baudrate) ((baudrate) >= 10000 ? (baudrate) / 10000 : 1)
 
-#define TX_FIFO_FLUSH_CHUNK_SIZE 10 // at a baudrate of 115200 this ensures completion within 1 ms
-                                    // TODO baudrate dependent
+#define TX_WINDOW_SIZE FRAMEWORK_MODEM_INTERFACE_TX_WINDOW_SIZE
+#if TX_WINDOW_SIZE > 0
+#define TX_FRAME_QUEUE_SIZE 16
+#define TX_ACK_TIMEOUT 1000 // ticks, frames which are not acknowledged in time are retransmitted
+_Static_assert(TX_WINDOW_SIZE <= TX_FRAME_QUEUE_SIZE, "FRAMEWORK_MODEM_INTERFACE_TX_WINDOW_SIZE too big");
+#endif
 
 static uart_handle_t* uart;
 #ifdef FRAMEWORK_MODEM_INTERFACE_USE_DMA
@@ -60,7 +68,8 @@ _Static_assert(false, "FRAMEWORK_MODEM_INTERFACE_USE_INTERRUPT_LINES should be d
 #endif
 
 static uint8_t rx_buffer[RX_BUFFER_SIZE];
-static fifo_t rx_fifo;
+static spsc_ring_t rx_ring; // filled by the UART RX interrupt, consumed by process_rx_fifo() without masking interrupts
+static volatile bool rx_overrun = false;
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_MODEM_INTERFACE_LOG_ENABLED)
   #define DPRINT(...) log_print_string(__VA_ARGS__)
@@ -72,21 +81,47 @@ static fifo_t rx_fifo;
 
 
 #define SERIAL_FRAME_SYNC_BYTE 0xC0
-#define SERIAL_FRAME_VERSION   0x00
-#define SERIAL_FRAME_HEADER_SIZE 7
-#define SERIAL_FRAME_SIZE 4
+#define SERIAL_FRAME_VERSION   0x01
+#define SERIAL_FRAME_VERSION_V0 0x00
+#define SERIAL_FRAME_HEADER_SIZE 8
+#define SERIAL_FRAME_HEADER_SIZE_V0 7
+#define SERIAL_FRAME_SIZE 4           // v0: length, v1: length MSB
+#define SERIAL_FRAME_SIZE_LSB 5       // v1 only
 #define SERIAL_FRAME_COUNTER 2
 #define SERIAL_FRAME_TYPE 3
-#define SERIAL_FRAME_CRC1   5
-#define SERIAL_FRAME_CRC2   6
+// the CRC is always contained in the last 2 bytes of the header
 
-#define MODEM_INTERFACE_TX_FIFO_SIZE 255
+#define MODEM_INTERFACE_TX_FIFO_SIZE FRAMEWORK_MODEM_INTERFACE_TX_BUFFER_SIZE
 static uint8_t modem_interface_tx_buffer[MODEM_INTERFACE_TX_FIFO_SIZE];
 static fifo_t modem_interface_tx_fifo;
 static bool request_pending = false;
+static uint16_t tx_chunk_size;
+static uint16_t tx_sent_bytes = 0; // number of bytes at the head of the TX fifo which are transmitted but not acknowledged
+
+#if TX_WINDOW_SIZE > 0
+typedef struct {
+  uint16_t size;
+  uint8_t counter;
+} tx_frame_t;
+
+// the frames contained in the TX fifo, oldest first
+static tx_frame_t tx_frames[TX_FRAME_QUEUE_SIZE];
+static uint8_t tx_frames_first = 0;
+static uint8_t tx_frames_count = 0;
+static volatile bool tx_rewind_pending = false;
+
+static bool ack_pending = false;
+static uint8_t ack_type;
+static uint8_t ack_counter;
+static uint8_t ack_frame[SERIAL_FRAME_HEADER_SIZE];
+static bool rx_ack_due = false;
+static bool rx_nack_sent = false;
+static uint8_t rx_nack_highest_counter; // the highest counter received ahead of the expected one since the NACK
+#endif
 
 uint8_t header[SERIAL_FRAME_HEADER_SIZE];
-static uint8_t payload_len = 0;
+static uint16_t payload_len = 0;
+static uint8_t peer_frame_version = SERIAL_FRAME_VERSION_V0;
 static uint8_t packet_up_counter = 0;
 static uint8_t packet_down_counter = 0;
 static pin_id_t uart_state_pin;
@@ -119,6 +154,10 @@ static state_t state = STATE_IDLE;
 
 static void process_rx_fifo(void *arg);
 static void execute_state_machine();
+static void fill_header(uint8_t* header, uint8_t* header_size, uint8_t counter, serial_message_type_t type, uint16_t length, uint16_t crc);
+#if TX_WINDOW_SIZE > 0
+static void tx_ack_timeout(void *arg);
+#endif
 
 
 /** @Brief Enable UART interface and UART interrupt
@@ -130,7 +169,14 @@ static void modem_interface_enable(void)
   assert(uart_enable(uart));
 #ifdef FRAMEWORK_MODEM_INTERFACE_USE_DMA
   assert(dma_channel_enable(dma_rx));
-  uart_start_read_bytes_via_DMA(uart, rx_buffer, RX_BUFFER_SIZE, PLATFORM_MODEM_INTERFACE_DMA_RX);
+  // DMA directly into the free space of the RX ring, restart from the beginning of the buffer when it is empty
+  // to make the whole buffer available as one contiguous span
+  spsc_ring_span_t rx_spans[2];
+  if(spsc_ring_get_size(&rx_ring) == 0)
+    spsc_ring_reset(&rx_ring);
+
+  spsc_ring_get_write_spans(&rx_ring, rx_spans);
+  uart_start_read_bytes_via_DMA(uart, rx_spans[0].data, rx_spans[0].len, PLATFORM_MODEM_INTERFACE_DMA_RX);
   uart_tx_interrupt_enable(uart);
 #else 
   uart_rx_interrupt_enable(uart);
@@ -169,35 +215,149 @@ static void release_receiver()
 #endif
 }
 
+/** @brief returns the number of bytes in the TX fifo which can be transmitted now
+ * In windowed mode only the frames inside the window can be transmitted.
+ */
+static uint16_t get_tx_sendable_size()
+{
+#if TX_WINDOW_SIZE > 0
+  uint16_t window_size = 0;
+  for(uint8_t i = 0; i < tx_frames_count && i < TX_WINDOW_SIZE; i++)
+    window_size += tx_frames[(tx_frames_first + i) % TX_FRAME_QUEUE_SIZE].size;
+
+  return window_size - tx_sent_bytes;
+#else
+  return fifo_get_size(&modem_interface_tx_fifo) - tx_sent_bytes;
+#endif
+}
+
+/** @brief returns the first contiguous part of the data which can be transmitted now, in place
+ */
+static void get_tx_sendable_data(uint8_t** data, uint16_t* len)
+{
+  uint16_t sendable = get_tx_sendable_size();
+  fifo_t unsent;
+  fifo_init_subview(&unsent, &modem_interface_tx_fifo, tx_sent_bytes, sendable);
+  fifo_get_continuos_raw_data(&unsent, data, len);
+  if(*len > sendable)
+    *len = sendable;
+}
+
+#if TX_WINDOW_SIZE > 0
+/** @brief returns true when no data frame is partially transmitted
+ */
+static bool tx_at_frame_boundary()
+{
+  uint16_t frames_size = 0;
+  for(uint8_t i = 0; i < tx_frames_count && frames_size < tx_sent_bytes; i++)
+    frames_size += tx_frames[(tx_frames_first + i) % TX_FRAME_QUEUE_SIZE].size;
+
+  return frames_size == tx_sent_bytes;
+}
+#endif
+
+/** @brief registers that len bytes were transmitted
+ * Without windowing these are removed from the TX fifo immediately, otherwise they are kept until acknowledged.
+ */
+static void tx_bytes_sent(uint16_t len)
+{
+#if TX_WINDOW_SIZE > 0
+  tx_sent_bytes += len;
+  if(tx_rewind_pending && tx_at_frame_boundary())
+  {
+    // a retransmission was requested while a frame was being transmitted
+    tx_rewind_pending = false;
+    tx_sent_bytes = 0;
+  }
+#else
+  fifo_skip(&modem_interface_tx_fifo, len);
+#endif
+}
+
+#if TX_WINDOW_SIZE > 0
+/** @brief an ACK or NACK frame can only be inserted when no data frame is partially transmitted
+ */
+static bool can_send_ack()
+{
+  return ack_pending && tx_at_frame_boundary();
+}
+
+/** @brief sends the pending ACK or NACK frame, before any data frame
+ *  @return void
+ */
+static void send_pending_ack()
+{
+  uint8_t ack_frame_size;
+  fill_header(ack_frame, &ack_frame_size, ack_counter, ack_type, 0, crc_calculate(NULL, 0));
+  ack_pending = false;
+#ifdef FRAMEWORK_MODEM_INTERFACE_USE_DMA
+  tx_size = 0; // nothing to release from the TX fifo when this transfer completes
+  uart_send_bytes_via_DMA(uart, ack_frame, ack_frame_size, PLATFORM_MODEM_INTERFACE_DMA_TX);
+#else
+  uart_send_bytes(uart, ack_frame, ack_frame_size);
+#endif
+}
+#endif
+
 /** @brief transmit data in fifo to UART
  *  @return void
  */
 static void flush_modem_interface_tx_fifo(void *arg) 
 {
-  uint8_t len = fifo_get_size(&modem_interface_tx_fifo);
+  uint16_t len;
+  uint8_t* buffer;
+#ifndef FRAMEWORK_MODEM_INTERFACE_USE_DMA
+  uint16_t part_len;
+#endif
+
+#if TX_WINDOW_SIZE > 0
+  // (re)start the acknowledgement timeout each time we transmit
+  if(get_tx_sendable_size() > 0)
+    timer_post_task_delay(&tx_ack_timeout, TX_ACK_TIMEOUT);
+#endif
 
 #ifdef HAL_UART_USE_DMA_TX
-  // when using DMA we transmit the whole FIFO at once
-  uint8_t buffer[MODEM_INTERFACE_TX_FIFO_SIZE];
-  fifo_pop(&modem_interface_tx_fifo, buffer, len);
-  uart_send_bytes(uart, buffer, len);
+  // when using DMA we transmit the whole FIFO at once, in place (at most 2 parts when the data wraps)
+#if TX_WINDOW_SIZE > 0
+  if(can_send_ack())
+    send_pending_ack();
+#endif
+  len = get_tx_sendable_size();
+  while(len > 0)
+  {
+    get_tx_sendable_data(&buffer, &part_len);
+    uart_send_bytes(uart, buffer, part_len);
+    tx_bytes_sent(part_len);
+    len -= part_len;
+  }
 #elif defined(FRAMEWORK_MODEM_INTERFACE_USE_DMA)
   //Execute atomic, otherwise there is a chance that the DMA complete callback is called during execution of this code.
   // If that would happen a DMA transfer with length 0 is started which will not trigger a complete callback
   // This means that we have to fetch the data size inside the fifo inside the atomic part again
   start_atomic();
-  len = fifo_get_size(&modem_interface_tx_fifo);
-  if(len > 0)
+  len = get_tx_sendable_size();
+  bool ack_to_send = false;
+#if TX_WINDOW_SIZE > 0
+  ack_to_send = can_send_ack();
+#endif
+  if(len > 0 || ack_to_send || tx_dma_busy)
   {
     //log_print_string("flush %d", tx_dma_busy);
     if(!tx_dma_busy)
     {
       assert(dma_channel_enable(dma_tx));
       dma_channel_interrupt_enable(dma_tx);
-      uint8_t* buffer;
-      fifo_get_continuos_raw_data(&modem_interface_tx_fifo, &buffer, &tx_size);
-      uart_send_bytes_via_DMA(uart, buffer, tx_size, PLATFORM_MODEM_INTERFACE_DMA_TX);
       tx_dma_busy = true;
+#if TX_WINDOW_SIZE > 0
+      if(ack_to_send)
+        send_pending_ack();
+      else
+#endif
+      {
+        // the whole frame goes out in one transfer, unless it wraps around the end of the TX fifo
+        get_tx_sendable_data(&buffer, &tx_size);
+        uart_send_bytes_via_DMA(uart, buffer, tx_size, PLATFORM_MODEM_INTERFACE_DMA_TX);
+      }
     }
     //To keep awake
     sched_post_task_prio(&flush_modem_interface_tx_fifo, MIN_PRIORITY, NULL);
@@ -210,16 +370,34 @@ static void flush_modem_interface_tx_fifo(void *arg)
     sched_post_task(&execute_state_machine);
   }
   end_atomic();
+#else
+#if TX_WINDOW_SIZE > 0
+  if(can_send_ack())
+    send_pending_ack();
+#endif
+  len = get_tx_sendable_size();
+#ifdef FRAMEWORK_MODEM_INTERFACE_USE_INTERRUPT_LINES
+  // the receiver is woken up for us, transmit all frames at once
+  uint16_t chunk_len = len;
 #else
   // only send small chunks over uart each invocation, to make sure
   // we don't interfer with critical stack timings.
   // When there is still data left in the fifo this will be rescheduled
   // with lowest prio
-  uint8_t chunk[TX_FIFO_FLUSH_CHUNK_SIZE];
-  if(len <= TX_FIFO_FLUSH_CHUNK_SIZE)
+  uint16_t chunk_len = len <= tx_chunk_size ? len : tx_chunk_size;
+#endif
+  for(uint16_t remaining = chunk_len; remaining > 0; remaining -= part_len)
+  {
+    get_tx_sendable_data(&buffer, &part_len);
+    if(part_len > remaining)
+      part_len = remaining;
+
+    uart_send_bytes(uart, buffer, part_len);
+    tx_bytes_sent(part_len);
+  }
+
+  if(chunk_len == len)
   {
-    fifo_pop(&modem_interface_tx_fifo, chunk, len);
-    uart_send_bytes(uart, chunk, len);
     request_pending = false;
     release_receiver();
 #ifdef FRAMEWORK_MODEM_INTERFACE_USE_INTERRUPT_LINES
@@ -228,13 +406,105 @@ static void flush_modem_interface_tx_fifo(void *arg)
   } 
   else 
   {
-    fifo_pop(&modem_interface_tx_fifo, chunk, TX_FIFO_FLUSH_CHUNK_SIZE);
-    uart_send_bytes(uart, chunk, TX_FIFO_FLUSH_CHUNK_SIZE);
     sched_post_task_prio(&flush_modem_interface_tx_fifo, MIN_PRIORITY, NULL);
   }
 #endif
 }
 
+/** @brief starts transmitting the TX fifo contents and pending ACK/NACK frames
+ *  @return void
+ */
+static void start_tx()
+{
+  request_pending = true;
+#ifdef FRAMEWORK_MODEM_INTERFACE_USE_INTERRUPT_LINES
+  sched_post_task_prio(&execute_state_machine, MIN_PRIORITY, NULL);
+#else
+  sched_post_task_prio(&flush_modem_interface_tx_fifo, MIN_PRIORITY, NULL); // state machine is not used when not using interrupt lines
+#endif  
+}
+
+#if TX_WINDOW_SIZE > 0
+/** @brief retransmits all unacknowledged frames, starting from the oldest one
+ * A frame which is partially transmitted is completed first, so the receiver can resync on the next header.
+ *  @return void
+ */
+static void tx_rewind()
+{
+  start_atomic();
+  bool transfer_ongoing = false;
+#ifdef FRAMEWORK_MODEM_INTERFACE_USE_DMA
+  transfer_ongoing = tx_dma_busy;
+#endif
+  if(transfer_ongoing || !tx_at_frame_boundary())
+    tx_rewind_pending = true; // applied when the frame is completed, see tx_bytes_sent()
+  else
+    tx_sent_bytes = 0;
+  end_atomic();
+}
+
+static void tx_ack_timeout(void *arg)
+{
+  if(tx_frames_count == 0)
+    return;
+
+  DPRINT("ACK timeout, retransmit %i frames", tx_frames_count);
+  tx_rewind();
+  start_tx();
+}
+
+/** @brief processes a received ACK or NACK frame
+ * Releases all acknowledged frames from the TX fifo, which advances the window, and retransmits after a NACK.
+ *  @return void
+ */
+static void process_ack(uint8_t type, uint8_t counter)
+{
+  uint8_t last_acked = (type == SERIAL_MESSAGE_TYPE_ACK) ? counter : (uint8_t)(counter - 1);
+
+  start_atomic();
+  while(tx_frames_count > 0)
+  {
+    tx_frame_t* frame = &tx_frames[tx_frames_first];
+    if((int8_t)(last_acked - frame->counter) < 0 || frame->size > tx_sent_bytes)
+      break;
+
+    fifo_skip(&modem_interface_tx_fifo, frame->size);
+    tx_sent_bytes -= frame->size;
+    tx_frames_first = (tx_frames_first + 1) % TX_FRAME_QUEUE_SIZE;
+    tx_frames_count--;
+  }
+  end_atomic();
+
+  if(type == SERIAL_MESSAGE_TYPE_NACK)
+  {
+    DPRINT("NACK %i, retransmit %i frames", counter, tx_frames_count);
+    tx_rewind();
+  }
+
+  if(tx_frames_count == 0)
+    timer_cancel_task(&tx_ack_timeout);
+  else
+    timer_post_task_delay(&tx_ack_timeout, TX_ACK_TIMEOUT);
+
+  if(get_tx_sendable_size() > 0)
+    start_tx();
+}
+
+/** @brief queues an ACK or NACK frame, which is transmitted before any pending data frame
+ * Only the last one is kept, since the ACK is cumulative.
+ *  @return void
+ */
+static void queue_ack(uint8_t type, uint8_t counter)
+{
+  start_atomic();
+  ack_type = type;
+  ack_counter = counter;
+  ack_pending = true;
+  end_atomic();
+  start_tx();
+}
+#endif
+
 /** @Brief Keeps µC awake while receiving UART data
  *  @return void
  */
@@ -269,7 +539,7 @@ static void execute_state_machine()
       // response period completed, process the request
 #ifdef FRAMEWORK_MODEM_INTERFACE_USE_DMA
       size_t received_bytes = uart_stop_read_bytes_via_DMA(uart);
-      fifo_init_filled(&rx_fifo, rx_buffer, received_bytes, RX_BUFFER_SIZE);
+      spsc_ring_produce(&rx_ring, received_bytes);
 #endif
       sched_post_task(&process_rx_fifo);
       if(request_pending) {
@@ -287,7 +557,7 @@ static void execute_state_machine()
       if(hw_gpio_get_in(target_uart_state_pin)) {
         // wake-up requested
 #ifdef FRAMEWORK_MODEM_INTERFACE_USE_DMA
-        if(fifo_get_size(&rx_fifo) == 0)
+        if(spsc_ring_get_size(&rx_ring) == 0)
         {
 #endif
           SWITCH_STATE(STATE_REC);
@@ -364,31 +634,43 @@ static void execute_state_machine()
 #endif
 }
 
-/** @Brief Check package counter and crc
+/** @Brief Returns the header size for a frame version, or 0 if the version is not supported
+ */
+static uint8_t get_header_size(uint8_t version)
+{
+  if(version == SERIAL_FRAME_VERSION)
+    return SERIAL_FRAME_HEADER_SIZE;
+  else if(version == SERIAL_FRAME_VERSION_V0)
+    return SERIAL_FRAME_HEADER_SIZE_V0;
+  else
+    return 0;
+}
+
+/** @Brief Check crc
  *  @return void
  */
 static bool verify_payload(fifo_t* bytes, uint8_t* header)
 {
-  static uint8_t payload[RX_BUFFER_SIZE - SERIAL_FRAME_HEADER_SIZE]; // statically allocated so this does not end up on stack
-  fifo_peek(bytes, payload, 0, header[SERIAL_FRAME_SIZE]);
-
-  //check for missing packages
-  packet_down_counter++;
-  if(header[SERIAL_FRAME_COUNTER]!=packet_down_counter)
-  {
-    //TODO consequence? (save total missing packages?)
-    log_print_string("!!! missed packages: %i",(header[SERIAL_FRAME_COUNTER]-packet_down_counter));
-    packet_down_counter=header[SERIAL_FRAME_COUNTER]; //reset package counter
-  }
+  uint8_t header_size = get_header_size(header[1]);
+  // the payload can wrap around the end of the RX buffer, calculate the CRC over both parts instead of copying it first
+  uint8_t* payload;
+  uint16_t first_part_len;
+  uint16_t payload_len = fifo_get_size(bytes);
+  fifo_get_continuos_raw_data(bytes, &payload, &first_part_len);
 
   DPRINT("RX HEADER: ");
-  DPRINT_DATA(header, SERIAL_FRAME_HEADER_SIZE);
+  DPRINT_DATA(header, header_size);
   DPRINT("RX PAYLOAD: ");
-  DPRINT_DATA(payload, header[SERIAL_FRAME_SIZE]);
+  DPRINT_DATA(payload, first_part_len);
+  DPRINT_DATA(bytes->buffer, payload_len - first_part_len);
 
-  uint16_t calculated_crc = crc_calculate(payload, header[SERIAL_FRAME_SIZE]);
+  crc_ctx_t crc;
+  crc_init(&crc);
+  crc_update(&crc, payload, first_part_len);
+  crc_update(&crc, bytes->buffer, payload_len - first_part_len);
+  uint16_t calculated_crc = crc_final(&crc);
  
-  if(header[SERIAL_FRAME_CRC1]!=((calculated_crc >> 8) & 0x00FF) || header[SERIAL_FRAME_CRC2]!=(calculated_crc & 0x00FF))
+  if(header[header_size - 2]!=((calculated_crc >> 8) & 0x00FF) || header[header_size - 1]!=(calculated_crc & 0x00FF))
   {
     //TODO consequence? (request repeat?)
     log_print_string("CRC incorrect!");
@@ -406,7 +688,7 @@ void modem_interface_clear_handler() {
     //clear RX
     parsed_header = false;
     payload_len = 0;
-    fifo_clear(&rx_fifo);
+    spsc_ring_flush(&rx_ring);
 
     //clear TX
 #ifdef FRAMEWORK_MODEM_INTERFACE_USE_DMA
@@ -415,6 +697,16 @@ void modem_interface_clear_handler() {
 #endif
     request_pending = false;
     fifo_clear(&modem_interface_tx_fifo);
+    tx_sent_bytes = 0;
+#if TX_WINDOW_SIZE > 0
+    tx_frames_first = 0;
+    tx_frames_count = 0;
+    tx_rewind_pending = false;
+    ack_pending = false;
+    rx_ack_due = false;
+    rx_nack_sent = false;
+    timer_cancel_task(&tx_ack_timeout);
+#endif
     SWITCH_STATE(STATE_IDLE);
 }
 
@@ -422,103 +714,243 @@ void modem_interface_clear_handler() {
 static void uart_error_cb(uart_error_t error) {
     log_print_string("UART ERROR %i", error);
     if(error == UART_OVERRUN_ERROR) {
-      parsed_header = false;
-      payload_len = 0;
-      fifo_clear(&rx_fifo);
+      // we are the producer here, let process_rx_fifo() drop the received data
+      rx_overrun = true;
+      sched_post_task(&process_rx_fifo);
+    }
+}
+
+/** @Brief Searches the next valid header in the RX ring and parses it
+ * All data in front of the next sync byte is dropped in one pass over the buffered spans. Sync bytes which are not
+ * followed by a supported version or a feasible length are dropped and the search continues, without going
+ * through the scheduler.
+ *  @return true when a header was parsed into header[] and payload_len, false when more data is needed
+ */
+static bool parse_header()
+{
+  while(true)
+  {
+    spsc_ring_span_t spans[2];
+    uint16_t size = spsc_ring_peek_spans(&rx_ring, spans);
+    uint16_t skip_len;
+    uint8_t* sync = memchr(spans[0].data, SERIAL_FRAME_SYNC_BYTE, spans[0].len);
+    if(sync)
+      skip_len = sync - spans[0].data;
+    else
+    {
+      sync = memchr(spans[1].data, SERIAL_FRAME_SYNC_BYTE, spans[1].len);
+      skip_len = sync ? spans[0].len + (sync - spans[1].data) : size;
+    }
+
+    if(skip_len > 0)
+    {
+      DPRINT("skip %i", skip_len);
+      spsc_ring_commit(&rx_ring, skip_len);
+      size -= skip_len;
+    }
+
+    if(size < 2)
+      return false;
+
+    spsc_ring_peek(&rx_ring, header, 0, 2);
+    uint8_t header_size = get_header_size(header[1]);
+    if(header_size == 0)
+    {
+      // not a frame start, drop the sync byte and search for the next one
+      spsc_ring_commit(&rx_ring, 1);
+      continue;
+    }
+
+    if(size < header_size)
+      return false;
+
+    spsc_ring_peek(&rx_ring, header, 0, header_size);
+    if(header[1] == SERIAL_FRAME_VERSION)
+      payload_len = (header[SERIAL_FRAME_SIZE] << 8) | header[SERIAL_FRAME_SIZE_LSB];
+    else
+      payload_len = header[SERIAL_FRAME_SIZE];
+
+    if(payload_len > RX_BUFFER_SIZE - header_size)
+    {
+      // this can never be received completely, so this cannot be a valid header
+      DPRINT("payload size %i too big", payload_len);
+      spsc_ring_commit(&rx_ring, 1);
+      continue;
+    }
+
+    spsc_ring_commit(&rx_ring, header_size);
+    DPRINT("UART RX, v%i payload size = %i", header[1], payload_len);
+    return true;
+  }
+}
+
+/** @Brief Verifies a complete frame of which the header is parsed and passes it to the corresponding service
+ *  @return void
+ */
+static void dispatch_frame()
+{
+  // rx_ring can contain more than the current serial packet, init a fifo view on the ring
+  // which is restricted to payload_len so we can't parse past this packet, and the handlers can parse it in place.
+  fifo_t payload_fifo;
+  spsc_ring_init_fifo_view(&rx_ring, &payload_fifo, 0, payload_len);
+
+  if(!verify_payload(&payload_fifo,header))
+  {
+    DPRINT("!!!PAYLOAD DATA INCORRECT");
+#if TX_WINDOW_SIZE > 0
+    if(!rx_nack_sent)
+    {
+      rx_nack_sent = true;
+      rx_nack_highest_counter = packet_down_counter;
+      queue_ack(SERIAL_MESSAGE_TYPE_NACK, packet_down_counter + 1);
+    }
+#endif
+    return;
+  }
+
+  peer_frame_version = header[1];
+#if TX_WINDOW_SIZE > 0
+  if(header[SERIAL_FRAME_TYPE] == SERIAL_MESSAGE_TYPE_ACK || header[SERIAL_FRAME_TYPE] == SERIAL_MESSAGE_TYPE_NACK)
+  {
+    process_ack(header[SERIAL_FRAME_TYPE], header[SERIAL_FRAME_COUNTER]);
+    spsc_ring_commit(&rx_ring, payload_len);
+    return;
+  }
+
+  uint8_t counter = header[SERIAL_FRAME_COUNTER];
+  uint8_t expected_counter = packet_down_counter + 1;
+  uint8_t behind = expected_counter - counter;
+  uint8_t ahead = counter - expected_counter;
+  if(header[SERIAL_FRAME_TYPE] == SERIAL_MESSAGE_TYPE_REBOOTED || counter == expected_counter)
+  {
+    // in order, or the peer restarted its counter
+  }
+  else if(behind <= TX_WINDOW_SIZE)
+  {
+    // retransmission of a frame we already processed, acknowledge again
+    rx_ack_due = true;
+    spsc_ring_commit(&rx_ring, payload_len);
+    return;
+  }
+  else if(ahead < TX_WINDOW_SIZE && (!rx_nack_sent || (int8_t)(counter - rx_nack_highest_counter) > 0))
+  {
+    // we missed a frame, request retransmission once and drop the frames which follow until it arrives
+    if(!rx_nack_sent)
+    {
+      DPRINT("missed frame %i", expected_counter);
+      rx_nack_sent = true;
+      queue_ack(SERIAL_MESSAGE_TYPE_NACK, expected_counter);
     }
+
+    rx_nack_highest_counter = counter;
+    spsc_ring_commit(&rx_ring, payload_len);
+    return;
+  }
+
+  // Otherwise the counter can't belong to the window of the peer, because one of both sides rebooted, or the
+  // peer retransmitted its window after our NACK without the frame we expect. Resync on this frame.
+  if(counter != expected_counter && header[SERIAL_FRAME_TYPE] != SERIAL_MESSAGE_TYPE_REBOOTED)
+    log_print_error_string("modem interface: resync from frame %i to %i", expected_counter, counter);
+
+  packet_down_counter = counter;
+  rx_nack_sent = false;
+  rx_ack_due = true;
+#else
+  //check for missing packages
+  packet_down_counter++;
+  if(header[SERIAL_FRAME_COUNTER]!=packet_down_counter)
+  {
+    //TODO consequence? (save total missing packages?)
+    log_print_string("!!! missed packages: %i",(header[SERIAL_FRAME_COUNTER]-packet_down_counter));
+    packet_down_counter=header[SERIAL_FRAME_COUNTER]; //reset package counter
+  }
+#endif
+
+  if(header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_ALP_DATA && alp_handler != NULL)
+    alp_handler(&payload_fifo);
+  else if (header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_PING_RESPONSE  && ping_response_handler != NULL)
+    ping_response_handler(&payload_fifo);
+  else if (header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_LOGGING && logging_handler != NULL)
+    logging_handler(&payload_fifo);
+  else if (header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_PING_REQUEST)
+  {
+#ifdef MODULE_ALP
+    // free all alp commands
+    alp_layer_free_commands();
+#endif
+    uint8_t ping_reply[1]={0x02};
+    fifo_skip(&payload_fifo,1);
+    modem_interface_transfer_bytes(ping_reply,1,SERIAL_MESSAGE_TYPE_PING_RESPONSE);
+  }
+  else if(header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_REBOOTED)
+  {
+    uint8_t reboot_reason;
+    fifo_pop(&payload_fifo, &reboot_reason, 1);
+    DPRINT("target rebooted, reason=%i\n", reboot_reason);
+    if(target_rebooted_cb)
+      target_rebooted_cb(reboot_reason);
+  }
+  else
+  {
+    fifo_skip(&payload_fifo, payload_len);
+    DPRINT("!!!FRAME TYPE NOT IMPLEMENTED");
+  }
+  spsc_ring_commit(&rx_ring, payload_len - fifo_get_size(&payload_fifo)); // release parsed bytes from the ring
 }
 
 /** @Brief Processes received uart data
  * 1) Search for sync bytes (always)
- * 2) get header size and parse header
+ * 2) get header size and parse header (v0 or v1)
  * 3) Wait for correct # of bytes (length present in header)
  * 4) Execute crc check and check message counter
  * 5) send to corresponding service (alp, ping service, log service)
+ * All complete frames which are buffered are dispatched in a single invocation.
  *  @return void
  */
 static void process_rx_fifo(void *arg) 
 {
-  if(!parsed_header) 
+  if(rx_overrun)
   {
-    if(fifo_get_size(&rx_fifo) > SERIAL_FRAME_HEADER_SIZE) 
-    {
-        fifo_peek(&rx_fifo, header, 0, SERIAL_FRAME_HEADER_SIZE);
-
-        if(header[0] != SERIAL_FRAME_SYNC_BYTE || header[1] != SERIAL_FRAME_VERSION) 
-        {
-          fifo_skip(&rx_fifo, 1);
-          DPRINT("skip");
-          parsed_header = false;
-          payload_len = 0;
-          if(fifo_get_size(&rx_fifo) > SERIAL_FRAME_HEADER_SIZE)
-            sched_post_task(&process_rx_fifo);
-          return;
-        }
-        parsed_header = true;
-        fifo_skip(&rx_fifo, SERIAL_FRAME_HEADER_SIZE);
-        payload_len = header[SERIAL_FRAME_SIZE];
-        DPRINT("UART RX, payload size = %i", payload_len);
-        sched_post_task(&process_rx_fifo);
-    }
+    rx_overrun = false;
+    parsed_header = false;
+    payload_len = 0;
+    spsc_ring_flush(&rx_ring);
+    return;
   }
-  else 
+
+  while(true)
   {
-    if(fifo_get_size(&rx_fifo) < payload_len) {
-      return;
-    }
-    // payload complete, start parsing
-    // rx_fifo can be bigger than the current serial packet, init a subview fifo
-    // which is restricted to payload_len so we can't parse past this packet.
-    fifo_t payload_fifo;
-    fifo_init_subview(&payload_fifo, &rx_fifo, 0, payload_len);
-  
-    if(verify_payload(&payload_fifo,header))
+    if(!parsed_header)
     {
-      if(header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_ALP_DATA && alp_handler != NULL)
-        alp_handler(&payload_fifo);
-      else if (header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_PING_RESPONSE  && ping_response_handler != NULL)
-        ping_response_handler(&payload_fifo);
-      else if (header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_LOGGING && logging_handler != NULL)
-        logging_handler(&payload_fifo);
-      else if (header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_PING_REQUEST)
-      {
-#ifdef MODULE_ALP
-        // free all alp commands
-        alp_layer_free_commands();
-#endif
-        uint8_t ping_reply[1]={0x02};
-        fifo_skip(&payload_fifo,1);
-        modem_interface_transfer_bytes(ping_reply,1,SERIAL_MESSAGE_TYPE_PING_RESPONSE);
-      }
-      else if(header[SERIAL_FRAME_TYPE]==SERIAL_MESSAGE_TYPE_REBOOTED)
-      {
-        uint8_t reboot_reason;
-        fifo_pop(&payload_fifo, &reboot_reason, 1);
-        DPRINT("target rebooted, reason=%i\n", reboot_reason);
-        if(target_rebooted_cb)
-          target_rebooted_cb(reboot_reason);
-      }
-      else
-      {
-        fifo_skip(&payload_fifo, payload_len);
-        DPRINT("!!!FRAME TYPE NOT IMPLEMENTED");
-      }
-      fifo_skip(&rx_fifo, payload_len - fifo_get_size(&payload_fifo)); // pop parsed bytes from original fifo
+      parsed_header = parse_header();
+      if(!parsed_header)
+        break;
     }
-    else
-      DPRINT("!!!PAYLOAD DATA INCORRECT");
+
+    if(spsc_ring_get_size(&rx_ring) < payload_len)
+      break;
+
+    // payload complete, start parsing
+    dispatch_frame();
     payload_len = 0;
     parsed_header = false;
-    if(fifo_get_size(&rx_fifo) > SERIAL_FRAME_HEADER_SIZE)
-      sched_post_task(&process_rx_fifo);
   }
+
+#if TX_WINDOW_SIZE > 0
+  // acknowledge all frames received in this batch at once
+  if(rx_ack_due)
+  {
+    rx_ack_due = false;
+    queue_ack(SERIAL_MESSAGE_TYPE_ACK, packet_down_counter);
+  }
+#endif
 }
 
 #ifdef FRAMEWORK_MODEM_INTERFACE_USE_DMA
 static void uart_tx_cb()
 {
   tx_dma_busy = false;
-  fifo_skip(&modem_interface_tx_fifo, tx_size);
+  tx_bytes_sent(tx_size);
 }
 #else
 /** @Brief put received UART data in fifo
@@ -526,11 +958,8 @@ static void uart_tx_cb()
  */
 static void uart_rx_cb(uint8_t data)
 {
-    error_t err;
-    start_atomic();
-    err = fifo_put(&rx_fifo, &data, 1);
+    error_t err = spsc_ring_put_byte(&rx_ring, data);
     assert(err == SUCCESS);
-    end_atomic();
 
 #ifndef FRAMEWORK_MODEM_INTERFACE_USE_INTERRUPT_LINES
     sched_post_task(&process_rx_fifo);
@@ -565,14 +994,18 @@ void modem_interface_init(uint8_t idx, uint32_t baudrate, pin_id_t uart_state_pi
   sched_register_task(&flush_modem_interface_tx_fifo);
   sched_register_task(&execute_state_machine);
   sched_register_task(&process_rx_fifo);
+#if TX_WINDOW_SIZE > 0
+  sched_register_task(&tx_ack_timeout);
+#endif
   state = STATE_IDLE;
+  tx_chunk_size = TX_FIFO_FLUSH_CHUNK_SIZE(baudrate);
   uart_state_pin=uart_state_pin_id;
   target_uart_state_pin=target_uart_state_pin_id;
 
   uart = uart_init(idx, baudrate,0);
   DPRINT("uart initialized");
   
-  fifo_init(&rx_fifo, rx_buffer, sizeof(rx_buffer));
+  spsc_ring_init(&rx_ring, rx_buffer, sizeof(rx_buffer));
 #ifdef FRAMEWORK_MODEM_INTERFACE_USE_DMA
   dma_rx = dma_channel_init(PLATFORM_MODEM_INTERFACE_DMA_RX);
   dma_tx = dma_channel_init(PLATFORM_MODEM_INTERFACE_DMA_TX);
@@ -607,37 +1040,71 @@ void modem_interface_init(uint8_t idx, uint32_t baudrate, pin_id_t uart_state_pi
 #endif
 }
 
-void modem_interface_transfer_bytes(uint8_t* bytes, uint8_t length, serial_message_type_t type) 
+/** @Brief Fills the header in the format supported by the peer
+ *  @return void
+ */
+static void fill_header(uint8_t* header, uint8_t* header_size, uint8_t counter, serial_message_type_t type, uint16_t length, uint16_t crc)
+{
+  header[0] = SERIAL_FRAME_SYNC_BYTE;
+  header[SERIAL_FRAME_COUNTER] = counter;
+  header[SERIAL_FRAME_TYPE] = type;
+
+  // keep using v0 towards peers which did not show they support v1, unless the length does not fit
+  if(peer_frame_version == SERIAL_FRAME_VERSION || length > 0xFF)
+  {
+    *header_size = SERIAL_FRAME_HEADER_SIZE;
+    header[1] = SERIAL_FRAME_VERSION;
+    header[SERIAL_FRAME_SIZE] = (length >> 8) & 0x00FF;
+    header[SERIAL_FRAME_SIZE_LSB] = length & 0x00FF;
+  }
+  else
+  {
+    *header_size = SERIAL_FRAME_HEADER_SIZE_V0;
+    header[1] = SERIAL_FRAME_VERSION_V0;
+    header[SERIAL_FRAME_SIZE] = length;
+  }
+
+  header[*header_size - 2] = (crc >> 8) & 0x00FF;
+  header[*header_size - 1] = crc & 0x00FF;
+}
+
+void modem_interface_transfer_bytes(uint8_t* bytes, uint16_t length, serial_message_type_t type) 
 {
   uint8_t header[SERIAL_FRAME_HEADER_SIZE];
+  uint8_t header_size;
   uint16_t crc=crc_calculate(bytes,length);
 
-  packet_up_counter++;
-  header[0] = SERIAL_FRAME_SYNC_BYTE;
-  header[1] = SERIAL_FRAME_VERSION;
+  start_atomic();
+  fill_header(header, &header_size, packet_up_counter + 1, type, length, crc);
+  if(fifo_get_size(&modem_interface_tx_fifo) + header_size + length > MODEM_INTERFACE_TX_FIFO_SIZE
+#if TX_WINDOW_SIZE > 0
+     || tx_frames_count == TX_FRAME_QUEUE_SIZE
+#endif
+    )
+  {
+    end_atomic();
+    log_print_error_string("modem interface TX fifo full, dropping frame of %i bytes", length);
+    return;
+  }
 
-  header[SERIAL_FRAME_COUNTER] = packet_up_counter;
-  header[SERIAL_FRAME_TYPE] = type;
-  header[SERIAL_FRAME_SIZE] = length;
-  header[SERIAL_FRAME_CRC1] = (crc >> 8) & 0x00FF;
-  header[SERIAL_FRAME_CRC2] = crc & 0x00FF;
+  packet_up_counter++;
+  fifo_put(&modem_interface_tx_fifo, header, header_size);
+  fifo_put(&modem_interface_tx_fifo, bytes, length);
+#if TX_WINDOW_SIZE > 0
+  tx_frames[(tx_frames_first + tx_frames_count) % TX_FRAME_QUEUE_SIZE] = (tx_frame_t){
+    .size = header_size + length,
+    .counter = packet_up_counter
+  };
+  tx_frames_count++;
+#endif
+  end_atomic();
 
   DPRINT("TX HEADER:");
-  DPRINT_DATA(header, SERIAL_FRAME_HEADER_SIZE);
+  DPRINT_DATA(header, header_size);
   DPRINT("TX PAYLOAD:");
   DPRINT_DATA(bytes, length);
-   
-  start_atomic();
-  request_pending = true;
-  fifo_put(&modem_interface_tx_fifo, header, SERIAL_FRAME_HEADER_SIZE);
-  fifo_put(&modem_interface_tx_fifo, bytes, length);
-  end_atomic();
 
-#ifdef FRAMEWORK_MODEM_INTERFACE_USE_INTERRUPT_LINES
-  sched_post_task_prio(&execute_state_machine, MIN_PRIORITY, NULL);
-#else
-  sched_post_task_prio(&flush_modem_interface_tx_fifo, MIN_PRIORITY, NULL); // state machine is not used when not using interrupt lines
-#endif  
+  start_tx();
 }
 
 void modem_interface_transfer(char* string) {
@@ -19,10 +19,41 @@
 
 #include "ng.h"
 #if defined(NODE_GLOBALS)
-size_t __ng_node_id__ = 0xFFFFFFFF;
+NG_THREAD_LOCAL size_t __ng_node_id__ = 0xFFFFFFFF;
+
+#ifdef NODE_GLOBALS_GROUPED
+#include <stdlib.h>
+#include <string.h>
+
+// the copies are cache line aligned, so the state of a node never shares a cache line with another node
+#define NODE_ALIGNMENT 64
+
+// provided by the linker, the bounds of the node_globals section (weak: the section is absent without node globals)
+extern char __start_node_globals[] __attribute__((weak));
+extern char __stop_node_globals[] __attribute__((weak));
+
+NG_THREAD_LOCAL intptr_t __ng_offset__;
+static char* nodes_state;
+static size_t node_state_size;
+
+// before main(), so the copies are ready before any thread selects a node
+__attribute__((constructor)) static void init_nodes_state(void)
+{
+    size_t size = __stop_node_globals - __start_node_globals;
+    node_state_size = (size + NODE_ALIGNMENT - 1) & ~(size_t)(NODE_ALIGNMENT - 1);
+    int rc = posix_memalign((void**)&nodes_state, NODE_ALIGNMENT, node_state_size * __ng_max_nodes__);
+    assert(rc == 0);
+    for(size_t i = 0; i < __ng_max_nodes__; i++)
+        memcpy(nodes_state + i * node_state_size, __start_node_globals, size);
+}
+#endif
+
 __LINK_C void set_node_global_id(size_t node_id)
 {
 	assert(node_id < __ng_max_nodes__);
     __ng_node_id__ = node_id;
+#ifdef NODE_GLOBALS_GROUPED
+    __ng_offset__ = (intptr_t)(nodes_state + node_id * node_state_size) - (intptr_t)__start_node_globals;
+#endif
 }
 #endif
@@ -27,6 +27,7 @@
 // oss7
 #include "framework_defs.h"
 #include "log.h"
+#include "ng.h"
 #include "modules_defs.h"
 
 // other
@@ -52,12 +53,12 @@
 
 #define SECONDS_TILL_PERSIST 60
 
-static power_tracking_file_t current_power_tracking_file;
+static power_tracking_file_t NGDEF(current_power_tracking_file);
 
-static timer_tick_t cpu_active_time_prev_store_value;
-static timer_tick_t last_store_time;
+static timer_tick_t NGDEF(cpu_active_time_prev_store_value);
+static timer_tick_t NGDEF(last_store_time);
 
-static bool persist_file = true;
+static bool NGDEF(persist_file) = NGINIT(true);
 
 static error_t power_tracking_file_write(power_tracking_file_t* power_tracking_file);
 
@@ -80,8 +81,8 @@ error_t power_tracking_file_initialize()
     case -EEXIST:
     {
         uint32_t length = POWER_TRACKING_FILE_SIZE;
-        d7ap_fs_read_file(POWER_TRACKING_FILE_ID, 0, current_power_tracking_file.bytes, &length, ROOT_AUTH);
-        cpu_active_time_prev_store_value = current_power_tracking_file.cpu_active_time;
+        d7ap_fs_read_file(POWER_TRACKING_FILE_ID, 0, NG(current_power_tracking_file).bytes, &length, ROOT_AUTH);
+        NG(cpu_active_time_prev_store_value) = NG(current_power_tracking_file).cpu_active_time;
         break;
     }
     case SUCCESS:
@@ -92,7 +93,7 @@ error_t power_tracking_file_initialize()
     }
     sched_register_task((task_t)&power_tracking_persist_file);
 
-    current_power_tracking_file.boot_counter++;
+    NG(current_power_tracking_file).boot_counter++;
 
     sched_post_task((task_t)&power_tracking_persist_file);
     
@@ -101,7 +102,7 @@ error_t power_tracking_file_initialize()
 
 error_t power_tracking_file_read(power_tracking_file_t* power_tracking_file)
 {
-    memcpy(power_tracking_file->bytes, current_power_tracking_file.bytes, POWER_TRACKING_FILE_SIZE);
+    memcpy(power_tracking_file->bytes, NG(current_power_tracking_file).bytes, POWER_TRACKING_FILE_SIZE);
     return SUCCESS;
 }
 
@@ -110,26 +111,26 @@ error_t power_tracking_file_write(power_tracking_file_t* power_tracking_file)
     return d7ap_fs_write_file(POWER_TRACKING_FILE_ID, 0, power_tracking_file->bytes, POWER_TRACKING_FILE_SIZE, ROOT_AUTH);
 }
 
-void power_tracking_file_toggle_persisting(bool persist) { persist_file = persist; }
+void power_tracking_file_toggle_persisting(bool persist) { NG(persist_file) = persist; }
 
 error_t power_tracking_persist_file()
 {
     // don't persist the file if the application doesn't want any file writes at the moment
-    if(!persist_file)
+    if(!NG(persist_file))
         return -EINTR;
 #ifdef FRAMEWORK_POWER_TRACKING_RF
     DPRINT("persisting power tracking file with %i active, %i boots, %i tx, %i rx, %i standby",
-        current_power_tracking_file.cpu_active_time, current_power_tracking_file.boot_counter,
-        current_power_tracking_file.temp_tx_time, current_power_tracking_file.temp_rx_time,
-        current_power_tracking_file.temp_standby_time);
+        NG(current_power_tracking_file).cpu_active_time, NG(current_power_tracking_file).boot_counter,
+        NG(current_power_tracking_file).temp_tx_time, NG(current_power_tracking_file).temp_rx_time,
+        NG(current_power_tracking_file).temp_standby_time);
 #else
     DPRINT("persisting power tracking file with %i active, %i boots",
-        current_power_tracking_file.cpu_active_time, current_power_tracking_file.boot_counter);
+        NG(current_power_tracking_file).cpu_active_time, NG(current_power_tracking_file).boot_counter);
 #endif // FRAMEWORK_POWER_TRACKING_RF
-    DPRINT_DATA(current_power_tracking_file.bytes, POWER_TRACKING_FILE_SIZE);
-    cpu_active_time_prev_store_value = current_power_tracking_file.cpu_active_time;
-    last_store_time = timer_get_counter_value();
-    return power_tracking_file_write(&current_power_tracking_file);
+    DPRINT_DATA(NG(current_power_tracking_file).bytes, POWER_TRACKING_FILE_SIZE);
+    NG(cpu_active_time_prev_store_value) = NG(current_power_tracking_file).cpu_active_time;
+    NG(last_store_time) = timer_get_counter_value();
+    return power_tracking_file_write(&NG(current_power_tracking_file));
 }
 
 #ifdef FRAMEWORK_POWER_TRACKING_RF
@@ -138,14 +139,14 @@ error_t power_tracking_register_radio_action(power_tracking_transmit_mode_t powe
 {
     switch (type) {
     case POWER_TRACKING_RADIO_TX:
-        current_power_tracking_file.temp_tx_time += time;
+        NG(current_power_tracking_file).temp_tx_time += time;
         int8_t power = *((int8_t*)argument);
         break;
     case POWER_TRACKING_RADIO_RX:
-        current_power_tracking_file.temp_rx_time += time;
+        NG(current_power_tracking_file).temp_rx_time += time;
         break;
     case POWER_TRACKING_RADIO_STANDBY:
-        current_power_tracking_file.temp_standby_time += time;
+        NG(current_power_tracking_file).temp_standby_time += time;
         break;
     }
 }
@@ -153,9 +154,9 @@ error_t power_tracking_register_radio_action(power_tracking_transmit_mode_t powe
 
 error_t power_tracking_register_run_time(timer_tick_t time)
 {
-    current_power_tracking_file.cpu_active_time += time;
-    if(timer_calculate_difference(cpu_active_time_prev_store_value, current_power_tracking_file.cpu_active_time) > STORE_VALUE_DELTA
-    || timer_calculate_difference(last_store_time, timer_get_counter_value()) > STORE_TIME_DELTA)
+    NG(current_power_tracking_file).cpu_active_time += time;
+    if(timer_calculate_difference(NG(cpu_active_time_prev_store_value), NG(current_power_tracking_file).cpu_active_time) > STORE_VALUE_DELTA
+    || timer_calculate_difference(NG(last_store_time), timer_get_counter_value()) > STORE_TIME_DELTA)
     {
         //This function is always called just before the scheduler goes to sleep so scheduling this function will trigger a wake-up so call this function directly
         power_tracking_persist_file();
@@ -19,8 +19,23 @@
 
 #include "random.h"
 #include "types.h"
+#include "ng.h"
 #include <stdlib.h>
 
+#ifdef NODE_GLOBALS
+// every node has its own random sequence, which does not depend on the order in which the nodes are executed
+static unsigned int NGDEF(rng_state) = NGINIT(1);
+
+__LINK_C uint32_t get_rnd()
+{
+    return (uint32_t) rand_r(&NG(rng_state));
+}
+
+__LINK_C void set_rng_seed(unsigned int seed)
+{
+    NG(rng_state) = seed;
+}
+#else
 __LINK_C uint32_t get_rnd()
 {
     return (uint32_t) rand();
@@ -30,3 +45,4 @@ __LINK_C void set_rng_seed(unsigned int seed)
 {
     srand(seed);
 }
+#endif
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file sched_profiling.c
+ *
+ * The profiling data itself is recorded by the scheduler, this component only publishes it.
+ */
+
+#include "sched_profiling.h"
+
+#include "scheduler.h"
+#include "console.h"
+#include "debug.h"
+#include "log.h"
+#include "modules_defs.h"
+
+#ifdef MODULE_D7AP_FS
+#include "d7ap_fs.h"
+
+_Static_assert(D7A_FILE_SCHED_PROFILING_SIZE == 34 + 2 * SCHED_PROFILING_HISTOGRAM_BINS,
+               "the size of the scheduler profiling file does not match its layout");
+
+static uint8_t* put_uint32(uint8_t* ptr, uint32_t value)
+{
+    *ptr++ = value >> 24;
+    *ptr++ = value >> 16;
+    *ptr++ = value >> 8;
+    *ptr++ = value;
+    return ptr;
+}
+
+static error_t write_file(uint8_t task_index)
+{
+    uint8_t data[D7A_FILE_SCHED_PROFILING_SIZE] = { 0 };
+    uint8_t* ptr = data;
+
+    *ptr++ = task_index;
+    *ptr++ = sched_get_registered_task_count();
+    for(uint8_t priority = MAX_PRIORITY; priority <= MIN_PRIORITY; priority++)
+        *ptr++ = sched_get_queue_high_water_mark(priority);
+
+    sched_task_profile_t profile;
+    if(sched_get_task_profile(task_index, &profile) == SUCCESS)
+    {
+        ptr = put_uint32(ptr, (uint32_t)(uintptr_t)profile.task);
+        ptr = put_uint32(ptr, profile.run_count);
+        ptr = put_uint32(ptr, profile.total_run_time);
+        ptr = put_uint32(ptr, profile.max_run_time);
+        ptr = put_uint32(ptr, profile.total_latency);
+        ptr = put_uint32(ptr, profile.max_latency);
+        for(uint8_t i = 0; i < SCHED_PROFILING_HISTOGRAM_BINS; i++)
+        {
+            *ptr++ = profile.run_time_histogram[i] >> 8;
+            *ptr++ = profile.run_time_histogram[i] & 0xFF;
+        }
+    }
+
+    // the modified callback is not triggered, since it is the caller of this function
+    return d7ap_fs_write_file_with_callback(D7A_FILE_SCHED_PROFILING_FILE_ID, 0, data, D7A_FILE_SCHED_PROFILING_SIZE, ROOT_AUTH, false);
+}
+
+static void file_modified_callback(uint8_t file_id)
+{
+    uint8_t task_index;
+    uint32_t length = 1;
+    error_t ret = d7ap_fs_read_file(D7A_FILE_SCHED_PROFILING_FILE_ID, 0, &task_index, &length, ROOT_AUTH);
+    if(ret != SUCCESS)
+    {
+        log_print_error_string("Error reading the scheduler profiling file: %d", ret);
+        return;
+    }
+
+    if(task_index == SCHED_PROFILING_RESET)
+    {
+        sched_reset_profiling();
+        task_index = 0;
+    }
+
+    ret = write_file(task_index);
+    if(ret != SUCCESS)
+        log_print_error_string("Error writing the scheduler profiling file: %d", ret);
+}
+
+error_t sched_profiling_file_initialize(void)
+{
+    d7ap_fs_file_header_t volatile_file_header = {
+        .file_permissions = (file_permission_t){ .guest_read = true, .user_read = true, .user_write = true },
+        .file_properties.storage_class = FS_STORAGE_VOLATILE,
+        .length = D7A_FILE_SCHED_PROFILING_SIZE,
+        .allocated_length = D7A_FILE_SCHED_PROFILING_SIZE };
+
+    error_t ret = d7ap_fs_init_file(D7A_FILE_SCHED_PROFILING_FILE_ID, &volatile_file_header, NULL);
+    if(ret == -EEXIST)
+    {
+        // an existing file is only used when it is volatile, has the same length and the host can select a task
+        d7ap_fs_file_header_t file_header;
+        ret = d7ap_fs_read_file_header(D7A_FILE_SCHED_PROFILING_FILE_ID, &file_header);
+        if(ret == SUCCESS && (file_header.file_properties.storage_class != FS_STORAGE_VOLATILE
+                              || file_header.length != D7A_FILE_SCHED_PROFILING_SIZE
+                              || !file_header.file_permissions.user_write))
+            ret = -EINVAL;
+    }
+
+    if(ret == SUCCESS)
+        ret = write_file(0);
+
+    if(ret != SUCCESS)
+    {
+        log_print_error_string("Error initialization of scheduler profiling file: %d", ret);
+        return ret;
+    }
+
+    d7ap_fs_register_file_modified_callback(D7A_FILE_SCHED_PROFILING_FILE_ID, &file_modified_callback);
+    return SUCCESS;
+}
+#else
+error_t sched_profiling_file_initialize(void)
+{
+    return -ENOSYS;
+}
+#endif
+
+void sched_profiling_print(void)
+{
+    console_print("\r\nid task       runs       total_run  max_run    total_lat  max_lat    histogram\r\n");
+    for(uint8_t id = 0; id < sched_get_registered_task_count(); id++)
+    {
+        sched_task_profile_t profile;
+        sched_get_task_profile(id, &profile);
+        console_printf("%-2u %-10p %-10lu %-10lu %-10lu %-10lu %-10lu", id, (void*)profile.task,
+                       (unsigned long)profile.run_count, (unsigned long)profile.total_run_time,
+                       (unsigned long)profile.max_run_time, (unsigned long)profile.total_latency,
+                       (unsigned long)profile.max_latency);
+        for(uint8_t i = 0; i < SCHED_PROFILING_HISTOGRAM_BINS; i++)
+        {
+            console_printf(" %u", profile.run_time_histogram[i]);
+        }
+
+        console_print("\r\n");
+    }
+
+    console_print("queue high water marks:");
+    for(uint8_t priority = MAX_PRIORITY; priority <= MIN_PRIORITY; priority++)
+    {
+        console_printf(" %u", sched_get_queue_high_water_mark(priority));
+    }
+
+    console_print("\r\n");
+}
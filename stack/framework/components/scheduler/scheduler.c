@@ -43,10 +43,6 @@
 #include "framework_defs.h"
 #define SCHEDULER_MAX_TASKS FRAMEWORK_SCHEDULER_MAX_TASKS
 
-#ifdef NODE_GLOBALS
-    #warning NODE_GLOBALS is defined when using the default scheduler. Are you sure this is what you want ?
-#endif
-
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_SCHED_LOG_ENABLED)
   #define DPRINT(...) log_print_string( __VA_ARGS__)
 #else
@@ -54,12 +50,16 @@
 #endif
 
 
+#if SCHEDULER_MAX_TASKS >= SCHED_INVALID_TASK_ID
+    #error FRAMEWORK_SCHEDULER_MAX_TASKS should be smaller than SCHED_INVALID_TASK_ID
+#endif
+
 enum
 {
 	NUM_PRIORITIES = MIN_PRIORITY+1,
 	NUM_TASKS = SCHEDULER_MAX_TASKS,
 	NOT_SCHEDULED = NUM_PRIORITIES,
-	NO_TASK = SCHEDULER_MAX_TASKS,
+	NO_TASK = SCHED_INVALID_TASK_ID,
 };
 
 typedef struct
@@ -79,6 +79,19 @@ typedef struct
 	uint8_t index;
 } taskindex_info_t;
 
+#ifdef FRAMEWORK_SCHED_PROFILING_ENABLED
+typedef struct
+{
+	timer_tick_t post_time;
+	uint32_t run_count;
+	uint32_t total_run_time;
+	uint32_t max_run_time;
+	uint32_t total_latency;
+	uint32_t max_latency;
+	uint16_t run_time_histogram[SCHED_PROFILING_HISTOGRAM_BINS];
+} task_profile_t;
+#endif
+
 taskindex_info_t NGDEF(m_index)[NUM_TASKS];
 task_info_t NGDEF(m_info)[NUM_TASKS];
 
@@ -86,11 +99,16 @@ uint8_t NGDEF(m_head)[NUM_PRIORITIES];
 uint8_t NGDEF(m_tail)[NUM_PRIORITIES];
 volatile uint8_t NGDEF(current_priority);
 unsigned int NGDEF(num_registered_tasks);
+#ifdef FRAMEWORK_SCHED_PROFILING_ENABLED
+task_profile_t NGDEF(m_profile)[NUM_TASKS];
+uint8_t NGDEF(m_queue_depth)[NUM_PRIORITIES];
+uint8_t NGDEF(m_queue_high_water_mark)[NUM_PRIORITIES];
+#endif
 #if defined FRAMEWORK_USE_WATCHDOG
-bool watchdog_wakeup;
+static bool NGDEF(watchdog_wakeup);
 #endif
 
-volatile bool task_scheduled_after_sched_loop = false;
+static volatile bool NGDEF(task_scheduled_after_sched_loop) = NGINIT(false);
 
 #ifdef SCHEDULER_DEBUG
 void check_structs_are_valid()
@@ -155,7 +173,7 @@ static inline void check_structs_are_valid(){}
 #endif
 
 #if defined FRAMEWORK_USE_WATCHDOG
-static void __feed_watchdog_task(void *arg) { watchdog_wakeup = true; }
+static void __feed_watchdog_task(void *arg) { NG(watchdog_wakeup) = true; }
 #endif
 
 __LINK_C void scheduler_init()
@@ -174,6 +192,11 @@ __LINK_C void scheduler_init()
 	memset(NG(m_tail), NO_TASK, sizeof(NG(m_tail)));
 	NG(current_priority) = NUM_PRIORITIES;
 	NG(num_registered_tasks) = 0;
+#ifdef FRAMEWORK_SCHED_PROFILING_ENABLED
+	memset(NG(m_profile), 0, sizeof(NG(m_profile)));
+	memset(NG(m_queue_depth), 0, sizeof(NG(m_queue_depth)));
+	memset(NG(m_queue_high_water_mark), 0, sizeof(NG(m_queue_high_water_mark)));
+#endif
 	check_structs_are_valid();
 #if defined FRAMEWORK_USE_WATCHDOG
 	__watchdog_init();
@@ -206,16 +229,26 @@ __LINK_C uint8_t get_task_id(task_t task)
 	return NO_TASK;
 }
 
-__LINK_C error_t sched_register_task(task_t task)
+__LINK_C sched_task_id_t sched_get_task_id(task_t task)
 {
-  assert(NG(num_registered_tasks) < NUM_TASKS);
-  if(get_task_id(task) != NO_TASK)
+	start_atomic();
+	uint8_t task_id = get_task_id(task);
+	end_atomic();
+	return task_id;
+}
+
+static error_t register_task(task_t task, sched_task_id_t* task_id)
+{
+  *task_id = get_task_id(task);
+  if(*task_id != NO_TASK)
     return -EALREADY;
 
+  assert(NG(num_registered_tasks) < NUM_TASKS);
 	error_t retVal;
 	check_structs_are_valid();
 	//INT_Disable();
 	start_atomic();
+	*task_id = NG(num_registered_tasks);
 
     for(int i = NG(num_registered_tasks); i >= 0; i--)
     {
@@ -241,6 +274,19 @@ __LINK_C error_t sched_register_task(task_t task)
 	return retVal;
 }
 
+__LINK_C error_t sched_register_task(task_t task)
+{
+	sched_task_id_t task_id;
+	return register_task(task, &task_id);
+}
+
+__LINK_C sched_task_id_t sched_register_task_id(task_t task)
+{
+	sched_task_id_t task_id;
+	register_task(task, &task_id);
+	return task_id;
+}
+
 static inline bool is_scheduled(uint8_t id)
 {
 	assert(id < NUM_TASKS);
@@ -248,26 +294,32 @@ static inline bool is_scheduled(uint8_t id)
 	return NG(m_info)[id].priority != NOT_SCHEDULED;
 }
 
-__LINK_C bool sched_is_scheduled(task_t task)
+__LINK_C bool sched_is_scheduled_by_id(sched_task_id_t task_id)
 {
 	//INT_Disable();
 	start_atomic();
-	uint8_t task_id = get_task_id(task);
 	bool retVal = false;
-	if(task_id != NO_TASK)
+	if(task_id < NG(num_registered_tasks))
 		retVal = is_scheduled(task_id);
 	//INT_Enable();
 	end_atomic();
 	return retVal;
 }
 
-__LINK_C error_t sched_post_task_prio(task_t task, uint8_t priority, void *arg)
+__LINK_C bool sched_is_scheduled(task_t task)
+{
+	start_atomic();
+	bool retVal = sched_is_scheduled_by_id(get_task_id(task));
+	end_atomic();
+	return retVal;
+}
+
+__LINK_C error_t sched_post_task_by_id(sched_task_id_t task_id, uint8_t priority, void *arg)
 {
 	error_t retVal;
 	start_atomic();
 	check_structs_are_valid();
-	uint8_t task_id = get_task_id(task);
-	if(task_id == NO_TASK)
+	if(task_id >= NG(num_registered_tasks))
 		retVal = -EINVAL;
 	else if(priority > MIN_PRIORITY || priority < MAX_PRIORITY)
 		retVal = -ESIZE;
@@ -288,6 +340,11 @@ __LINK_C error_t sched_post_task_prio(task_t task, uint8_t priority, void *arg)
 		}
 		NG(m_info)[task_id].priority = priority;
                 NG(m_info)[task_id].arg = arg;
+#ifdef FRAMEWORK_SCHED_PROFILING_ENABLED
+		NG(m_profile)[task_id].post_time = timer_get_counter_value();
+		if(++NG(m_queue_depth)[priority] > NG(m_queue_high_water_mark)[priority])
+			NG(m_queue_high_water_mark)[priority] = NG(m_queue_depth)[priority];
+#endif
 		//if our priority is higher than the currently known maximum priority
 		if((priority < NG(current_priority)))
 			NG(current_priority) = priority;
@@ -296,18 +353,25 @@ __LINK_C error_t sched_post_task_prio(task_t task, uint8_t priority, void *arg)
 	}
 	end_atomic();
 	check_structs_are_valid();
-	task_scheduled_after_sched_loop = true;
+	NG(task_scheduled_after_sched_loop) = true;
 	return retVal;
 }
 
-__LINK_C error_t sched_cancel_task(task_t task)
+__LINK_C error_t sched_post_task_prio(task_t task, uint8_t priority, void *arg)
+{
+	start_atomic();
+	error_t retVal = sched_post_task_by_id(get_task_id(task), priority, arg);
+	end_atomic();
+	return retVal;
+}
+
+__LINK_C error_t sched_cancel_task_by_id(sched_task_id_t id)
 {
 	check_structs_are_valid();
 	error_t retVal;
 
 	start_atomic();
-	uint8_t id = get_task_id(task);
-	if(id == NO_TASK)
+	if(id >= NG(num_registered_tasks))
 		retVal = -EINVAL;
 	else if(!is_scheduled(id))
 		retVal = -EALREADY;
@@ -323,6 +387,9 @@ __LINK_C error_t sched_cancel_task(task_t task)
 		else
 			NG(m_info)[NG(m_info)[id].next].prev = NG(m_info)[id].prev;
 
+#ifdef FRAMEWORK_SCHED_PROFILING_ENABLED
+		NG(m_queue_depth)[NG(m_info)[id].priority]--;
+#endif
 		NG(m_info)[id].prev = NO_TASK;
 		NG(m_info)[id].next = NO_TASK;
 		NG(m_info)[id].priority = NOT_SCHEDULED;
@@ -333,6 +400,14 @@ __LINK_C error_t sched_cancel_task(task_t task)
 	return retVal;
 }
 
+__LINK_C error_t sched_cancel_task(task_t task)
+{
+	start_atomic();
+	error_t retVal = sched_cancel_task_by_id(get_task_id(task));
+	end_atomic();
+	return retVal;
+}
+
 static uint8_t pop_task(int priority)
 {
 	uint8_t id = NO_TASK;
@@ -347,6 +422,9 @@ static uint8_t pop_task(int priority)
 		else
 			NG(m_info)[NG(m_head)[priority]].prev = NO_TASK;
 
+#ifdef FRAMEWORK_SCHED_PROFILING_ENABLED
+		NG(m_queue_depth)[priority]--;
+#endif
 		NG(m_info)[id].next = NO_TASK;
 		NG(m_info)[id].prev = NO_TASK;
 		NG(m_info)[id].priority = NOT_SCHEDULED;
@@ -361,14 +439,103 @@ static inline bool tasks_waiting(int priority)
 	return NG(m_head)[priority] != NO_TASK;
 }
 
-static uint8_t low_power_mode = FRAMEWORK_SCHEDULER_LP_MODE;
+#ifdef FRAMEWORK_SCHED_PROFILING_ENABLED
+// bin 0 counts runs which took less than one tick, bin i runs which took [2^(i-1), 2^i) ticks and the last bin all longer runs
+static uint8_t get_histogram_bin(uint32_t run_time)
+{
+	uint8_t bin = 0;
+	while(run_time != 0 && bin < SCHED_PROFILING_HISTOGRAM_BINS - 1)
+	{
+		run_time >>= 1;
+		bin++;
+	}
+
+	return bin;
+}
+
+static void profile_task_run(uint8_t id, timer_tick_t start, timer_tick_t stop)
+{
+	task_profile_t* profile = &NG(m_profile)[id];
+	uint32_t run_time = stop - start;
+	uint32_t latency = start - profile->post_time;
+
+	profile->run_count++;
+	profile->total_run_time += run_time;
+	if(run_time > profile->max_run_time)
+		profile->max_run_time = run_time;
+
+	profile->total_latency += latency;
+	if(latency > profile->max_latency)
+		profile->max_latency = latency;
+
+	uint8_t bin = get_histogram_bin(run_time);
+	if(profile->run_time_histogram[bin] != UINT16_MAX)
+		profile->run_time_histogram[bin]++;
+}
+
+__LINK_C uint8_t sched_get_registered_task_count(void)
+{
+	return NG(num_registered_tasks);
+}
+
+__LINK_C error_t sched_get_task_profile(sched_task_id_t task_id, sched_task_profile_t* profile)
+{
+	if(task_id >= NG(num_registered_tasks))
+		return EINVAL;
+
+	start_atomic();
+	task_profile_t* p = &NG(m_profile)[task_id];
+	profile->task = NG(m_info)[task_id].task;
+	profile->run_count = p->run_count;
+	profile->total_run_time = p->total_run_time;
+	profile->max_run_time = p->max_run_time;
+	profile->total_latency = p->total_latency;
+	profile->max_latency = p->max_latency;
+	memcpy(profile->run_time_histogram, p->run_time_histogram, sizeof(profile->run_time_histogram));
+	end_atomic();
+	return SUCCESS;
+}
+
+__LINK_C uint8_t sched_get_queue_high_water_mark(uint8_t priority)
+{
+	assert(priority <= MIN_PRIORITY);
+	return NG(m_queue_high_water_mark)[priority];
+}
+
+__LINK_C void sched_reset_profiling(void)
+{
+	start_atomic();
+	for(uint8_t id = 0; id < NUM_TASKS; id++)
+	{
+		// the post time of queued tasks is kept, so their latency is still measured correctly
+		timer_tick_t post_time = NG(m_profile)[id].post_time;
+		memset(&NG(m_profile)[id], 0, sizeof(task_profile_t));
+		NG(m_profile)[id].post_time = post_time;
+	}
+
+	memcpy(NG(m_queue_high_water_mark), NG(m_queue_depth), sizeof(NG(m_queue_high_water_mark)));
+	end_atomic();
+}
+#endif
+
+static uint8_t NGDEF(low_power_mode) = NGINIT(FRAMEWORK_SCHEDULER_LP_MODE);
 
 uint8_t sched_get_low_power_mode(void) {
-  return low_power_mode;
+  return NG(low_power_mode);
 }
 
 void sched_set_low_power_mode(uint8_t mode) {
-  low_power_mode = mode;
+  NG(low_power_mode) = mode;
+}
+
+static uint8_t NGDEF(low_power_mode_limit) = NGINIT(UINT8_MAX);
+
+void sched_limit_low_power_mode(uint8_t max_mode) {
+  NG(low_power_mode_limit) = max_mode;
+}
+
+void sched_release_low_power_mode_limit(void) {
+  NG(low_power_mode_limit) = UINT8_MAX;
 }
 
 __LINK_C void scheduler_run()
@@ -378,7 +545,7 @@ __LINK_C void scheduler_run()
 #if defined FRAMEWORK_USE_WATCHDOG
 		bool task_list_empty = true;
 		uint8_t executed_tasks = 0;
-		watchdog_wakeup = false;
+		NG(watchdog_wakeup) = false;
 #endif
 #if defined FRAMEWORK_USE_POWER_TRACKING
 		timer_tick_t wakeup_time = timer_get_counter_value();
@@ -394,11 +561,17 @@ __LINK_C void scheduler_run()
 				hw_watchdog_feed();
 #endif
 				check_structs_are_valid();
+#ifdef FRAMEWORK_SCHED_PROFILING_ENABLED
+        timer_tick_t profile_start = timer_get_counter_value();
+#endif
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_SCHED_LOG_ENABLED)
         timer_tick_t start = timer_get_counter_value();
         log_print_string("SCHED start %p at %i", NG(m_info)[id].task, start);
 #endif
         NG(m_info)[id].task(NG(m_info)[id].arg);
+#ifdef FRAMEWORK_SCHED_PROFILING_ENABLED
+        profile_task_run(id, profile_start, timer_get_counter_value());
+#endif
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_SCHED_LOG_ENABLED)
         timer_tick_t stop = timer_get_counter_value();
         timer_tick_t duration = stop - start;
@@ -414,19 +587,24 @@ __LINK_C void scheduler_run()
 			for(int i = 0; i < NG(current_priority); i++)
 				assert(!tasks_waiting(i));
 #endif
-			task_scheduled_after_sched_loop = false;
+			NG(task_scheduled_after_sched_loop) = false;
 			end_atomic();	
 		}		
 #if defined FRAMEWORK_USE_WATCHDOG
 		if(!task_list_empty) //avoid rescheduling watchdog tasks when we didn't execute any tasks
-			timer_post_task_prio_delay(&__feed_watchdog_task, hw_watchdog_get_timeout() * TIMER_TICKS_PER_SEC, MAX_PRIORITY);
+		{
+			//the feed can share the wake-up of another timer during the second half of the watchdog timeout.
+			//Reposting it after every busy loop only reprograms the hw timer once the previous window has passed.
+			timer_tick_t feed_window = hw_watchdog_get_timeout() * TIMER_TICKS_PER_SEC / 2;
+			timer_post_task_prio_slack(&__feed_watchdog_task, timer_get_counter_value() + feed_window, feed_window, MAX_PRIORITY, 0, NULL);
+		}
 
 		hw_watchdog_feed();
 #if defined FRAMEWORK_USE_POWER_TRACKING
 		//we don't want to register wake-ups that only trigger the watchdog
 		//we also need to check that the watchdog task was the only task that was executed as there is a small chance that
 		//the watchdog task is triggered when also other tasks are executing. In that case we want to track the time as active.
-		if(!(task_list_empty || (watchdog_wakeup && executed_tasks == 1)))
+		if(!(task_list_empty || (NG(watchdog_wakeup) && executed_tasks == 1)))
 		{
 #endif
 #endif
@@ -441,8 +619,8 @@ __LINK_C void scheduler_run()
 		//during some oss7-testsuite cases we can see a scheduling of the flushing of the fifos for the UART in between the end of the scheduler 
 		//priority loop, and the call to enter low power mode. This caused the test to fail as the response was received by the testsuite only 
 		//after the watchdog woke up the device. So, task_scheduled_after_sched_loop is used to ensure the tasklist is really empty.
-		if(!task_scheduled_after_sched_loop) {
-			hw_enter_lowpower_mode(low_power_mode);
+		if(!NG(task_scheduled_after_sched_loop)) {
+			hw_enter_lowpower_mode(NG(low_power_mode) > NG(low_power_mode_limit) ? NG(low_power_mode_limit) : NG(low_power_mode));
 		}
 	}
 }
@@ -29,25 +29,25 @@
 #ifdef FRAMEWORK_SHELL_ENABLED
 
 
-#define CMD_BUFFER_SIZE 512
+#define CMD_BUFFER_SIZE 512 // must be a power of two, see spsc_ring_init()
 #define CMD_HANDLER_REGISTRATIONS_COUNT 3 // TODO configurable using cmake
 #define CMD_HANDLER_ID_NOT_SET -1
 
 #include "hwuart.h"
 #include "scheduler.h"
 #include "hwsystem.h"
-#include "hwatomic.h"
+#include "spsc_ring.h"
 #include "debug.h"
 
 #include "console.h"
+#include "sched_profiling.h"
 
 #include "ng.h"
 
 static uint8_t NGDEF(_cmd_buffer)[CMD_BUFFER_SIZE] = { 0 };
 #define cmd_buffer NG(_cmd_buffer)
 
-static fifo_t NGDEF(_cmd_fifo);
-#define cmd_fifo NG(_cmd_fifo)
+static spsc_ring_t NGDEF(cmd_ring);
 
 static cmd_handler_registration_t NGDEF(_cmd_handler_registrations)[CMD_HANDLER_REGISTRATIONS_COUNT];
 #define cmd_handler_registrations NG(_cmd_handler_registrations)
@@ -66,6 +66,9 @@ static void process_shell_cmd(char cmd)
         case 'R':
             hw_reset();
             break;
+        case 'P':
+            sched_profiling_print();
+            break;
         default:
             // TODO log
             break;
@@ -93,21 +96,22 @@ static cmd_handler_t get_cmd_handler_callback(int8_t id)
 // ATx\r : shell command, where x is a char which maps to a command.
 // List of supported commands:
 // - R: reboot device
+// - P: print the scheduler profiling data (FRAMEWORK_SCHED_PROFILING_ENABLED)
 // AT$<command handler id> : command to be handled by the command handler specified. The command handler id is a byte < 65 (non ASCII)
 // The handlers are passed the command fifo (including the header) and are responsible for pop()-ing the bytes which are processed by the handler.
 // When the fifo does not yet contain a full command which can be processed by the specific handler nothing should be popped and the handler will
 // called again later when more data is received.
 static void process_cmd_fifo()
 {
-    if(fifo_get_size(&cmd_fifo) >= SHELL_CMD_HEADER_SIZE)
+    if(spsc_ring_get_size(&NG(cmd_ring)) >= SHELL_CMD_HEADER_SIZE)
     {
         uint8_t cmd_header[SHELL_CMD_HEADER_SIZE];
-        fifo_peek(&cmd_fifo, cmd_header, 0, SHELL_CMD_HEADER_SIZE);
+        spsc_ring_peek(&NG(cmd_ring), cmd_header, 0, SHELL_CMD_HEADER_SIZE);
         if(cmd_header[0] != 'A' || cmd_header[1] != 'T')
         {
             // unexpected data, pop and return
             // TODO log?
-            fifo_pop(&cmd_fifo, cmd_header, 1);
+            spsc_ring_commit(&NG(cmd_ring), 1);
             sched_post_task(&process_cmd_fifo);
             return;
         }
@@ -115,23 +119,28 @@ static void process_cmd_fifo()
         if(cmd_header[2] != '$')
         {
             process_shell_cmd(cmd_header[2]);
-            fifo_pop(&cmd_fifo, cmd_header, SHELL_CMD_HEADER_SIZE);
+            spsc_ring_commit(&NG(cmd_ring), SHELL_CMD_HEADER_SIZE);
         }
         else
         {
+            // the handler parses the received bytes in place using a fifo view on the ring
+            fifo_t cmd_fifo;
+            uint16_t size = spsc_ring_get_size(&NG(cmd_ring));
+            spsc_ring_init_fifo_view(&NG(cmd_ring), &cmd_fifo, 0, size);
             get_cmd_handler_callback(cmd_header[3])(&cmd_fifo);
+            spsc_ring_commit(&NG(cmd_ring), size - fifo_get_size(&cmd_fifo));
         }
 
         sched_post_task(&process_cmd_fifo);
-    } else if(fifo_get_size(&cmd_fifo) >= 3) {
+    } else if(spsc_ring_get_size(&NG(cmd_ring)) >= 3) {
       // AT[\r|\n]
       uint8_t cmd_header[3];
-      fifo_peek(&cmd_fifo, cmd_header, 0, 3);
+      spsc_ring_peek(&NG(cmd_ring), cmd_header, 0, 3);
       if( cmd_header[0] == 'A' && cmd_header[1] == 'T'
           && ( cmd_header[2] == '\r' || cmd_header[2] == '\n' ) )
       {
         console_print("OK\r\n");
-        fifo_pop(&cmd_fifo, cmd_header, 3);
+        spsc_ring_commit(&NG(cmd_ring), 3);
       }
     }
 }
@@ -143,11 +152,7 @@ static void uart_rx_cb(uint8_t data)
       if( data == '\r' ) { console_print_byte('\n'); }
     }
 
-    error_t err;
-
-    start_atomic();
-        err = fifo_put(&cmd_fifo, &data, 1); assert(err == SUCCESS);
-    end_atomic();
+    error_t err = spsc_ring_put_byte(&NG(cmd_ring), data); assert(err == SUCCESS);
 
     if(!sched_is_scheduled(&process_cmd_fifo))
         sched_post_task_prio(&process_cmd_fifo, MIN_PRIORITY - 1, NULL);
@@ -161,7 +166,7 @@ void shell_init()
         cmd_handler_registrations[i].cmd_handler_callback = NULL;
     }
 
-    fifo_init(&cmd_fifo, cmd_buffer, sizeof(cmd_buffer));
+    spsc_ring_init(&NG(cmd_ring), cmd_buffer, sizeof(cmd_buffer));
 
     console_set_rx_interrupt_callback(&uart_rx_cb);
     console_rx_interrupt_enable();
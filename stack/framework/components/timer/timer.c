@@ -32,11 +32,6 @@
   #define DPRINT(...)
 #endif
 
-
-#ifdef NODE_GLOBALS
-    #warning Default Timer implementation used when NODE_GLOBALS is active. Are you sure this is what you want ??
-#endif
-
 #define HW_TIMER_ID 0
 
 #define COUNTER_OVERFLOW_INCREASE (UINT32_C(1) << (8*sizeof(hwtimer_tick_t)))
@@ -45,15 +40,33 @@
 extern inline error_t timer_post_task(task_t task, timer_tick_t time);
 extern inline error_t timer_post_task_prio_delay(task_t task, timer_tick_t delay, uint8_t priority);
 extern inline error_t timer_post_task_delay(task_t task, timer_tick_t delay);
+extern inline error_t timer_post_task_delay_slack(task_t task, timer_tick_t delay, timer_tick_t slack);
 extern inline error_t timer_add_event(timer_event* event);
 
 static timer_event NGDEF(timers)[FRAMEWORK_TIMER_STACK_SIZE];
+// scheduler handles of the timer tasks, resolved when posting so the timer interrupt does not need to look them up
+static sched_task_id_t NGDEF(timer_task_ids)[FRAMEWORK_TIMER_STACK_SIZE];
+#ifdef FRAMEWORK_TIMER_USE_HEAP
+// the table mapping tasks to timer slots is kept at least twice as large as the number of
+// slots, this keeps the probe sequences short and guarantees there is always an empty entry
+#define TIMER_LOOKUP_SIZE (2 * FRAMEWORK_TIMER_STACK_SIZE + 1)
+#if FRAMEWORK_TIMER_STACK_SIZE >= UINT16_MAX
+    #error FRAMEWORK_TIMER_STACK_SIZE is too large for the timer heap
+#endif
+typedef uint16_t timer_slot_t;
+// timer_heap[0 .. timer_heap_size) contains the slots of the scheduled events, ordered as a binary min-heap
+// on their fire time. The remaining entries contain the unused slots, so allocating a slot is O(1) as well.
+static timer_slot_t NGDEF(timer_heap)[FRAMEWORK_TIMER_STACK_SIZE];
+static timer_slot_t NGDEF(timer_heap_pos)[FRAMEWORK_TIMER_STACK_SIZE];
+static timer_slot_t NGDEF(timer_lookup)[TIMER_LOOKUP_SIZE];
+static uint32_t NGDEF(timer_heap_size);
+#endif
 static volatile timer_tick_t NGDEF(next_event);
 static volatile bool NGDEF(hw_event_scheduled);
 static volatile timer_tick_t NGDEF(timer_offset);
 static const hwtimer_info_t* timer_info;
-static bool timer_busy_programming = false;
-static bool fired_by_interrupt = true;
+static bool NGDEF(timer_busy_programming) = NGINIT(false);
+static bool NGDEF(fired_by_interrupt) = NGINIT(true);
 enum
 {
     NO_EVENT = FRAMEWORK_TIMER_STACK_SIZE,
@@ -62,10 +75,237 @@ enum
 static void timer_overflow();
 static void timer_fired();
 
-__LINK_C void timer_init()
+// the latest time at which the event may fire, the hw timer is always programmed for the earliest of these
+static inline timer_tick_t get_deadline(uint32_t slot)
+{
+    return NG(timers)[slot].next_event + NG(timers)[slot].slack;
+}
+
+/*
+ * Timer event storage backends. Both store the events in NG(timers) and identify them by their slot index,
+ * they only differ in how the events are located and ordered:
+ *  - the default backend scans the complete table, which is the smallest in code size
+ *  - the heap backend (FRAMEWORK_TIMER_USE_HEAP) keeps the events in a min-heap ordered on deadline together with
+ *    a hash table from task to slot, so inserting and cancelling is O(log n) and finding the next event is O(1).
+ * get_next_event() returns the event with the earliest deadline (fire time + slack).
+ * All of these functions should only be called from an atomic context.
+ */
+#ifndef FRAMEWORK_TIMER_USE_HEAP
+
+static void timer_storage_init()
+{
+    for(uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
+        NG(timers)[i].f = 0x0;
+}
+
+static uint32_t timer_storage_find(task_t task)
+{
+    for(uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
+    {
+        if(NG(timers)[i].f == task)
+            return i;
+    }
+    return NO_EVENT;
+}
+
+static uint32_t timer_storage_alloc()
+{
+    return timer_storage_find(0x0);
+}
+
+static inline void timer_storage_insert(uint32_t slot) {}
+
+static inline void timer_storage_update(uint32_t slot) {}
+
+static void timer_storage_remove(uint32_t slot)
+{
+    NG(timers)[slot].f = 0x0;
+}
+
+static uint32_t get_next_event()
+{
+    int32_t min_delay;
+    uint32_t next_fire_event = NO_EVENT;
+    uint32_t counter = timer_get_counter_value();
+
+    for(uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
+    {
+    	if(NG(timers)[i].f == 0x0)
+    		continue;
+    	//trick borrowed from AODV: by using signed integers in this way
+    	//we know that if the event has already passed delay_ticks will be < 0
+    	// --> events are sorted from past -> future regardless of any (pending) overflows
+    	int32_t delay_ticks = ((int32_t)get_deadline(i)) - ((int32_t)counter);
+    	if(next_fire_event == NO_EVENT || delay_ticks < min_delay)
+		{
+    		min_delay = delay_ticks;
+			next_fire_event = i;
+		}
+    }
+    return next_fire_event;
+}
+
+#else
+
+static inline uint32_t timer_lookup_hash(task_t task)
+{
+    return ((uint32_t)(((uintptr_t)task >> 1) * UINT32_C(2654435761))) % TIMER_LOOKUP_SIZE;
+}
+
+static inline uint32_t timer_lookup_next(uint32_t index)
+{
+    return (index + 1) == TIMER_LOOKUP_SIZE ? 0 : index + 1;
+}
+
+static void timer_lookup_remove(uint32_t slot)
+{
+    uint32_t i = timer_lookup_hash(NG(timers)[slot].f);
+    while(NG(timer_lookup)[i] != slot)
+    {
+        assert(NG(timer_lookup)[i] != NO_EVENT);
+        i = timer_lookup_next(i);
+    }
+
+    // backward shift deletion: move up the entries of the probe sequence which would no longer be reachable
+    for(uint32_t j = timer_lookup_next(i); NG(timer_lookup)[j] != NO_EVENT; j = timer_lookup_next(j))
+    {
+        uint32_t home = timer_lookup_hash(NG(timers)[NG(timer_lookup)[j]].f);
+        bool reachable = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if(!reachable)
+        {
+            NG(timer_lookup)[i] = NG(timer_lookup)[j];
+            i = j;
+        }
+    }
+    NG(timer_lookup)[i] = NO_EVENT;
+}
+
+// wrap-around safe comparison, valid as long as all scheduled events lie within 2^31 ticks of each other
+static inline bool timer_fires_before(timer_slot_t a, timer_slot_t b)
+{
+    return ((int32_t)(get_deadline(a) - get_deadline(b))) < 0;
+}
+
+static inline void timer_heap_swap(uint32_t i, uint32_t j)
+{
+    timer_slot_t slot = NG(timer_heap)[i];
+    NG(timer_heap)[i] = NG(timer_heap)[j];
+    NG(timer_heap)[j] = slot;
+    NG(timer_heap_pos)[NG(timer_heap)[i]] = i;
+    NG(timer_heap_pos)[NG(timer_heap)[j]] = j;
+}
+
+static void timer_heap_sift_up(uint32_t pos)
+{
+    while(pos > 0)
+    {
+        uint32_t parent = (pos - 1) / 2;
+        if(!timer_fires_before(NG(timer_heap)[pos], NG(timer_heap)[parent]))
+            break;
+
+        timer_heap_swap(pos, parent);
+        pos = parent;
+    }
+}
+
+static void timer_heap_sift_down(uint32_t pos)
+{
+    while(true)
+    {
+        uint32_t first = pos;
+        uint32_t left = 2 * pos + 1;
+        uint32_t right = left + 1;
+        if(left < NG(timer_heap_size) && timer_fires_before(NG(timer_heap)[left], NG(timer_heap)[first]))
+            first = left;
+
+        if(right < NG(timer_heap_size) && timer_fires_before(NG(timer_heap)[right], NG(timer_heap)[first]))
+            first = right;
+
+        if(first == pos)
+            break;
+
+        timer_heap_swap(pos, first);
+        pos = first;
+    }
+}
+
+static void timer_storage_init()
 {
     for(uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
-	NG(timers)[i].f = 0x0;
+    {
+        NG(timers)[i].f = 0x0;
+        NG(timer_heap)[i] = i;
+        NG(timer_heap_pos)[i] = i;
+    }
+
+    for(uint32_t i = 0; i < TIMER_LOOKUP_SIZE; i++)
+        NG(timer_lookup)[i] = NO_EVENT;
+
+    NG(timer_heap_size) = 0;
+}
+
+static uint32_t timer_storage_find(task_t task)
+{
+    for(uint32_t i = timer_lookup_hash(task); NG(timer_lookup)[i] != NO_EVENT; i = timer_lookup_next(i))
+    {
+        if(NG(timers)[NG(timer_lookup)[i]].f == task)
+            return NG(timer_lookup)[i];
+    }
+    return NO_EVENT;
+}
+
+static uint32_t timer_storage_alloc()
+{
+    if(NG(timer_heap_size) == FRAMEWORK_TIMER_STACK_SIZE)
+        return NO_EVENT;
+
+    return NG(timer_heap)[NG(timer_heap_size)];
+}
+
+static void timer_storage_insert(uint32_t slot)
+{
+    assert(NG(timer_heap_pos)[slot] == NG(timer_heap_size));
+    uint32_t i = timer_lookup_hash(NG(timers)[slot].f);
+    while(NG(timer_lookup)[i] != NO_EVENT)
+        i = timer_lookup_next(i);
+
+    NG(timer_lookup)[i] = slot;
+    NG(timer_heap_size)++;
+    timer_heap_sift_up(NG(timer_heap_pos)[slot]);
+}
+
+static void timer_storage_update(uint32_t slot)
+{
+    timer_heap_sift_up(NG(timer_heap_pos)[slot]);
+    timer_heap_sift_down(NG(timer_heap_pos)[slot]);
+}
+
+static void timer_storage_remove(uint32_t slot)
+{
+    timer_lookup_remove(slot);
+    NG(timers)[slot].f = 0x0;
+
+    // move the last event in the place of the removed one and restore the heap order from there
+    uint32_t pos = NG(timer_heap_pos)[slot];
+    NG(timer_heap_size)--;
+    timer_heap_swap(pos, NG(timer_heap_size));
+    if(pos < NG(timer_heap_size))
+        timer_storage_update(NG(timer_heap)[pos]);
+}
+
+static uint32_t get_next_event()
+{
+    if(NG(timer_heap_size) == 0)
+        return NO_EVENT;
+
+    return NG(timer_heap)[0];
+}
+
+#endif
+
+__LINK_C void timer_init()
+{
+    timer_storage_init();
 
     NG(next_event) = NO_EVENT;
     NG(timer_offset) = 0;
@@ -83,11 +323,17 @@ error_t timer_init_event(timer_event* event, task_t callback)
     event->arg = NULL;
     event->priority = MAX_PRIORITY;
     event->period = 0;
+    event->slack = 0;
     return (sched_register_task(callback)); // register the function callback to be called at the end of the timeout
 }
 
 static bool configure_next_event();
 __LINK_C error_t timer_post_task_prio(task_t task, timer_tick_t fire_time, uint8_t priority, timer_tick_t period, void *arg)
+{
+    return timer_post_task_prio_slack(task, fire_time, 0, priority, period, arg);
+}
+
+__LINK_C error_t timer_post_task_prio_slack(task_t task, timer_tick_t fire_time, timer_tick_t slack, uint8_t priority, timer_tick_t period, void *arg)
 {
     error_t status = ENOMEM;
     if (priority > MIN_PRIORITY)
@@ -101,41 +347,56 @@ __LINK_C error_t timer_post_task_prio(task_t task, timer_tick_t fire_time, uint8
         return (sched_post_task_prio(task, priority, arg));
     }
 
+    sched_task_id_t task_id = sched_get_task_id(task);
     bool conf_atomic_ended = false;
     start_atomic();
-    uint32_t empty_index = FRAMEWORK_TIMER_STACK_SIZE;
-    for (uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
+    uint32_t empty_index = timer_storage_find(task);
+    if (empty_index != NO_EVENT)
     {
-        if (NG(timers)[i].f == 0x0 && empty_index == FRAMEWORK_TIMER_STACK_SIZE)
-        {
-            empty_index = i;
-        }
-        else if (NG(timers)[i].f == task)
+        // it is allowed to update only the fire time
+        if (NG(timers)[empty_index].priority == priority)
         {
-            // it is allowed to update only the fire time
-            if (NG(timers)[i].priority == priority)
+            NG(timers)[empty_index].period = period;
+            timer_tick_t deadline = get_deadline(empty_index);
+            if (((int32_t)(fire_time - NG(timers)[empty_index].next_event)) >= 0
+                && ((int32_t)(deadline - fire_time)) >= 0
+                && ((int32_t)(fire_time + slack - deadline)) >= 0)
             {
-                NG(timers)[i].period = period;
-                NG(timers)[i].next_event = fire_time;
-                empty_index = i;
-                goto config;
+                // the new window starts within the scheduled one and ends after it, so firing in their intersection
+                // satisfies both. The deadline does not change, so the hw timer is left untouched. This way repeatedly
+                // posting a task with slack (eg the watchdog feed) does not reprogram the hw timer every time.
+                NG(timers)[empty_index].next_event = fire_time;
+                NG(timers)[empty_index].slack = deadline - fire_time;
+                status = SUCCESS;
+                goto end;
             }
-            else
+
+            NG(timers)[empty_index].next_event = fire_time;
+            NG(timers)[empty_index].slack = slack;
+            timer_storage_update(empty_index);
+            goto config;
+        }
+        else
+        {
             //for now: do not allow an event to be scheduled more than once
             //otherwise we risk having the same task being scheduled twice and only executed once
             //because the scheduler disallows the same task to be scheduled multiple times
-                status = EALREADY;
-            break;
+            status = EALREADY;
+            goto end;
         }
     }
 
-    if (status != EALREADY && empty_index != FRAMEWORK_TIMER_STACK_SIZE)
+    empty_index = timer_storage_alloc();
+    if (empty_index != NO_EVENT)
     {
         NG(timers)[empty_index].f = task;
         NG(timers)[empty_index].next_event = fire_time;
         NG(timers)[empty_index].priority = priority;
         NG(timers)[empty_index].arg = arg;
         NG(timers)[empty_index].period = period;
+        NG(timers)[empty_index].slack = slack;
+        NG(timer_task_ids)[empty_index] = task_id;
+        timer_storage_insert(empty_index);
     }
     else
         goto end;
@@ -155,11 +416,11 @@ config:
             //if the new event should fire sooner than the old event --> trigger reconfig
             //this is done using signed ints (compared to the current counter)
             //to ensure propper handling of timer overflows
-            int32_t next_fire_delay = ((int32_t)fire_time) - ((int32_t)counter);
+            int32_t next_fire_delay = ((int32_t)get_deadline(empty_index)) - ((int32_t)counter);
 
             DPRINT("next_fire_delay <%lu>" , next_fire_delay);
 
-            int32_t old_fire_delay = ((int32_t)NG(timers)[NG(next_event)].next_event) - ((int32_t)counter);
+            int32_t old_fire_delay = ((int32_t)get_deadline(NG(next_event))) - ((int32_t)counter);
             do_config = (next_fire_delay <= old_fire_delay) || NG(next_event) == empty_index; //when same index is overwritten, also update
         }
 
@@ -187,20 +448,16 @@ __LINK_C error_t timer_cancel_task(task_t task)
 
     start_atomic();
 
-    for(uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
+    uint32_t i = timer_storage_find(task);
+    if(i != NO_EVENT)
     {
-      if(NG(timers)[i].f == task)
-      {
-        NG(timers)[i].f = 0x0;
+        timer_storage_remove(i);
         //if we were the first event to fire --> trigger a reconfiguration
         if(NG(next_event) == i) {
             conf_atomic_ended = configure_next_event();
         }
-          
 
         status = SUCCESS;
-        break;
-      }
     }
     if(!conf_atomic_ended) { //if configure_next_event gets run, then atomic is ended in there. Otherwise we should end it here.
         end_atomic(); 
@@ -212,7 +469,7 @@ __LINK_C error_t timer_cancel_task(task_t task)
 
 error_t timer_add_event(timer_event* event)
 {
-    return timer_post_task_prio(event->f, timer_get_counter_value() + event->next_event, event->priority, event->period, event->arg);
+    return timer_post_task_prio_slack(event->f, timer_get_counter_value() + event->next_event, event->slack, event->priority, event->period, event->arg);
 }
 
 void timer_cancel_event(timer_event* event)
@@ -223,19 +480,9 @@ void timer_cancel_event(timer_event* event)
 
 __LINK_C bool timer_is_task_scheduled(task_t task)
 {
-    bool present = false;
-
     start_atomic();
-
-     for (uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
-     {
-       if (NG(timers)[i].f == task)
-       {
-          present = true;
-          break;
-       }
-     }
-     end_atomic();
+    bool present = (timer_storage_find(task) != NO_EVENT);
+    end_atomic();
 
      return present;
 }
@@ -255,42 +502,19 @@ __LINK_C timer_tick_t timer_get_counter_value()
     return counter;
 }
 
-static uint32_t get_next_event()
-{
-    //this function should only be called from an atomic context
-    int32_t min_delay;
-    uint32_t next_fire_event = NO_EVENT;
-    uint32_t counter = timer_get_counter_value();
-
-    for(uint32_t i = 0; i < FRAMEWORK_TIMER_STACK_SIZE; i++)
-    {
-    	if(NG(timers)[i].f == 0x0)
-    		continue;
-    	//trick borrowed from AODV: by using signed integers in this way
-    	//we know that if the event has already passed delay_ticks will be < 0
-    	// --> events are sorted from past -> future regardless of any (pending) overflows
-    	int32_t delay_ticks = ((int32_t)NG(timers)[i].next_event) - ((int32_t)counter);
-    	if(next_fire_event == NO_EVENT || delay_ticks < min_delay)
-		{
-    		min_delay = delay_ticks;
-			next_fire_event = i;
-		}
-    }
-    return next_fire_event;
-}
-
 static bool configure_next_event()
 {
     //this function should only be called from an atomic context
 	timer_tick_t next_fire_time;
     timer_tick_t current_time = timer_get_counter_value();
 
-    timer_busy_programming = true;
+    NG(timer_busy_programming) = true;
 
     do
     {
-		//find the next event that has not yet passed, and schedule
-		//the 'late' events while we're at it
+		//find the event with the earliest deadline, and schedule it right away
+		//when its window has already started. This fires the 'late' events and
+		//groups all events whose window contains the current wake-up
 		NG(next_event) = get_next_event();
 
 		if(NG(next_event) != NO_EVENT)
@@ -302,7 +526,7 @@ static bool configure_next_event()
                 if(NG(timers)[NG(next_event)].f == 0)
                     DPRINT("function was empty, skipping");
                 else {
-                    fired_by_interrupt = false;
+                    NG(fired_by_interrupt) = false;
                     timer_fired();
                 }
 			}
@@ -311,12 +535,15 @@ static bool configure_next_event()
     while(NG(next_event) != NO_EVENT && ( (((int32_t)next_fire_time) - ((int32_t)current_time)  - timer_info->min_delay_ticks) <= 0  ) );
 
     // if recursive event was scheduled immediately, don't set hw timer delay until last time in configure next event
-    if(!fired_by_interrupt)
+    if(!NG(fired_by_interrupt))
         return false;
 
     //at this point NG(next_event) is eiter equal to NO_EVENT (no tasks left)
-    //or we have the next event we can schedule
+    //or we have the next event we can schedule, at its deadline
     bool called_atomic = false;
+    if(NG(next_event) != NO_EVENT)
+        next_fire_time = get_deadline(NG(next_event));
+
     if(NG(next_event) == NO_EVENT)
     {
 		//cancel the timer in case it is still running (can happen if we're called from timer_cancel_event)
@@ -357,7 +584,7 @@ static bool configure_next_event()
 		    hw_timer_cancel(HW_TIMER_ID);
 		}
     }
-    timer_busy_programming = false;
+    NG(timer_busy_programming) = false;
     return called_atomic;
 }
 
@@ -375,12 +602,12 @@ static void timer_overflow()
     NG(timer_offset) += COUNTER_OVERFLOW_INCREASE;
     if(NG(next_event) != NO_EVENT && 		//there is an event scheduled at THIS timer level
 	(!NG(hw_event_scheduled)) &&		//but NOT at the hw timer level
-		NG(timers)[NG(next_event)].next_event <= (NG(timer_offset) + COUNTER_OVERFLOW_INCREASE) //and the next trigger will happen before the next overflow
+		get_deadline(NG(next_event)) <= (NG(timer_offset) + COUNTER_OVERFLOW_INCREASE) //and the next trigger will happen before the next overflow
 	)
     {
 		//normally this shouldn't happen. Put an assert here just to make sure
-		assert(NG(timers)[NG(next_event)].next_event >= NG(timer_offset));
-		timer_tick_t fire_time = (NG(timers)[NG(next_event)].next_event - NG(timer_offset));
+		assert(get_deadline(NG(next_event)) >= NG(timer_offset));
+		timer_tick_t fire_time = (get_deadline(NG(next_event)) - NG(timer_offset));
 
 		//fire time already passed
 		if(fire_time <= (hw_timer_getvalue(HW_TIMER_ID) + timer_info->min_delay_ticks))
@@ -399,7 +626,7 @@ static void timer_overflow()
 
 static void timer_fired()
 {
-    if(timer_busy_programming && fired_by_interrupt)
+    if(NG(timer_busy_programming) && NG(fired_by_interrupt))
         return;
     assert(NG(next_event) != NO_EVENT);
     assert(NG(timers)[NG(next_event)].f != 0x0);
@@ -409,20 +636,23 @@ static void timer_fired()
     if((current_time + timer_info->min_delay_ticks) < NG(timers)[NG(next_event)].next_event)
         log_print_error_string("timer fired too early with current time %i + min delay ticks %i < next event %i: function 0x%X",
             current_time, timer_info->min_delay_ticks, NG(timers)[NG(next_event)].next_event, NG(timers)[NG(next_event)].f);
-    else if(current_time > (NG(timers)[NG(next_event)].next_event + 5))
-        log_print_error_string("timer fired too late with current time %i > next event %i + 5: function 0x%X",
-            current_time, timer_info->min_delay_ticks, NG(timers)[NG(next_event)].next_event, NG(timers)[NG(next_event)].f);
+    else if(current_time > (get_deadline(NG(next_event)) + 5))
+        log_print_error_string("timer fired too late with current time %i > deadline %i + 5: function 0x%X",
+            current_time, get_deadline(NG(next_event)), NG(timers)[NG(next_event)].f);
 #endif
-    sched_post_task_prio(
-        NG(timers)[NG(next_event)].f, NG(timers)[NG(next_event)].priority, NG(timers)[NG(next_event)].arg);
+    sched_post_task_by_id(
+        NG(timer_task_ids)[NG(next_event)], NG(timers)[NG(next_event)].priority, NG(timers)[NG(next_event)].arg);
 
     if(NG(timers)[NG(next_event)].period > 0)
+    {
         NG(timers)[NG(next_event)].next_event = current_time + NG(timers)[NG(next_event)].period;
+        timer_storage_update(NG(next_event));
+    }
     else
-        NG(timers)[NG(next_event)].f = 0x0;
+        timer_storage_remove(NG(next_event));
 
-    if(fired_by_interrupt)
+    if(NG(fired_by_interrupt))
         configure_next_event();
     else
-        fired_by_interrupt = true;
+        NG(fired_by_interrupt) = true;
 }
\ No newline at end of file
@@ -35,8 +35,8 @@ void __framework_bootstrap()
     timer_init();
     //initialise libc RNG with the unique device id
     set_rng_seed((unsigned int)hw_get_unique_id());
-    //reset the log counter
-    log_counter_reset();
+    //initialise logging, this also resets the log counter
+    log_init();
 
 #ifdef FRAMEWORK_CONSOLE_ENABLED
     console_init();
@@ -157,6 +157,19 @@ void hw_radio_set_rssi_config(uint8_t rssi_smoothing, uint8_t rssi_offset)
     netdev->driver->set(netdev, NETOPT_RSSI_OFFSET, &rssi_smoothing, sizeof(uint8_t));
 }
 
+// the settings are passed to the netdev driver as they are
+void hw_radio_prepare_channel_config(hw_radio_channel_config_t* config) {}
+
+void hw_radio_apply_channel_config(const hw_radio_channel_config_t* config)
+{
+    hw_radio_set_bitrate(config->bitrate);
+    hw_radio_set_tx_fdev(config->tx_fdev);
+    hw_radio_set_rx_bw_hz(config->rx_bw_hz);
+    hw_radio_set_preamble_size(config->preamble_size);
+    hw_radio_set_preamble_detector(config->preamble_detector_size, config->preamble_tol);
+    hw_radio_set_center_freq(config->center_freq);
+}
+
 
 /* TODO Make use of the following APIs to setup the xcvr */
 /*
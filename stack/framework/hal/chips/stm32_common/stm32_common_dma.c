@@ -79,13 +79,38 @@ bool dma_channel_enable(dma_handle_t* dma_handle)
             dma_handle->dma_hal_handle.Init.Request = DMA_REQUEST_5;
             break;
         }
+        case PERIPH_SPI1:
+        {
+            dma_handle->dma_hal_handle.Init.Request = DMA_REQUEST_1;
+            break;
+        }
+        case PERIPH_SPI2:
+        {
+            dma_handle->dma_hal_handle.Init.Request = DMA_REQUEST_2;
+            break;
+        }
         default:
         {
             return false;
         }
     }
-    // Note that the direction selection code is only valid for UARTS
-    if(dma_handle->dma_channel->channel_nr == 2 || dma_handle->dma_channel->channel_nr == 4  || dma_handle->dma_channel->channel_nr == 7)
+    if(dma_handle->dma_channel->peripheral == PERIPH_SPI1 || dma_handle->dma_channel->peripheral == PERIPH_SPI2)
+    {
+        // SPI1 RX and TX are on channel 2 and 3, SPI2 RX and TX on channel 4 and 5 or 6 and 7
+        if(dma_handle->dma_channel->channel_nr == 2 || dma_handle->dma_channel->channel_nr == 4  || dma_handle->dma_channel->channel_nr == 6)
+        {
+            dma_handle->dma_hal_handle.Init.Direction = DMA_PERIPH_TO_MEMORY;
+        }
+        else if(dma_handle->dma_channel->channel_nr == 3 || dma_handle->dma_channel->channel_nr == 5  || dma_handle->dma_channel->channel_nr == 7)
+        {
+            dma_handle->dma_hal_handle.Init.Direction = DMA_MEMORY_TO_PERIPH;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if(dma_handle->dma_channel->channel_nr == 2 || dma_handle->dma_channel->channel_nr == 4  || dma_handle->dma_channel->channel_nr == 7)
     {
         dma_handle->dma_hal_handle.Init.Direction = DMA_MEMORY_TO_PERIPH;
     }
@@ -202,7 +227,7 @@ void dma_channel_interrupt_disable(dma_handle_t* dma_handle)
   HAL_NVIC_DisableIRQ(dma_handle->dma_channel->irq);
 }
 
-void DMA1_Channel2_3_IRQHandler(void)
+static void dma_irq_handler(void)
 {
     for(uint8_t index = 0; index < DMA_COUNT; index++)
     {
@@ -218,3 +243,13 @@ void DMA1_Channel2_3_IRQHandler(void)
         }
     }
 }
+
+void DMA1_Channel2_3_IRQHandler(void)
+{
+    dma_irq_handler();
+}
+
+void DMA1_Channel4_5_6_7_IRQHandler(void)
+{
+    dma_irq_handler();
+}
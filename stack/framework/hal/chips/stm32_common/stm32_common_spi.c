@@ -33,6 +33,8 @@
 #include "hwgpio.h"
 #include "errors.h"
 #include "hwatomic.h"
+#include "hwdma.h"
+#include "hal_defs.h"
 
 
 #define MAX_SPI_SLAVE_HANDLES 5        // TODO expose this in chip configuration
@@ -336,3 +338,42 @@ void spi_exchange_bytes(spi_slave_handle_t* slave, uint8_t* TxData, uint8_t* RxD
     }
   }
 }
+
+#ifdef HAL_SPI_USE_DMA
+void spi_exchange_bytes_via_DMA(spi_slave_handle_t* slave, uint8_t* TxData, uint8_t* RxData, size_t length,
+                                uint8_t dma_rx_channel_idx, uint8_t dma_tx_channel_idx) {
+  SPI_HandleTypeDef* hspi = &slave->spi->hspi;
+  assert(hspi->Init.Direction == SPI_DIRECTION_2LINES); // a 3 wire read needs to stop the clock manually, see above
+  dma_handle_t* dma_rx = dma_channel_get_handle(dma_rx_channel_idx);
+  dma_handle_t* dma_tx = dma_channel_get_handle(dma_tx_channel_idx);
+  assert(dma_rx != NULL && dma_tx != NULL);
+
+  // in master mode the TX channel clocks out dummy bytes for a receive only transfer, so both channels are used
+  hspi->hdmarx = dma_channel_get_hal_handle(dma_rx_channel_idx);
+  hspi->hdmarx->Parent = hspi;
+  hspi->hdmatx = dma_channel_get_hal_handle(dma_tx_channel_idx);
+  hspi->hdmatx->Parent = hspi;
+  bool enabled = dma_channel_enable(dma_rx) && dma_channel_enable(dma_tx);
+  assert(enabled);
+  dma_channel_interrupt_enable(dma_rx);
+  dma_channel_interrupt_enable(dma_tx);
+
+  HAL_StatusTypeDef status;
+  if(RxData != NULL && TxData != NULL)
+    status = HAL_SPI_TransmitReceive_DMA(hspi, TxData, RxData, length);
+  else if(TxData != NULL)
+    status = HAL_SPI_Transmit_DMA(hspi, TxData, length);
+  else
+    status = HAL_SPI_Receive_DMA(hspi, RxData, length);
+
+  assert(status == HAL_OK);
+  while(HAL_SPI_GetState(hspi) != HAL_SPI_STATE_READY); // set by the DMA complete interrupt
+
+  dma_channel_interrupt_disable(dma_rx);
+  dma_channel_interrupt_disable(dma_tx);
+  dma_channel_disable(dma_rx);
+  dma_channel_disable(dma_tx);
+  hspi->hdmarx = NULL;
+  hspi->hdmatx = NULL;
+}
+#endif
@@ -36,6 +36,7 @@
 #include "hwradio.h"
 #include "hwdebug.h"
 #include "hwspi.h"
+#include "hwdma.h"
 #include "platform.h"
 #include "errors.h"
 #include "power_tracking_file.h"
@@ -57,6 +58,9 @@
 #define BG_THRESHOLD                5
 #define FG_THRESHOLD                32
 #define FIFO_AVAILABLE_SPACE        FIFO_SIZE - FG_THRESHOLD
+#define FIFO_TAIL_SIZE              2   // the last bytes of a packet are read after PayloadReady instead of on a FifoLevel interrupt
+#define REG_SHADOW_SIZE             0x80
+#define DMA_MIN_SIZE                8   // shorter FIFO transfers are done by the CPU, setting up the DMA takes longer
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(FRAMEWORK_PHY_LOG_ENABLED)
 #define DPRINT(...) log_print_stack_string(LOG_STACK_PHY, __VA_ARGS__)
@@ -136,7 +140,7 @@ static timer_tick_t rx_start_time = 0;
 static timer_tick_t standby_start_time = 0;
 #endif //FRAMEWORK_POWER_TRACKING_RF
 
-static volatile bool fifo_level_irq_triggered = false;
+static volatile bool refill_pending = false;
 
 typedef enum {
   OPMODE_SLEEP = 0,
@@ -212,6 +216,19 @@ static bool lora_mode = false;
 static uint32_t current_center_freq = 0;
 static bool rx_type_continuous = true; //if true, use RXCONT, if false use RX_SINGLE
 
+// scheduler handles of the tasks posted from the DIO interrupts
+static sched_task_id_t bg_scan_rx_done_task_id;
+static sched_task_id_t lora_rxdone_isr_task_id;
+static sched_task_id_t lora_rxtimeout_isr_task_id;
+static sched_task_id_t packet_transmitted_isr_task_id;
+static sched_task_id_t fifo_threshold_isr_task_id;
+
+// Copy of the register values last written by the driver, so a read-modify-write of a configuration register does not
+// need an SPI read. Only read through read_reg_cached(), for registers which the chip does not change by itself.
+// Invalidated on reset and when switching between FSK and LoRa, which use different registers at the same address.
+static uint8_t reg_shadow[REG_SHADOW_SIZE];
+static uint32_t reg_shadow_valid[REG_SHADOW_SIZE / 32];
+
 void set_opmode(uint8_t opmode);
 static void fifo_threshold_isr();
 static void update_active_times(hw_radio_state_t opmode);
@@ -240,19 +257,58 @@ static void write_reg(uint8_t addr, uint8_t value) {
   spi_exchange_byte(sx127x_spi, addr | 0x80); // send address with bit 8 high to signal a write operation
   spi_exchange_byte(sx127x_spi, value);
   spi_deselect(sx127x_spi);
+  reg_shadow[addr] = value;
+  reg_shadow_valid[addr / 32] |= 1UL << (addr % 32);
   //DPRINT("WRITE %02x: %02x", addr, value);
 }
 
+static uint8_t read_reg_cached(uint8_t addr) {
+  if(!(reg_shadow_valid[addr / 32] & (1UL << (addr % 32)))) {
+    reg_shadow[addr] = read_reg(addr);
+    reg_shadow_valid[addr / 32] |= 1UL << (addr % 32);
+  }
+
+  return reg_shadow[addr];
+}
+
+static void invalidate_reg_shadow() {
+  memset(reg_shadow_valid, 0, sizeof(reg_shadow_valid));
+}
+
+#ifdef HAL_SPI_USE_DMA
+static void exchange_fifo_bytes(uint8_t* tx_buffer, uint8_t* rx_buffer, uint8_t size) {
+  if(size >= DMA_MIN_SIZE)
+    spi_exchange_bytes_via_DMA(sx127x_spi, tx_buffer, rx_buffer, size, PLATFORM_SX127X_SPI_DMA_RX, PLATFORM_SX127X_SPI_DMA_TX);
+  else
+    spi_exchange_bytes(sx127x_spi, tx_buffer, rx_buffer, size);
+}
+#else
+#define exchange_fifo_bytes(tx_buffer, rx_buffer, size) spi_exchange_bytes(sx127x_spi, tx_buffer, rx_buffer, size)
+#endif
+
+// burst write of consecutive registers, the address is incremented by the chip
+static void write_regs(uint8_t start_reg, const uint8_t* values, uint8_t size) {
+  enable_spi_io();
+  spi_select(sx127x_spi);
+  spi_exchange_byte(sx127x_spi, start_reg | 0x80);
+  spi_exchange_bytes(sx127x_spi, (uint8_t*)values, NULL, size);
+  spi_deselect(sx127x_spi);
+  for(uint8_t addr = start_reg; addr < start_reg + size; addr++) {
+    reg_shadow[addr] = values[addr - start_reg];
+    reg_shadow_valid[addr / 32] |= 1UL << (addr % 32);
+  }
+}
+
 void write_reg_16(uint8_t start_reg, uint16_t value) {
-  write_reg(start_reg, (uint8_t)((value >> 8) & 0xFF));
-  write_reg(start_reg + 1, (uint8_t)(value & 0xFF));
+  uint8_t values[2] = { (uint8_t)((value >> 8) & 0xFF), (uint8_t)(value & 0xFF) };
+  write_regs(start_reg, values, sizeof(values));
 }
 
 static void write_fifo(uint8_t* buffer, uint8_t size) {
   enable_spi_io();
   spi_select(sx127x_spi);
   spi_exchange_byte(sx127x_spi, 0x80); // send address with bit 8 high to signal a write operation
-  spi_exchange_bytes(sx127x_spi, buffer, NULL, size);
+  exchange_fifo_bytes(buffer, NULL, size);
   spi_deselect(sx127x_spi);
   // DPRINT("WRITE FIFO %i", size);
   // DPRINT_DATA(buffer, size);
@@ -262,7 +318,7 @@ static void read_fifo(uint8_t* buffer, uint8_t size) {
   enable_spi_io();
   spi_select(sx127x_spi);
   spi_exchange_byte(sx127x_spi, REG_FIFO);
-  spi_exchange_bytes(sx127x_spi, NULL, buffer, size);
+  exchange_fifo_bytes(NULL, buffer, size);
   spi_deselect(sx127x_spi);
   DPRINT("READ FIFO %i", size);
 }
@@ -294,7 +350,7 @@ static void set_antenna_switch(opmode_t opmode) {
 #endif
 #ifdef PLATFORM_USE_ABZ
     hw_gpio_clr(ABZ_ANT_SW_RX_PIN);
-    if((read_reg(REG_PACONFIG) & RF_PACONFIG_PASELECT_PABOOST) == RF_PACONFIG_PASELECT_PABOOST) {
+    if((read_reg_cached(REG_PACONFIG) & RF_PACONFIG_PASELECT_PABOOST) == RF_PACONFIG_PASELECT_PABOOST) {
       hw_gpio_clr(ABZ_ANT_SW_TX_PIN);
       hw_gpio_set(ABZ_ANT_SW_PA_BOOST_PIN);
     } else {
@@ -429,8 +485,12 @@ static void init_regs() {
   // TODO burst write reg?
 }
 
+static uint8_t get_preamble_detector_reg(uint8_t preamble_detector_size, uint8_t preamble_tol) {
+  return RF_PREAMBLEDETECT_DETECTOR_ON | (preamble_detector_size-1) << 5 | preamble_tol;
+}
+
 void hw_radio_set_preamble_detector(uint8_t preamble_detector_size, uint8_t preamble_tol) {
-  write_reg(REG_PREAMBLEDETECT, RF_PREAMBLEDETECT_DETECTOR_ON | (preamble_detector_size-1) << 5 | preamble_tol);
+  write_reg(REG_PREAMBLEDETECT, get_preamble_detector_reg(preamble_detector_size, preamble_tol));
 }
 
 void hw_radio_set_rssi_config(uint8_t rssi_smoothing, uint8_t rssi_offset) {
@@ -568,25 +628,36 @@ static void dio0_isr(void *arg) {
 
   if(state == STATE_RX) {
     if(lora_mode)
-      sched_post_task(&lora_rxdone_isr);
+      sched_post_task_by_id(lora_rxdone_isr_task_id, DEFAULT_PRIORITY, NULL);
     else
-      sched_post_task(&bg_scan_rx_done);
+      sched_post_task_by_id(bg_scan_rx_done_task_id, DEFAULT_PRIORITY, NULL);
   } else {
-    sched_post_task(&packet_transmitted_isr);
+    sched_post_task_by_id(packet_transmitted_isr_task_id, DEFAULT_PRIORITY, NULL);
   }
 }
 
 static void set_packet_handler_enabled(bool enable) {
-  write_reg(REG_PREAMBLEDETECT, (read_reg(REG_PREAMBLEDETECT) & RF_PREAMBLEDETECT_DETECTOR_MASK) | (enable << 7));
-  write_reg(REG_SYNCCONFIG, (read_reg(REG_SYNCCONFIG) & RF_SYNCCONFIG_SYNC_MASK) | (enable << 4));
+  write_reg(REG_PREAMBLEDETECT, (read_reg_cached(REG_PREAMBLEDETECT) & RF_PREAMBLEDETECT_DETECTOR_MASK) | (enable << 7));
+  write_reg(REG_SYNCCONFIG, (read_reg_cached(REG_SYNCCONFIG) & RF_SYNCCONFIG_SYNC_MASK) | (enable << 4));
+}
+
+// While the TX FIFO is refilled on the FifoLevel interrupt the MCU can sleep, but not in a mode which stops the clocks:
+// the interrupt writes the next chunk over SPI before the scheduler restored the clocks after waking up
+static void set_refill_pending(bool pending) {
+  refill_pending = pending;
+  if(pending)
+    sched_limit_low_power_mode(0);
+  else
+    sched_release_low_power_mode_limit();
 }
 
+// Runs in the DIO1 interrupt, so the next chunk is written before the FIFO runs empty whatever tasks are pending. The
+// refill callback only copies a prepared chunk to the FIFO.
 static void fifo_level_isr()
 {
     uint8_t flags;
 
-    hw_gpio_disable_interrupt(SX127x_DIO1_PIN);
-
+    set_refill_pending(false);
     flags = read_reg(REG_IRQFLAGS2);
     // detect underflow
     if (flags & 0x08)
@@ -597,16 +668,15 @@ static void fifo_level_isr()
     tx_refill_callback(remaining_bytes_len);
 }
 
-static void wait_for_fifo_level_isr() { 
-  // We're holding the MCU from going to sleep as this sometimes takes to long to fill the newer data
-  // TODO make this non-blocking without breaking it, for example by telling scheduler it can't go to sleep
-  fifo_level_irq_triggered = false;
-  while(!fifo_level_irq_triggered) 
-  {
-      if(state == STATE_IDLE)
-          return; //if radio gets put in sleep mode, cancel this action
-  }
-  fifo_level_isr();
+// Called on every transition out of TX: a refill which is still pending will never be served, so drop it together with
+// the rest of the aborted packet and allow the deeper low power modes again
+static void cancel_refill() {
+  if(!refill_pending)
+    return;
+
+  hw_gpio_disable_interrupt(SX127x_DIO1_PIN);
+  set_refill_pending(false);
+  remaining_bytes_len = 0;
 }
 
 static void reinit_rx() {
@@ -617,7 +687,7 @@ static void reinit_rx() {
  write_reg(REG_FIFOTHRESH, RF_FIFOTHRESH_TXSTARTCONDITION_FIFONOTEMPTY | 0x03);
  write_reg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO2_11);
  previous_payload_length = 0;
- write_reg(REG_PACKETCONFIG2, (read_reg(REG_PACKETCONFIG2) & RF_PACKETCONFIG2_PAYLOADLENGTH_MSB_MASK));
+ write_reg(REG_PACKETCONFIG2, (read_reg_cached(REG_PACKETCONFIG2) & RF_PACKETCONFIG2_PAYLOADLENGTH_MSB_MASK));
  write_reg(REG_PAYLOADLENGTH, 0);
 
  // Trigger a manual restart of the Receiver chain (no frequency change)
@@ -630,34 +700,26 @@ static void reinit_rx() {
  hw_gpio_enable_interrupt(SX127x_DIO1_PIN);
 }
 
-// TODO
 static void fifo_threshold_isr() {
- // TODO might be optimized. Initial plan was to read length byte and reconfigure threshold
- // based on the expected length so we can wait for next interrupt to read remaining bytes.
- // This doesn't seem to work for now however: the interrupt doesn't fire again for some unclear reason.
- // So now we do it as suggest in the datasheet: reading bytes from FIFO until FifoEmpty flag is set.
- // Reading more bytes at once might be more efficient, however getting the number of bytes in the FIFO seems
- // not possible at least in FSK mode (for LoRa, the register RegRxNbBytes gives the number of received bytes).
+ // The FifoLevel interrupt on DIO1 fires when more than the FIFO threshold bytes were received, so we know how many
+ // bytes can be read and these are read in one burst. The threshold for the next interrupt is sized from the remaining
+ // length of the packet. The interrupt is edge triggered: when the FIFO already holds more bytes than the new threshold
+ // by the time the interrupt is enabled, there won't be an edge, so in that case we continue reading right away.
+ // The last bytes are read in one burst as well, once PayloadReady tells the complete packet is received.
    hw_gpio_disable_interrupt(SX127x_DIO1_PIN);
    DPRINT("THR ISR with IRQ %x\n", read_reg(REG_IRQFLAGS2));
    assert(state == STATE_RX);
 
    if (FskPacketHandler_sx127x.Size == 0 && FskPacketHandler_sx127x.NbBytes == 0)
    {
-       // For RX, the threshold is set to 4, so if the DIO1 interrupt occurs, it means that can read at least 4 bytes
-       uint8_t rx_bytes = 0;
+       // For RX, the threshold is set to 3, so if the DIO1 interrupt occurs, it means that can read at least 4 bytes
        uint8_t buffer[4];
        uint8_t backup_buffer[4];
        int16_t rssi = get_rssi();
-       while(!(CHECK_FIFO_EMPTY()) && rx_bytes < 4)
-       {
-           buffer[rx_bytes++] = read_reg(REG_FIFO);
-       }
-
-       assert(rx_bytes == 4);
+       read_fifo(buffer, 4);
 
-      memcpy(backup_buffer, buffer, rx_bytes);
-       rx_packet_header_callback(buffer, rx_bytes);
+       memcpy(backup_buffer, buffer, 4);
+       rx_packet_header_callback(buffer, 4);
        if(FskPacketHandler_sx127x.Size == 0) {
          log_print_error_string("Length was too large, discarding packet");
          reinit_rx();
@@ -678,58 +740,60 @@ static void fifo_threshold_isr() {
        FskPacketHandler_sx127x.NbBytes = 4;
    }
 
-   if (FskPacketHandler_sx127x.FifoThresh)
+   uint16_t remaining_bytes;
+   while(true)
    {
-       read_fifo(&current_packet->data[FskPacketHandler_sx127x.NbBytes], FskPacketHandler_sx127x.FifoThresh);
-       FskPacketHandler_sx127x.NbBytes += FskPacketHandler_sx127x.FifoThresh;
-   }
-
-   while(!(CHECK_FIFO_EMPTY()) && (FskPacketHandler_sx127x.NbBytes < FskPacketHandler_sx127x.Size))
-      current_packet->data[FskPacketHandler_sx127x.NbBytes++] = read_reg(REG_FIFO);
+       if (FskPacketHandler_sx127x.FifoThresh)
+       {
+           read_fifo(&current_packet->data[FskPacketHandler_sx127x.NbBytes], FskPacketHandler_sx127x.FifoThresh);
+           FskPacketHandler_sx127x.NbBytes += FskPacketHandler_sx127x.FifoThresh;
+       }
 
-   uint16_t remaining_bytes = FskPacketHandler_sx127x.Size - FskPacketHandler_sx127x.NbBytes;
+       remaining_bytes = FskPacketHandler_sx127x.Size - FskPacketHandler_sx127x.NbBytes;
+       if(remaining_bytes <= FIFO_TAIL_SIZE)
+           break;
 
-   // blocking to get last data
-   while((remaining_bytes < 3) && (remaining_bytes != 0)) {
-      if(!CHECK_FIFO_EMPTY()) {
-        current_packet->data[FskPacketHandler_sx127x.NbBytes++] = read_reg(REG_FIFO);
-        remaining_bytes--;
-      }
-   }
+       //Trigger FifoLevel interrupt
+       if (remaining_bytes > FIFO_SIZE)
+           FskPacketHandler_sx127x.FifoThresh = BYTES_IN_RX_FIFO;
+       else
+           FskPacketHandler_sx127x.FifoThresh = remaining_bytes - FIFO_TAIL_SIZE; // wakeup right before the entire message arrives to get the data asap
 
-   if(remaining_bytes == 0) {
-    current_packet->rx_meta.timestamp = timer_get_counter_value();
-    current_packet->rx_meta.crc_status = HW_CRC_UNAVAILABLE;
-    current_packet->rx_meta.lqi = 0; // TODO
+       write_reg(REG_FIFOTHRESH, RF_FIFOTHRESH_TXSTARTCONDITION_FIFONOTEMPTY | (FskPacketHandler_sx127x.FifoThresh - 1));
+       hw_gpio_set_edge_interrupt(SX127x_DIO1_PIN, GPIO_RISING_EDGE);
+       hw_gpio_enable_interrupt(SX127x_DIO1_PIN);
+       if(!CHECK_FIFO_LEVEL())
+       {
+           DPRINT("read %i bytes, %i remaining, time: %i \n", FskPacketHandler_sx127x.NbBytes, remaining_bytes, timer_get_counter_value());
+           return;
+       }
 
-    // RSSI is measured during reception of the first part of the packet
-    // to make sure we are actually measuring during a TX, instead of after
+       // the threshold was already exceeded, an edge which occurred in the meantime has posted this task again
+       hw_gpio_disable_interrupt(SX127x_DIO1_PIN);
+       sched_cancel_task_by_id(fifo_threshold_isr_task_id);
+   }
 
-    // Restart the reception until upper layer decides to stop it
-    reinit_rx(); // restart already before doing decoding so we don't miss packets on low clock speeds
+   if(remaining_bytes != 0)
+   {
+       // blocking to get last data
+       while(!(read_reg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PAYLOADREADY));
+       read_fifo(&current_packet->data[FskPacketHandler_sx127x.NbBytes], remaining_bytes);
+       FskPacketHandler_sx127x.NbBytes += remaining_bytes;
+   }
 
-    DEBUG_FG_END();
+   current_packet->rx_meta.timestamp = timer_get_counter_value();
+   current_packet->rx_meta.crc_status = HW_CRC_UNAVAILABLE;
+   current_packet->rx_meta.lqi = 0; // TODO
 
-    rx_packet_callback(current_packet);
+   // RSSI is measured during reception of the first part of the packet
+   // to make sure we are actually measuring during a TX, instead of after
 
-    return;
-   }
+   // Restart the reception until upper layer decides to stop it
+   reinit_rx(); // restart already before doing decoding so we don't miss packets on low clock speeds
 
-   //Trigger FifoLevel interrupt
-   if ( remaining_bytes > FIFO_SIZE)
-   {
-       write_reg(REG_FIFOTHRESH, RF_FIFOTHRESH_TXSTARTCONDITION_FIFONOTEMPTY | (BYTES_IN_RX_FIFO - 1));
-       FskPacketHandler_sx127x.FifoThresh = BYTES_IN_RX_FIFO;
-   } else {
-      // wakeup right before the entire message arrives to get the data asap
-      write_reg(REG_FIFOTHRESH, RF_FIFOTHRESH_TXSTARTCONDITION_FIFONOTEMPTY | (remaining_bytes - 3));
-      FskPacketHandler_sx127x.FifoThresh = remaining_bytes - 2;
-   }
+   DEBUG_FG_END();
 
-   hw_gpio_set_edge_interrupt(SX127x_DIO1_PIN, GPIO_RISING_EDGE);
-   hw_gpio_enable_interrupt(SX127x_DIO1_PIN);
-   
-   DPRINT("read %i bytes, %i remaining, FLAGS2 %x, time: %i \n", FskPacketHandler_sx127x.NbBytes, remaining_bytes, read_reg(REG_IRQFLAGS2), timer_get_counter_value());
+   rx_packet_callback(current_packet);
 }
 
 static void dio1_isr(void *arg) {
@@ -738,12 +802,12 @@ static void dio1_isr(void *arg) {
 
   if(state == STATE_RX) {
     if(lora_mode && rx_lora_timeout_callback) {
-      sched_post_task(&lora_rxtimeout_isr);
+      sched_post_task_by_id(lora_rxtimeout_isr_task_id, DEFAULT_PRIORITY, NULL);
     } else {
-      sched_post_task(&fifo_threshold_isr);
+      sched_post_task_by_id(fifo_threshold_isr_task_id, DEFAULT_PRIORITY, NULL);
     }
-  } else {
-      fifo_level_irq_triggered = true;
+  } else if(refill_pending) {
+      fifo_level_isr();
   }
 }
 
@@ -801,6 +865,12 @@ error_t hw_radio_init(hwradio_init_args_t* init_args) {
   hw_radio_io_init(true);
   io_inited = true;
   hw_radio_reset();
+  invalidate_reg_shadow();
+
+#ifdef HAL_SPI_USE_DMA
+  dma_channel_init(PLATFORM_SX127X_SPI_DMA_RX);
+  dma_channel_init(PLATFORM_SX127X_SPI_DMA_TX);
+#endif
 
   write_reg(REG_OPMODE, ((read_reg(REG_OPMODE) & RF_OPMODE_MASK) & RF_OPMODE_LONGRANGEMODE_MASK) | OPMODE_STANDBY);
   while(get_opmode() != OPMODE_STANDBY) {}
@@ -829,12 +899,11 @@ error_t hw_radio_init(hwradio_init_args_t* init_args) {
   e = hw_gpio_configure_interrupt(SX127x_DIO1_PIN, GPIO_RISING_EDGE, &dio1_isr, NULL); assert(e == SUCCESS);
 
   sched_register_task(&rx_timeout);
-  sched_register_task(&bg_scan_rx_done);
-  sched_register_task(&lora_rxdone_isr);
-  sched_register_task(&lora_rxtimeout_isr);
-  sched_register_task(&packet_transmitted_isr);
-  sched_register_task(&fifo_threshold_isr);
-  sched_register_task(&wait_for_fifo_level_isr);
+  bg_scan_rx_done_task_id = sched_register_task_id(&bg_scan_rx_done);
+  lora_rxdone_isr_task_id = sched_register_task_id(&lora_rxdone_isr);
+  lora_rxtimeout_isr_task_id = sched_register_task_id(&lora_rxtimeout_isr);
+  packet_transmitted_isr_task_id = sched_register_task_id(&packet_transmitted_isr);
+  fifo_threshold_isr_task_id = sched_register_task_id(&fifo_threshold_isr);
 
   return SUCCESS; // TODO FAIL return code
 }
@@ -847,7 +916,7 @@ void hw_radio_stop() {
 error_t hw_radio_set_idle() {
     if(state == STATE_IDLE && !io_inited)
         return EALREADY;
-    hw_radio_set_opmode(HW_STATE_SLEEP);
+    hw_radio_set_opmode(HW_STATE_SLEEP); // also cancels a pending TX FIFO refill
     if(FskPacketHandler_sx127x.Size - FskPacketHandler_sx127x.NbBytes != 0 && FskPacketHandler_sx127x.NbBytes != 0) {
       DPRINT("going to idle while still %i bytes to read.", FskPacketHandler_sx127x.Size - FskPacketHandler_sx127x.NbBytes);
       FskPacketHandler_sx127x.Size = 0;
@@ -855,7 +924,6 @@ error_t hw_radio_set_idle() {
       release_packet_callback(current_packet);
     }
     sched_cancel_task(&fifo_threshold_isr);
-    sched_cancel_task(&wait_for_fifo_level_isr);
     sched_cancel_task(&bg_scan_rx_done);
     sched_cancel_task(&packet_transmitted_isr);
     timer_cancel_task(&rx_timeout);
@@ -917,7 +985,8 @@ void set_opmode(uint8_t opmode) {
   #if defined(PLATFORM_SX127X_USE_MANUAL_RXTXSW_PIN) || defined(PLATFORM_USE_ABZ)
   set_antenna_switch(opmode);
   #endif
-  write_reg(REG_OPMODE, (read_reg(REG_OPMODE) & RF_OPMODE_MASK) | opmode);
+  // only the mode bits are changed by the chip itself, the cached value is used for the others
+  write_reg(REG_OPMODE, (read_reg_cached(REG_OPMODE) & RF_OPMODE_MASK) | opmode);
 
   #ifdef PLATFORM_SX127X_USE_VCC_TXCO
   if(opmode == OPMODE_SLEEP)
@@ -931,6 +1000,7 @@ void set_opmode(uint8_t opmode) {
 }
 
 void set_state_rx() {
+  cancel_refill();
   if(lora_mode) {
     hw_radio_set_opmode(HW_STATE_STANDBY);
 
@@ -1048,12 +1118,14 @@ void hw_radio_set_opmode(hw_radio_state_t opmode) {
       DEBUG_RX_END();
       hw_gpio_disable_interrupt(SX127x_DIO0_PIN);
       hw_gpio_disable_interrupt(SX127x_DIO1_PIN);
+      cancel_refill();
       set_opmode(OPMODE_SLEEP);
       spi_disable(spi_handle);
       hw_radio_io_deinit();
       io_inited = false;
       break;
     case HW_STATE_STANDBY:
+      cancel_refill();
       set_opmode(OPMODE_STANDBY);
       break;
     case HW_STATE_TX:
@@ -1073,17 +1145,22 @@ void hw_radio_set_opmode(hw_radio_state_t opmode) {
   update_active_times(opmode);
 }
 
+static uint32_t get_frf(uint32_t center_freq) {
+  return (uint32_t)(center_freq / FREQ_STEP);
+}
+
 void hw_radio_set_center_freq(uint32_t center_freq) {
   current_center_freq = center_freq; 
   
-  center_freq = (uint32_t)(center_freq / FREQ_STEP);
+  center_freq = get_frf(center_freq);
 
   write_reg(REG_FRFMSB, (uint8_t)((center_freq >> 16) & 0xFF));
   write_reg(REG_FRFMID, (uint8_t)((center_freq >> 8) & 0xFF));
   write_reg(REG_FRFLSB, (uint8_t)(center_freq & 0xFF));
 }
 
-void hw_radio_set_rx_bw_hz(uint32_t bw_hz) {
+// the RXBW register value for the closest supported bandwidth, and its index in rx_bw_startup_time and value in kHz
+static uint8_t get_rx_bw_reg(uint32_t bw_hz, uint8_t* bw_number, uint8_t* bw_khz) {
   uint8_t bw_exp_count, bw_mant_count;
   uint32_t computed_bw;
   uint32_t min_bw_dif = 10e6;
@@ -1095,27 +1172,35 @@ void hw_radio_set_rx_bw_hz(uint32_t bw_hz) {
       if(abs(computed_bw - bw_hz) < min_bw_dif) {
         min_bw_dif = abs(computed_bw - bw_hz);
         reg_bw = ((((bw_mant_count - 16) / 4) << 3) | bw_exp_count);
-        rx_bw_number = (bw_exp_count - 1) * 3 + ((bw_mant_count - 16) >> 2);
-        rx_bw_khz = (uint8_t) (computed_bw / 1000);
+        *bw_number = (bw_exp_count - 1) * 3 + ((bw_mant_count - 16) >> 2);
+        *bw_khz = (uint8_t) (computed_bw / 1000);
       }
     }
   }
 
-  write_reg(REG_RXBW, reg_bw);
+  return reg_bw;
 }
 
-void hw_radio_set_bitrate(uint32_t bps) {
+void hw_radio_set_rx_bw_hz(uint32_t bw_hz) {
+  write_reg(REG_RXBW, get_rx_bw_reg(bw_hz, &rx_bw_number, &rx_bw_khz));
+}
+
+static uint16_t get_bitrate_reg(uint32_t bps) {
   /* Bitrate(15,0) + (BitrateFrac / 16) = FXOSC / bps */
-  uint16_t bps_downscaled = (uint16_t)(SX127X_FXOSC / bps); 
-  
-  write_reg_16(REG_BITRATEMSB, bps_downscaled);
+  return (uint16_t)(SX127X_FXOSC / bps);
 }
 
-void hw_radio_set_tx_fdev(uint32_t fdev) {
+void hw_radio_set_bitrate(uint32_t bps) {
+  write_reg_16(REG_BITRATEMSB, get_bitrate_reg(bps));
+}
+
+static uint16_t get_fdev_reg(uint32_t fdev) {
   /* Fdev(13,0) = Fdev / Fstep */
-  uint16_t fdev_downscaled = fdev / FREQ_STEP;
+  return fdev / FREQ_STEP;
+}
 
-  write_reg_16(REG_FDEVMSB, fdev_downscaled);
+void hw_radio_set_tx_fdev(uint32_t fdev) {
+  write_reg_16(REG_FDEVMSB, get_fdev_reg(fdev));
 }
 
 void hw_radio_set_preamble_size(uint16_t size) {
@@ -1123,7 +1208,7 @@ void hw_radio_set_preamble_size(uint16_t size) {
 }
 
 void hw_radio_set_dc_free(uint8_t scheme) {
-  write_reg(REG_PACKETCONFIG1, (read_reg(REG_PACKETCONFIG1) & RF_PACKETCONFIG1_DCFREE_MASK) | (scheme << 5));
+  write_reg(REG_PACKETCONFIG1, (read_reg_cached(REG_PACKETCONFIG1) & RF_PACKETCONFIG1_DCFREE_MASK) | (scheme << 5));
 }
 
 void hw_radio_set_sync_word(uint8_t *sync_word, uint8_t sync_size) {
@@ -1135,7 +1220,7 @@ void hw_radio_set_sync_word(uint8_t *sync_word, uint8_t sync_size) {
 }
 
 void hw_radio_set_crc_on(uint8_t enable) {
-  write_reg(REG_PACKETCONFIG1, (read_reg(REG_PACKETCONFIG1) & RF_PACKETCONFIG1_CRC_MASK) | (enable << 4));
+  write_reg(REG_PACKETCONFIG1, (read_reg_cached(REG_PACKETCONFIG1) & RF_PACKETCONFIG1_CRC_MASK) | (enable << 4));
 }
 
 error_t hw_radio_send_payload(uint8_t * data, uint16_t len) {
@@ -1185,9 +1270,9 @@ error_t hw_radio_send_payload(uint8_t * data, uint16_t len) {
       write_reg(REG_FIFOTHRESH, RF_FIFOTHRESH_TXSTARTCONDITION_FIFONOTEMPTY | FG_THRESHOLD);
       write_fifo(data + start, available_size);
       remaining_bytes_len = remaining_bytes_len - available_size;
+      set_refill_pending(true);
       hw_gpio_set_edge_interrupt(SX127x_DIO1_PIN, GPIO_FALLING_EDGE);
-      hw_gpio_enable_interrupt(SX127x_DIO1_PIN); 
-      sched_post_task(&wait_for_fifo_level_isr);
+      hw_gpio_enable_interrupt(SX127x_DIO1_PIN);
     } else {
       if(!enable_refill) {
         previous_threshold = 0;
@@ -1200,9 +1285,9 @@ error_t hw_radio_send_payload(uint8_t * data, uint16_t len) {
         write_reg(REG_FIFOTHRESH, RF_FIFOTHRESH_TXSTARTCONDITION_FIFONOTEMPTY | 2);
         write_fifo(data + start, remaining_bytes_len);
         remaining_bytes_len = 0;
+        set_refill_pending(true);
         hw_gpio_set_edge_interrupt(SX127x_DIO1_PIN, GPIO_FALLING_EDGE);
         hw_gpio_enable_interrupt(SX127x_DIO1_PIN);
-        sched_post_task(&wait_for_fifo_level_isr);
       }
     }
 
@@ -1238,7 +1323,7 @@ error_t hw_radio_send_payload(uint8_t * data, uint16_t len) {
 
 void hw_radio_set_payload_length(uint16_t length) {
   if(previous_payload_length != length) {
-    write_reg(REG_PACKETCONFIG2, (read_reg(REG_PACKETCONFIG2) & RF_PACKETCONFIG2_PAYLOADLENGTH_MSB_MASK) | ((length >> 8) & 0x07));
+    write_reg(REG_PACKETCONFIG2, (read_reg_cached(REG_PACKETCONFIG2) & RF_PACKETCONFIG2_PAYLOADLENGTH_MSB_MASK) | ((length >> 8) & 0x07));
     write_reg(REG_PAYLOADLENGTH, length & 0xFF);
     previous_payload_length = length;
   }
@@ -1252,7 +1337,7 @@ bool hw_radio_is_rx(void) {
 
 void hw_radio_enable_refill(bool enable) {
   if(lora_mode) {
-    write_reg(REG_LR_MODEMCONFIG2, read_reg(REG_LR_MODEMCONFIG2) | (enable * RFLR_MODEMCONFIG2_TXCONTINUOUSMODE_ON));
+    write_reg(REG_LR_MODEMCONFIG2, read_reg_cached(REG_LR_MODEMCONFIG2) | (enable * RFLR_MODEMCONFIG2_TXCONTINUOUSMODE_ON));
     hw_radio_set_opmode(HW_STATE_STANDBY);
   } else
     enable_refill = enable;
@@ -1275,8 +1360,8 @@ static void hw_radio_sx1272_set_tx_power(int8_t power)
   uint8_t paConfig = 0;
   uint8_t paDac = 0;
 
-  paConfig = read_reg(REG_PACONFIG);
-  paDac = read_reg(SX1272_REG_PADAC);
+  paConfig = read_reg_cached(REG_PACONFIG);
+  paDac = read_reg_cached(SX1272_REG_PADAC);
  
   // Quick Hack since SX1272GetPaSelect always returns RF_CONFIG_PASELECT_PA_BOOST
   paConfig = (paConfig & RF_PACONFIG_PASELECT_MASK) | hw_radio_get_pa_select(0);
@@ -1333,16 +1418,16 @@ static void hw_radio_sx1276_set_tx_power(int8_t eirp) {
   current_tx_power = eirp;
   if(eirp <= 5) {
     write_reg(REG_PACONFIG, (uint8_t)(eirp - 10.8 + 15));
-    write_reg(REG_PADAC, (read_reg(REG_PADAC) & RF_PADAC_20DBM_MASK) | RF_PADAC_20DBM_OFF); //Default Power
+    write_reg(REG_PADAC, (read_reg_cached(REG_PADAC) & RF_PADAC_20DBM_MASK) | RF_PADAC_20DBM_OFF); //Default Power
   } else if(eirp <= 15) {
     write_reg(REG_PACONFIG, 0x70 | (uint8_t)(eirp));
-    write_reg(REG_PADAC, (read_reg(REG_PADAC) & RF_PADAC_20DBM_MASK) | RF_PADAC_20DBM_OFF); //Default Power
+    write_reg(REG_PADAC, (read_reg_cached(REG_PADAC) & RF_PADAC_20DBM_MASK) | RF_PADAC_20DBM_OFF); //Default Power
   } else if(eirp <= 17) {
     write_reg(REG_PACONFIG, RF_PACONFIG_PASELECT_PABOOST | (eirp - 2));
-    write_reg(REG_PADAC, (read_reg(REG_PADAC) & RF_PADAC_20DBM_MASK) | RF_PADAC_20DBM_OFF); //Default Power
+    write_reg(REG_PADAC, (read_reg_cached(REG_PADAC) & RF_PADAC_20DBM_MASK) | RF_PADAC_20DBM_OFF); //Default Power
   } else {
     write_reg(REG_PACONFIG, RF_PACONFIG_PASELECT_PABOOST | (eirp - 5));
-    write_reg(REG_PADAC, (read_reg(REG_PADAC) & RF_PADAC_20DBM_MASK) | RF_PADAC_20DBM_ON);  //High Power
+    write_reg(REG_PADAC, (read_reg_cached(REG_PADAC) & RF_PADAC_20DBM_MASK) | RF_PADAC_20DBM_ON);  //High Power
   }
 #else
   // Pout = Pmax-(15-outputpower)
@@ -1372,8 +1457,9 @@ void hw_radio_switch_longRangeMode(bool use_lora) {
   if(use_lora != lora_mode) {
       set_opmode(OPMODE_SLEEP);
       update_active_times(HW_STATE_SLEEP);
-      write_reg(REG_OPMODE, (read_reg(REG_OPMODE) & RFLR_OPMODE_LONGRANGEMODE_MASK) | (use_lora << 7));
+      write_reg(REG_OPMODE, (read_reg_cached(REG_OPMODE) & RFLR_OPMODE_LONGRANGEMODE_MASK) | (use_lora << 7));
       lora_mode = use_lora;
+      invalidate_reg_shadow();
 
       if(!use_lora) {
         //swapping back to FSK mode, remove LoRaMac callbacks. If the LoRaMac is reinitialised, these will be reset.
@@ -1385,16 +1471,23 @@ void hw_radio_switch_longRangeMode(bool use_lora) {
   }
 }
 
-void hw_radio_set_lora_mode(uint32_t lora_bw, uint8_t lora_SF) {
-  hw_radio_set_opmode(HW_STATE_STANDBY); //device has to be in sleep or standby when configuring
+static uint8_t get_lora_bw_index(uint32_t lora_bw) {
   uint32_t min_diff = UINT32_MAX;
+  uint8_t bw_index = 0;
 
   for(uint8_t bw_cnt = 0; bw_cnt < 10; bw_cnt++) {
     if(abs(lora_bw - lora_available_bw[bw_cnt]) < min_diff) {
-      lora_closest_bw_index = bw_cnt;
+      bw_index = bw_cnt;
       min_diff = abs(lora_bw - lora_available_bw[bw_cnt]);
     }
   }
+
+  return bw_index;
+}
+
+void hw_radio_set_lora_mode(uint32_t lora_bw, uint8_t lora_SF) {
+  hw_radio_set_opmode(HW_STATE_STANDBY); //device has to be in sleep or standby when configuring
+  lora_closest_bw_index = get_lora_bw_index(lora_bw);
   write_reg(REG_LR_MODEMCONFIG1, RFLR_MODEMCONFIG1_CODINGRATE_4_5 | RFLR_MODEMCONFIG1_IMPLICITHEADER_OFF | (lora_closest_bw_index << 4));
 
   DPRINT("set to lora mode with %i Hz bandwidth (corrected to %i Hz) and Spreading Factor %i", lora_bw, lora_available_bw[lora_closest_bw_index], lora_SF);
@@ -1403,8 +1496,72 @@ void hw_radio_set_lora_mode(uint32_t lora_bw, uint8_t lora_SF) {
   write_reg(REG_LR_MODEMCONFIG2, RFLR_MODEMCONFIG2_RXPAYLOADCRC_OFF | RFLR_MODEMCONFIG2_TXCONTINUOUSMODE_OFF | (lora_SF << 4));
 }
 
+// Layout of hw_radio_channel_config_t.regs. In FSK mode the bitrate, frequency deviation and carrier frequency are
+// consecutive registers (REG_BITRATEMSB up to REG_FRFLSB), written in one burst. The carrier frequency registers are at
+// the same address in LoRa mode.
+#define CHANNEL_REGS_BITRATE          0
+#define CHANNEL_REGS_FDEV             2
+#define CHANNEL_REGS_FRF              4
+#define CHANNEL_REGS_FSK_BURST_SIZE   7
+#define CHANNEL_REGS_RXBW             7
+#define CHANNEL_REGS_PREAMBLEDETECT   8
+#define CHANNEL_REGS_PREAMBLE         9
+#define CHANNEL_REGS_RX_BW_NUMBER     11
+#define CHANNEL_REGS_RX_BW_KHZ        12
+#define CHANNEL_REGS_LR_MODEMCONFIG   7 // REG_LR_MODEMCONFIG1 and REG_LR_MODEMCONFIG2
+#define CHANNEL_REGS_LR_BW_INDEX      9
+
+void hw_radio_prepare_channel_config(hw_radio_channel_config_t* config) {
+  uint8_t* regs = config->regs;
+  uint32_t frf = get_frf(config->center_freq);
+  regs[CHANNEL_REGS_FRF] = (uint8_t)((frf >> 16) & 0xFF);
+  regs[CHANNEL_REGS_FRF + 1] = (uint8_t)((frf >> 8) & 0xFF);
+  regs[CHANNEL_REGS_FRF + 2] = (uint8_t)(frf & 0xFF);
+
+  if(config->lora) {
+    assert((config->lora_SF >= 7) && (config->lora_SF <= 12));
+    uint8_t bw_index = get_lora_bw_index(config->lora_bw);
+    regs[CHANNEL_REGS_LR_MODEMCONFIG] = RFLR_MODEMCONFIG1_CODINGRATE_4_5 | RFLR_MODEMCONFIG1_IMPLICITHEADER_OFF | (bw_index << 4);
+    regs[CHANNEL_REGS_LR_MODEMCONFIG + 1] = RFLR_MODEMCONFIG2_RXPAYLOADCRC_OFF | RFLR_MODEMCONFIG2_TXCONTINUOUSMODE_OFF | (config->lora_SF << 4);
+    regs[CHANNEL_REGS_LR_BW_INDEX] = bw_index;
+    return;
+  }
+
+  uint16_t bitrate = get_bitrate_reg(config->bitrate);
+  regs[CHANNEL_REGS_BITRATE] = (uint8_t)(bitrate >> 8);
+  regs[CHANNEL_REGS_BITRATE + 1] = (uint8_t)(bitrate & 0xFF);
+  uint16_t fdev = get_fdev_reg(config->tx_fdev);
+  regs[CHANNEL_REGS_FDEV] = (uint8_t)(fdev >> 8);
+  regs[CHANNEL_REGS_FDEV + 1] = (uint8_t)(fdev & 0xFF);
+  regs[CHANNEL_REGS_RXBW] = get_rx_bw_reg(config->rx_bw_hz, &regs[CHANNEL_REGS_RX_BW_NUMBER], &regs[CHANNEL_REGS_RX_BW_KHZ]);
+  regs[CHANNEL_REGS_PREAMBLEDETECT] = get_preamble_detector_reg(config->preamble_detector_size, config->preamble_tol);
+  regs[CHANNEL_REGS_PREAMBLE] = (uint8_t)(config->preamble_size >> 8);
+  regs[CHANNEL_REGS_PREAMBLE + 1] = (uint8_t)(config->preamble_size & 0xFF);
+}
+
+void hw_radio_apply_channel_config(const hw_radio_channel_config_t* config) {
+  const uint8_t* regs = config->regs;
+  hw_radio_switch_longRangeMode(config->lora);
+  current_center_freq = config->center_freq;
+
+  if(config->lora) {
+    hw_radio_set_opmode(HW_STATE_STANDBY); //device has to be in sleep or standby when configuring
+    write_regs(REG_LR_MODEMCONFIG1, &regs[CHANNEL_REGS_LR_MODEMCONFIG], 2);
+    write_regs(REG_LR_FRFMSB, &regs[CHANNEL_REGS_FRF], 3);
+    lora_closest_bw_index = regs[CHANNEL_REGS_LR_BW_INDEX];
+    return;
+  }
+
+  write_regs(REG_BITRATEMSB, regs, CHANNEL_REGS_FSK_BURST_SIZE);
+  write_reg(REG_RXBW, regs[CHANNEL_REGS_RXBW]);
+  write_reg(REG_PREAMBLEDETECT, regs[CHANNEL_REGS_PREAMBLEDETECT]);
+  write_regs(REG_PREAMBLEMSB, &regs[CHANNEL_REGS_PREAMBLE], 2);
+  rx_bw_number = regs[CHANNEL_REGS_RX_BW_NUMBER];
+  rx_bw_khz = regs[CHANNEL_REGS_RX_BW_KHZ];
+}
+
 void hw_radio_set_lora_cont_tx(bool activate) {
-  write_reg(REG_LR_MODEMCONFIG2, read_reg(REG_LR_MODEMCONFIG2) | (activate * RFLR_MODEMCONFIG2_TXCONTINUOUSMODE_ON));
+  write_reg(REG_LR_MODEMCONFIG2, read_reg_cached(REG_LR_MODEMCONFIG2) | (activate * RFLR_MODEMCONFIG2_TXCONTINUOUSMODE_ON));
 }
 
 void hw_radio_set_rx_timeout(uint32_t timeout) {
@@ -1524,7 +1681,7 @@ void hw_lora_set_rx_config(uint32_t bandwidth,
   }
 
   write_reg( REG_LR_MODEMCONFIG1,
-        ( read_reg( REG_LR_MODEMCONFIG1 ) &
+        ( read_reg_cached( REG_LR_MODEMCONFIG1 ) &
         RFLR_MODEMCONFIG1_BW_MASK &
         RFLR_MODEMCONFIG1_CODINGRATE_MASK &
         RFLR_MODEMCONFIG1_IMPLICITHEADER_MASK ) |
@@ -1532,7 +1689,7 @@ void hw_lora_set_rx_config(uint32_t bandwidth,
         fixLen );
 
   write_reg( REG_LR_MODEMCONFIG2,
-        ( read_reg( REG_LR_MODEMCONFIG2 ) &
+        ( read_reg_cached( REG_LR_MODEMCONFIG2 ) &
         RFLR_MODEMCONFIG2_SF_MASK &
         RFLR_MODEMCONFIG2_RXPAYLOADCRC_MASK &
         RFLR_MODEMCONFIG2_SYMBTIMEOUTMSB_MASK ) |
@@ -1540,7 +1697,7 @@ void hw_lora_set_rx_config(uint32_t bandwidth,
         ( ( symbTimeout >> 8 ) & ~RFLR_MODEMCONFIG2_SYMBTIMEOUTMSB_MASK ) );
 
   write_reg( REG_LR_MODEMCONFIG3,
-        ( read_reg( REG_LR_MODEMCONFIG3 ) &
+        ( read_reg_cached( REG_LR_MODEMCONFIG3 ) &
         RFLR_MODEMCONFIG3_LOWDATARATEOPTIMIZE_MASK ) |
         ( lowDatarateOptimize << 3 ) );
 
@@ -1554,7 +1711,7 @@ void hw_lora_set_rx_config(uint32_t bandwidth,
 
   if( freqHopOn )
   {
-    write_reg( REG_LR_PLLHOP, ( read_reg( REG_LR_PLLHOP ) & RFLR_PLLHOP_FASTHOP_MASK ) | RFLR_PLLHOP_FASTHOP_ON );
+    write_reg( REG_LR_PLLHOP, ( read_reg_cached( REG_LR_PLLHOP ) & RFLR_PLLHOP_FASTHOP_MASK ) | RFLR_PLLHOP_FASTHOP_ON );
     write_reg( REG_LR_HOPPERIOD, hopPeriod );
   }
 
@@ -1579,7 +1736,7 @@ void hw_lora_set_rx_config(uint32_t bandwidth,
   if( datarate == 6 )
   {
     write_reg( REG_LR_DETECTOPTIMIZE,
-                ( read_reg( REG_LR_DETECTOPTIMIZE ) &
+                ( read_reg_cached( REG_LR_DETECTOPTIMIZE ) &
                 RFLR_DETECTIONOPTIMIZE_MASK ) |
                 RFLR_DETECTIONOPTIMIZE_SF6 );
     write_reg( REG_LR_DETECTIONTHRESHOLD, RFLR_DETECTIONTHRESH_SF6 );
@@ -1587,7 +1744,7 @@ void hw_lora_set_rx_config(uint32_t bandwidth,
   else
   {
     write_reg( REG_LR_DETECTOPTIMIZE,
-                ( read_reg( REG_LR_DETECTOPTIMIZE ) &
+                ( read_reg_cached( REG_LR_DETECTOPTIMIZE ) &
                 RFLR_DETECTIONOPTIMIZE_MASK ) |
                 RFLR_DETECTIONOPTIMIZE_SF7_TO_SF12 );
     write_reg( REG_LR_DETECTIONTHRESHOLD, RFLR_DETECTIONTHRESH_SF7_TO_SF12 );
@@ -1595,12 +1752,12 @@ void hw_lora_set_rx_config(uint32_t bandwidth,
 
   if( iqInverted )
   {
-    write_reg( REG_LR_INVERTIQ, ( ( read_reg( REG_LR_INVERTIQ ) & RFLR_INVERTIQ_TX_MASK & RFLR_INVERTIQ_RX_MASK ) | RFLR_INVERTIQ_RX_ON | RFLR_INVERTIQ_TX_OFF ) );
+    write_reg( REG_LR_INVERTIQ, ( ( read_reg_cached( REG_LR_INVERTIQ ) & RFLR_INVERTIQ_TX_MASK & RFLR_INVERTIQ_RX_MASK ) | RFLR_INVERTIQ_RX_ON | RFLR_INVERTIQ_TX_OFF ) );
     write_reg( REG_LR_INVERTIQ2, RFLR_INVERTIQ2_ON );
   }
   else
   {
-    write_reg( REG_LR_INVERTIQ, ( ( read_reg( REG_LR_INVERTIQ ) & RFLR_INVERTIQ_TX_MASK & RFLR_INVERTIQ_RX_MASK ) | RFLR_INVERTIQ_RX_OFF | RFLR_INVERTIQ_TX_OFF ) );
+    write_reg( REG_LR_INVERTIQ, ( ( read_reg_cached( REG_LR_INVERTIQ ) & RFLR_INVERTIQ_TX_MASK & RFLR_INVERTIQ_RX_MASK ) | RFLR_INVERTIQ_RX_OFF | RFLR_INVERTIQ_TX_OFF ) );
     write_reg( REG_LR_INVERTIQ2, RFLR_INVERTIQ2_OFF );
   }
   rx_type_continuous = rxContinuous;
@@ -1637,24 +1794,24 @@ void hw_lora_set_tx_config(uint32_t bandwidth, uint32_t datarate,
 
   if( freqHopOn  )
   {
-    write_reg( REG_LR_PLLHOP, ( read_reg( REG_LR_PLLHOP ) & RFLR_PLLHOP_FASTHOP_MASK ) | RFLR_PLLHOP_FASTHOP_ON );
+    write_reg( REG_LR_PLLHOP, ( read_reg_cached( REG_LR_PLLHOP ) & RFLR_PLLHOP_FASTHOP_MASK ) | RFLR_PLLHOP_FASTHOP_ON );
     write_reg( REG_LR_HOPPERIOD, hopPeriod );
   }
 
   write_reg( REG_LR_MODEMCONFIG1,
-        ( read_reg( REG_LR_MODEMCONFIG1 ) &
+        ( read_reg_cached( REG_LR_MODEMCONFIG1 ) &
         RFLR_MODEMCONFIG1_BW_MASK &
         RFLR_MODEMCONFIG1_CODINGRATE_MASK &
         RFLR_MODEMCONFIG1_IMPLICITHEADER_MASK ) |
         ( bandwidth << 4 ) | ( coderate << 1 ) |   fixLen );
 
   write_reg( REG_LR_MODEMCONFIG2,
-        ( read_reg( REG_LR_MODEMCONFIG2 ) &
+        ( read_reg_cached( REG_LR_MODEMCONFIG2 ) &
         RFLR_MODEMCONFIG2_SF_MASK &
         RFLR_MODEMCONFIG2_RXPAYLOADCRC_MASK ) | ( datarate << 4 ) | ( crcOn << 2 ) );
 
   write_reg( REG_LR_MODEMCONFIG3,
-        ( read_reg( REG_LR_MODEMCONFIG3 ) &
+        ( read_reg_cached( REG_LR_MODEMCONFIG3 ) &
         RFLR_MODEMCONFIG3_LOWDATARATEOPTIMIZE_MASK ) | ( lowDatarateOptimize << 3 ) );
 
   write_reg( REG_LR_PREAMBLEMSB, ( preambleLen >> 8 ) & 0x00FF );
@@ -1663,7 +1820,7 @@ void hw_lora_set_tx_config(uint32_t bandwidth, uint32_t datarate,
   if( datarate == 6 )
   {
     write_reg( REG_LR_DETECTOPTIMIZE,
-            ( read_reg( REG_LR_DETECTOPTIMIZE ) &
+            ( read_reg_cached( REG_LR_DETECTOPTIMIZE ) &
             RFLR_DETECTIONOPTIMIZE_MASK ) |
             RFLR_DETECTIONOPTIMIZE_SF6 );
     write_reg( REG_LR_DETECTIONTHRESHOLD, RFLR_DETECTIONTHRESH_SF6 );
@@ -1671,7 +1828,7 @@ void hw_lora_set_tx_config(uint32_t bandwidth, uint32_t datarate,
   else
   {
     write_reg( REG_LR_DETECTOPTIMIZE,
-            ( read_reg( REG_LR_DETECTOPTIMIZE ) &
+            ( read_reg_cached( REG_LR_DETECTOPTIMIZE ) &
             RFLR_DETECTIONOPTIMIZE_MASK ) |
             RFLR_DETECTIONOPTIMIZE_SF7_TO_SF12 );
     write_reg( REG_LR_DETECTIONTHRESHOLD, RFLR_DETECTIONTHRESH_SF7_TO_SF12 );
@@ -1679,12 +1836,12 @@ void hw_lora_set_tx_config(uint32_t bandwidth, uint32_t datarate,
 
   if( iqInverted )
   {
-    write_reg( REG_LR_INVERTIQ, ( ( read_reg( REG_LR_INVERTIQ ) & RFLR_INVERTIQ_TX_MASK & RFLR_INVERTIQ_RX_MASK ) | RFLR_INVERTIQ_RX_OFF | RFLR_INVERTIQ_TX_ON ) );
+    write_reg( REG_LR_INVERTIQ, ( ( read_reg_cached( REG_LR_INVERTIQ ) & RFLR_INVERTIQ_TX_MASK & RFLR_INVERTIQ_RX_MASK ) | RFLR_INVERTIQ_RX_OFF | RFLR_INVERTIQ_TX_ON ) );
     write_reg( REG_LR_INVERTIQ2, RFLR_INVERTIQ2_ON );
   }
   else
   {
-    write_reg( REG_LR_INVERTIQ, ( ( read_reg( REG_LR_INVERTIQ ) & RFLR_INVERTIQ_TX_MASK & RFLR_INVERTIQ_RX_MASK ) | RFLR_INVERTIQ_RX_OFF | RFLR_INVERTIQ_TX_OFF ) );
+    write_reg( REG_LR_INVERTIQ, ( ( read_reg_cached( REG_LR_INVERTIQ ) & RFLR_INVERTIQ_TX_MASK & RFLR_INVERTIQ_RX_MASK ) | RFLR_INVERTIQ_RX_OFF | RFLR_INVERTIQ_TX_OFF ) );
     write_reg( REG_LR_INVERTIQ2, RFLR_INVERTIQ2_OFF );
   }
 }
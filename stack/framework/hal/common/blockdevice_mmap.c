@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This is a blockdevice implementation for hosted platforms, backed by a memory mapped file. Reads and programs are a
+// memcpy from or to the mapping, without any system call; the kernel pages the file in and writes it back.
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "blockdevice_mmap.h"
+#include "debug.h"
+#include "log.h"
+#include "framework_defs.h"
+
+
+#if defined(FRAMEWORK_LOG_ENABLED) && defined(HAL_PERIPH_LOG_ENABLED)
+#define DPRINT(...) log_print_stack_string(LOG_STACK_ALP, __VA_ARGS__)
+#define DPRINT_DATA(p, n) log_print_data(p, n)
+#else
+#define DPRINT(...)
+#define DPRINT_DATA(p, n)
+#endif
+
+#define SECTOR_4K_SIZE  0x1000
+#define BLOCK_32K_SIZE  0x8000
+
+// forward declare driver function pointers (read and program are prefixed, unistd.h declares read())
+static void init(blockdevice_t* bd);
+static error_t bd_read(blockdevice_t* bd, uint8_t* data, uint32_t addr, uint32_t size);
+static error_t bd_program(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size);
+static error_t erase_chip(blockdevice_t* bd);
+static error_t erase_block32k(blockdevice_t* bd, uint32_t addr);
+static error_t erase_sector4k(blockdevice_t* bd, uint32_t addr);
+
+blockdevice_driver_t blockdevice_driver_mmap = {
+    .init = init,
+    .read = bd_read,
+    .program = bd_program,
+    .erase_chip = erase_chip,
+    .erase_block32k = erase_block32k,
+    .erase_sector4k = erase_sector4k,
+    .erase_block_size = 0,          //erase not necessary, programming overwrites like RAM
+    .write_block_size = UINT32_MAX  //blocks don't have a limit to write at once
+};
+
+static blockdevice_mmap_t* idle_sync_list = NULL;
+
+// msync() needs a page aligned address
+static void sync_range(blockdevice_mmap_t* bd_mmap, uint32_t start, uint32_t end)
+{
+  uint32_t page_mask = (uint32_t)sysconf(_SC_PAGESIZE) - 1;
+  uint32_t aligned_start = start & ~page_mask;
+  int rc = msync(bd_mmap->buffer + aligned_start, end - aligned_start, MS_SYNC);
+  assert(rc == 0);
+}
+
+static void mark_changed(blockdevice_mmap_t* bd_mmap, uint32_t addr, uint32_t size)
+{
+  if(bd_mmap->sync == BLOCKDEVICE_MMAP_SYNC_WRITE_THROUGH)
+  {
+    sync_range(bd_mmap, addr, addr + size);
+  }
+  else if(bd_mmap->sync == BLOCKDEVICE_MMAP_SYNC_ON_IDLE)
+  {
+    if(bd_mmap->dirty_start == bd_mmap->dirty_end)
+    {
+      bd_mmap->dirty_start = addr;
+      bd_mmap->dirty_end = addr + size;
+    }
+    else
+    {
+      if(addr < bd_mmap->dirty_start) bd_mmap->dirty_start = addr;
+      if(addr + size > bd_mmap->dirty_end) bd_mmap->dirty_end = addr + size;
+    }
+  }
+}
+
+static void init(blockdevice_t* bd) {
+  blockdevice_mmap_t* bd_mmap = (blockdevice_mmap_t*)bd;
+  DPRINT("init mmap block device %s of size %i\n", bd_mmap->path, bd_mmap->base.size);
+
+  int fd = open(bd_mmap->path, O_RDWR | O_CREAT, 0644);
+  if(fd < 0)
+    perror(bd_mmap->path);
+
+  assert(fd >= 0);
+
+  struct stat file_stat;
+  int rc = fstat(fd, &file_stat);
+  assert(rc == 0);
+
+  // a shorter file is extended, the new part is erased below
+  uint32_t existing_size = file_stat.st_size;
+  uint32_t file_size = existing_size;
+  if(file_size < bd_mmap->base.size)
+  {
+    rc = ftruncate(fd, bd_mmap->base.size);
+    assert(rc == 0);
+  }
+
+  bd_mmap->buffer = mmap(NULL, bd_mmap->base.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(bd_mmap->buffer == MAP_FAILED)
+    perror(bd_mmap->path);
+
+  assert(bd_mmap->buffer != MAP_FAILED);
+  close(fd); // the mapping keeps the file open
+
+  if(file_size == 0 && bd_mmap->initial_data != NULL)
+  {
+    memcpy(bd_mmap->buffer, bd_mmap->initial_data, bd_mmap->base.size);
+    file_size = bd_mmap->base.size;
+  }
+
+  if(file_size < bd_mmap->base.size)
+    memset(bd_mmap->buffer + file_size, 0xFF, bd_mmap->base.size - file_size);
+
+  bd_mmap->dirty_start = 0;
+  bd_mmap->dirty_end = 0;
+  if(existing_size < bd_mmap->base.size)
+    mark_changed(bd_mmap, existing_size, bd_mmap->base.size - existing_size);
+
+  if(bd_mmap->sync == BLOCKDEVICE_MMAP_SYNC_ON_IDLE)
+  {
+    bd_mmap->next = idle_sync_list;
+    idle_sync_list = bd_mmap;
+  }
+}
+
+static error_t bd_read(blockdevice_t* bd, uint8_t* data, uint32_t addr, uint32_t size) {
+  blockdevice_mmap_t* bd_mmap = (blockdevice_mmap_t*)bd;
+  DPRINT("BD READ %i @ %x\n", size, addr);
+
+  if(size == 0) return SUCCESS;
+  if(addr + size > bd_mmap->base.size) return -ESIZE;
+
+  memcpy((void*)data, bd_mmap->buffer + addr, size);
+
+  return SUCCESS;
+}
+
+static error_t bd_program(blockdevice_t* bd, const uint8_t* data, uint32_t addr, uint32_t size) {
+  blockdevice_mmap_t* bd_mmap = (blockdevice_mmap_t*)bd;
+  DPRINT("BD WRITE %i @ %x\n", size, addr);
+
+  if(size == 0) return SUCCESS;
+  if(addr + size > bd_mmap->base.size) return -ESIZE;
+
+  memcpy(bd_mmap->buffer + addr, data, size);
+  mark_changed(bd_mmap, addr, size);
+
+  DPRINT_DATA(data, size);
+
+  return SUCCESS;
+}
+
+// like NOR flash, erasing sets all bits of the block containing addr
+static error_t erase(blockdevice_mmap_t* bd_mmap, uint32_t addr, uint32_t block_size) {
+  addr &= ~(block_size - 1);
+  if(addr >= bd_mmap->base.size) return -ESIZE;
+
+  uint32_t size = bd_mmap->base.size - addr < block_size ? bd_mmap->base.size - addr : block_size;
+  memset(bd_mmap->buffer + addr, 0xFF, size);
+  mark_changed(bd_mmap, addr, size);
+
+  return SUCCESS;
+}
+
+static error_t erase_chip(blockdevice_t* bd) {
+  blockdevice_mmap_t* bd_mmap = (blockdevice_mmap_t*)bd;
+  DPRINT("BD ERASE CHIP\n");
+
+  memset(bd_mmap->buffer, 0xFF, bd_mmap->base.size);
+  mark_changed(bd_mmap, 0, bd_mmap->base.size);
+
+  return SUCCESS;
+}
+
+static error_t erase_block32k(blockdevice_t* bd, uint32_t addr) {
+  DPRINT("BD ERASE 32K @ %x\n", addr);
+  return erase((blockdevice_mmap_t*)bd, addr, BLOCK_32K_SIZE);
+}
+
+static error_t erase_sector4k(blockdevice_t* bd, uint32_t addr) {
+  DPRINT("BD ERASE 4K @ %x\n", addr);
+  return erase((blockdevice_mmap_t*)bd, addr, SECTOR_4K_SIZE);
+}
+
+void blockdevice_mmap_sync_idle(void) {
+  for(blockdevice_mmap_t* bd_mmap = idle_sync_list; bd_mmap != NULL; bd_mmap = bd_mmap->next)
+  {
+    if(bd_mmap->dirty_start == bd_mmap->dirty_end)
+      continue;
+
+    DPRINT("BD SYNC %i @ %x\n", bd_mmap->dirty_end - bd_mmap->dirty_start, bd_mmap->dirty_start);
+    sync_range(bd_mmap, bd_mmap->dirty_start, bd_mmap->dirty_end);
+    bd_mmap->dirty_start = 0;
+    bd_mmap->dirty_end = 0;
+  }
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLOCKDEVICE_MMAP_H_
+#define __BLOCKDEVICE_MMAP_H_
+
+#include "hwblockdevice.h"
+
+// This is a blockdevice implementation for hosted platforms (NATIVE), backed by a memory mapped file. The contents
+// survive a restart of the process and the file can be inspected or copied while the process is not running.
+// A file which does not exist yet is created with the initial data, or erased (0xFF) if there is none.
+
+typedef enum {
+  BLOCKDEVICE_MMAP_SYNC_NONE,           // the kernel writes the changes back at its own pace, survives a crash of the process but not of the host
+  BLOCKDEVICE_MMAP_SYNC_ON_IDLE,        // the changes are written back by blockdevice_mmap_sync_idle(), called when the MCU goes to sleep
+  BLOCKDEVICE_MMAP_SYNC_WRITE_THROUGH,  // every program or erase is written back before it returns
+} blockdevice_mmap_sync_t;
+
+// extend blockdevice_t
+typedef struct blockdevice_mmap blockdevice_mmap_t;
+struct blockdevice_mmap {
+  blockdevice_t base;
+  const char* path;
+  blockdevice_mmap_sync_t sync;
+  const uint8_t* initial_data;  // base.size bytes, or NULL
+  uint8_t* buffer;              // the mapped file, set by init
+  uint32_t dirty_start;         // range changed since the last sync, only used for BLOCKDEVICE_MMAP_SYNC_ON_IDLE
+  uint32_t dirty_end;
+  blockdevice_mmap_t* next;     // list of the blockdevices synced on idle
+};
+
+extern blockdevice_driver_t blockdevice_driver_mmap;
+
+/*! \brief Writes the changes to all BLOCKDEVICE_MMAP_SYNC_ON_IDLE blockdevices back to their files
+ */
+void blockdevice_mmap_sync_idle(void);
+
+#endif //__BLOCKDEVICE_MMAP_H_
@@ -26,6 +26,11 @@
  *
  * This header files specifies a number of cryptographic functions rendered by
  * the hardware cryptography engine.
+ *
+ * It is the dispatch point between the AES component and the hardware engines: a chip
+ * providing these functions sets HAL_SUPPORT_HW_AES, after which the AES component uses
+ * them when built with FRAMEWORK_AES_BACKEND set to 'HW'. The engines receive the plain
+ * 128 bit key and are responsible for their own key expansion.
  */
 #ifndef __HW_AES_H_
 #define __HW_AES_H_
@@ -33,6 +33,8 @@ typedef enum
     PERIPH_USART1,
     PERIPH_USART2,
     PERIPH_LPUART1,
+    PERIPH_SPI1,
+    PERIPH_SPI2,
 } dma_peripheral_t;
 
 __LINK_C dma_handle_t* dma_channel_init(uint8_t channel_idx);
@@ -474,6 +474,31 @@ void hw_radio_set_preamble_size(uint16_t size);
 void hw_radio_set_preamble_detector(uint8_t preamble_detector_size, uint8_t preamble_tol);
 void hw_radio_set_rssi_config(uint8_t rssi_smoothing, uint8_t rssi_offset);
 
+#define HW_RADIO_CHANNEL_REGS_SIZE 16
+
+/** \brief The settings of a channel, to switch to it with a single call to hw_radio_apply_channel_config()
+ *
+ * The caller fills in the settings, hw_radio_prepare_channel_config() converts them once into the register values of
+ * the radio (regs, driver specific). Applying a prepared config is the same as calling the hw_radio_set_* functions
+ * with these settings, but does not need to compute anything and can write consecutive registers in one burst.
+ */
+typedef struct {
+    uint32_t center_freq;
+    bool lora;                      // if true, only center_freq, lora_bw and lora_SF are used
+    uint32_t bitrate;
+    uint32_t tx_fdev;
+    uint32_t rx_bw_hz;
+    uint16_t preamble_size;
+    uint8_t preamble_detector_size;
+    uint8_t preamble_tol;
+    uint32_t lora_bw;
+    uint8_t lora_SF;
+    uint8_t regs[HW_RADIO_CHANNEL_REGS_SIZE];
+} hw_radio_channel_config_t;
+
+void hw_radio_prepare_channel_config(hw_radio_channel_config_t* config);
+void hw_radio_apply_channel_config(const hw_radio_channel_config_t* config);
+
 #if 0
 void hw_radio_set_modulation_shaping(uint8_t shaping);
 void hw_radio_set_preamble_polarity(uint8_t polarity);
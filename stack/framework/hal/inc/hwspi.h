@@ -73,6 +73,14 @@ __LINK_C void                spi_send_byte_with_control(spi_slave_handle_t* spi,
 __LINK_C void                spi_exchange_bytes(spi_slave_handle_t* spi,
                                                 uint8_t *TxData,
                                                 uint8_t *RxData, size_t length);
+
+// same as spi_exchange_bytes() but the bytes are moved by the DMA channels (see hwdma.h), returns when the transfer is
+// complete. TxData or RxData can be NULL, both channels need to be initialized with dma_channel_init()
+__LINK_C void                spi_exchange_bytes_via_DMA(spi_slave_handle_t* spi,
+                                                        uint8_t *TxData,
+                                                        uint8_t *RxData, size_t length,
+                                                        uint8_t dma_rx_channel_idx,
+                                                        uint8_t dma_tx_channel_idx);
 #endif
 
 /** @}*/
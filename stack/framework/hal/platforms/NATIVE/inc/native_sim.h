@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file native_sim.h
+ * \addtogroup NATIVE
+ * @{
+ * \brief Interface between an application and the network simulator of the NATIVE platform, see native_sim.c
+ *
+ * With PLATFORM_NATIVE_SIMULATOR every node of the network runs its own copy of the application and the stack,
+ * the node global variables (see ng.h) of the node which is currently running are selected by get_node_global_id().
+ */
+
+#ifndef __NATIVE_SIM_H_
+#define __NATIVE_SIM_H_
+
+#include "types.h"
+#include "blockdevice_ram.h"
+
+/*! \brief Returns the number of simulated nodes. The node IDs are 0 up to this number - 1.
+ */
+uint32_t native_sim_get_node_count(void);
+
+/*! \brief Returns the simulated time since the start of the simulation in ns.
+ */
+uint64_t native_sim_get_time(void);
+
+/*! \brief Returns the blockdevice of the given type (see fs_blockdevice_types_t) of the current node.
+ */
+blockdevice_t* native_sim_get_blockdevice(uint8_t type);
+
+/*! \brief Called once when the simulation ended, to print the results. Weak, can be implemented by the application.
+ *
+ * The state of the individual nodes can be accessed by selecting them using set_node_global_id().
+ */
+void native_sim_report(void);
+
+#endif
+
+/** @}*/
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file native_time.h
+ * \addtogroup NATIVE
+ * @{
+ * \brief Access to the virtual clock of the NATIVE platform, see native_timer.c
+ */
+
+#ifndef __NATIVE_TIME_H_
+#define __NATIVE_TIME_H_
+
+#include "types.h"
+
+/*! \brief Returns the virtual time since boot in hardware timer ticks. Unlike the framework timer this does not overflow.
+ */
+uint64_t native_time_get_ticks(void);
+
+/*! \brief Advances the virtual time by the given number of ticks, to model the time spent by a busy MCU.
+ *
+ * The timer interrupts which expire in the meantime are handled once the scheduler enters low power mode, like
+ * pending interrupts on the hardware. The number of ticks should stay below the hardware timer period.
+ */
+void native_time_advance(uint32_t ticks);
+
+#endif
+
+/** @}*/
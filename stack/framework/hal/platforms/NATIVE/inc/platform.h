@@ -31,12 +31,20 @@
 #endif
 
 /** Platform BD drivers*/
+#ifdef PLATFORM_NATIVE_SIMULATOR
+// every simulated node has its own blockdevices
+blockdevice_t* native_sim_get_blockdevice(uint8_t type);
+#define PLATFORM_METADATA_BLOCKDEVICE native_sim_get_blockdevice(FS_BLOCKDEVICE_TYPE_METADATA)
+#define PLATFORM_PERMANENT_BLOCKDEVICE native_sim_get_blockdevice(FS_BLOCKDEVICE_TYPE_PERMANENT)
+#define PLATFORM_VOLATILE_BLOCKDEVICE native_sim_get_blockdevice(FS_BLOCKDEVICE_TYPE_VOLATILE)
+#else
 extern blockdevice_t * const metadata_blockdevice;
 extern blockdevice_t * const persistent_files_blockdevice;
 extern blockdevice_t * const volatile_blockdevice;
 #define PLATFORM_METADATA_BLOCKDEVICE metadata_blockdevice
 #define PLATFORM_PERMANENT_BLOCKDEVICE persistent_files_blockdevice
 #define PLATFORM_VOLATILE_BLOCKDEVICE volatile_blockdevice
+#endif
 
 #endif
 
@@ -0,0 +1,651 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file native_sim.c
+ *
+ * Discrete-event simulation of a network of nodes, each running its own copy of the application and the stack on
+ * top of the node global variables (see ng.h), with a simulated radio (native_sim_radio.c) on a shared medium.
+ *
+ * Every node runs as a coroutine with its own stack and its own virtual clock, which jumps from event to event like
+ * the single node clock in native_timer.c. The events of all nodes are ordered in a global queue. The simulation
+ * proceeds in windows which start at the earliest event and last as long as the lookahead of the medium: nothing a
+ * node does within a window can reach another node before the end of the window, so all nodes with an event in the
+ * window can run in parallel, on a pool of worker threads. A node always runs on the same worker, which owns it
+ * during the window. In the serial phase between two windows the transmissions of the nodes are applied to the
+ * medium in node order, which makes the results independent of the number of workers.
+ *
+ * Processing takes no virtual time, except for the busy waits of the stack.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bootstrap.h"
+#include "hwtimer.h"
+#include "hwsystem.h"
+#include "scheduler.h"
+#include "errors.h"
+#include "debug.h"
+#include "ng.h"
+#include "fs.h"
+#include "framework_defs.h"
+#include "platform_defs.h"
+#include "native_time.h"
+#include "native_sim.h"
+#include "native_sim_node.h"
+
+#define HWTIMER_NUM 1
+#define COUNTER_PERIOD (UINT64_C(1) << (8 * sizeof(hwtimer_tick_t)))
+#define NODE_STACK_SIZE (128 * 1024)
+#define METADATA_SIZE (4 + 4 + (12 * FRAMEWORK_FS_FILE_COUNT))
+#define NOT_IN_QUEUE UINT32_MAX
+
+// the initial file system of every node, see d7ap_fs_data.c
+extern uint8_t d7ap_fs_metadata[];
+extern uint8_t d7ap_files_data[FRAMEWORK_FS_PERMANENT_STORAGE_SIZE];
+extern uint8_t d7ap_volatile_files_data[FRAMEWORK_FS_VOLATILE_STORAGE_SIZE];
+
+void __platform_init();
+void __platform_post_framework_init();
+
+typedef struct {
+    pthread_t thread;
+    uint32_t index;
+    sem_t start;
+    ucontext_t context;
+} sim_worker_t;
+
+static const hwtimer_info_t timer_info = {
+  .min_delay_ticks = 1,
+};
+
+static uint32_t node_count = 100;
+static double duration = 3600.0;
+static uint64_t seed = 1;
+static double area = 500.0;
+static uint32_t worker_count = 1;
+static const char* positions_file = NULL;
+
+static sim_node_t* nodes;
+static sim_node_t** queue;          // min-heap on the time of the next event of the nodes which are not running
+static uint32_t queue_size = 0;
+static sim_node_t** window_nodes;
+static uint32_t window_count = 0;
+static uint64_t window_end = 0;
+static sim_worker_t* workers;
+static sem_t workers_done;
+static bool stopping = false;
+
+static __thread sim_node_t* current_node;
+static __thread sim_worker_t* current_worker;
+
+sim_node_t* sim_current_node(void)
+{
+    return current_node;
+}
+
+void sim_yield(void)
+{
+    swapcontext(&current_node->context, &current_worker->context);
+}
+
+uint64_t sim_random(sim_node_t* node)
+{
+    // splitmix64
+    uint64_t z = (node->rng += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t get_ticks(sim_node_t* node)
+{
+    return (unsigned __int128)node->now * node->ticks_per_sec / SIM_NS_PER_SEC;
+}
+
+// the time at which the counter reaches the given value
+static inline uint64_t get_tick_time(sim_node_t* node, uint64_t ticks)
+{
+    return ((unsigned __int128)ticks * SIM_NS_PER_SEC + node->ticks_per_sec - 1) / node->ticks_per_sec;
+}
+
+static inline uint64_t get_next_overflow_tick(sim_node_t* node)
+{
+    return (node->overflows_delivered + 1) * COUNTER_PERIOD;
+}
+
+static uint64_t get_timer_next_event(sim_node_t* node)
+{
+    if(!node->timer_inited)
+        return SIM_TIME_NEVER;
+
+    uint64_t next = get_next_overflow_tick(node);
+    if(node->compare_pending && node->compare_tick < next)
+        next = node->compare_tick;
+
+    return get_tick_time(node, next);
+}
+
+static uint64_t get_next_event(sim_node_t* node)
+{
+    if(node->busy)
+        return node->now;
+
+    uint64_t next = get_timer_next_event(node);
+    uint64_t radio_next = sim_radio_get_next_event(node);
+    return radio_next < next ? radio_next : next;
+}
+
+// call the callbacks of the timer interrupts which are due, in chronological order
+static bool deliver_timer_interrupts(sim_node_t* node)
+{
+    if(!node->timer_inited)
+        return false;
+
+    bool delivered = false;
+    uint64_t ticks = get_ticks(node);
+    while(true)
+    {
+        if(node->compare_pending && node->compare_tick <= ticks && node->compare_tick < get_next_overflow_tick(node))
+        {
+            node->compare_pending = false;
+            if(node->compare_f)
+                node->compare_f();
+        }
+        else if(get_next_overflow_tick(node) <= ticks)
+        {
+            node->overflows_delivered++;
+            if(node->overflow_f)
+                node->overflow_f();
+        }
+        else
+            return delivered;
+
+        delivered = true;
+    }
+}
+
+error_t hw_timer_init(hwtimer_id_t timer_id, uint8_t frequency, timer_callback_t compare_callback, timer_callback_t overflow_callback)
+{
+    sim_node_t* node = current_node;
+    if(timer_id >= HWTIMER_NUM)
+        return ESIZE;
+
+    if(node->timer_inited)
+        return EALREADY;
+
+    if(frequency != HWTIMER_FREQ_1MS && frequency != HWTIMER_FREQ_32K)
+        return EINVAL;
+
+    node->ticks_per_sec = (frequency == HWTIMER_FREQ_1MS) ? HWTIMER_TICKS_1MS : HWTIMER_TICKS_32K;
+    node->compare_f = compare_callback;
+    node->overflow_f = overflow_callback;
+    // the counter starts from 0 at boot, overflows which would have happened before are not delivered
+    node->overflows_delivered = get_ticks(node) / COUNTER_PERIOD;
+    node->timer_inited = true;
+    return SUCCESS;
+}
+
+const hwtimer_info_t* hw_timer_get_info(hwtimer_id_t timer_id)
+{
+    if(timer_id >= HWTIMER_NUM)
+        return NULL;
+
+    return &timer_info;
+}
+
+hwtimer_tick_t hw_timer_getvalue(hwtimer_id_t timer_id)
+{
+    if(timer_id >= HWTIMER_NUM || !current_node->timer_inited)
+        return 0;
+
+    return (hwtimer_tick_t)get_ticks(current_node);
+}
+
+error_t hw_timer_schedule(hwtimer_id_t timer_id, hwtimer_tick_t tick)
+{
+    sim_node_t* node = current_node;
+    if(timer_id >= HWTIMER_NUM)
+        return ESIZE;
+
+    if(!node->timer_inited)
+        return EOFF;
+
+    // a compare value equal to or lower than the current counter value only matches after the counter looped around
+    uint64_t ticks = get_ticks(node);
+    hwtimer_tick_t delay = tick - (hwtimer_tick_t)ticks;
+    node->compare_tick = ticks + (delay == 0 ? COUNTER_PERIOD : delay);
+    node->compare_pending = true;
+    return SUCCESS;
+}
+
+error_t hw_timer_cancel(hwtimer_id_t timer_id)
+{
+    if(timer_id >= HWTIMER_NUM)
+        return ESIZE;
+
+    if(!current_node->timer_inited)
+        return EOFF;
+
+    current_node->compare_pending = false;
+    return SUCCESS;
+}
+
+bool hw_timer_is_overflow_pending(hwtimer_id_t timer_id)
+{
+    sim_node_t* node = current_node;
+    return node->timer_inited && get_next_overflow_tick(node) <= get_ticks(node);
+}
+
+void hw_enter_lowpower_mode(uint8_t mode)
+{
+    sim_node_t* node = current_node;
+    while(true)
+    {
+        // interrupts which became due while the MCU was busy are delivered first, without sleeping
+        bool delivered = deliver_timer_interrupts(node);
+        delivered |= sim_radio_deliver(node);
+        if(delivered)
+            return;
+
+        uint64_t next = get_next_event(node);
+        if(next >= window_end)
+            sim_yield(); // the engine resumes the node in the window containing its next event
+        else if(next > node->now)
+            node->now = next;
+    }
+}
+
+static void advance(sim_node_t* node, uint64_t ns)
+{
+    // like on the hardware, the interrupts which expire during a busy wait are only handled once the MCU is idle
+    node->now += ns;
+    while(node->now >= window_end)
+    {
+        node->busy = true;
+        sim_yield();
+    }
+
+    node->busy = false;
+}
+
+void hw_busy_wait(int16_t microseconds)
+{
+    if(microseconds > 0)
+        advance(current_node, (uint64_t)microseconds * 1000);
+}
+
+uint64_t native_time_get_ticks(void)
+{
+    return get_ticks(current_node);
+}
+
+void native_time_advance(uint32_t ticks)
+{
+    advance(current_node, get_tick_time(current_node, ticks));
+}
+
+uint64_t native_sim_get_time(void)
+{
+    return current_node->now;
+}
+
+uint32_t native_sim_get_node_count(void)
+{
+    return node_count;
+}
+
+blockdevice_t* native_sim_get_blockdevice(uint8_t type)
+{
+    assert(type <= FS_BLOCKDEVICE_TYPE_VOLATILE);
+    return &current_node->bd[type].base;
+}
+
+uint64_t hw_get_unique_id(void)
+{
+    // the upper bytes make the ID easy to recognize, the lower ones depend on the seed
+    uint64_t hash = seed * UINT64_C(0x9E3779B97F4A7C15) + current_node->id;
+    hash = (hash ^ (hash >> 31)) * UINT64_C(0xBF58476D1CE4E5B9);
+    return ((uint64_t)(current_node->id + 1) << 32) | (uint32_t)(hash ^ (hash >> 29));
+}
+
+__attribute__((weak)) void native_sim_report(void)
+{
+}
+
+static inline bool is_earlier(sim_node_t* a, sim_node_t* b)
+{
+    return a->next_event < b->next_event || (a->next_event == b->next_event && a->id < b->id);
+}
+
+static void queue_swap(uint32_t a, uint32_t b)
+{
+    sim_node_t* node = queue[a];
+    queue[a] = queue[b];
+    queue[b] = node;
+    queue[a]->heap_index = a;
+    queue[b]->heap_index = b;
+}
+
+static void queue_sift(uint32_t index)
+{
+    while(index > 0 && is_earlier(queue[index], queue[(index - 1) / 2]))
+    {
+        queue_swap(index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+
+    while(true)
+    {
+        uint32_t earliest = index;
+        for(uint32_t child = 2 * index + 1; child <= 2 * index + 2 && child < queue_size; child++)
+            if(is_earlier(queue[child], queue[earliest]))
+                earliest = child;
+
+        if(earliest == index)
+            return;
+
+        queue_swap(index, earliest);
+        index = earliest;
+    }
+}
+
+static void queue_push(sim_node_t* node)
+{
+    node->next_event = get_next_event(node);
+    node->heap_index = queue_size;
+    queue[queue_size++] = node;
+    queue_sift(node->heap_index);
+}
+
+static sim_node_t* queue_pop(void)
+{
+    sim_node_t* node = queue[0];
+    queue_swap(0, --queue_size);
+    if(queue_size)
+        queue_sift(0);
+
+    node->heap_index = NOT_IN_QUEUE;
+    return node;
+}
+
+static void reschedule(sim_node_t* node)
+{
+    if(node->heap_index == NOT_IN_QUEUE)
+        return;
+
+    node->next_event = get_next_event(node);
+    queue_sift(node->heap_index);
+}
+
+static void node_main(void)
+{
+    current_node->busy = false;
+
+    //initialise the platform itself
+    __platform_init();
+    //do not initialise the scheduler, this is done by __framework_bootstrap()
+    __framework_bootstrap();
+    //initialise platform functionality that depends on the framework
+    __platform_post_framework_init();
+
+    scheduler_run();
+}
+
+static void run_nodes(sim_worker_t* worker)
+{
+    current_worker = worker;
+    for(uint32_t i = 0; i < window_count; i++)
+    {
+        sim_node_t* node = window_nodes[i];
+        if(node->id % worker_count != worker->index)
+            continue;
+
+        current_node = node;
+        set_node_global_id(node->id);
+        swapcontext(&worker->context, &node->context);
+    }
+}
+
+static void* worker_main(void* arg)
+{
+    sim_worker_t* worker = arg;
+    while(true)
+    {
+        sem_wait(&worker->start);
+        if(stopping)
+            return NULL;
+
+        run_nodes(worker);
+        sem_post(&workers_done);
+    }
+}
+
+static int compare_node_ids(const void* a, const void* b)
+{
+    uint32_t id_a = (*(sim_node_t* const*)a)->id;
+    uint32_t id_b = (*(sim_node_t* const*)b)->id;
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+static void init_blockdevice(blockdevice_ram_t* bd, const uint8_t* image, uint32_t size)
+{
+    bd->base.driver = &blockdevice_driver_ram;
+    bd->base.size = size;
+    bd->buffer = malloc(size);
+    assert(bd->buffer != NULL);
+    memcpy(bd->buffer, image, size);
+}
+
+static void init_node(sim_node_t* node, uint32_t id)
+{
+    memset(node, 0, sizeof(sim_node_t));
+    node->id = id;
+    node->rng = seed ^ ((uint64_t)id << 32);
+    node->busy = true; // runnable at time 0 to boot
+
+    init_blockdevice(&node->bd[FS_BLOCKDEVICE_TYPE_METADATA], d7ap_fs_metadata, METADATA_SIZE);
+    init_blockdevice(&node->bd[FS_BLOCKDEVICE_TYPE_PERMANENT], d7ap_files_data, FRAMEWORK_FS_PERMANENT_STORAGE_SIZE);
+    init_blockdevice(&node->bd[FS_BLOCKDEVICE_TYPE_VOLATILE], d7ap_volatile_files_data, FRAMEWORK_FS_VOLATILE_STORAGE_SIZE);
+    sim_radio_node_init(node);
+
+    node->stack = malloc(NODE_STACK_SIZE);
+    assert(node->stack != NULL);
+    getcontext(&node->context);
+    node->context.uc_stack.ss_sp = node->stack;
+    node->context.uc_stack.ss_size = NODE_STACK_SIZE;
+    node->context.uc_link = NULL;
+    makecontext(&node->context, node_main, 0);
+}
+
+static void place_nodes(void)
+{
+    if(positions_file != NULL)
+    {
+        FILE* file = fopen(positions_file, "r");
+        if(file == NULL)
+        {
+            perror(positions_file);
+            exit(EXIT_FAILURE);
+        }
+
+        for(uint32_t i = 0; i < node_count; i++)
+        {
+            if(fscanf(file, "%lf %lf", &nodes[i].x, &nodes[i].y) != 2)
+            {
+                fprintf(stderr, "%s: expected a position for %u nodes\n", positions_file, node_count);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        fclose(file);
+        return;
+    }
+
+    // node 0 in the center, typically the gateway, the others at random in a square area
+    for(uint32_t i = 1; i < node_count; i++)
+    {
+        nodes[i].x = (sim_random(&nodes[i]) >> 11) * 0x1.0p-53 * area - area / 2;
+        nodes[i].y = (sim_random(&nodes[i]) >> 11) * 0x1.0p-53 * area - area / 2;
+    }
+}
+
+static void usage(const char* name)
+{
+    printf("usage: %s [options]\n"
+           "  -n <nodes>     number of nodes, at most %u (default %u)\n"
+           "  -d <seconds>   simulated time (default %.0f)\n"
+           "  -s <seed>      seed for the placement of the nodes and the IDs (default %" PRIu64 ")\n"
+           "  -a <meters>    side of the square area in which the nodes are placed (default %.0f)\n"
+           "  -p <file>      read the positions of the nodes from a file instead, one 'x y' pair in meters per line\n"
+           "  -e <exponent>  path loss exponent (default %.1f)\n"
+           "  -c <dB>        minimum SINR to receive a byte (default %.1f)\n"
+           "  -j <threads>   number of worker threads (default %u)\n",
+           name, NODE_GLOBALS_MAX_NODES, node_count, duration, seed, area, sim_medium_config.path_loss_exponent,
+           sim_medium_config.min_sinr, worker_count);
+}
+
+static void parse_options(int argc, char** argv)
+{
+    int option;
+    while((option = getopt(argc, argv, "n:d:s:a:p:e:c:j:h")) != -1)
+    {
+        switch(option)
+        {
+            case 'n': node_count = strtoul(optarg, NULL, 0); break;
+            case 'd': duration = strtod(optarg, NULL); break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            case 'a': area = strtod(optarg, NULL); break;
+            case 'p': positions_file = optarg; break;
+            case 'e': sim_medium_config.path_loss_exponent = strtod(optarg, NULL); break;
+            case 'c': sim_medium_config.min_sinr = strtod(optarg, NULL); break;
+            case 'j': worker_count = strtoul(optarg, NULL, 0); break;
+            case 'h': usage(argv[0]); exit(EXIT_SUCCESS);
+            default: usage(argv[0]); exit(EXIT_FAILURE);
+        }
+    }
+
+    if(node_count == 0 || node_count > NODE_GLOBALS_MAX_NODES || worker_count == 0 || duration < 0)
+    {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    parse_options(argc, argv);
+
+    nodes = calloc(node_count, sizeof(sim_node_t));
+    queue = calloc(node_count, sizeof(sim_node_t*));
+    window_nodes = calloc(node_count, sizeof(sim_node_t*));
+    workers = calloc(worker_count, sizeof(sim_worker_t));
+    assert(nodes != NULL && queue != NULL && window_nodes != NULL && workers != NULL);
+
+    for(uint32_t i = 0; i < node_count; i++)
+        init_node(&nodes[i], i);
+
+    place_nodes();
+    for(uint32_t i = 0; i < node_count; i++)
+        queue_push(&nodes[i]);
+
+    sem_init(&workers_done, 0, 0);
+    for(uint32_t i = 0; i < worker_count; i++)
+    {
+        workers[i].index = i;
+        sem_init(&workers[i].start, 0, 0);
+        if(i > 0)
+            pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+
+    struct timespec wall_clock_start, wall_clock_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_clock_start);
+
+    uint64_t end_time = (uint64_t)(duration * SIM_NS_PER_SEC);
+    uint64_t windows = 0;
+    uint64_t node_runs = 0;
+    while(queue_size > 0 && queue[0]->next_event < end_time)
+    {
+        window_end = queue[0]->next_event + sim_medium_config.lookahead;
+        if(window_end > end_time)
+            window_end = end_time;
+
+        window_count = 0;
+        while(queue_size > 0 && queue[0]->next_event < window_end)
+            window_nodes[window_count++] = queue_pop();
+
+        qsort(window_nodes, window_count, sizeof(sim_node_t*), compare_node_ids);
+
+        for(uint32_t i = 1; i < worker_count; i++)
+            sem_post(&workers[i].start);
+
+        run_nodes(&workers[0]);
+        for(uint32_t i = 1; i < worker_count; i++)
+            sem_wait(&workers_done);
+
+        // serial phase, in node order
+        for(uint32_t i = 0; i < window_count; i++)
+            sim_medium_apply(window_nodes[i]);
+
+        for(uint32_t i = 0; i < window_count; i++)
+            queue_push(window_nodes[i]);
+
+        sim_medium_update_receivers(reschedule);
+        sim_medium_collect_garbage(queue_size > 0 ? queue[0]->next_event : end_time);
+
+        windows++;
+        node_runs += window_count;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_clock_end);
+    stopping = true;
+    for(uint32_t i = 1; i < worker_count; i++)
+    {
+        sem_post(&workers[i].start);
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    double wall_time = (wall_clock_end.tv_sec - wall_clock_start.tv_sec)
+                       + (wall_clock_end.tv_nsec - wall_clock_start.tv_nsec) / 1e9;
+    uint32_t transmissions, rx_packets = 0, rx_corrupted = 0;
+    uint64_t airtime;
+    sim_medium_get_stats(&transmissions, &airtime);
+    for(uint32_t i = 0; i < node_count; i++)
+    {
+        rx_packets += nodes[i].radio.stats_rx;
+        rx_corrupted += nodes[i].radio.stats_rx_corrupted;
+    }
+
+    printf("simulated %u nodes for %.1f s in %.2f s (%.1fx real time) using %u threads\n",
+           node_count, duration, wall_time, wall_time > 0 ? duration / wall_time : 0.0, worker_count);
+    printf("%" PRIu64 " windows, %.2f nodes per window\n", windows, windows ? (double)node_runs / windows : 0.0);
+    printf("medium: %u transmissions, %.3f s airtime\n", transmissions, airtime / 1e9);
+    printf("radios: %u packets received, of which %u corrupted\n", rx_packets, rx_corrupted);
+
+    current_node = NULL;
+    native_sim_report();
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file native_sim_node.h
+ *
+ * State of a simulated node, shared between the simulation engine (native_sim.c) and the simulated radio medium
+ * (native_sim_radio.c). Everything in here is owned by the node: it is only modified while the node runs, or by the
+ * engine in the serial phase between two windows, when no node runs.
+ */
+
+#ifndef __NATIVE_SIM_NODE_H_
+#define __NATIVE_SIM_NODE_H_
+
+#include <ucontext.h>
+
+#include "types.h"
+#include "hwradio.h"
+#include "hwtimer.h"
+#include "blockdevice_ram.h"
+
+#define SIM_NS_PER_SEC UINT64_C(1000000000)
+#define SIM_TIME_NEVER UINT64_MAX
+
+typedef struct sim_tx sim_tx_t;
+
+typedef enum {
+    SIM_RX_OFF,         // not receiving, or in RX without the packet handler (RSSI measurement)
+    SIM_RX_SEARCHING,   // waiting for a preamble followed by the sync word
+    SIM_RX_LOCKED,      // the sync word was detected, receiving the payload
+} sim_rx_stage_t;
+
+// operations of a node on the medium, applied in the serial phase after the window in which they were done
+typedef enum {
+    SIM_OP_TX_START,
+    SIM_OP_TX_APPEND,
+    SIM_OP_TX_END,
+} sim_op_type_t;
+
+typedef struct {
+    sim_op_type_t type;
+    uint64_t time;
+    uint32_t offset;    // bytes of TX_START and TX_APPEND, in the byte buffer of the outbox
+    uint32_t len;
+    uint32_t freq;      // TX_START only
+    uint32_t bitrate;
+    int8_t eirp;
+} sim_op_t;
+
+typedef struct {
+    hwradio_init_args_t callbacks;
+    hw_radio_state_t opmode;
+
+    uint32_t center_freq;
+    uint32_t rx_bw;                 // actual bandwidth of the receiver filter, in Hz
+    uint8_t rx_bw_number;           // index in the table of receiver startup times
+    uint16_t rx_bw_khz;
+    uint32_t bitrate;
+    int8_t eirp;
+    uint16_t preamble_size;
+    uint8_t preamble_detector_size;
+    uint16_t sync_word;             // the first byte on air is the most significant byte
+    uint16_t payload_length;        // 0 for unlimited length mode
+    uint8_t rssi_smoothing_full;
+    bool refill_enabled;
+    bool preloading_enabled;
+
+    sim_rx_stage_t rx_stage;
+    uint64_t rx_search_from;        // preambles starting before this time are not detected
+    sim_tx_t* rx_tx;                // the transmission the receiver (will) lock on
+    uint32_t rx_pos;                // index of the first payload byte in rx_tx
+    uint64_t rx_lock_time;
+    uint64_t rx_event_time;         // header or end of packet, while locked
+    bool rx_event_posted;
+    uint16_t rx_size;               // 0 while the length is not known yet
+    uint8_t rx_header[4];           // first bytes of a packet in unlimited length mode, as received
+    bool rx_corrupted;
+    hw_radio_packet_t* rx_packet;
+
+    bool tx_active;
+    bool tx_loaded;                 // bytes were preloaded, the TX starts on hw_radio_set_opmode(HW_STATE_TX)
+    uint64_t tx_start;
+    uint64_t tx_byte_ns;
+    uint32_t tx_total;              // bytes on air, including the preamble and sync word inserted by the radio
+    uint32_t tx_refilled_at;        // value of tx_total when the refill was signalled
+    uint8_t* tx_preload;
+    uint32_t tx_preload_len;
+    uint32_t tx_preload_capacity;
+
+    sim_tx_t* medium_tx;            // the record of the current transmission, only used in the serial phase
+    bool medium_listening;          // registered as receiver on the medium
+    uint32_t medium_index;          // position in the receiver registry while listening
+
+    sim_op_t* ops;
+    uint32_t ops_count;
+    uint32_t ops_capacity;
+    uint8_t* op_bytes;
+    uint32_t op_bytes_len;
+    uint32_t op_bytes_capacity;
+
+    uint32_t stats_tx;
+    uint32_t stats_rx;
+    uint32_t stats_rx_corrupted;
+} sim_radio_t;
+
+typedef struct {
+    uint32_t id;
+    double x;
+    double y;
+
+    uint64_t now;                   // local virtual time in ns
+    bool busy;                      // yielded during a busy wait
+    uint64_t rng;
+    ucontext_t context;
+    void* stack;
+
+    timer_callback_t compare_f;
+    timer_callback_t overflow_f;
+    bool timer_inited;
+    uint32_t ticks_per_sec;
+    uint64_t compare_tick;
+    bool compare_pending;
+    uint64_t overflows_delivered;
+
+    blockdevice_ram_t bd[3];
+
+    sim_radio_t radio;
+
+    uint64_t next_event;
+    uint32_t heap_index;
+} sim_node_t;
+
+typedef struct {
+    double path_loss_exponent;
+    double min_sinr;                // dB needed to detect and receive a byte
+    double noise_figure;
+    uint64_t lookahead;             // ns, every transmission is perceived this much later by the receivers
+} sim_medium_config_t;
+
+extern sim_medium_config_t sim_medium_config;
+
+// native_sim.c
+sim_node_t* sim_current_node(void);
+void sim_yield(void);
+uint64_t sim_random(sim_node_t* node);
+
+// native_sim_radio.c
+void sim_radio_node_init(sim_node_t* node);
+uint64_t sim_radio_get_next_event(sim_node_t* node);
+bool sim_radio_deliver(sim_node_t* node);
+void sim_medium_apply(sim_node_t* node);
+void sim_medium_update_receivers(void (*reschedule)(sim_node_t* node));
+void sim_medium_collect_garbage(uint64_t before);
+void sim_medium_get_stats(uint32_t* transmissions, uint64_t* airtime);
+
+#endif
@@ -0,0 +1,928 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file native_sim_radio.c
+ *
+ * Implementation of hwradio.h for the nodes of the network simulator, on top of a radio medium shared by all nodes.
+ *
+ * The medium carries byte streams: a transmission is the sequence of bytes a node puts on the air, including the
+ * preamble and sync word inserted by the radio, at the bitrate and on the center frequency it was started with.
+ * The received power follows a log-distance path loss model starting from the free space loss at 1 m. Every byte
+ * is received correctly when its power exceeds the thermal noise in the receiver bandwidth plus the power of all
+ * other transmissions overlapping it on the same frequency by at least the minimum SINR, otherwise it is corrupted.
+ * Channels on a different frequency do not interfere.
+ *
+ * Like the SX127x in FSK mode, a receiver locks on the first transmission in which it detects enough preamble
+ * bytes followed by its sync word, and stays locked on it until the packet was received, even when a stronger
+ * transmission starts in the meantime. The packet length is either fixed or, in unlimited length mode, taken from
+ * the first 4 bytes through the header callback. The callbacks are called from scheduler tasks, as on the SX127x.
+ *
+ * The nodes run in parallel within a window of virtual time and only read the medium while doing so. The
+ * transmissions they start, extend or abort are recorded in their outbox and applied to the medium in the serial
+ * phase after the window, in node order. Every transmission reaches the receivers the lookahead of the simulation
+ * later than it left the sender, which is never before the end of the window in which it was started, so each node
+ * sees a medium which is complete up to the end of the window it runs in.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hwradio.h"
+#include "hwsystem.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "debug.h"
+#include "errors.h"
+#include "native_sim_node.h"
+
+#define SPEED_OF_LIGHT 299792458.0
+#define GC_MARGIN (SIM_NS_PER_SEC)  // keep ended transmissions for a while, they may still overlap bytes of interest
+
+typedef struct {
+    uint32_t pos;   // index of the first byte of a sync word
+    uint8_t run;    // number of preamble bytes preceding it
+} sim_candidate_t;
+
+struct sim_tx {
+    sim_node_t* sender;
+    uint32_t freq;
+    uint32_t bitrate;
+    double power_1m;        // dBm at 1 m from the sender
+    uint64_t start;         // time at which the first byte starts at the receivers
+    uint64_t end;           // SIM_TIME_NEVER until the transmission was ended
+    uint64_t byte_ns;
+    uint8_t* bytes;
+    uint32_t len;
+    uint32_t capacity;
+    uint32_t scanned;       // the bytes up to here were scanned for sync word candidates
+    sim_candidate_t* candidates;
+    uint32_t candidates_count;
+    uint32_t candidates_capacity;
+    sim_tx_t* next;
+};
+
+sim_medium_config_t sim_medium_config = {
+    .path_loss_exponent = 3.0,
+    .min_sinr = 10.0,
+    .noise_figure = 6.0,
+    .lookahead = 100000,
+};
+
+// the medium is only modified in the serial phase, the nodes only read it
+static sim_tx_t* medium = NULL;
+static sim_node_t** receivers = NULL;
+static uint32_t receivers_count = 0;
+static uint32_t receivers_capacity = 0;
+static uint32_t* changed_freqs = NULL;
+static uint32_t changed_freqs_count = 0;
+static uint32_t changed_freqs_capacity = 0;
+static uint32_t total_transmissions = 0;
+static uint64_t total_airtime = 0;
+
+// startup time of the receiver in us for each bandwidth setting, see sx127x.c
+static const uint16_t rx_bw_startup_time[21] = {66, 78, 89, 105, 88, 126, 125, 151, 177, 226, 277, 329, 427, 529, 631, 831, 1033, 1239, 1638, 2037, 2447};
+
+static void rx_header_task(void* arg);
+static void rx_end_task(void* arg);
+static void tx_refill_task(void* arg);
+static void tx_done_task(void* arg);
+static void rx_timeout_task(void* arg);
+
+static void* grow(void* buffer, uint32_t* capacity, uint32_t needed, size_t element_size)
+{
+    if(needed <= *capacity)
+        return buffer;
+
+    uint32_t new_capacity = *capacity ? *capacity : 16;
+    while(new_capacity < needed)
+        new_capacity *= 2;
+
+    buffer = realloc(buffer, new_capacity * element_size);
+    assert(buffer != NULL);
+    *capacity = new_capacity;
+    return buffer;
+}
+
+static inline uint64_t get_active_end(const sim_tx_t* tx)
+{
+    uint64_t end = tx->start + tx->len * tx->byte_ns;
+    return tx->end < end ? tx->end : end;
+}
+
+static double get_rx_power(const sim_tx_t* tx, const sim_node_t* node)
+{
+    double dx = tx->sender->x - node->x;
+    double dy = tx->sender->y - node->y;
+    double distance = sqrt(dx * dx + dy * dy);
+    if(distance < 1.0)
+        distance = 1.0;
+
+    return tx->power_1m - 10.0 * sim_medium_config.path_loss_exponent * log10(distance);
+}
+
+static double get_noise_mw(const sim_node_t* node)
+{
+    return pow(10.0, (-174.0 + 10.0 * log10((double)node->radio.rx_bw) + sim_medium_config.noise_figure) / 10.0);
+}
+
+// total power in mW of the noise and all transmissions overlapping [from, to), except the wanted one and our own
+static double get_interference_mw(const sim_node_t* node, const sim_tx_t* wanted, uint64_t from, uint64_t to)
+{
+    double total = get_noise_mw(node);
+    for(const sim_tx_t* tx = medium; tx != NULL; tx = tx->next)
+    {
+        if(tx == wanted || tx->sender == node || tx->freq != node->radio.center_freq)
+            continue;
+
+        if(tx->start < to && get_active_end(tx) > from)
+            total += pow(10.0, get_rx_power(tx, node) / 10.0);
+    }
+
+    return total;
+}
+
+static bool is_byte_received(const sim_node_t* node, const sim_tx_t* tx, uint32_t index)
+{
+    uint64_t from = tx->start + index * tx->byte_ns;
+    uint64_t to = from + tx->byte_ns;
+    if(index >= tx->len || to > get_active_end(tx))
+        return false;
+
+    double sinr = get_rx_power(tx, node) - 10.0 * log10(get_interference_mw(node, tx, from, to));
+    return sinr >= sim_medium_config.min_sinr;
+}
+
+static int16_t get_current_rssi(sim_node_t* node)
+{
+    double total = get_interference_mw(node, NULL, node->now, node->now + 1);
+    double rssi = floor(10.0 * log10(total));
+    if(rssi < -127)
+        return -127;
+
+    return rssi > 0 ? 0 : (int16_t)rssi;
+}
+
+// the bytes of the locked transmission as received, corrupted ones are replaced by random values
+static void read_bytes(sim_node_t* node, uint32_t from, uint32_t len, uint8_t* buffer)
+{
+    sim_radio_t* radio = &node->radio;
+    for(uint32_t i = 0; i < len; i++)
+    {
+        uint32_t index = from + i;
+        if(is_byte_received(node, radio->rx_tx, index))
+        {
+            buffer[i] = radio->rx_tx->bytes[index];
+            continue;
+        }
+
+        uint8_t noise = (uint8_t)sim_random(node);
+        if(index < radio->rx_tx->len)
+            buffer[i] = radio->rx_tx->bytes[index] ^ (noise ? noise : 0xFF);
+        else
+            buffer[i] = noise;
+
+        radio->rx_corrupted = true;
+    }
+}
+
+// look for the first sync word detected on or after rx_search_from
+static void find_lock(sim_node_t* node)
+{
+    sim_radio_t* radio = &node->radio;
+    uint8_t needed = radio->preamble_detector_size ? radio->preamble_detector_size : 1;
+    uint8_t sync[2] = { radio->sync_word >> 8, radio->sync_word & 0xFF };
+
+    radio->rx_tx = NULL;
+    radio->rx_lock_time = SIM_TIME_NEVER;
+    for(sim_tx_t* tx = medium; tx != NULL; tx = tx->next)
+    {
+        if(tx->sender == node || tx->freq != radio->center_freq || tx->bitrate != radio->bitrate)
+            continue;
+
+        for(uint32_t i = 0; i < tx->candidates_count; i++)
+        {
+            sim_candidate_t* candidate = &tx->candidates[i];
+            uint64_t lock_time = tx->start + (candidate->pos + 2) * tx->byte_ns;
+            if(lock_time >= radio->rx_lock_time)
+                break; // the candidates are sorted
+
+            if(candidate->run < needed || candidate->pos + 2 > tx->len || lock_time > get_active_end(tx)
+               || tx->start + (candidate->pos - needed) * tx->byte_ns < radio->rx_search_from)
+                continue;
+
+            if(tx->bytes[candidate->pos] != sync[0] || tx->bytes[candidate->pos + 1] != sync[1])
+                continue;
+
+            bool detected = true;
+            for(uint32_t index = candidate->pos - needed; index < candidate->pos + 2 && detected; index++)
+                detected = is_byte_received(node, tx, index);
+
+            if(!detected)
+                continue;
+
+            radio->rx_tx = tx;
+            radio->rx_pos = candidate->pos + 2;
+            radio->rx_lock_time = lock_time;
+            break;
+        }
+    }
+}
+
+static void start_search(sim_node_t* node)
+{
+    sim_radio_t* radio = &node->radio;
+    radio->rx_stage = SIM_RX_SEARCHING;
+    radio->rx_search_from = node->now;
+    radio->rx_size = 0;
+    radio->rx_packet = NULL;
+    radio->rx_event_posted = false;
+    find_lock(node);
+}
+
+static void stop_rx(sim_node_t* node)
+{
+    sim_radio_t* radio = &node->radio;
+    if(radio->rx_packet != NULL)
+        radio->callbacks.release_packet_cb(radio->rx_packet);
+
+    radio->rx_stage = SIM_RX_OFF;
+    radio->rx_tx = NULL;
+    radio->rx_packet = NULL;
+    radio->rx_event_posted = false;
+}
+
+static sim_op_t* add_op(sim_radio_t* radio, sim_op_type_t type, uint64_t time, const uint8_t* data, uint32_t len)
+{
+    radio->ops = grow(radio->ops, &radio->ops_capacity, radio->ops_count + 1, sizeof(sim_op_t));
+    sim_op_t* op = &radio->ops[radio->ops_count++];
+    *op = (sim_op_t){ .type = type, .time = time, .offset = radio->op_bytes_len, .len = len };
+
+    radio->op_bytes = grow(radio->op_bytes, &radio->op_bytes_capacity, radio->op_bytes_len + len, 1);
+    if(len)
+        memcpy(radio->op_bytes + radio->op_bytes_len, data, len);
+
+    radio->op_bytes_len += len;
+    return op;
+}
+
+static inline uint64_t get_tx_end_time(sim_radio_t* radio)
+{
+    return radio->tx_start + radio->tx_total * radio->tx_byte_ns;
+}
+
+static void start_tx(sim_node_t* node)
+{
+    sim_radio_t* radio = &node->radio;
+    uint8_t header[radio->preamble_size + 2];
+    memset(header, 0xAA, radio->preamble_size);
+    header[radio->preamble_size] = radio->sync_word >> 8;
+    header[radio->preamble_size + 1] = radio->sync_word & 0xFF;
+
+    radio->opmode = HW_STATE_TX;
+    radio->tx_active = true;
+    radio->tx_loaded = false;
+    radio->tx_start = node->now;
+    radio->tx_byte_ns = 8 * SIM_NS_PER_SEC / radio->bitrate;
+    radio->tx_total = sizeof(header) + radio->tx_preload_len;
+    radio->tx_refilled_at = 0;
+
+    sim_op_t* op = add_op(radio, SIM_OP_TX_START, node->now, header, sizeof(header));
+    op->freq = radio->center_freq;
+    op->bitrate = radio->bitrate;
+    op->eirp = radio->eirp;
+    op->len += radio->tx_preload_len;
+    radio->op_bytes = grow(radio->op_bytes, &radio->op_bytes_capacity, radio->op_bytes_len + radio->tx_preload_len, 1);
+    memcpy(radio->op_bytes + radio->op_bytes_len, radio->tx_preload, radio->tx_preload_len);
+    radio->op_bytes_len += radio->tx_preload_len;
+    radio->tx_preload_len = 0;
+    radio->stats_tx++;
+}
+
+static void stop_tx(sim_node_t* node, uint64_t time)
+{
+    sim_radio_t* radio = &node->radio;
+    if(!radio->tx_active)
+        return;
+
+    add_op(radio, SIM_OP_TX_END, time, NULL, 0);
+    radio->tx_active = false;
+}
+
+// handle the TX events which are due, these are not delayed by the scheduler like the interrupts on the hardware
+static bool deliver_tx(sim_node_t* node)
+{
+    sim_radio_t* radio = &node->radio;
+    if(!radio->tx_active)
+        return false;
+
+    uint32_t refill_at = radio->tx_total > 2 ? radio->tx_total - 2 : 0;
+    if(radio->refill_enabled && radio->tx_refilled_at != radio->tx_total
+       && radio->tx_start + refill_at * radio->tx_byte_ns <= node->now)
+    {
+        radio->tx_refilled_at = radio->tx_total;
+        sched_post_task(&tx_refill_task);
+        return true;
+    }
+
+    if(get_tx_end_time(radio) <= node->now)
+    {
+        stop_tx(node, get_tx_end_time(radio));
+        radio->opmode = HW_STATE_STANDBY;
+        sched_post_task(&tx_done_task);
+        return true;
+    }
+
+    return false;
+}
+
+void sim_radio_node_init(sim_node_t* node)
+{
+    memset(&node->radio, 0, sizeof(sim_radio_t));
+    node->radio.opmode = HW_STATE_SLEEP;
+    node->radio.center_freq = 868000000;
+    node->radio.bitrate = 55555;
+    node->radio.rx_bw = 125000;
+    node->radio.rx_bw_khz = 125;
+}
+
+uint64_t sim_radio_get_next_event(sim_node_t* node)
+{
+    sim_radio_t* radio = &node->radio;
+    uint64_t next = SIM_TIME_NEVER;
+    if(radio->rx_stage == SIM_RX_SEARCHING && radio->rx_tx != NULL)
+        next = radio->rx_lock_time;
+    else if(radio->rx_stage == SIM_RX_LOCKED && !radio->rx_event_posted)
+        next = radio->rx_event_time;
+
+    if(radio->tx_active)
+    {
+        uint64_t end = get_tx_end_time(radio);
+        if(end < next)
+            next = end;
+
+        if(radio->refill_enabled && radio->tx_refilled_at != radio->tx_total)
+        {
+            uint64_t refill = radio->tx_start + (radio->tx_total > 2 ? radio->tx_total - 2 : 0) * radio->tx_byte_ns;
+            if(refill < next)
+                next = refill;
+        }
+    }
+
+    return next;
+}
+
+bool sim_radio_deliver(sim_node_t* node)
+{
+    sim_radio_t* radio = &node->radio;
+    if(deliver_tx(node))
+        return true;
+
+    if(radio->rx_stage == SIM_RX_SEARCHING && radio->rx_tx != NULL && radio->rx_lock_time <= node->now)
+    {
+        sim_tx_t* tx = radio->rx_tx;
+        radio->rx_stage = SIM_RX_LOCKED;
+        radio->rx_size = radio->payload_length;
+        radio->rx_corrupted = false;
+        radio->rx_event_posted = false;
+        // in unlimited length mode the header is needed first to know the length
+        radio->rx_event_time = tx->start + (radio->rx_pos + (radio->rx_size ? radio->rx_size : 4)) * tx->byte_ns;
+        return true;
+    }
+
+    if(radio->rx_stage == SIM_RX_LOCKED && !radio->rx_event_posted && radio->rx_event_time <= node->now)
+    {
+        radio->rx_event_posted = true;
+        if(radio->rx_size == 0)
+            sched_post_task(&rx_header_task);
+        else
+            sched_post_task(&rx_end_task);
+
+        return true;
+    }
+
+    return false;
+}
+
+static void rx_header_task(void* arg)
+{
+    sim_node_t* node = sim_current_node();
+    sim_radio_t* radio = &node->radio;
+    if(radio->rx_stage != SIM_RX_LOCKED || radio->rx_size != 0 || !radio->rx_event_posted)
+        return;
+
+    uint8_t buffer[4];
+    read_bytes(node, radio->rx_pos, sizeof(buffer), radio->rx_header);
+    memcpy(buffer, radio->rx_header, sizeof(buffer));
+    int16_t rssi = get_current_rssi(node);
+
+    radio->callbacks.rx_packet_header_cb(buffer, sizeof(buffer));
+    if(radio->payload_length == 0)
+    {
+        start_search(node);
+        return;
+    }
+
+    hw_radio_packet_t* packet = radio->callbacks.alloc_packet_cb(radio->payload_length);
+    if(packet == NULL)
+    {
+        radio->payload_length = 0;
+        start_search(node);
+        return;
+    }
+
+    packet->rx_meta.rssi = rssi;
+    memcpy(packet->data, radio->rx_header, sizeof(radio->rx_header));
+    packet->length = radio->payload_length;
+
+    radio->rx_packet = packet;
+    radio->rx_size = radio->payload_length;
+    radio->rx_event_time = radio->rx_tx->start + (radio->rx_pos + radio->rx_size) * radio->rx_tx->byte_ns;
+    radio->rx_event_posted = false;
+}
+
+static void rx_end_task(void* arg)
+{
+    sim_node_t* node = sim_current_node();
+    sim_radio_t* radio = &node->radio;
+    if(radio->rx_stage != SIM_RX_LOCKED || radio->rx_size == 0 || !radio->rx_event_posted)
+        return;
+
+    hw_radio_packet_t* packet = radio->rx_packet;
+    if(packet == NULL)
+    {
+        // fixed length mode
+        packet = radio->callbacks.alloc_packet_cb(radio->rx_size);
+        if(packet == NULL)
+        {
+            start_search(node);
+            return;
+        }
+
+        packet->length = radio->rx_size;
+        read_bytes(node, radio->rx_pos, radio->rx_size, packet->data);
+        packet->rx_meta.rssi = get_current_rssi(node);
+    }
+    else
+    {
+        read_bytes(node, radio->rx_pos + sizeof(radio->rx_header), radio->rx_size - sizeof(radio->rx_header),
+                   packet->data + sizeof(radio->rx_header));
+    }
+
+    packet->rx_meta.timestamp = timer_get_counter_value();
+    packet->rx_meta.crc_status = HW_CRC_UNAVAILABLE;
+    packet->rx_meta.lqi = 0;
+
+    radio->stats_rx++;
+    if(radio->rx_corrupted)
+        radio->stats_rx_corrupted++;
+
+    // restart the reception before handing over the packet, as the SX127x driver does
+    if(radio->rx_packet != NULL)
+        radio->payload_length = 0;
+
+    radio->rx_packet = NULL;
+    start_search(node);
+    radio->callbacks.rx_packet_cb(packet);
+}
+
+static void tx_refill_task(void* arg)
+{
+    sim_node_t* node = sim_current_node();
+    sim_radio_t* radio = &node->radio;
+    if(!radio->tx_active || !radio->refill_enabled || radio->callbacks.tx_refill_cb == NULL)
+        return;
+
+    uint64_t elapsed = (node->now - radio->tx_start) / radio->tx_byte_ns;
+    radio->callbacks.tx_refill_cb(elapsed < radio->tx_total ? radio->tx_total - elapsed : 0);
+}
+
+static void tx_done_task(void* arg)
+{
+    sim_radio_t* radio = &sim_current_node()->radio;
+    hw_busy_wait(110);
+    if(radio->callbacks.tx_packet_cb)
+        radio->callbacks.tx_packet_cb(timer_get_counter_value());
+}
+
+static void rx_timeout_task(void* arg)
+{
+    hw_radio_set_idle();
+}
+
+error_t hw_radio_init(hwradio_init_args_t* init_args)
+{
+    sim_radio_t* radio = &sim_current_node()->radio;
+    radio->callbacks = *init_args;
+
+    sched_register_task(&rx_header_task);
+    sched_register_task(&rx_end_task);
+    sched_register_task(&tx_refill_task);
+    sched_register_task(&tx_done_task);
+    sched_register_task(&rx_timeout_task);
+
+    hw_radio_set_idle();
+    return SUCCESS;
+}
+
+void hw_radio_stop(void)
+{
+    hw_radio_set_idle();
+}
+
+error_t hw_radio_set_idle(void)
+{
+    hw_radio_set_opmode(HW_STATE_SLEEP);
+    sched_cancel_task(&rx_header_task);
+    sched_cancel_task(&rx_end_task);
+    sched_cancel_task(&tx_refill_task);
+    sched_cancel_task(&tx_done_task);
+    timer_cancel_task(&rx_timeout_task);
+    return SUCCESS;
+}
+
+bool hw_radio_is_idle(void)
+{
+    return sim_current_node()->radio.opmode == HW_STATE_SLEEP;
+}
+
+bool hw_radio_is_rx(void)
+{
+    return sim_current_node()->radio.opmode == HW_STATE_RX;
+}
+
+hw_radio_state_t hw_radio_get_opmode(void)
+{
+    return sim_current_node()->radio.opmode;
+}
+
+void hw_radio_set_opmode(hw_radio_state_t opmode)
+{
+    sim_node_t* node = sim_current_node();
+    sim_radio_t* radio = &node->radio;
+    deliver_tx(node);
+    switch(opmode)
+    {
+        case HW_STATE_TX:
+            if(!radio->tx_active && radio->tx_loaded)
+                start_tx(node);
+
+            radio->opmode = HW_STATE_TX;
+            break;
+        case HW_STATE_IDLE:
+        case HW_STATE_RX:
+        case HW_STATE_RESET:
+            stop_tx(node, node->now);
+            stop_rx(node);
+            radio->opmode = HW_STATE_RX;
+            start_search(node);
+            break;
+        case HW_STATE_STANDBY:
+            stop_tx(node, node->now);
+            stop_rx(node);
+            radio->opmode = HW_STATE_STANDBY;
+            break;
+        case HW_STATE_OFF:
+        case HW_STATE_SLEEP:
+            stop_tx(node, node->now);
+            stop_rx(node);
+            radio->tx_loaded = false;
+            radio->tx_preload_len = 0;
+            radio->opmode = HW_STATE_SLEEP;
+            break;
+    }
+}
+
+error_t hw_radio_send_payload(uint8_t* data, uint16_t len)
+{
+    sim_node_t* node = sim_current_node();
+    sim_radio_t* radio = &node->radio;
+    if(len == 0)
+        return ESIZE;
+
+    deliver_tx(node);
+    if(radio->tx_active)
+    {
+        // refilling the FIFO during the transmission
+        add_op(radio, SIM_OP_TX_APPEND, node->now, data, len);
+        radio->tx_total += len;
+        radio->preloading_enabled = false;
+        return SUCCESS;
+    }
+
+    stop_rx(node);
+    radio->opmode = HW_STATE_STANDBY;
+    radio->tx_preload = grow(radio->tx_preload, &radio->tx_preload_capacity, radio->tx_preload_len + len, 1);
+    memcpy(radio->tx_preload + radio->tx_preload_len, data, len);
+    radio->tx_preload_len += len;
+    radio->tx_loaded = true;
+
+    if(!radio->preloading_enabled)
+        start_tx(node);
+    else
+        radio->preloading_enabled = false;
+
+    return SUCCESS;
+}
+
+int16_t hw_radio_get_rssi(void)
+{
+    sim_node_t* node = sim_current_node();
+    sim_radio_t* radio = &node->radio;
+    stop_tx(node, node->now);
+    stop_rx(node);
+    radio->opmode = HW_STATE_RX;
+    hw_busy_wait(rx_bw_startup_time[radio->rx_bw_number] + (radio->rssi_smoothing_full * 1000) / (4 * radio->rx_bw_khz));
+    return get_current_rssi(node);
+}
+
+// a changed channel or sync word is only used by the packet handler after a restart of the receiver
+static void restart_search_if_rx(sim_node_t* node)
+{
+    if(node->radio.rx_stage != SIM_RX_OFF)
+    {
+        stop_rx(node);
+        start_search(node);
+    }
+}
+
+void hw_radio_set_center_freq(uint32_t center_freq)
+{
+    sim_node_t* node = sim_current_node();
+    node->radio.center_freq = center_freq;
+    restart_search_if_rx(node);
+}
+
+void hw_radio_set_rx_bw_hz(uint32_t bw_hz)
+{
+    sim_radio_t* radio = &sim_current_node()->radio;
+    uint32_t min_bw_diff = UINT32_MAX;
+
+    // the closest bandwidth supported by the SX127x
+    for(uint8_t exp = 1; exp < 8; exp++)
+    {
+        for(uint8_t mant = 16; mant <= 24; mant += 4)
+        {
+            uint32_t computed_bw = 32000000 / (mant * (1 << (exp + 2)));
+            uint32_t diff = computed_bw > bw_hz ? computed_bw - bw_hz : bw_hz - computed_bw;
+            if(diff < min_bw_diff)
+            {
+                min_bw_diff = diff;
+                radio->rx_bw = computed_bw;
+                radio->rx_bw_number = (exp - 1) * 3 + (mant - 16) / 4;
+                radio->rx_bw_khz = computed_bw / 1000;
+            }
+        }
+    }
+}
+
+void hw_radio_set_bitrate(uint32_t bps)
+{
+    sim_node_t* node = sim_current_node();
+    node->radio.bitrate = bps;
+    restart_search_if_rx(node);
+}
+
+void hw_radio_set_tx_fdev(uint32_t fdev) {}
+
+void hw_radio_set_preamble_size(uint16_t size)
+{
+    sim_current_node()->radio.preamble_size = size;
+}
+
+void hw_radio_set_preamble_detector(uint8_t preamble_detector_size, uint8_t preamble_tol)
+{
+    sim_current_node()->radio.preamble_detector_size = preamble_detector_size;
+}
+
+void hw_radio_set_rssi_config(uint8_t rssi_smoothing, uint8_t rssi_offset)
+{
+    sim_current_node()->radio.rssi_smoothing_full = 2 << rssi_smoothing;
+}
+
+// nothing to precompute, the simulated radio uses the settings as they are
+void hw_radio_prepare_channel_config(hw_radio_channel_config_t* config) {}
+
+void hw_radio_apply_channel_config(const hw_radio_channel_config_t* config)
+{
+    sim_node_t* node = sim_current_node();
+    hw_radio_set_rx_bw_hz(config->rx_bw_hz);
+    node->radio.bitrate = config->bitrate;
+    node->radio.preamble_size = config->preamble_size;
+    node->radio.preamble_detector_size = config->preamble_detector_size;
+    node->radio.center_freq = config->center_freq;
+    restart_search_if_rx(node);
+}
+
+void hw_radio_set_dc_free(uint8_t scheme) {}
+
+void hw_radio_set_sync_word(uint8_t* sync_word, uint8_t sync_size)
+{
+    sim_node_t* node = sim_current_node();
+    node->radio.sync_word = sync_word[0];
+    if(sync_size > 1)
+        node->radio.sync_word |= ((uint16_t)sync_word[1]) << 8;
+
+    restart_search_if_rx(node);
+}
+
+void hw_radio_set_crc_on(uint8_t enable) {}
+
+void hw_radio_set_payload_length(uint16_t length)
+{
+    sim_current_node()->radio.payload_length = length;
+}
+
+void hw_radio_enable_refill(bool enable)
+{
+    sim_current_node()->radio.refill_enabled = enable;
+}
+
+void hw_radio_enable_preloading(bool enable)
+{
+    sim_current_node()->radio.preloading_enabled = enable;
+}
+
+void hw_radio_set_tx_power(int8_t eirp)
+{
+    sim_current_node()->radio.eirp = eirp;
+}
+
+void hw_radio_set_rx_timeout(uint32_t timeout)
+{
+    timer_post_task_delay(&rx_timeout_task, timeout);
+}
+
+static void scan_candidates(sim_tx_t* tx)
+{
+    uint32_t i = tx->scanned > 1 ? tx->scanned : 1;
+    for(; i + 1 < tx->len; i++)
+    {
+        if(tx->bytes[i - 1] != 0xAA || tx->bytes[i] == 0xAA)
+            continue;
+
+        uint32_t run = 0;
+        while(run < i && run < UINT8_MAX && tx->bytes[i - 1 - run] == 0xAA)
+            run++;
+
+        tx->candidates = grow(tx->candidates, &tx->candidates_capacity, tx->candidates_count + 1, sizeof(sim_candidate_t));
+        tx->candidates[tx->candidates_count++] = (sim_candidate_t){ .pos = i, .run = run };
+    }
+
+    tx->scanned = i;
+}
+
+static void append_bytes(sim_tx_t* tx, const uint8_t* data, uint32_t len)
+{
+    tx->bytes = grow(tx->bytes, &tx->capacity, tx->len + len, 1);
+    memcpy(tx->bytes + tx->len, data, len);
+    tx->len += len;
+    scan_candidates(tx);
+}
+
+static void mark_changed(uint32_t freq)
+{
+    for(uint32_t i = 0; i < changed_freqs_count; i++)
+        if(changed_freqs[i] == freq)
+            return;
+
+    changed_freqs = grow(changed_freqs, &changed_freqs_capacity, changed_freqs_count + 1, sizeof(uint32_t));
+    changed_freqs[changed_freqs_count++] = freq;
+}
+
+void sim_medium_apply(sim_node_t* node)
+{
+    sim_radio_t* radio = &node->radio;
+    for(uint32_t i = 0; i < radio->ops_count; i++)
+    {
+        sim_op_t* op = &radio->ops[i];
+        uint8_t* data = radio->op_bytes + op->offset;
+        sim_tx_t* tx = radio->medium_tx;
+        switch(op->type)
+        {
+            case SIM_OP_TX_START:
+                tx = calloc(1, sizeof(sim_tx_t));
+                assert(tx != NULL);
+                tx->sender = node;
+                tx->freq = op->freq;
+                tx->bitrate = op->bitrate;
+                tx->power_1m = op->eirp - 20.0 * log10(4.0 * M_PI * op->freq / SPEED_OF_LIGHT);
+                tx->start = op->time + sim_medium_config.lookahead;
+                tx->end = SIM_TIME_NEVER;
+                tx->byte_ns = 8 * SIM_NS_PER_SEC / op->bitrate;
+                append_bytes(tx, data, op->len);
+                tx->next = medium;
+                medium = tx;
+                radio->medium_tx = tx;
+                total_transmissions++;
+                break;
+            case SIM_OP_TX_APPEND:
+                assert(tx != NULL);
+                append_bytes(tx, data, op->len);
+                break;
+            case SIM_OP_TX_END:
+                assert(tx != NULL);
+                tx->end = op->time + sim_medium_config.lookahead;
+                total_airtime += tx->end - tx->start;
+                radio->medium_tx = NULL;
+                break;
+        }
+
+        mark_changed(tx->freq);
+    }
+
+    radio->ops_count = 0;
+    radio->op_bytes_len = 0;
+
+    bool listening = radio->rx_stage != SIM_RX_OFF;
+    if(listening && !radio->medium_listening)
+    {
+        receivers = grow(receivers, &receivers_capacity, receivers_count + 1, sizeof(sim_node_t*));
+        radio->medium_index = receivers_count;
+        receivers[receivers_count++] = node;
+    }
+    else if(!listening && radio->medium_listening)
+    {
+        receivers[radio->medium_index] = receivers[--receivers_count];
+        receivers[radio->medium_index]->radio.medium_index = radio->medium_index;
+    }
+
+    radio->medium_listening = listening;
+}
+
+void sim_medium_update_receivers(void (*reschedule)(sim_node_t* node))
+{
+    if(changed_freqs_count == 0)
+        return;
+
+    for(uint32_t i = 0; i < receivers_count; i++)
+    {
+        sim_node_t* node = receivers[i];
+        if(node->radio.rx_stage != SIM_RX_SEARCHING)
+            continue;
+
+        for(uint32_t j = 0; j < changed_freqs_count; j++)
+        {
+            if(changed_freqs[j] == node->radio.center_freq)
+            {
+                find_lock(node);
+                reschedule(node);
+                break;
+            }
+        }
+    }
+
+    changed_freqs_count = 0;
+}
+
+void sim_medium_collect_garbage(uint64_t before)
+{
+    // the bytes of a locked transmission are read until the end of the packet, including the interference on them
+    for(uint32_t i = 0; i < receivers_count; i++)
+    {
+        sim_tx_t* tx = receivers[i]->radio.rx_tx;
+        if(tx != NULL && tx->start < before)
+            before = tx->start;
+    }
+
+    if(before < GC_MARGIN)
+        return;
+
+    before -= GC_MARGIN;
+    sim_tx_t** link = &medium;
+    while(*link != NULL)
+    {
+        sim_tx_t* tx = *link;
+        if(tx->end != SIM_TIME_NEVER && tx->end < before)
+        {
+            *link = tx->next;
+            free(tx->bytes);
+            free(tx->candidates);
+            free(tx);
+        }
+        else
+            link = &tx->next;
+    }
+}
+
+void sim_medium_get_stats(uint32_t* transmissions, uint64_t* airtime)
+{
+    *transmissions = total_transmissions;
+    *airtime = total_airtime;
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file native_timer.c
+ *
+ * Discrete-event implementation of the hardware timer on NATIVE. The timer counts virtual time instead of wall
+ * clock time: hw_enter_lowpower_mode() jumps straight to the next compare or overflow of the timer and calls its
+ * callback, as if the interrupt woke up the MCU. This way the complete stack runs as fast as the host can execute
+ * the tasks, while all timeouts still expire in the correct order and at the correct tick.
+ *
+ * With PLATFORM_NATIVE_REALTIME the virtual time is paced to the wall clock instead, which is useful when the
+ * process interacts with the outside world.
+ *
+ * Since nothing but the timer can wake up the MCU, a node without any timer event scheduled for a complete
+ * framework timer period (2^32 ticks) will never do anything again, in that case the process exits.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hwtimer.h"
+#include "hwsystem.h"
+#include "errors.h"
+#include "platform_defs.h"
+#include "native_time.h"
+#include "blockdevice_mmap.h"
+
+#define HWTIMER_NUM 1
+#define COUNTER_PERIOD (UINT64_C(1) << (8 * sizeof(hwtimer_tick_t)))
+#define IDLE_OVERFLOWS_BEFORE_EXIT (UINT32_C(1) << (32 - 8 * sizeof(hwtimer_tick_t)))
+
+static const hwtimer_info_t timer_info = {
+  .min_delay_ticks = 1,
+};
+
+static timer_callback_t compare_f = 0x0;
+static timer_callback_t overflow_f = 0x0;
+static bool timer_inited = false;
+static uint32_t ticks_per_sec;
+
+static uint64_t virtual_time = 0;
+static uint64_t overflows_delivered = 0;
+static uint64_t compare_time;
+static bool compare_pending = false;
+static uint32_t idle_overflows = 0;
+
+#ifdef PLATFORM_NATIVE_REALTIME
+static struct timespec wall_clock_start;
+
+static void wait_for_wall_clock(uint64_t ticks)
+{
+    uint64_t ns = ticks * UINT64_C(1000000000) / ticks_per_sec;
+    struct timespec until = {
+        .tv_sec = wall_clock_start.tv_sec + ns / UINT64_C(1000000000),
+        .tv_nsec = wall_clock_start.tv_nsec + ns % UINT64_C(1000000000)
+    };
+    if(until.tv_nsec >= 1000000000)
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) != 0);
+}
+#endif
+
+static inline uint64_t get_next_overflow_time()
+{
+    return (overflows_delivered + 1) * COUNTER_PERIOD;
+}
+
+// call the callbacks of the interrupts which are due, in chronological order
+static bool deliver_interrupts()
+{
+    bool delivered = false;
+    while(true)
+    {
+        if(compare_pending && compare_time <= virtual_time && compare_time < get_next_overflow_time())
+        {
+            compare_pending = false;
+            idle_overflows = 0;
+            if(compare_f)
+                compare_f();
+        }
+        else if(get_next_overflow_time() <= virtual_time)
+        {
+            overflows_delivered++;
+            if(!compare_pending)
+                idle_overflows++;
+
+            if(overflow_f)
+                overflow_f();
+        }
+        else
+            return delivered;
+
+        delivered = true;
+    }
+}
+
+error_t hw_timer_init(hwtimer_id_t timer_id, uint8_t frequency, timer_callback_t compare_callback, timer_callback_t overflow_callback)
+{
+    if(timer_id >= HWTIMER_NUM)
+        return ESIZE;
+
+    if(timer_inited)
+        return EALREADY;
+
+    if(frequency != HWTIMER_FREQ_1MS && frequency != HWTIMER_FREQ_32K)
+        return EINVAL;
+
+    ticks_per_sec = (frequency == HWTIMER_FREQ_1MS) ? HWTIMER_TICKS_1MS : HWTIMER_TICKS_32K;
+    compare_f = compare_callback;
+    overflow_f = overflow_callback;
+    timer_inited = true;
+#ifdef PLATFORM_NATIVE_REALTIME
+    clock_gettime(CLOCK_MONOTONIC, &wall_clock_start);
+#endif
+    return SUCCESS;
+}
+
+const hwtimer_info_t* hw_timer_get_info(hwtimer_id_t timer_id)
+{
+    if(timer_id >= HWTIMER_NUM)
+        return NULL;
+
+    return &timer_info;
+}
+
+hwtimer_tick_t hw_timer_getvalue(hwtimer_id_t timer_id)
+{
+    if(timer_id >= HWTIMER_NUM || !timer_inited)
+        return 0;
+
+    return (hwtimer_tick_t)virtual_time;
+}
+
+error_t hw_timer_schedule(hwtimer_id_t timer_id, hwtimer_tick_t tick)
+{
+    if(timer_id >= HWTIMER_NUM)
+        return ESIZE;
+
+    if(!timer_inited)
+        return EOFF;
+
+    // a compare value equal to or lower than the current counter value only matches after the counter looped around
+    hwtimer_tick_t delay = tick - (hwtimer_tick_t)virtual_time;
+    compare_time = virtual_time + (delay == 0 ? COUNTER_PERIOD : delay);
+    compare_pending = true;
+    return SUCCESS;
+}
+
+error_t hw_timer_cancel(hwtimer_id_t timer_id)
+{
+    if(timer_id >= HWTIMER_NUM)
+        return ESIZE;
+
+    if(!timer_inited)
+        return EOFF;
+
+    compare_pending = false;
+    return SUCCESS;
+}
+
+bool hw_timer_is_overflow_pending(hwtimer_id_t timer_id)
+{
+    return timer_inited && get_next_overflow_time() <= virtual_time;
+}
+
+void hw_enter_lowpower_mode(uint8_t mode)
+{
+    // interrupts which became due while the MCU was busy are delivered first, without sleeping
+    if(deliver_interrupts())
+        return;
+
+#ifdef PLATFORM_NATIVE_FS_PATH
+    blockdevice_mmap_sync_idle();
+#endif
+
+    if(!timer_inited || idle_overflows >= IDLE_OVERFLOWS_BEFORE_EXIT)
+        exit(EXIT_SUCCESS);
+
+    uint64_t wake_up_time = get_next_overflow_time();
+    if(compare_pending && compare_time < wake_up_time)
+        wake_up_time = compare_time;
+
+#ifdef PLATFORM_NATIVE_REALTIME
+    wait_for_wall_clock(wake_up_time);
+#endif
+    virtual_time = wake_up_time;
+    deliver_interrupts();
+}
+
+void hw_busy_wait(int16_t microseconds)
+{
+    native_time_advance((uint64_t)microseconds * ticks_per_sec / 1000000);
+}
+
+uint64_t native_time_get_ticks(void)
+{
+    return virtual_time;
+}
+
+void native_time_advance(uint32_t ticks)
+{
+#ifdef PLATFORM_NATIVE_REALTIME
+    wait_for_wall_clock(virtual_time + ticks);
+#endif
+    // like on the hardware, the interrupts which expire during a busy wait are only handled once the MCU is idle
+    virtual_time += ticks;
+}
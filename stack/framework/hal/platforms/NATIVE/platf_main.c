@@ -17,6 +17,8 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
+
 #include "bootstrap.h"
 #include "hwgpio.h"
 #include "hwleds.h"
@@ -27,15 +29,41 @@
 #include "hwuart.h"
 #include "errors.h"
 #include "blockdevice_ram.h"
+#include "blockdevice_mmap.h"
 #include "framework_defs.h"
+#include "platform.h"
+
+#ifdef PLATFORM_NATIVE_FS_PATH
+#include <sys/stat.h>
+#endif
 
+#ifndef PLATFORM_NATIVE_SIMULATOR
 #define METADATA_SIZE (4 + 4 + (12 * FRAMEWORK_FS_FILE_COUNT))
 
-// on native we use a RAM blockdevice as NVM as well for now
+// on native we use a RAM blockdevice as NVM, or memory mapped files which start with the same contents
 uint8_t d7ap_fs_metadata[METADATA_SIZE];
 uint8_t d7ap_files_data[FRAMEWORK_FS_PERMANENT_STORAGE_SIZE];
-uint8_t d7ap_volatile_files_data[FRAMEWORK_FS_VOLATILE_STORAGE_SIZE];
 
+#ifdef PLATFORM_NATIVE_FS_PATH
+#define __MMAP_SYNC(policy) BLOCKDEVICE_MMAP_SYNC_ ## policy
+#define MMAP_SYNC(policy) __MMAP_SYNC(policy)
+
+static blockdevice_mmap_t metadata_bd = (blockdevice_mmap_t){
+    .base.driver = &blockdevice_driver_mmap,
+    .base.size = METADATA_SIZE,
+    .path = PLATFORM_NATIVE_FS_PATH "/metadata.bin",
+    .sync = MMAP_SYNC(PLATFORM_NATIVE_FS_SYNC),
+    .initial_data = d7ap_fs_metadata
+};
+
+static blockdevice_mmap_t permanent_bd = (blockdevice_mmap_t){
+    .base.driver = &blockdevice_driver_mmap,
+    .base.size = FRAMEWORK_FS_PERMANENT_STORAGE_SIZE,
+    .path = PLATFORM_NATIVE_FS_PATH "/permanent.bin",
+    .sync = MMAP_SYNC(PLATFORM_NATIVE_FS_SYNC),
+    .initial_data = d7ap_files_data
+};
+#else
 static blockdevice_ram_t metadata_bd = (blockdevice_ram_t){
     .base.driver = &blockdevice_driver_ram,
     .base.size = METADATA_SIZE,
@@ -47,6 +75,10 @@ static blockdevice_ram_t permanent_bd = (blockdevice_ram_t){
     .base.size = FRAMEWORK_FS_PERMANENT_STORAGE_SIZE,
     .buffer = d7ap_files_data
 };
+#endif
+
+// the volatile files are lost at exit, like at a reset of the MCU
+uint8_t d7ap_volatile_files_data[FRAMEWORK_FS_VOLATILE_STORAGE_SIZE];
 
 static blockdevice_ram_t volatile_bd = (blockdevice_ram_t){
     .base.driver = &blockdevice_driver_ram,
@@ -57,19 +89,24 @@ static blockdevice_ram_t volatile_bd = (blockdevice_ram_t){
 blockdevice_t * const metadata_blockdevice = (blockdevice_t* const) &metadata_bd;
 blockdevice_t * const persistent_files_blockdevice = (blockdevice_t* const) &permanent_bd;
 blockdevice_t * const volatile_blockdevice = (blockdevice_t* const) &volatile_bd;
-
+#endif
 
 void __platform_init()
 {
-    blockdevice_init(metadata_blockdevice);
-    blockdevice_init(persistent_files_blockdevice);
-    blockdevice_init(volatile_blockdevice);
+#ifdef PLATFORM_NATIVE_FS_PATH
+    mkdir(PLATFORM_NATIVE_FS_PATH, 0755); // fails if it exists already, opening the files reports other errors
+#endif
+    blockdevice_init(PLATFORM_METADATA_BLOCKDEVICE);
+    blockdevice_init(PLATFORM_PERMANENT_BLOCKDEVICE);
+    blockdevice_init(PLATFORM_VOLATILE_BLOCKDEVICE);
 }
 
 void __platform_post_framework_init()
 {
 }
 
+// the network simulator runs this sequence for every node, see native_sim.c
+#ifndef PLATFORM_NATIVE_SIMULATOR
 int main()
 {
     //initialise the platform itself
@@ -82,25 +119,24 @@ int main()
     scheduler_run();
     return 0;
 }
+#endif
 
-// empty stubs
+// empty stubs, the hardware timer is implemented in native_timer.c
 __LINK_C uart_handle_t* uart_init(uint8_t port_idx, uint32_t baudrate, uint8_t pins) {}
 __LINK_C bool uart_enable(uart_handle_t* uart) {}
 __LINK_C bool uart_disable(uart_handle_t* uart) {}
 __LINK_C void uart_send_bytes(uart_handle_t* uart, void const *data, size_t length) {}
 __LINK_C error_t uart_rx_interrupt_enable(uart_handle_t* uart) {}
+__LINK_C void uart_rx_interrupt_disable(uart_handle_t* uart) {}
+__LINK_C void uart_pull_down_rx(uart_handle_t* uart) {}
 __LINK_C void uart_set_rx_interrupt_callback(uart_handle_t* uart, uart_rx_inthandler_t rx_handler) {}
 __LINK_C void uart_set_error_callback(uart_handle_t* uart, uart_error_handler_t error_handler) {}
 __LINK_C error_t hw_gpio_set(pin_id_t pin_id) {}
 system_reboot_reason_t hw_system_reboot_reason(void) {}
-__LINK_C void hw_enter_lowpower_mode(uint8_t mode) {}
-__LINK_C hwtimer_tick_t hw_timer_getvalue(hwtimer_id_t timer_id) {}
-__LINK_C const hwtimer_info_t* hw_timer_get_info(hwtimer_id_t timer_id) {}
-__LINK_C error_t hw_timer_schedule(hwtimer_id_t timer_id, hwtimer_tick_t tick ) {}
-__LINK_C error_t hw_timer_init(hwtimer_id_t timer_id, uint8_t frequency, timer_callback_t compare_callback, timer_callback_t overflow_callback) {}
-__LINK_C bool hw_timer_is_overflow_pending(hwtimer_id_t id) {}
-__LINK_C error_t hw_timer_cancel(hwtimer_id_t timer_id) {}
+__LINK_C void hw_reset(void) { exit(EXIT_SUCCESS); }
+#ifndef PLATFORM_NATIVE_SIMULATOR
 __LINK_C uint64_t hw_get_unique_id(void) { return 0xFFFFFFFFFFFFFF;}
+#endif
 __LINK_C void hw_watchdog_feed(void) {};
 __LINK_C void __watchdog_init(void) {};
-__LINK_C void hw_watchdog_get_timeout(void) {};
+__LINK_C uint8_t hw_watchdog_get_timeout(void) { return 30; } // there is no watchdog, but the scheduler uses this to post the feed task
@@ -32,6 +32,23 @@
 #include <types.h>
 
 #define AES_BLOCK_SIZE 16
+#define AES128_ROUNDS 10
+
+/*! \brief AES-128 key context, owned by the caller.
+ *
+ * The key schedule is computed once by AES128_ctx_init() and can then be used for any number of
+ * operations. Multiple contexts allow multiple keys to be in use at the same time.
+ */
+typedef struct {
+    uint32_t round_keys[4 * (AES128_ROUNDS + 1)]; //!< expanded key, one word per column with the first byte in the LSB
+    uint8_t key[AES_BLOCK_SIZE];                  //!< the plain key, for hardware engines which do their own key expansion
+} aes128_ctx_t;
+
+/*! \brief A segment of a scatter-gather list, used to pass data which is not contiguous in memory */
+typedef struct {
+    uint8_t *data;
+    uint16_t len;
+} aes_sg_t;
 
 // #define the macros below to 1/0 to enable/disable the mode of operation.
 //
@@ -51,6 +68,12 @@
   #define CTR 1
 #endif
 
+/*! \brief Computes the key schedule of key into ctx */
+void AES128_ctx_init(aes128_ctx_t *ctx, const uint8_t *key);
+
+/*
+ * The functions without _ctx suffix use a single context shared by all callers, set using AES128_init().
+ */
 void AES128_init(const uint8_t *key);
 
 #if defined(ECB) && ECB
@@ -58,6 +81,8 @@ void AES128_init(const uint8_t *key);
 // The two functions AES128_ECB_xxcrypt() do most of the work, and they expect inputs of 128 bit length.
 void AES128_ECB_encrypt(uint8_t *input, uint8_t *output);
 void AES128_ECB_decrypt(uint8_t *input, uint8_t *output);
+void AES128_ECB_encrypt_ctx(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output);
+void AES128_ECB_decrypt_ctx(const aes128_ctx_t *ctx, const uint8_t *input, uint8_t *output);
 
 #endif // #if defined(ECB) && ECB
 
@@ -66,11 +91,14 @@ void AES128_ECB_decrypt(uint8_t *input, uint8_t *output);
 
 void AES128_CBC_encrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length, const uint8_t *iv);
 void AES128_CBC_decrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length, const uint8_t *iv);
+void AES128_CBC_encrypt_buffer_ctx(const aes128_ctx_t *ctx, uint8_t *output, const uint8_t *input, uint32_t length, const uint8_t *iv);
+void AES128_CBC_decrypt_buffer_ctx(const aes128_ctx_t *ctx, uint8_t *output, const uint8_t *input, uint32_t length, const uint8_t *iv);
 
 #endif // #if defined(CBC) && CBC
 
 #if defined(CTR) && CTR
 void AES128_CTR_encrypt(uint8_t *output, uint8_t *input, uint32_t length, uint8_t* ctr_blk);
+void AES128_CTR_encrypt_ctx(const aes128_ctx_t *ctx, uint8_t *output, const uint8_t *input, uint32_t length, uint8_t* ctr_blk);
 // Decryption is exactly the same operation as encryption
 
 #endif // #if defined(CTR) && CTR
@@ -87,6 +115,8 @@ void AES128_CTR_encrypt(uint8_t *output, uint8_t *input, uint32_t length, uint8_
  */
 error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const uint8_t *iv,
                         const uint8_t *add, uint8_t add_len, uint8_t auth_len );
+error_t AES128_CBC_MAC_ctx( const aes128_ctx_t *ctx, uint8_t *auth, const uint8_t *payload, uint8_t length,
+                            const uint8_t *iv, const uint8_t *add, uint8_t add_len, uint8_t auth_len );
 
 
 /*! \brief AES Counter with CBC-MAC (CCM), 128 bit key.
@@ -102,6 +132,9 @@ error_t AES128_CBC_MAC( uint8_t *auth, uint8_t *payload, uint8_t length, const u
 error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
                             const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
                             uint8_t auth_len );
+error_t AES128_CCM_encrypt_ctx( const aes128_ctx_t *ctx, uint8_t *payload, uint8_t length, const uint8_t *iv,
+                                const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
+                                uint8_t auth_len );
 
 /*! \brief AES Counter with CBC-MAC (CCM), 128 bit key.
  *
@@ -117,6 +150,40 @@ error_t AES128_CCM_encrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
 error_t AES128_CCM_decrypt( uint8_t *payload, uint8_t length, const uint8_t *iv,
                             const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
                             const uint8_t *auth, uint8_t auth_len );
+error_t AES128_CCM_decrypt_ctx( const aes128_ctx_t *ctx, uint8_t *payload, uint8_t length, const uint8_t *iv,
+                                const uint8_t *add, uint8_t add_len, uint8_t *ctr_blk,
+                                const uint8_t *auth, uint8_t auth_len );
+
+/*! \brief AES-CCM authenticated encryption in a single pass, 128 bit key.
+ *
+ * The CBC-MAC and the CTR encryption are interleaved block by block, so the payload is only
+ * read and written once. The additional data and the payload can be spread over multiple segments.
+ *
+ * \param ctx		Key context
+ * \param iv		First block used by CBC-MAC (B_0)
+ * \param ctr_blk	Counter block template. The 4 LSB of the first byte are replaced by the block counter,
+ *                  so the same buffer as @p iv can be passed when they only differ in these bits.
+ * \param add		Segments of additional authenticated data, in total at most 255 bytes
+ * \param add_cnt	Number of segments in @p add
+ * \param payload	Segments of plain text, encrypted in place
+ * \param payload_cnt	Number of segments in @p payload
+ * \param auth		Buffer to place the encrypted authentication tag, may directly follow the payload
+ * \param auth_len	MIC length of 4, 8 or 16 bytes are allowed
+ */
+error_t AES128_CCM_encrypt_sg( const aes128_ctx_t *ctx, const uint8_t *iv, const uint8_t *ctr_blk,
+                               const aes_sg_t *add, uint8_t add_cnt,
+                               const aes_sg_t *payload, uint8_t payload_cnt,
+                               uint8_t *auth, uint8_t auth_len );
+
+/*! \brief AES-CCM authenticated decryption in a single pass, 128 bit key.
+ *
+ * Same parameters as AES128_CCM_encrypt_sg(), the payload segments are decrypted in place
+ * and @p auth is the encrypted authentication tag to check.
+ */
+error_t AES128_CCM_decrypt_sg( const aes128_ctx_t *ctx, const uint8_t *iv, const uint8_t *ctr_blk,
+                               const aes_sg_t *add, uint8_t add_cnt,
+                               const aes_sg_t *payload, uint8_t payload_cnt,
+                               const uint8_t *auth, uint8_t auth_len );
 
 #endif //_AES_H_
 
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*! \file airtime.h
+ * \addtogroup airtime
+ * \ingroup framework
+ * @{
+ * \brief Calculates the time on air of a packet in timer ticks, using integer arithmetic only
+ *
+ * The duration of a byte (FSK) or a quarter of a symbol (LoRa) is converted once into a fixed point number of ticks,
+ * an airtime_rate_t. Calculating the airtime of a packet is then a multiplication, without a division or floating point
+ * (which is emulated in software on a Cortex-M0+). The result is rounded up to the next tick.
+ */
+
+#ifndef AIRTIME_H_
+#define AIRTIME_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AIRTIME_RATE_FRACTIONAL_BITS 16
+
+/*! \brief Number of ticks per byte or quarter symbol, with AIRTIME_RATE_FRACTIONAL_BITS fractional bits, rounded up */
+typedef uint32_t airtime_rate_t;
+
+/*! \brief The LoRa modulation settings which determine the airtime, see the SX127x datasheet */
+typedef struct {
+    uint8_t spreading_factor;       //!< 6 up to 12
+    uint8_t coding_rate;            //!< 1 up to 4, for 4/5 up to 4/8
+    uint16_t preamble_length;       //!< in symbols, without the 4.25 symbols added by the modem
+    uint32_t bandwidth;             //!< in Hz
+    bool implicit_header;
+    bool crc;
+    bool low_data_rate_optimize;
+    airtime_rate_t rate;            //!< ticks per quarter symbol, set by airtime_lora_init()
+} airtime_lora_t;
+
+/*! \brief The airtime of a byte at bitrate (in bps), for a timer running at ticks_per_sec (TIMER_TICKS_PER_SEC) */
+airtime_rate_t airtime_fsk_rate(uint32_t bitrate, uint32_t ticks_per_sec);
+
+/*! \brief The airtime of length bytes, in ticks */
+uint32_t airtime_fsk_ticks(airtime_rate_t rate, uint16_t length);
+
+/*! \brief Sets the rate of the LoRa settings, for a timer running at ticks_per_sec (TIMER_TICKS_PER_SEC) */
+void airtime_lora_init(airtime_lora_t* lora, uint32_t ticks_per_sec);
+
+/*! \brief The airtime of a LoRa packet with a payload of length bytes, including the preamble and header, in ticks */
+uint32_t airtime_lora_ticks(const airtime_lora_t* lora, uint16_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AIRTIME_H_ */
+
+/** @}*/
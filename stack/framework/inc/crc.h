@@ -34,7 +34,46 @@
 
 #include <stdint.h>
 
-uint16_t crc_calculate(uint8_t* data, uint8_t length);
+/*! \brief Context of an incremental CRC calculation, owned by the caller
+ *
+ */
+typedef struct {
+    uint16_t crc;
+} crc_ctx_t;
+
+/*! \brief Start a new incremental CRC calculation
+ *
+ * \param ctx       The context to initialise
+ */
+void crc_init(crc_ctx_t* ctx);
+
+/*! \brief Add data to an incremental CRC calculation
+ *
+ * The data of a frame can be passed in multiple chunks, for example the parts of a wrapped FIFO,
+ * which gives the same result as a single call on the contiguous data.
+ *
+ * \param ctx       The context of the calculation
+ * \param data      The data to add
+ * \param length    The number of bytes to add
+ */
+void crc_update(crc_ctx_t* ctx, const uint8_t* data, uint16_t length);
+
+/*! \brief Get the CRC of all data added to the context so far
+ *
+ * The context is not modified, so more data can be added afterwards.
+ *
+ * \param ctx       The context of the calculation
+ * \return          The CRC16
+ */
+uint16_t crc_final(const crc_ctx_t* ctx);
+
+/*! \brief Calculate the CRC of a contiguous buffer in one go
+ *
+ * \param data      The data
+ * \param length    The number of bytes
+ * \return          The CRC16
+ */
+uint16_t crc_calculate(const uint8_t* data, uint16_t length);
 
 #endif /* CRC_H_ */
 
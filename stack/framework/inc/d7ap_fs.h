@@ -71,6 +71,12 @@
 #define D7A_FILE_SEL_CONF_SEGMENT_FILTER_OFFSET 5
 #define D7A_FILE_SEL_CONF_SEGMENT_FILTER_SIZE 1
 
+#define D7A_FILE_PACKET_QUEUE_STATUS_FILE_ID 0x30 // RFU in the specification and not defined by the default file system image, used for stack diagnostics
+#define D7A_FILE_PACKET_QUEUE_STATUS_SIZE    4    // queue size | high water mark | allocation failures (2 bytes, MSB first)
+
+#define D7A_FILE_SCHED_PROFILING_FILE_ID 0x31 // RFU in the specification and not defined by the default file system image, used for stack diagnostics, see sched_profiling.h
+#define D7A_FILE_SCHED_PROFILING_SIZE    50
+
 #define D7A_FILE_ACCESS_PROFILE_ID 0x20 // the first access class file
 #define D7A_FILE_ACCESS_PROFILE_SIZE 65
 #define D7A_FILE_ACCESS_PROFILE_COUNT 15
@@ -161,6 +167,9 @@ int d7ap_fs_update_nwl_security_state_register(dae_nwl_trusted_node_t *trusted_n
 uint32_t d7ap_fs_get_file_length(uint8_t file_id);
 int d7ap_fs_change_file_length(uint8_t file_id, uint32_t length);
 
+/* \brief Returns the number of file header lookups served from the header cache and the number which required a read from the blockdevice */
+void d7ap_fs_get_header_cache_stats(uint32_t* hits, uint32_t* misses);
+
 #endif /* D7AP_FS_H_ */
 
 /** @}*/
@@ -46,22 +46,30 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 
+/*! \brief State of the Viterbi decoder, owned by the caller so decoding is reentrant */
 typedef struct {
-	uint8_t cost;
-	uint16_t path;
-} VITERBIPATH;
+    int16_t cost[8];    //!< path cost per trellis state
+    uint16_t path[8];   //!< survivor path per trellis state, the most recent decision in the LSB
+} fec_decoder_t;
 
-typedef struct {
-	uint8_t path_size;
-	VITERBIPATH* old;
-	VITERBIPATH* new;
-	VITERBIPATH states1[8];
-	VITERBIPATH states2[8];
-} VITERBISTATE;
+/*! \brief Encodes and interleaves nbytes in place, the buffer needs room for fec_calculated_decoded_length(nbytes) bytes
+ * \return the encoded length
+ */
+uint16_t fec_encode(uint8_t *data, uint16_t nbytes);
 
-//void print_array(uint8_t* buffer, uint8_t length);
+/*! \brief Decodes packet_length (a multiple of 4) received bytes into packet_length / 2 bytes. Output may equal input.
+ * \return the decoded length or 0 on error
+ */
+uint16_t fec_decode(fec_decoder_t* decoder, const uint8_t* input, uint16_t packet_length, uint8_t* output);
 
-uint16_t fec_encode(uint8_t *data, uint16_t nbytes);
+/*! \brief Soft decision variant of fec_decode(). Samples contains one value per received bit, in transmission order
+ * (MSB first), ranging from 0 for a certain 0 to 255 for a certain 1. Samples of whitened bits need to be inverted
+ * (255 - sample) by the caller when the PN9 bit is 1.
+ * \return the decoded length or 0 on error
+ */
+uint16_t fec_decode_soft(fec_decoder_t* decoder, const uint8_t* samples, uint16_t packet_length, uint8_t* output);
+
+/*! \brief Decodes a packet in place, using a decoder on the stack */
 uint16_t fec_decode_packet(uint8_t* data, uint16_t packet_length, uint16_t output_length);
 uint16_t fec_calculated_decoded_length(uint16_t packet_length);
 
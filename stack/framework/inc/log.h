@@ -30,6 +30,13 @@
  * Logging can be globally enabled or disabled by setting or clearing the 
  * 'FRAMEWORK_LOG_ENABLED' CMake option.
  *
+ * When the 'FRAMEWORK_LOG_BINARY' CMake option is set the logs are not formatted
+ * in the caller's context. Instead a binary record containing an ID of the format
+ * string and the raw arguments is stored in a buffer, which is output by a task
+ * running at the lowest priority. The output can be converted back to text using
+ * tools/general/log_decoder.py and the ELF file of the application, which contains the
+ * format strings.
+ *
  * \author maarten.weyn@uantwerpen.be
  * \author glenn.ergeerts@uantwerpen.be
  * \author daniel.vandenakker@uantwerpen.be
@@ -59,6 +66,9 @@ typedef enum
 
 #ifdef FRAMEWORK_LOG_ENABLED
 
+/*! \brief Initializes logging, should be called after the scheduler is initialized */
+__LINK_C void log_init(void);
+
 /*! \brief Reset the log counter back to zero */
 __LINK_C void log_counter_reset(void);
 
@@ -77,6 +87,7 @@ __LINK_C void log_print_data(uint8_t* message, uint32_t length);
 void log_print_error_string(char* format,...);
 
 #else
+    #define log_init() ((void)0)
     #define log_counter_reset() ((void)0)
     #define log_print_string(...) ((void)0)
     #define log_print_stack_string(...) ((void)0)
@@ -32,15 +32,30 @@ typedef enum
     SERIAL_MESSAGE_TYPE_PING_RESPONSE=0X03,
     SERIAL_MESSAGE_TYPE_LOGGING=0X04,
     SERIAL_MESSAGE_TYPE_REBOOTED=0X05,
+    SERIAL_MESSAGE_TYPE_ACK=0X06,   // windowed TX only: cumulative acknowledgement up to and including the frame counter in the header
+    SERIAL_MESSAGE_TYPE_NACK=0X07,  // windowed TX only: retransmit starting from the frame counter in the header
 } serial_message_type_t;
 
 typedef void (*cmd_handler_t)(fifo_t* cmd_fifo);
 typedef void (*target_rebooted_callback_t)(system_reboot_reason_t reboot_reason);
 
 /*
----------------HEADER(bytes)---------------------
-|sync|sync|counter|message type|length|crc1|crc2|
--------------------------------------------------
+---------------------HEADER v1 (bytes)----------------------------
+|sync|version (0x01)|counter|message type|length MSB|length LSB|crc1|crc2|
+------------------------------------------------------------------
+
+---------------HEADER v0 (bytes)-------------------------
+|sync|version (0x00)|counter|message type|length|crc1|crc2|
+---------------------------------------------------------
+
+Both versions are accepted on reception. A v0 header is transmitted as long as the peer did not send a v1 frame
+and the payload fits in a single length byte, so peers which only support v0 keep working.
+
+When FRAMEWORK_MODEM_INTERFACE_TX_WINDOW_SIZE is not 0 (on both sides of the link) up to that number of frames are
+in flight, and a frame is only released from the TX buffer after it is acknowledged. The receiver answers a batch of
+in order frames with a cumulative ACK frame, and a missing or corrupted frame with a NACK frame, both without payload
+and with the acknowledged or requested frame counter in the counter field of the header. Frames which are not
+acknowledged within a timeout are retransmitted as well.
 */
 
 /** @brief Initialize the modem interface by registering
@@ -59,7 +74,7 @@ void modem_interface_init(uint8_t idx, uint32_t baudrate, pin_id_t uart_state_pi
  *  @param type type of message (SERIAL_MESSAGE_TYPE_ALP, SERIAL_MESSAGE_TYPE_PING_REQUEST, SERIAL_MESSAGE_TYPE_LOGGING, ...)
  *  @return Void.
  */
-void modem_interface_transfer_bytes(uint8_t* bytes, uint8_t length, serial_message_type_t type);
+void modem_interface_transfer_bytes(uint8_t* bytes, uint16_t length, serial_message_type_t type);
 /** @brief Transmits a string by adding a header and putting it in the UART fifo
  *  @param string Bytes that need to be transmitted
  *  @return Void.
@@ -38,17 +38,43 @@ enum
 {
     __ng_max_nodes__ = NODE_GLOBALS_MAX_NODES,
 };
-extern size_t __ng_node_id__;
+#ifdef NODE_GLOBALS_THREAD_LOCAL
+    // every thread runs its own node, used when nodes are simulated in parallel
+    #define NG_THREAD_LOCAL __thread
+#else
+    #define NG_THREAD_LOCAL
+#endif
+
+extern NG_THREAD_LOCAL size_t __ng_node_id__;
 __LINK_C void set_node_global_id(size_t node_id);
 static inline size_t get_node_global_id() { assert(__ng_node_id__ < __ng_max_nodes__); return __ng_node_id__; }
 
+#ifdef NODE_GLOBALS_GROUPED
+#include <stdint.h>
+/*
+ * All node global variables are collected by the linker in the node_globals section, which is the layout of the
+ * state of one node. ng.c allocates a copy of this section for every node, initialized from the section itself, and
+ * set_node_global_id() only switches the offset from the section to the copy of the selected node. The state of a
+ * node is contiguous, instead of spread over one array per variable.
+ */
+extern NG_THREAD_LOCAL intptr_t __ng_offset__;
+
+#define NG(var)			(*(__typeof__(&__ng_glob_ ## var ## __))((intptr_t)&__ng_glob_ ## var ## __ + __ng_offset__))
+#define NGDEF(var)		__attribute__((section("node_globals"))) __ng_glob_ ## var ## __
+// initializer of an NGDEF variable, the initial value of the copy of every node
+#define NGINIT(...)		__VA_ARGS__
+#else
 #define NG(var)			(__ng_glob_ ## var ## __[(get_node_global_id())])
 #define NGDEF(var)		(__ng_glob_ ## var ## __[__ng_max_nodes__])
+// initializer of an NGDEF variable, applied to the copy of every node (uses a GCC range designator)
+#define NGINIT(...)		{ [0 ... __ng_max_nodes__ - 1] = __VA_ARGS__ }
+#endif
 
 #else
 
 #define NGDEF(var)	(__ng_single_ ## var ## __)
 #define NG(var)		(__ng_single_ ## var ## __)
+#define NGINIT(...)	__VA_ARGS__
 
 
 #endif //defined(NODE_GLOBALS)
@@ -40,6 +40,13 @@
  */
 void pn9_encode(uint8_t *data, uint16_t length);
 
+/*
+ * Whitens (or de-whitens) in place a part of a frame, where data points to the byte at
+ * position offset in the frame. This allows to process a frame in multiple steps, for example
+ * the header as soon as it is received and the remainder of the payload later.
+ */
+void pn9_encode_at(uint8_t *data, uint16_t length, uint16_t offset);
+
 #endif // PN9_H_
 
 /** @}*/
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file sched_profiling.h
+ * @addtogroup sched_profiling
+ * @ingroup framework
+ * @{
+ * @brief Publishes the scheduler profiling data (FRAMEWORK_SCHED_PROFILING_ENABLED) in a system file and on the shell.
+ *
+ * The data is exposed in the volatile system file D7A_FILE_SCHED_PROFILING_FILE_ID, which only contains the data of
+ * one task at a time. The host selects a task by writing its index to the first byte of the file, after which the
+ * file is refreshed, so an ALP command containing this write followed by a read of the file returns the current data.
+ * Writing SCHED_PROFILING_RESET instead clears all profiling data. All fields are MSB first, times are in timer ticks:
+ *
+ * | offset | size | field                                                    |
+ * |--------|------|----------------------------------------------------------|
+ * | 0      | 1    | selected task index                                      |
+ * | 1      | 1    | number of registered tasks                               |
+ * | 2      | 8    | queue high water mark, per priority (MAX_PRIORITY first) |
+ * | 10     | 4    | address of the task function                             |
+ * | 14     | 4    | run count                                                |
+ * | 18     | 4    | total run time                                           |
+ * | 22     | 4    | max run time                                             |
+ * | 26     | 4    | total latency between posting and running the task       |
+ * | 30     | 4    | max latency                                              |
+ * | 34     | 16   | run time histogram, see SCHED_PROFILING_HISTOGRAM_BINS   |
+ *
+ * The shell command ATP prints the data of all tasks.
+ */
+
+#ifndef SCHED_PROFILING_H
+#define SCHED_PROFILING_H
+
+#include "framework_defs.h"
+#include "errors.h"
+
+#define SCHED_PROFILING_RESET 0xFF
+
+#ifdef FRAMEWORK_SCHED_PROFILING_ENABLED
+
+/**
+ * @brief Creates the profiling system file. Should be called by the application after the filesystem is initialised.
+ */
+error_t sched_profiling_file_initialize(void);
+
+/**
+ * @brief Prints the profiling data of all tasks and the queue high water marks on the console
+ */
+void sched_profiling_print(void);
+
+#else
+
+#define sched_profiling_file_initialize()   ((void)0)
+#define sched_profiling_print()             ((void)0)
+
+#endif
+
+#endif // SCHED_PROFILING_H
+
+/** @}*/
@@ -31,12 +31,26 @@
 
 #include "link_c.h"
 #include "types.h"
+#include "framework_defs.h"
 
 /*! \brief Type definition for tasks
  *
  */
 typedef void (*task_t)(void *arg);
 
+/*! \brief Type definition of the handle of a registered task
+ *
+ * The handle is assigned when the task is registered and stays valid for the lifetime of the application.
+ * Posting or cancelling a task by handle avoids looking up the task, which makes it the preferred way to
+ * post tasks from interrupt context.
+ */
+typedef uint8_t sched_task_id_t;
+
+/*! \brief The handle returned for tasks which are not registered with the scheduler
+ *
+ */
+#define SCHED_INVALID_TASK_ID 0xFF
+
 /*! \brief Initialise the scheduler sub system. 
  *
  * This function is called while bootstrapping the framework. On no account should you call this function 
@@ -86,6 +100,26 @@ enum
  */
 __LINK_C error_t sched_register_task(task_t task);
 
+/*! \brief Register a task with the task scheduler and return its handle.
+ *
+ *  This behaves the same as sched_register_task() but returns the handle of the task, which can be used with
+ *  sched_post_task_by_id(), sched_cancel_task_by_id() and sched_is_scheduled_by_id().
+ *  When the task was already registered the existing handle is returned.
+ *
+ * \param task		The task to register
+ *
+ * \return sched_task_id_t 	The handle of the task
+ */
+__LINK_C sched_task_id_t sched_register_task_id(task_t task);
+
+/*! \brief Retrieve the handle of a registered task
+ *
+ * \param task		The task to look up
+ *
+ * \return sched_task_id_t	The handle of the task or SCHED_INVALID_TASK_ID if the task is not registered
+ */
+__LINK_C sched_task_id_t sched_get_task_id(task_t task);
+
 /*! \brief Post a task with the given priority
  *
  * \param task		The task to be executed by the scheduler
@@ -110,6 +144,19 @@ __LINK_C error_t sched_post_task_prio(task_t task, uint8_t priority, void *arg);
  */
 static inline error_t sched_post_task(task_t task) { return sched_post_task_prio(task,DEFAULT_PRIORITY, NULL);}
 
+/*! \brief Post a task with the given priority, using the handle returned when registering the task
+ *
+ * \param task_id	The handle of the task to be executed by the scheduler
+ * \param priority	The priority of the task
+ *
+ * \return error_t	SUCCESS if the task was successfully scheduled
+ *			EINVAL if the handle does not belong to a registered task
+ *			ESIZE if the priority is not between MAX_PRIORITY and MIN_PRIORITY
+ *			EALREADY if the task was already scheduled. If this is the case,
+ *			the task will be executed but only once.
+ */
+__LINK_C error_t sched_post_task_by_id(sched_task_id_t task_id, uint8_t priority, void *arg);
+
 /*! \brief Cancel an already scheduled task
  *
  * \param task		The task to cancel
@@ -120,16 +167,88 @@ static inline error_t sched_post_task(task_t task) { return sched_post_task_prio
  */
 __LINK_C error_t sched_cancel_task(task_t task);
 
+/*! \brief Cancel an already scheduled task, using the handle returned when registering the task
+ *
+ * \param task_id	The handle of the task to cancel
+ *
+ * \return error_t	SUCCESS if the task was cancelled successfully
+ * 			EINVAL if the handle does not belong to a registered task
+ *			EALREADY if the task was not scheduled or has already been executed
+ */
+__LINK_C error_t sched_cancel_task_by_id(sched_task_id_t task_id);
+
 /*! \brief Check whether a task is scheduled to be executed
  *
  * \return bool		TRUE if the task is scheduled, FALSE otherwise
  */
 __LINK_C bool sched_is_scheduled(task_t task);
 
+/*! \brief Check whether a task is scheduled to be executed, using the handle returned when registering the task
+ *
+ * \return bool		TRUE if the task is scheduled, FALSE otherwise
+ */
+__LINK_C bool sched_is_scheduled_by_id(sched_task_id_t task_id);
+
 
 __LINK_C uint8_t sched_get_low_power_mode(void);
 __LINK_C void    sched_set_low_power_mode(uint8_t mode);
 
+/*! \brief Keep the MCU out of the low power modes deeper than max_mode while the scheduler is idle, until
+ * sched_release_low_power_mode_limit() is called. For drivers which need to service an interrupt with a short wake-up
+ * latency, for example to refill a radio FIFO. The mode set with sched_set_low_power_mode() is not changed.
+ */
+__LINK_C void    sched_limit_low_power_mode(uint8_t max_mode);
+__LINK_C void    sched_release_low_power_mode_limit(void);
+
+#ifdef FRAMEWORK_SCHED_PROFILING_ENABLED
+
+/*! \brief The number of bins of the run time histogram of a task
+ *
+ * Bin 0 counts the runs which took less than one timer tick, bin i the runs which took between 2^(i-1) and
+ * 2^i - 1 ticks and the last bin all longer runs.
+ */
+#define SCHED_PROFILING_HISTOGRAM_BINS 8
+
+/*! \brief The profiling data of a registered task, all times are expressed in timer ticks
+ *
+ */
+typedef struct
+{
+	task_t task;
+	uint32_t run_count;			/**< The number of times the task was executed */
+	uint32_t total_run_time;		/**< The cumulative execution time */
+	uint32_t max_run_time;			/**< The longest execution time */
+	uint32_t total_latency;			/**< The cumulative time between posting the task and executing it */
+	uint32_t max_latency;			/**< The longest time between posting the task and executing it */
+	uint16_t run_time_histogram[SCHED_PROFILING_HISTOGRAM_BINS]; /**< Saturating counters, see SCHED_PROFILING_HISTOGRAM_BINS */
+} sched_task_profile_t;
+
+/*! \brief Returns the number of registered tasks. The handles of the registered tasks are 0 up to this number.
+ *
+ */
+__LINK_C uint8_t sched_get_registered_task_count(void);
+
+/*! \brief Retrieve the profiling data of a registered task
+ *
+ * \param task_id	The handle of the task
+ * \param profile	Filled with the profiling data
+ *
+ * \return error_t	SUCCESS, or EINVAL if the handle does not belong to a registered task
+ */
+__LINK_C error_t sched_get_task_profile(sched_task_id_t task_id, sched_task_profile_t* profile);
+
+/*! \brief Returns the largest number of tasks which were queued at the same time at the given priority
+ *
+ */
+__LINK_C uint8_t sched_get_queue_high_water_mark(uint8_t priority);
+
+/*! \brief Clears the profiling data of all tasks and resets the high water marks to the current queue depths
+ *
+ */
+__LINK_C void sched_reset_profiling(void);
+
+#endif
+
 #endif /* SCHEDULER_H_ */
 
 /** @}*/
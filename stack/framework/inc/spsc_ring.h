@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file spsc_ring.h
+ * @addtogroup spsc_ring
+ * @ingroup framework
+ * @{
+ * @brief A single-producer/single-consumer byte ring which can be shared between an ISR and a task without masking interrupts.
+ *
+ * The producer (typically a UART RX interrupt) only writes the tail index, the consumer (typically a scheduler task) only
+ * writes the head index. Both indices are free running and published with release semantics, so neither side needs
+ * start_atomic()/end_atomic(). The buffer size must be a power of two.
+ *
+ * The consumer can access the buffered data in place using spsc_ring_peek_spans(), which returns at most two contiguous
+ * spans, and releases the bytes it parsed using spsc_ring_commit().
+ *
+ * Use fifo_t instead when there is no concurrent access.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include "types.h"
+#include "fifo.h"
+
+/**
+ * @brief This struct contains the ring state variables
+ **/
+typedef struct {
+    uint8_t* buffer;        /**< The buffer where the data is stored */
+    uint16_t mask;          /**< The buffer size minus one, the buffer size is a power of two */
+    uint16_t head;          /**< Free running index of the first data byte, only modified by the consumer */
+    uint16_t tail;          /**< Free running index of the first empty byte, only modified by the producer */
+} spsc_ring_t;
+
+/**
+ * @brief A contiguous part of the data contained in the ring
+ **/
+typedef struct {
+    uint8_t* data;
+    uint16_t len;
+} spsc_ring_span_t;
+
+/**
+ * @brief Initializes the ring. Should be called before the producer or consumer are started.
+ * @param ring      Ring state, initialized by this function
+ * @param buffer    The buffer used for the ring, the caller is responsible for allocating this
+ * @param size      The size of buffer, must be a power of two and not larger than 0x8000
+ * @return SUCCESS, or EINVAL when size is not a power of two
+ */
+error_t spsc_ring_init(spsc_ring_t* ring, uint8_t* buffer, uint16_t size);
+
+/**
+ * @brief Empties the ring. Only allowed when the producer is not active (for example when the RX interrupt is disabled).
+ * @param ring  Pointer to the ring object
+ */
+void spsc_ring_reset(spsc_ring_t* ring);
+
+/**
+ * @brief Returns the capacity of the ring
+ */
+static inline uint16_t spsc_ring_get_capacity(spsc_ring_t* ring) { return ring->mask + 1; }
+
+/*
+ * Producer side
+ */
+
+/**
+ * @brief Put bytes in to the ring. The bytes are either all added, or none of them.
+ * @param ring  Pointer to the ring object
+ * @param data  Pointer to the data to be put in the ring
+ * @param len   Number of bytes to put in the ring
+ * @return SUCCESS, or ESIZE when there is not enough space
+ */
+error_t spsc_ring_put(spsc_ring_t* ring, const uint8_t* data, uint16_t len);
+
+/**
+ * @brief Put a single byte in to the ring. This is the variant to be used from a byte-wise RX interrupt.
+ * @return SUCCESS, or ESIZE when the ring is full
+ */
+error_t spsc_ring_put_byte(spsc_ring_t* ring, uint8_t byte);
+
+/**
+ * @brief Returns the number of free bytes, as seen by the producer
+ */
+uint16_t spsc_ring_get_space(spsc_ring_t* ring);
+
+/**
+ * @brief Returns the free space as at most two contiguous spans, so the producer (or a DMA transfer) can write in place.
+ * The written bytes become visible for the consumer after calling spsc_ring_produce().
+ * @param ring  Pointer to the ring object
+ * @param spans Filled with the free spans, spans[1].len is 0 when the free space does not wrap
+ * @return The total number of free bytes
+ */
+uint16_t spsc_ring_get_write_spans(spsc_ring_t* ring, spsc_ring_span_t spans[2]);
+
+/**
+ * @brief Publishes len bytes which were written in place, starting from the first write span
+ * @return SUCCESS, or ESIZE when len exceeds the free space
+ */
+error_t spsc_ring_produce(spsc_ring_t* ring, uint16_t len);
+
+/*
+ * Consumer side
+ */
+
+/**
+ * @brief Returns the number of bytes contained in the ring, as seen by the consumer
+ */
+uint16_t spsc_ring_get_size(spsc_ring_t* ring);
+
+/**
+ * @brief Returns the contained data as at most two contiguous spans, without copying.
+ * The data stays valid until it is released using spsc_ring_commit().
+ * @param ring  Pointer to the ring object
+ * @param spans Filled with the data spans, spans[1].len is 0 when the data does not wrap
+ * @return The total number of bytes contained in the ring
+ */
+uint16_t spsc_ring_peek_spans(spsc_ring_t* ring, spsc_ring_span_t spans[2]);
+
+/**
+ * @brief Releases len bytes which were consumed by the consumer
+ * @return SUCCESS, or ESIZE when len exceeds the number of contained bytes
+ */
+error_t spsc_ring_commit(spsc_ring_t* ring, uint16_t len);
+
+/**
+ * @brief Copies len bytes starting from offset, without releasing them
+ * @return SUCCESS, or ESIZE when the ring does not contain offset + len bytes
+ */
+error_t spsc_ring_peek(spsc_ring_t* ring, uint8_t* buffer, uint16_t offset, uint16_t len);
+
+/**
+ * @brief Copies and releases len bytes
+ * @return SUCCESS, or ESIZE when the ring does not contain len bytes
+ */
+error_t spsc_ring_pop(spsc_ring_t* ring, uint8_t* buffer, uint16_t len);
+
+/**
+ * @brief Releases all bytes currently contained in the ring. Unlike spsc_ring_reset() this is safe while the producer is active.
+ */
+void spsc_ring_flush(spsc_ring_t* ring);
+
+/**
+ * @brief Initializes a fifo_t subview on len bytes starting from offset, so existing fifo_t based parsers can be used
+ * in place. Popping from the view does not release data from the ring, use spsc_ring_commit() afterwards.
+ * @return SUCCESS, or ESIZE when the ring does not contain offset + len bytes
+ */
+error_t spsc_ring_init_fifo_view(spsc_ring_t* ring, fifo_t* view, uint16_t offset, uint16_t len);
+
+#endif // SPSC_RING_H
+
+/** @}*/
@@ -29,6 +29,7 @@
  *  - Multiple timer events can be scheduled simultaneously
  *  - Events are executed by the scheduler in the main task loop and NOT during the timer interrupt
  *  - Support for multiple priorities
+ *  - Events can be posted with a slack, which allows the timer to group them with other events in a single wake-up
  *
  * The framework timer supports the same timer resolutions supported by the hal. By default
  * a binary millisecond timer interval is used (HWTIMER_FREQ_MS), but this can be changed
@@ -65,6 +66,7 @@ typedef struct
     uint8_t priority;
     void *arg;
     timer_tick_t period;
+    timer_tick_t slack;
 } timer_event;
 
 //a bit of dirty macro evaluation to prepend HWTIMER_FREQ_ to the value of 'FRAMEWORK_TIMER_RESOLUTION'
@@ -143,6 +145,33 @@ __LINK_C timer_tick_t timer_get_counter_value();
  */
 __LINK_C error_t timer_post_task_prio(task_t task, timer_tick_t time, uint8_t priority, timer_tick_t period, void *arg);
 
+/*! \brief Post a task to be scheduled at any time between \<time\> and \<time\> + \<slack\>
+ *
+ * This behaves the same as timer_post_task_prio(), but allows the framework timer to postpone the task by up
+ * to \<slack\> ticks. The hardware timer is programmed for the earliest deadline (time + slack) of all events,
+ * and on every wake-up all events of which the window has started are executed as well. This way events with
+ * overlapping windows share a single wake-up, which matters more for the battery life than the work done per
+ * wake-up. Tasks which need to be executed at an exact time should use a slack of 0.
+ *
+ * The slack is the jitter the task can tolerate. For periodic work such as a sensor measurement, which only
+ * needs to run about once per period, a tenth of the period is a reasonable choice: the interval between two
+ * executions then stays within 10% of the period, while the task mostly runs on a wake-up which was needed
+ * for another event anyway.
+ *
+ * When the task is already scheduled and the new window starts within the scheduled one and ends after it,
+ * the task keeps its current deadline and the hardware timer is not reprogrammed. This makes it cheap to
+ * repeatedly postpone a task, as for example the watchdog feed does.
+ *
+ * \param task		The task to be scheduled.
+ * \param time		The earliest time at which to schedule the task for execution.
+ * \param slack		The number of ticks the task may be postponed after time.
+ * \param priority	The priority with which the task should be executed
+ * \param period    The period on which the task should be repeated (0 is not repeated)
+ *
+ * \returns error_t	See timer_post_task_prio()
+ */
+__LINK_C error_t timer_post_task_prio_slack(task_t task, timer_tick_t time, timer_tick_t slack, uint8_t priority, timer_tick_t period, void *arg);
+
 /*! \brief Post a task \<task\> to be scheduled at a given \<time\> with the default priority.
  *
  * This function is equivalent to
@@ -206,6 +235,21 @@ inline error_t timer_post_task_prio_delay(task_t task, timer_tick_t delay, uint8
  */
 inline error_t timer_post_task_delay(task_t task, timer_tick_t delay) { return timer_post_task_prio_delay(task, delay, DEFAULT_PRIORITY);}
 
+/*! \brief Post a task to be scheduled between \<delay\> and \<delay\> + \<slack\> ticks from now, with the default priority.
+ *
+ * See the comments above 'timer_post_task_prio_slack()' for a more detailed explanation.
+ *
+ * \param task		The task to be executed.
+ * \param delay		The minimal delay with which the task is to be executed.
+ * \param slack		The number of ticks the task may be postponed after delay.
+ *
+ * \returns error_t	See timer_post_task_prio()
+ */
+inline error_t timer_post_task_delay_slack(task_t task, timer_tick_t delay, timer_tick_t slack)
+{
+    return timer_post_task_prio_slack(task, timer_get_counter_value() + delay, slack, DEFAULT_PRIORITY, 0, NULL);
+}
+
 /*! \brief Set a timer to execute a callback at some time in the future.
  *
  * @param[in] event        Structure containing the event parameters
@@ -21,6 +21,7 @@
 #include "alp_layer.h"
 #include "string.h"
 #include "log.h"
+#include "ng.h"
 #include "MODULE_ALP_defs.h"
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(MODULE_ALP_LOG_ENABLED)
@@ -35,13 +36,13 @@ static void response_from_d7ap(uint16_t trans_id, uint8_t* payload, uint8_t len,
 static bool command_from_d7ap(uint8_t* payload, uint8_t len, d7ap_session_result_t result, bool response_expected);
 static void d7ap_command_completed(uint16_t trans_id, error_t error);
 
-static alp_interface_t d7_alp_interface;
-static uint8_t alp_client_id;
-static bool inited = false;
+static alp_interface_t NGDEF(d7_alp_interface);
+static uint8_t NGDEF(alp_client_id);
+static bool NGDEF(inited) = NGINIT(false);
 
 static error_t d7ap_interface_init()
 {
-    if(inited)
+    if(NG(inited))
         return EALREADY;
     d7ap_init();
 
@@ -50,19 +51,19 @@ static error_t d7ap_interface_init()
         .transmitted_cb = d7ap_command_completed,
         .unsolicited_cb = command_from_d7ap
     };  
-    alp_client_id = d7ap_register(&alp_desc);
-    inited = true;
+    NG(alp_client_id) = d7ap_register(&alp_desc);
+    NG(inited) = true;
 
-    DPRINT("alp_client_id is %i",alp_client_id);
+    DPRINT("alp_client_id is %i",NG(alp_client_id));
     return SUCCESS;
 }
 
 static void d7ap_interface_stop()
 {
-    if(!inited)
+    if(!NG(inited))
         return;
     d7ap_stop();
-    inited = false;
+    NG(inited) = false;
 }
 
 static alp_interface_status_t serialize_session_result_to_alp_interface_status(const d7ap_session_result_t* session_result)
@@ -129,9 +130,9 @@ static error_t d7ap_alp_send(uint8_t* payload, uint8_t payload_length, uint8_t e
     DPRINT("sending D7 packet");
 
     if(itf_cfg != NULL) {
-        return d7ap_send(alp_client_id, (d7ap_session_config_t*)&itf_cfg->itf_config, payload, payload_length, expected_response_length, trans_id);
+        return d7ap_send(NG(alp_client_id), (d7ap_session_config_t*)&itf_cfg->itf_config, payload, payload_length, expected_response_length, trans_id);
     } else {
-        return d7ap_send(alp_client_id, NULL, payload, payload_length, expected_response_length, trans_id);
+        return d7ap_send(NG(alp_client_id), NULL, payload, payload_length, expected_response_length, trans_id);
     }
 }
 
@@ -148,7 +149,7 @@ static void d7ap_command_completed(uint16_t trans_id, error_t error) {
 
 void d7ap_interface_register()
 {
-    d7_alp_interface = (alp_interface_t) {
+    NG(d7_alp_interface) = (alp_interface_t) {
         .itf_id = 0xD7,
         .itf_cfg_len = sizeof(d7ap_session_config_t),
         .itf_status_len = sizeof(d7ap_session_result_t),
@@ -158,5 +159,5 @@ void d7ap_interface_register()
         .unique = true
     };
     
-    alp_layer_register_interface(&d7_alp_interface);
+    alp_layer_register_interface(&NG(d7_alp_interface));
 }
@@ -25,7 +25,6 @@
 
 #define ALP_CMD_MAX_SIZE 0xFF
 
-#include "hwatomic.h"
 #include "hwsystem.h"
 #include "types.h"
 #include "string.h"
@@ -64,9 +63,8 @@ static void serial_interface_cmd_handler(fifo_t* cmd_fifo)
 {
     error_t err;
     uint8_t alp_command_len=fifo_get_size(cmd_fifo);
-    start_atomic();
+    // cmd_fifo is a view on the modem interface RX ring, only accessed from task context
     err = fifo_pop(cmd_fifo, alp_command, alp_command_len); assert(err == SUCCESS); // pop full ALP command
-    end_atomic();
 
     alp_command_t* command = alp_layer_command_alloc(false, false);
     command->origin_itf_id = ALP_ITF_ID_SERIAL;
@@ -50,7 +50,7 @@ typedef enum {
     D7ANP_STATE_FOREGROUND_SCAN,
 } state_t;
 
-static state_t NGDEF(_d7anp_state) = D7ANP_STATE_STOPPED;
+static state_t NGDEF(_d7anp_state) = NGINIT(D7ANP_STATE_STOPPED);
 #define d7anp_state NG(_d7anp_state)
 
 static state_t NGDEF(_d7anp_prev_state);
@@ -70,11 +70,14 @@ static dae_nwl_trusted_node_t* NGDEF(_latest_node);
 #define latest_node NG(_latest_node)
 #endif
 
-static timer_event d7anp_fg_scan_expired_timer;
-static timer_event d7anp_start_fg_scan_after_d7aadvp_timer;
+// key schedule of the NWL security key, computed when the key file changes
+static aes128_ctx_t NGDEF(nwl_key_ctx);
 
-d7ap_addressee_id_type_t address_id_type;
-uint8_t address_id[8];
+static timer_event NGDEF(d7anp_fg_scan_expired_timer);
+static timer_event NGDEF(d7anp_start_fg_scan_after_d7aadvp_timer);
+
+static d7ap_addressee_id_type_t NGDEF(address_id_type);
+static uint8_t NGDEF(address_id)[8];
 
 #if defined(MODULE_D7AP_NLS_ENABLED)
 static inline uint8_t get_auth_len(uint8_t nls_method)
@@ -150,8 +153,8 @@ static void schedule_foreground_scan_expired_timer()
     // since this FG scan is started directly from the ISR (transmitted callback), I don't expect a significative delta between now and the transmission time
 
     DPRINT("starting foreground scan expiration timer (%i ticks, now %i)", fg_scan_timeout_ticks, timer_get_counter_value());
-    d7anp_fg_scan_expired_timer.next_event = fg_scan_timeout_ticks;
-    error_t rtc = timer_add_event(&d7anp_fg_scan_expired_timer);
+    NG(d7anp_fg_scan_expired_timer).next_event = fg_scan_timeout_ticks;
+    error_t rtc = timer_add_event(&NG(d7anp_fg_scan_expired_timer));
     assert(rtc == SUCCESS);
 }
 
@@ -180,7 +183,7 @@ void d7anp_set_foreground_scan_timeout(timer_tick_t timeout)
 
 static void cancel_foreground_scan_task()
 {
-    timer_cancel_event(&d7anp_fg_scan_expired_timer);
+    timer_cancel_event(&NG(d7anp_fg_scan_expired_timer));
     fg_scan_timeout_ticks = 0;
 }
 
@@ -207,7 +210,7 @@ void start_foreground_scan_after_D7AAdvP(void *arg)
 
 void d7anp_set_address_id(uint8_t file_id)
 {
-    d7ap_fs_read_uid(address_id);
+    d7ap_fs_read_uid(NG(address_id));
 }
 
 static void set_key(uint8_t file_id)
@@ -216,7 +219,7 @@ static void set_key(uint8_t file_id)
     assert(d7ap_fs_read_nwl_security_key(key) == SUCCESS);
     DPRINT("KEY");
     DPRINT_DATA(key, AES_BLOCK_SIZE);
-    AES128_init(key);
+    AES128_ctx_init(&NG(nwl_key_ctx), key);
 }
 
 void d7anp_init()
@@ -227,22 +230,22 @@ void d7anp_init()
     fg_scan_timeout_ticks = 0;
 
     // Initialize timers
-    timer_init_event(&d7anp_fg_scan_expired_timer, &foreground_scan_expired);
-    timer_init_event(&d7anp_start_fg_scan_after_d7aadvp_timer, &start_foreground_scan_after_D7AAdvP);
+    timer_init_event(&NG(d7anp_fg_scan_expired_timer), &foreground_scan_expired);
+    timer_init_event(&NG(d7anp_start_fg_scan_after_d7aadvp_timer), &start_foreground_scan_after_D7AAdvP);
 
     /*
      * vid or uid caching to prevent latency due to file access
      */
-    d7ap_fs_read_vid(address_id);
+    d7ap_fs_read_vid(NG(address_id));
 
     // vid is not valid when set to FF
-    if (memcmp(address_id, (uint8_t[2]){ 0xFF, 0xFF }, 2) == 0)
+    if (memcmp(NG(address_id), (uint8_t[2]){ 0xFF, 0xFF }, 2) == 0)
     {
         d7ap_fs_register_file_modified_callback(D7A_FILE_UID_FILE_ID, &d7anp_set_address_id);
-        d7ap_fs_read_uid(address_id);
-        address_id_type = ID_TYPE_UID;
+        d7ap_fs_read_uid(NG(address_id));
+        NG(address_id_type) = ID_TYPE_UID;
     } else
-        address_id_type = ID_TYPE_VID;
+        NG(address_id_type) = ID_TYPE_VID;
 
 #if defined(MODULE_D7AP_NLS_ENABLED)
     /*
@@ -266,8 +269,8 @@ void d7anp_init()
 void d7anp_stop()
 {
     d7anp_state = D7ANP_STATE_STOPPED;
-    timer_cancel_event(&d7anp_fg_scan_expired_timer);
-    timer_cancel_event(&d7anp_start_fg_scan_after_d7aadvp_timer);
+    timer_cancel_event(&NG(d7anp_fg_scan_expired_timer));
+    timer_cancel_event(&NG(d7anp_start_fg_scan_after_d7aadvp_timer));
 }
 
 error_t d7anp_tx_foreground_frame(packet_t* packet, bool should_include_origin_template)
@@ -290,7 +293,7 @@ error_t d7anp_tx_foreground_frame(packet_t* packet, bool should_include_origin_t
     }
     else
     {
-        packet->d7anp_ctrl.origin_id_type = address_id_type;
+        packet->d7anp_ctrl.origin_id_type = NG(address_id_type);
         packet->d7anp_ctrl.origin_void = false;
         // note we set packet->origin_access_class in DLL, since we cache the active access class there already
     }
@@ -328,8 +331,8 @@ security:
 static void schedule_foreground_scan_after_D7AAdvP(timer_tick_t eta)
 {
     DPRINT("Perform a dll foreground scan at the end of the delay period (%i ticks)", eta);
-    d7anp_start_fg_scan_after_d7aadvp_timer.next_event = eta;
-    error_t rtc = timer_add_event(&d7anp_start_fg_scan_after_d7aadvp_timer);
+    NG(d7anp_start_fg_scan_after_d7aadvp_timer).next_event = eta;
+    error_t rtc = timer_add_event(&NG(d7anp_start_fg_scan_after_d7aadvp_timer));
     assert(rtc == SUCCESS);
 }
 
@@ -393,12 +396,10 @@ static void build_iv(packet_t *packet, uint8_t payload_len, uint8_t *iv)
 uint8_t d7anp_secure_payload(packet_t *packet, uint8_t *payload, uint8_t payload_len)
 {
     uint8_t nls_method;
-    uint8_t ctr_blk[AES_BLOCK_SIZE];
-    uint8_t header[AES_BLOCK_SIZE];
-    uint8_t auth[AES_BLOCK_SIZE];
+    uint8_t iv[AES_BLOCK_SIZE];
     uint8_t auth_len;
-    uint8_t add[AES_BLOCK_SIZE];
-    uint8_t add_len = 0;
+    aes_sg_t add = { .data = NULL, .len = 0 };
+    aes_sg_t data = { .data = payload, .len = payload_len };
 
     DPRINT("Start Secure payload (len %d) ", payload_len );
     timer_tick_t time_elapsed = timer_get_counter_value();
@@ -410,33 +411,30 @@ uint8_t d7anp_secure_payload(packet_t *packet, uint8_t *payload, uint8_t payload
     /* When unicast access, add the auxiliary authentication data composed of the destination address */
     if(auth_len && !ID_TYPE_IS_BROADCAST(packet->d7anp_addressee->ctrl.id_type))
     {
-        add_len = packet->d7anp_addressee->ctrl.id_type == ID_TYPE_VID ? 2 : 8;
-        memcpy(add, packet->d7anp_addressee->id, add_len);
+        add.len = packet->d7anp_addressee->ctrl.id_type == ID_TYPE_VID ? 2 : 8;
+        add.data = packet->d7anp_addressee->id;
     }
 
     switch (nls_method)
     {
     case AES_CTR:
         // Build the initial counter block
-        build_iv(packet, payload_len, ctr_blk);
+        build_iv(packet, payload_len, iv);
 
         // the encrypted payload replaces the plaintext
-        AES128_CTR_encrypt(payload, payload, payload_len, ctr_blk);
+        AES128_CTR_encrypt_ctx(&NG(nwl_key_ctx), payload, payload, payload_len, iv);
         break;
     case AES_CBC_MAC_128:
     case AES_CBC_MAC_64:
     case AES_CBC_MAC_32:
         /* Build the header block to prepend to the payload */
-        build_header(packet, payload_len, header);
+        build_header(packet, payload_len, iv);
 
         /* Set Header flags */
-        header[0] |= ( add_len > 0 );
-
-        /* Compute the CBC-MAC */
-        AES128_CBC_MAC(auth, payload, payload_len, header, add, add_len, auth_len);
+        iv[0] |= ( add.len > 0 );
 
-        /* Insert the authentication Tag */
-        memcpy(payload + payload_len, auth, auth_len);
+        /* Compute the CBC-MAC and insert the authentication Tag */
+        AES128_CBC_MAC_ctx(&NG(nwl_key_ctx), payload + payload_len, payload, payload_len, iv, add.data, add.len, auth_len);
         break;
     case AES_CCM_128:
     case AES_CCM_64:
@@ -445,14 +443,13 @@ uint8_t d7anp_secure_payload(packet_t *packet, uint8_t *payload, uint8_t payload
          * For CCM, the same IV is used for the header block and the counter block
          * Bits 0-3 are set with the flags in AES-CCM header whereas they are set
          * to the Block counter for the CTR block*/
-        build_iv(packet, payload_len, header);
-        memcpy(ctr_blk, header, AES_BLOCK_SIZE);
+        build_iv(packet, payload_len, iv);
 
         /* Set Header flags */
-        header[0] |= ( add_len > 0 );
+        iv[0] |= ( add.len > 0 );
 
         // TODO check that the payload length does not exceed the maximum size
-        AES128_CCM_encrypt(payload, payload_len, header, add, add_len, ctr_blk, auth_len);
+        AES128_CCM_encrypt_sg(&NG(nwl_key_ctx), iv, iv, &add, 1, &data, 1, payload + payload_len, auth_len);
         break;
     }
 
@@ -464,8 +461,7 @@ uint8_t d7anp_secure_payload(packet_t *packet, uint8_t *payload, uint8_t payload
 bool d7anp_unsecure_payload(packet_t *packet, uint8_t index)
 {
     uint8_t nls_method;
-    uint8_t ctr_blk[AES_BLOCK_SIZE];
-    uint8_t header[AES_BLOCK_SIZE];
+    uint8_t iv[AES_BLOCK_SIZE];
     uint8_t auth[AES_BLOCK_SIZE];
     uint8_t auth_len;
     uint32_t payload_len;
@@ -505,25 +501,25 @@ bool d7anp_unsecure_payload(packet_t *packet, uint8_t index)
     {
     case AES_CTR:
         /* Build the initial counter block */
-        build_iv(packet, payload_len, ctr_blk);
+        build_iv(packet, payload_len, iv);
 
         // the decrypted payload replaces the encrypted data
-        AES128_CTR_encrypt(packet->hw_radio_packet.data + index,
+        AES128_CTR_encrypt_ctx(&NG(nwl_key_ctx), packet->hw_radio_packet.data + index,
                            packet->hw_radio_packet.data + index,
-                           payload_len, ctr_blk);
+                           payload_len, iv);
         break;
     case AES_CBC_MAC_128:
     case AES_CBC_MAC_64:
     case AES_CBC_MAC_32:
         /* Build the header block to prepend to the payload */
-        build_header(packet, payload_len, header);
+        build_header(packet, payload_len, iv);
 
         /* Set Header flags */
-        header[0] |= ( add_len > 0 );
+        iv[0] |= ( add_len > 0 );
 
         /* Compute the CBC-MAC and check the authentication Tag */
-        AES128_CBC_MAC(auth, packet->hw_radio_packet.data + index,
-                       payload_len, header, add, add_len, auth_len);
+        AES128_CBC_MAC_ctx(&NG(nwl_key_ctx), auth, packet->hw_radio_packet.data + index,
+                       payload_len, iv, add, add_len, auth_len);
 
         if (memcmp(auth, tag, auth_len) != 0)
         {
@@ -537,20 +533,27 @@ bool d7anp_unsecure_payload(packet_t *packet, uint8_t index)
     case AES_CCM_128:
     case AES_CCM_64:
     case AES_CCM_32:
+    {
+        aes_sg_t add_sg = { .data = add, .len = add_len };
+        aes_sg_t data = { .data = packet->hw_radio_packet.data + index, .len = payload_len };
+
+        /* For DASH7, the payload length shall be less than 250 - Security header len - authentication tag len */
+        if (payload_len > (250 - 5 - auth_len))
+            return false;
+
         /* For CCM, the same IV is used for the header block and the counter block */
-        build_iv(packet, payload_len, header);
-        memcpy(ctr_blk, header, AES_BLOCK_SIZE);
+        build_iv(packet, payload_len, iv);
 
         /* Set Header flags */
-        header[0] |= ( add_len > 0 );
+        iv[0] |= ( add_len > 0 );
 
-        if (AES128_CCM_decrypt(packet->hw_radio_packet.data + index,
-                               payload_len, header, add, add_len, ctr_blk,
-                               tag, auth_len) != 0)
+        if (AES128_CCM_decrypt_sg(&NG(nwl_key_ctx), iv, iv, &add_sg, 1, &data, 1, tag, auth_len) != SUCCESS)
             return false;
 
         /* remove the authentication Tag */
         packet->hw_radio_packet.length -= auth_len;
+        break;
+    }
     }
 
     return true;
@@ -570,14 +573,14 @@ uint8_t d7anp_assemble_packet_header(packet_t *packet, uint8_t *data_ptr)
 
         if (packet->d7anp_ctrl.origin_id_type == ID_TYPE_UID)
         {
-            memcpy(packet->origin_access_id, address_id, 8);
-            memcpy(data_ptr, address_id, 8);
+            memcpy(packet->origin_access_id, NG(address_id), 8);
+            memcpy(data_ptr, NG(address_id), 8);
             data_ptr += 8;
         }
         else if (packet->d7anp_ctrl.origin_id_type == ID_TYPE_VID)
         {
-            memcpy(packet->origin_access_id, address_id, 2);
-            memcpy(data_ptr, address_id, 2);
+            memcpy(packet->origin_access_id, NG(address_id), 2);
+            memcpy(data_ptr, NG(address_id), 2);
             data_ptr += 2;
         }
         else if (packet->d7anp_ctrl.origin_id_type == ID_TYPE_NBID)
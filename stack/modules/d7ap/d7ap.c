@@ -27,6 +27,7 @@
 #include "hwradio.h"
 #include "errors.h"
 #include "debug.h"
+#include "ng.h"
 #include "dae.h"
 #include "modules_defs.h"
 #include "MODULE_D7AP_defs.h"
@@ -47,27 +48,27 @@
 
 #define D7A_SECURITY_HEADER_SIZE 5
 
-d7ap_resource_desc_t registered_client[MODULE_D7AP_MAX_CLIENT_COUNT];
-uint8_t registered_client_nb = 0;
-bool inited = false;
+d7ap_resource_desc_t NGDEF(registered_client)[MODULE_D7AP_MAX_CLIENT_COUNT];
+uint8_t NGDEF(registered_client_nb) = NGINIT(0);
+static bool NGDEF(inited) = NGINIT(false);
 
 
 void d7ap_init()
 {
-    if(inited)
+    if(NG(inited))
         return;
-    inited = true;
+    NG(inited) = true;
 
     // Initialize the D7AP stack
     d7ap_stack_init();
-    registered_client_nb = 0;
+    NG(registered_client_nb) = 0;
 }
 
 void d7ap_stop()
 {
-    inited = false;
+    NG(inited) = false;
     d7ap_stack_stop();
-    registered_client_nb = 0;
+    NG(registered_client_nb) = 0;
 }
 
 /**
@@ -79,11 +80,11 @@ void d7ap_stop()
  */
 uint8_t d7ap_register(d7ap_resource_desc_t* desc)
 {
-    assert(inited);
-    assert(registered_client_nb < MODULE_D7AP_MAX_CLIENT_COUNT);
-    registered_client[registered_client_nb] = *desc;
-    registered_client_nb++;
-    return (registered_client_nb-1);
+    assert(NG(inited));
+    assert(NG(registered_client_nb) < MODULE_D7AP_MAX_CLIENT_COUNT);
+    NG(registered_client)[NG(registered_client_nb)] = *desc;
+    NG(registered_client_nb)++;
+    return (NG(registered_client_nb)-1);
 }
 
 //TODO to unregister, better to introduce a linked list for the registered clients
@@ -176,7 +177,7 @@ error_t d7ap_send(uint8_t client_id, d7ap_session_config_t* config, uint8_t* pay
 {
     error_t error;
 
-    if (client_id >= registered_client_nb)
+    if (client_id >= NG(registered_client_nb))
         return -ESIZE;
 
     error = d7ap_stack_send(client_id, config, payload, len, expected_response_len, trans_id);
@@ -70,12 +70,18 @@ struct d7asp_master_session {
     uint8_t requests_lengths[MODULE_D7AP_FIFO_MAX_REQUESTS_COUNT]; /**< Contains for every request ID the index in command_buffer the length of the ALP payload in that request */
     uint8_t response_lengths[MODULE_D7AP_FIFO_MAX_REQUESTS_COUNT]; /**< Contains for every request ID the index in command_buffer the expected length of the ALP response for the specific request */
     uint8_t request_buffer[MODULE_D7AP_FIFO_COMMAND_BUFFER_SIZE];
-    d7ap_addressee_t preferred_addressee;
+    timer_tick_t dormant_timeout_tick; /**< Time at which a dormant session becomes pending */
 };
 
-static d7asp_master_session_t NGDEF(_current_master_session); // TODO we only use 1 fifo for now, should be multiple later (1 per on unique addressee and QoS combination)
+// one FIFO per unique addressee and QoS combination, only one of them is flushed at a time
+static d7asp_master_session_t NGDEF(master_sessions)[MODULE_D7AP_FIFO_COUNT];
+
+static d7asp_master_session_t* NGDEF(_current_master_session);
 #define current_master_session NG(_current_master_session)
 
+// the preferred addressee is shared by all sessions, since it is the outcome of previous sessions
+static d7ap_addressee_t NGDEF(preferred_addressee);
+
 static uint8_t NGDEF(_current_request_id); // TODO move ?
 #define current_request_id NG(_current_request_id)
 
@@ -91,8 +97,8 @@ static uint8_t NGDEF(_single_request_retry_limit);
 static packet_t* NGDEF(_current_response_packet);
 #define current_response_packet NG(_current_response_packet)
 
-static timer_event current_session_timer;
-static timer_event dormant_session_timer;
+static timer_event NGDEF(current_session_timer);
+static timer_event NGDEF(dormant_session_timer);
 
 typedef enum {
     D7ASP_STATE_STOPPED,
@@ -109,31 +115,47 @@ typedef struct {
   uint8_t id[8];
 } lowest_lb_responder_t;
 
-static lowest_lb_responder_t current_responder_lowest_lb;
+static lowest_lb_responder_t NGDEF(current_responder_lowest_lb);
 
 #define LB_MAX 140
 
-static state_t NGDEF(_state) = D7ASP_STATE_STOPPED;
+static state_t NGDEF(_state) = NGINIT(D7ASP_STATE_STOPPED);
 #define d7asp_state NG(_state)
 
 static void switch_state(state_t new_state);
 
 static void mark_current_request_done()
 {
-    bitmap_set(current_master_session.progress_bitmap, current_request_id);
+    bitmap_set(current_master_session->progress_bitmap, current_request_id);
     // current_request_packet will be free-ed in the packet_queue when the transaction is completed
 }
 
 static void mark_current_request_successful()
 {
-    bitmap_set(current_master_session.success_bitmap, current_request_id);
+    bitmap_set(current_master_session->success_bitmap, current_request_id);
+}
+
+static d7asp_master_session_t* get_master_session_from_token(uint8_t session_token)
+{
+    for(uint8_t i = 0; i < MODULE_D7AP_FIFO_COUNT; i++)
+    {
+        // the tokens are unique over all FIFOs, idle included: a session created by d7asp_master_session_create()
+        // stays idle until its first request is queued
+        if(NG(master_sessions)[i].token == session_token)
+            return &(NG(master_sessions)[i]);
+    }
+
+    return NULL;
 }
 
 static void init_master_session(d7asp_master_session_t* session) {
     session->state = D7ASP_MASTER_SESSION_IDLE;
+    session->token = 0;
+    uint8_t token;
     do {
-        session->token = get_rnd() % 0xFF;
-    } while(session->token == 0);
+        token = get_rnd() % 0xFF;
+    } while(token == 0 || get_master_session_from_token(token) != NULL);
+    session->token = token;
     memset(session->progress_bitmap, 0x00, REQUESTS_BITMAP_BYTE_COUNT);
     memset(session->success_bitmap, 0x00, REQUESTS_BITMAP_BYTE_COUNT);
     session->next_request_id = 0;
@@ -142,11 +164,52 @@ static void init_master_session(d7asp_master_session_t* session) {
     memset(session->requests_lengths, 0x00, MODULE_D7AP_FIFO_MAX_REQUESTS_COUNT);
     memset(session->response_lengths, 255, MODULE_D7AP_FIFO_MAX_REQUESTS_COUNT);
     memset(session->request_buffer, 0x00, MODULE_D7AP_FIFO_COMMAND_BUFFER_SIZE);
+}
+
+static bool is_master_session_pending(d7asp_master_session_t* session)
+{
+    return session->state == D7ASP_MASTER_SESSION_PENDING ||
+           session->state == D7ASP_MASTER_SESSION_PENDING_DORMANT_TIMEOUT ||
+           session->state == D7ASP_MASTER_SESSION_PENDING_DORMANT_TRIGGERED;
+}
+
+/*
+ * Selects the next FIFO to flush. A dormant session triggered by a request of its addressee goes first,
+ * the other pending sessions are served round robin starting after the current one.
+ */
+static d7asp_master_session_t* select_pending_master_session()
+{
+    uint8_t current_index = current_master_session - NG(master_sessions);
+    d7asp_master_session_t* selected = NULL;
+
+    for(uint8_t i = 1; i <= MODULE_D7AP_FIFO_COUNT; i++)
+    {
+        d7asp_master_session_t* session = &(NG(master_sessions)[(current_index + i) % MODULE_D7AP_FIFO_COUNT]);
+        if(session->state == D7ASP_MASTER_SESSION_PENDING_DORMANT_TRIGGERED)
+            return session;
+
+        if(selected == NULL && is_master_session_pending(session))
+            selected = session;
+    }
+
+    return selected;
+}
 
-    // TODO we don't reset preferred_addressee field for now
-    // for now one ALP command execution mostly results one new session, which
-    // would break the preferred addressee mechanism. For now this is cached regardless
-    // over the session, until we decide on session lifetime etc
+static void schedule_current_session();
+
+static bool start_next_master_session()
+{
+    assert(d7asp_state == D7ASP_STATE_IDLE);
+
+    d7asp_master_session_t* session = select_pending_master_session();
+    if(session == NULL)
+        return false;
+
+    DPRINT("Next session to flush %d", session->token);
+    current_master_session = session;
+    switch_state(D7ASP_STATE_PENDING_MASTER);
+    schedule_current_session();
+    return true;
 }
 
 static void flush_completed() {
@@ -156,21 +219,22 @@ static void flush_completed() {
     // the RETRY_MODE pattern defined in the Configuration file
 
     // single flush of the FIFO without retry
-    d7ap_stack_session_completed(current_master_session.token, current_master_session.progress_bitmap,
-                                   current_master_session.success_bitmap, current_master_session.next_request_id - 1);
-    init_master_session(&current_master_session);
-    current_master_session.state = D7ASP_MASTER_SESSION_IDLE;
+    d7ap_stack_session_completed(current_master_session->token, current_master_session->progress_bitmap,
+                                   current_master_session->success_bitmap, current_master_session->next_request_id - 1);
+    init_master_session(current_master_session);
+    current_master_session->state = D7ASP_MASTER_SESSION_IDLE;
     d7atp_signal_dialog_termination();
     switch_state(D7ASP_STATE_IDLE);
+    start_next_master_session();
 }
 
 static void schedule_current_session() {
     assert(d7asp_state == D7ASP_STATE_MASTER || d7asp_state == D7ASP_STATE_PENDING_MASTER || d7asp_state == D7ASP_STATE_SLAVE);
-    assert(current_master_session.state >= D7ASP_MASTER_SESSION_PENDING);
+    assert(current_master_session->state >= D7ASP_MASTER_SESSION_PENDING);
 
     DPRINT("Re-schedule immediately the current session");
-    current_session_timer.next_event = 0;
-    int rtc = timer_add_event(&current_session_timer);
+    NG(current_session_timer).next_event = 0;
+    int rtc = timer_add_event(&NG(current_session_timer));
     assert(rtc == SUCCESS);
 }
 
@@ -184,31 +248,31 @@ static void flush_fifos()
         return;
     }
 
-    if(current_master_session.state != D7ASP_MASTER_SESSION_PENDING &&
-       current_master_session.state != D7ASP_MASTER_SESSION_ACTIVE &&
-       current_master_session.state != D7ASP_MASTER_SESSION_PENDING_DORMANT_TIMEOUT &&
-       current_master_session.state != D7ASP_MASTER_SESSION_PENDING_DORMANT_TRIGGERED) {
+    if(current_master_session->state != D7ASP_MASTER_SESSION_PENDING &&
+       current_master_session->state != D7ASP_MASTER_SESSION_ACTIVE &&
+       current_master_session->state != D7ASP_MASTER_SESSION_PENDING_DORMANT_TIMEOUT &&
+       current_master_session->state != D7ASP_MASTER_SESSION_PENDING_DORMANT_TRIGGERED) {
       DPRINT("No sessions in pending or active state, skipping");
       return;
     }
 
-    bool is_triggered_dormant_session = (current_master_session.state == D7ASP_MASTER_SESSION_PENDING_DORMANT_TRIGGERED);
-    current_master_session.state = D7ASP_MASTER_SESSION_ACTIVE;
+    bool is_triggered_dormant_session = (current_master_session->state == D7ASP_MASTER_SESSION_PENDING_DORMANT_TRIGGERED);
+    current_master_session->state = D7ASP_MASTER_SESSION_ACTIVE;
     if (d7asp_state == D7ASP_STATE_PENDING_MASTER)
     {
         switch_state(D7ASP_STATE_MASTER);
-        d7ap_stack_signal_active_master_session(current_master_session.token);
+        d7ap_stack_signal_active_master_session(current_master_session->token);
     }
 
-    current_responder_lowest_lb.lb = LB_MAX;
+    NG(current_responder_lowest_lb).lb = LB_MAX;
     DPRINT("Flushing FIFOs");
     hw_watchdog_feed(); // TODO do here?
 
     if (current_request_id == NO_ACTIVE_REQUEST_ID)
     {
         // find first request which is not acked or dropped
-        int8_t found_next_req_index = bitmap_search(current_master_session.progress_bitmap, false, MODULE_D7AP_FIFO_MAX_REQUESTS_COUNT);
-        if (found_next_req_index == -1 || found_next_req_index == current_master_session.next_request_id)
+        int8_t found_next_req_index = bitmap_search(current_master_session->progress_bitmap, false, MODULE_D7AP_FIFO_MAX_REQUESTS_COUNT);
+        if (found_next_req_index == -1 || found_next_req_index == current_master_session->next_request_id)
         {
             // we handled all requests ...
             flush_completed();
@@ -222,20 +286,20 @@ static void flush_fifos()
         current_request_packet = packet_queue_alloc_packet();
         assert(current_request_packet);
         packet_queue_mark_processing(current_request_packet);
-        current_request_packet->d7anp_addressee = &(current_master_session.config.addressee); // TODO explicitly pass addressee down the stack layers?
+        current_request_packet->d7anp_addressee = &(current_master_session->config.addressee); // TODO explicitly pass addressee down the stack layers?
 
-        if(current_master_session.config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED
-           && memcmp(current_master_session.preferred_addressee.id,(uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8) != 0)
+        if(current_master_session->config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED
+           && memcmp(NG(preferred_addressee).id,(uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8) != 0)
         {
             DPRINT("overriding addressee with preferred one");
-            current_master_session.preferred_addressee.access_class = current_master_session.config.addressee.access_class;
-            current_master_session.preferred_addressee.ctrl.nls_method = current_master_session.config.addressee.ctrl.nls_method;
-            current_master_session.config.addressee.ctrl.id_type = ID_TYPE_UID; // TODO no VID for now
-            current_request_packet->d7anp_addressee = &current_master_session.preferred_addressee;
+            NG(preferred_addressee).access_class = current_master_session->config.addressee.access_class;
+            NG(preferred_addressee).ctrl.nls_method = current_master_session->config.addressee.ctrl.nls_method;
+            current_master_session->config.addressee.ctrl.id_type = ID_TYPE_UID; // TODO no VID for now
+            current_request_packet->d7anp_addressee = &NG(preferred_addressee);
         }
 
-        memcpy(current_request_packet->payload, current_master_session.request_buffer + current_master_session.requests_indices[current_request_id], current_master_session.requests_lengths[current_request_id]);
-        current_request_packet->payload_length = current_master_session.requests_lengths[current_request_id];
+        memcpy(current_request_packet->payload, current_master_session->request_buffer + current_master_session->requests_indices[current_request_id], current_master_session->requests_lengths[current_request_id]);
+        current_request_packet->payload_length = current_master_session->requests_lengths[current_request_id];
 
         if(is_triggered_dormant_session)
         {
@@ -273,8 +337,8 @@ static void flush_fifos()
     }
 
     uint8_t listen_timeout = 0; // TODO calculate timeout (and update during transaction lifetime) (based on Tc, channel, cs, payload size, # msgs, # retries)
-    ret = d7atp_send_request(current_master_session.token, current_request_id, (current_request_id == current_master_session.next_request_id - 1),
-                       current_request_packet, &current_master_session.config.qos, listen_timeout, current_master_session.response_lengths[current_request_id]);
+    ret = d7atp_send_request(current_master_session->token, current_request_id, (current_request_id == current_master_session->next_request_id - 1),
+                       current_request_packet, &current_master_session->config.qos, listen_timeout, current_master_session->response_lengths[current_request_id]);
     if (ret == EPERM)
     {
         // this is probably because no further encryption is possible (frame counter reaches the maximum value)
@@ -350,25 +414,52 @@ static void switch_state(state_t new_state)
     }
 }
 
+// the dormant session timer is shared by all sessions and always set to the first dormant timeout to expire
+static void schedule_dormant_session_timer() {
+  timer_tick_t now = timer_get_counter_value();
+  d7asp_master_session_t* first = NULL;
+
+  for(uint8_t i = 0; i < MODULE_D7AP_FIFO_COUNT; i++) {
+    d7asp_master_session_t* session = &(NG(master_sessions)[i]);
+    if(session->state == D7ASP_MASTER_SESSION_DORMANT &&
+       (first == NULL || (int32_t)(session->dormant_timeout_tick - first->dormant_timeout_tick) < 0))
+      first = session;
+  }
+
+  if(first == NULL) {
+    timer_cancel_event(&NG(dormant_session_timer));
+    return;
+  }
+
+  int32_t remaining = first->dormant_timeout_tick - now;
+  NG(dormant_session_timer).next_event = remaining > 0 ? remaining : 0;
+  error_t rtc = timer_add_event(&NG(dormant_session_timer));
+  assert(rtc == SUCCESS);
+}
+
 static void dormant_session_timeout() {
-  // TODO pass session so we can have multiple
-  DPRINT("dormant session timeout");
-  if(current_master_session.state == D7ASP_MASTER_SESSION_DORMANT) {
-    current_master_session.state = D7ASP_MASTER_SESSION_PENDING_DORMANT_TIMEOUT;
-    if(d7asp_state == D7ASP_STATE_IDLE)
-      d7asp_state = D7ASP_STATE_PENDING_MASTER;
+  timer_tick_t now = timer_get_counter_value();
 
-    schedule_current_session();
+  for(uint8_t i = 0; i < MODULE_D7AP_FIFO_COUNT; i++) {
+    d7asp_master_session_t* session = &(NG(master_sessions)[i]);
+    if(session->state == D7ASP_MASTER_SESSION_DORMANT && (int32_t)(session->dormant_timeout_tick - now) <= 0) {
+      DPRINT("dormant session %d timeout", session->token);
+      session->state = D7ASP_MASTER_SESSION_PENDING_DORMANT_TIMEOUT;
+    }
   }
+
+  if(d7asp_state == D7ASP_STATE_IDLE)
+    start_next_master_session();
+
+  schedule_dormant_session_timer();
 }
 
 static void schedule_dormant_session(d7asp_master_session_t* dormant_session) {
   assert(dormant_session->state == D7ASP_MASTER_SESSION_DORMANT);
   timer_tick_t timeout = CT_DECOMPRESS(dormant_session->config.dormant_timeout);
   DPRINT("Sched dormant timeout in %i s", timeout);
-  dormant_session_timer.next_event = timeout * 1024;
-  error_t rtc = timer_add_event(&dormant_session_timer);
-  assert(rtc == SUCCESS);
+  dormant_session->dormant_timeout_tick = timer_get_counter_value() + timeout * 1024;
+  schedule_dormant_session_timer();
 }
 
 void d7asp_init()
@@ -378,78 +469,85 @@ void d7asp_init()
     d7asp_state = D7ASP_STATE_IDLE;
     current_request_id = NO_ACTIVE_REQUEST_ID;
 
-    current_master_session.state = D7ASP_MASTER_SESSION_IDLE;
-    memcpy(current_responder_lowest_lb.id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
-    memcpy(current_master_session.preferred_addressee.id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
+    for(uint8_t i = 0; i < MODULE_D7AP_FIFO_COUNT; i++)
+        NG(master_sessions)[i].state = D7ASP_MASTER_SESSION_IDLE;
+
+    current_master_session = &(NG(master_sessions)[0]);
+    memcpy(NG(current_responder_lowest_lb).id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
+    memcpy(NG(preferred_addressee).id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
     DPRINT("REQUESTS_BITMAP_BYTE_COUNT %d", REQUESTS_BITMAP_BYTE_COUNT);
     DPRINT("FIFO_MAX_REQUESTS_COUNT %d", MODULE_D7AP_FIFO_MAX_REQUESTS_COUNT);
+    DPRINT("FIFO_COUNT %d", MODULE_D7AP_FIFO_COUNT);
 
-    timer_init_event(&dormant_session_timer, &dormant_session_timeout);
-    timer_init_event(&current_session_timer, &flush_fifos);
+    timer_init_event(&NG(dormant_session_timer), &dormant_session_timeout);
+    timer_init_event(&NG(current_session_timer), &flush_fifos);
 }
 
 void d7asp_stop()
 {
     d7asp_state = D7ASP_STATE_STOPPED;
-    timer_cancel_event(&current_session_timer);
-    timer_cancel_event(&dormant_session_timer);
+    timer_cancel_event(&NG(current_session_timer));
+    timer_cancel_event(&NG(dormant_session_timer));
+}
+
+// the full QoS has to match, a request with other response, retry or stop on error settings gets its own FIFO
+static bool is_master_session_compatible(d7asp_master_session_t* session, d7ap_session_config_t* config)
+{
+    return (session->config.qos.raw == config->qos.raw) &&
+           (session->config.addressee.access_class == config->addressee.access_class) &&
+           (session->config.addressee.ctrl.nls_method == config->addressee.ctrl.nls_method) &&
+           (config->qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED ||
+            (session->config.addressee.ctrl.id_type == config->addressee.ctrl.id_type &&
+             memcmp(session->config.addressee.id, config->addressee.id, d7ap_addressee_id_length(config->addressee.ctrl.id_type)) == 0));
 }
 
 uint8_t d7asp_master_session_create(d7ap_session_config_t* d7asp_master_session_config) {
-    // TODO for now we assume only one concurrent session, in the future we should dynamically allocate (or return from pool) a session
+    d7asp_master_session_t* session = NULL;
 
-    if (current_master_session.state != D7ASP_MASTER_SESSION_IDLE)
+    // Requests can be pushed in the FIFO of a compatible session by upper layer anytime
+    for(uint8_t i = 0; i < MODULE_D7AP_FIFO_COUNT; i++)
     {
-        // Requests can be pushed in the FIFO by upper layer anytime
-        if ((current_master_session.config.addressee.access_class == d7asp_master_session_config->addressee.access_class) &&
-                (current_master_session.config.addressee.ctrl.nls_method == d7asp_master_session_config->addressee.ctrl.nls_method) &&
-                ((d7asp_master_session_config->qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED && current_master_session.config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED) ||
-                (current_master_session.config.addressee.ctrl.id_type == d7asp_master_session_config->addressee.ctrl.id_type && 
-                memcmp(current_master_session.config.addressee.id, d7asp_master_session_config->addressee.id, d7ap_addressee_id_length(d7asp_master_session_config->addressee.ctrl.id_type)) == 0)))
-            return current_master_session.token;
-        else
-            return 0;
-        // TODO create a pending session or a dormant session if TO (DORM_TIMER) !=0
-    }
+        if(NG(master_sessions)[i].state != D7ASP_MASTER_SESSION_IDLE &&
+           is_master_session_compatible(&(NG(master_sessions)[i]), d7asp_master_session_config))
+            return NG(master_sessions)[i].token;
 
-    DPRINT("current master session state %d", current_master_session.state);
+        if(session == NULL && NG(master_sessions)[i].state == D7ASP_MASTER_SESSION_IDLE)
+            session = &(NG(master_sessions)[i]);
+    }
 
+    if(session == NULL)
+    {
+        DPRINT("All %d FIFOs are in use", MODULE_D7AP_FIFO_COUNT);
+        return 0;
+    }
 
-    init_master_session(&current_master_session);
+    init_master_session(session);
 
-    DPRINT("Create master session %d", current_master_session.token);
+    DPRINT("Create master session %d", session->token);
 
-    current_master_session.config.qos = d7asp_master_session_config->qos;
-    current_master_session.config.dormant_timeout = d7asp_master_session_config->dormant_timeout;
-    current_master_session.config.addressee.ctrl = d7asp_master_session_config->addressee.ctrl;
-    current_master_session.config.addressee.access_class = d7asp_master_session_config->addressee.access_class;
+    session->config.qos = d7asp_master_session_config->qos;
+    session->config.dormant_timeout = d7asp_master_session_config->dormant_timeout;
+    session->config.addressee.ctrl = d7asp_master_session_config->addressee.ctrl;
+    session->config.addressee.access_class = d7asp_master_session_config->addressee.access_class;
 
-    if(current_master_session.config.qos.qos_resp_mode != SESSION_RESP_MODE_PREFERRED) {
-      memcpy(current_master_session.config.addressee.id, d7asp_master_session_config->addressee.id, sizeof(current_master_session.config.addressee.id));
+    if(session->config.qos.qos_resp_mode != SESSION_RESP_MODE_PREFERRED) {
+      memcpy(session->config.addressee.id, d7asp_master_session_config->addressee.id, sizeof(session->config.addressee.id));
     } else {
       // in this case we don't reset the preferred addressee.
       // for now one ALP command execution mostly results one new session, which
       // would break the preferred addressee mechanism. For now this is cached regardless
       // over the session, until we decide on session lifetime etc.
-      current_master_session.config.addressee.id[0] = d7asp_master_session_config->addressee.id[0];
+      session->config.addressee.id[0] = d7asp_master_session_config->addressee.id[0];
       assert(d7asp_master_session_config->addressee.ctrl.id_type == ID_TYPE_NBID
              || d7asp_master_session_config->addressee.ctrl.id_type == ID_TYPE_NOID);
     }
 
-    if(current_master_session.config.dormant_timeout) {
-      current_master_session.state = D7ASP_MASTER_SESSION_DORMANT;
-      schedule_dormant_session(&current_master_session);
+    if(session->config.dormant_timeout) {
+      session->state = D7ASP_MASTER_SESSION_DORMANT;
+      schedule_dormant_session(session);
     }
 
-    return current_master_session.token;
-}
-
-static d7asp_master_session_t* get_master_session_from_token(uint8_t session_token)
-{
-    //TODO handle a list of sessions
-    //for now, return systematically the current master session
-    assert(current_master_session.token == session_token);
-    return(&current_master_session);
+    return session->token;
 }
 
 error_t d7asp_send_response(uint8_t* payload, uint8_t length)
@@ -468,7 +566,7 @@ error_t d7asp_send_response(uint8_t* payload, uint8_t length)
     memcpy(current_response_packet->payload, payload, length);
 
     // check if there is a pending session
-    if (current_master_session.state == D7ASP_MASTER_SESSION_ACTIVE)
+    if (current_master_session->state == D7ASP_MASTER_SESSION_ACTIVE)
         switch_state(D7ASP_STATE_SLAVE_PENDING_MASTER);
     else
         switch_state(D7ASP_STATE_SLAVE);
@@ -513,19 +611,17 @@ uint8_t d7asp_queue_request(uint8_t session_token, uint8_t* alp_payload_buffer,
     session->request_buffer_tail_idx += alp_payload_length + 1;
     session->next_request_id++;
 
-    if(current_master_session.state == D7ASP_MASTER_SESSION_IDLE) {
-      current_master_session.state = D7ASP_MASTER_SESSION_PENDING;
+    if(session->state == D7ASP_MASTER_SESSION_IDLE) {
+      session->state = D7ASP_MASTER_SESSION_PENDING;
       DPRINT("converting IDLE session to PENDING");
-    } else if(current_master_session.state == D7ASP_MASTER_SESSION_DORMANT) {
+    } else if(session->state == D7ASP_MASTER_SESSION_DORMANT) {
       DPRINT("session is dormant, not activating");
     }
 
     // TODO for master only set to pending when asked by upper layer (ie new function call)
-    if ((d7asp_state == D7ASP_STATE_IDLE) && (current_master_session.state != D7ASP_MASTER_SESSION_DORMANT))
-    {
-        switch_state(D7ASP_STATE_PENDING_MASTER);
-        schedule_current_session();
-    }
+    // when another session is being flushed, this one is selected after it completes
+    if ((d7asp_state == D7ASP_STATE_IDLE) && (session->state != D7ASP_MASTER_SESSION_DORMANT))
+        start_next_master_session();
     else if (d7asp_state == D7ASP_STATE_SLAVE)
         switch_state(D7ASP_STATE_SLAVE_PENDING_MASTER);
 
@@ -555,41 +651,41 @@ void d7asp_process_received_response(packet_t* packet, bool extension)
     };
 
     assert(d7asp_state == D7ASP_STATE_MASTER);
-    assert(packet->d7atp_dialog_id == current_master_session.token);
+    assert(packet->d7atp_dialog_id == current_master_session->token);
     assert(packet->d7atp_transaction_id == current_request_id);
 
     // received ack
     DPRINT("Received ACK for request ID %d", current_request_id);
-    if (current_master_session.config.qos.qos_resp_mode != SESSION_RESP_MODE_NO
-       && current_master_session.config.qos.qos_resp_mode != SESSION_RESP_MODE_NO_RPT)
+    if (current_master_session->config.qos.qos_resp_mode != SESSION_RESP_MODE_NO
+       && current_master_session->config.qos.qos_resp_mode != SESSION_RESP_MODE_NO_RPT)
     {
         // for SESSION_RESP_MODE_NO and SESSION_RESP_MODE_NO_RPT the request was already marked as done
         // upon successfull CSMA insertion. We don't care about response in these cases.
 
-        if((current_master_session.config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED) 
-            && (current_master_session.config.addressee.ctrl.id_type == ID_TYPE_UID) 
+        if((current_master_session->config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED) 
+            && (current_master_session->config.addressee.ctrl.id_type == ID_TYPE_UID) 
             && (packet->d7atp_ctrl.ctrl_xoff)) {
             DPRINT("preferred gateway answered that it should not be preferred, this should not count as an ACK");
-            memcpy(current_master_session.preferred_addressee.id,
+            memcpy(NG(preferred_addressee).id,
                 (uint8_t[8]) { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
-            memcpy(current_responder_lowest_lb.id, (uint8_t[8]) { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
+            memcpy(NG(current_responder_lowest_lb).id, (uint8_t[8]) { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
             packet_queue_free_packet(packet);
             return;
         }
 
-        result.fifo_token = current_master_session.token;
+        result.fifo_token = current_master_session->token;
         result.seqnr = current_request_id;
         mark_current_request_successful();
         mark_current_request_done();
-        if(current_master_session.config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED
-           && ID_TYPE_IS_BROADCAST(current_master_session.config.addressee.ctrl.id_type))
+        if(current_master_session->config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED
+           && ID_TYPE_IS_BROADCAST(current_master_session->config.addressee.ctrl.id_type))
         {
-            if(result.link_budget < current_responder_lowest_lb.lb && (!packet->d7atp_ctrl.ctrl_xoff))
+            if(result.link_budget < NG(current_responder_lowest_lb).lb && (!packet->d7atp_ctrl.ctrl_xoff))
             {
-                memcpy(current_responder_lowest_lb.id, result.addressee.id, 8); // TODO assume UID for now
-                current_responder_lowest_lb.lb = result.link_budget;
-                DPRINT("current responder with lowest LB %i:", current_responder_lowest_lb.lb);
-                DPRINT_DATA(current_responder_lowest_lb.id, 8);
+                memcpy(NG(current_responder_lowest_lb).id, result.addressee.id, 8); // TODO assume UID for now
+                NG(current_responder_lowest_lb).lb = result.link_budget;
+                DPRINT("current responder with lowest LB %i:", NG(current_responder_lowest_lb).lb);
+                DPRINT_DATA(NG(current_responder_lowest_lb).id, 8);
             }
         }
         assert(packet != current_request_packet);
@@ -600,7 +696,7 @@ void d7asp_process_received_response(packet_t* packet, bool extension)
     packet_queue_free_packet(packet); // ACK can be cleaned
 
     /* In case of unicast session, it is acceptable to switch to the next request before the expiration of Tc */
-    if (!ID_TYPE_IS_BROADCAST(current_master_session.config.addressee.ctrl.id_type))
+    if (!ID_TYPE_IS_BROADCAST(current_master_session->config.addressee.ctrl.id_type))
     {
         DPRINT("Request completed, don't wait end of transaction");
         packet_queue_free_packet(current_request_packet);
@@ -608,7 +704,7 @@ void d7asp_process_received_response(packet_t* packet, bool extension)
         // terminate the dialog if all request handled
         // we need to switch to the state idle otherwise we may receive a new packet before the task flush_fifos is handled
         // in this case, we may assert since the state remains MASTER
-        if (current_request_id == current_master_session.next_request_id - 1)
+        if (current_request_id == current_master_session->next_request_id - 1)
         {
             flush_completed();
             return;
@@ -619,13 +715,13 @@ void d7asp_process_received_response(packet_t* packet, bool extension)
         // d7atp_stop_transaction(); //TO BE CHECKED THAT COMMENTING THIS OUT HAS NO NEGATIVE EFFECT
     }
     // switch to the state slave when the D7ATP Dialog Extension Procedure is initiated and all request are handled
-    else if ((extension) && (current_request_id == current_master_session.next_request_id - 1))
+    else if ((extension) && (current_request_id == current_master_session->next_request_id - 1))
     {
         DPRINT("Dialog Extension Procedure is initiated, mark the FIFO flush "
                "completed before switching to a responder state");
-        d7ap_stack_session_completed(current_master_session.token, current_master_session.progress_bitmap,
-                                     current_master_session.success_bitmap, current_master_session.next_request_id - 1);
-        current_master_session.state = D7ASP_MASTER_SESSION_IDLE;
+        d7ap_stack_session_completed(current_master_session->token, current_master_session->progress_bitmap,
+                                     current_master_session->success_bitmap, current_master_session->next_request_id - 1);
+        current_master_session->state = D7ASP_MASTER_SESSION_IDLE;
         switch_state(D7ASP_STATE_SLAVE);
     }
 }
@@ -670,11 +766,19 @@ bool d7asp_process_received_packet(packet_t* packet)
         expect_upper_layer_resp_payload = d7ap_stack_process_unsolicited_request(packet->payload, packet->payload_length, result, packet->d7atp_ctrl.ctrl_is_ack_requested);
     }
 
-    if (current_master_session.state == D7ASP_MASTER_SESSION_DORMANT &&
-        (!ID_TYPE_IS_BROADCAST(packet->dll_header.control_target_id_type)) &&
-        memcmp(current_master_session.config.addressee.id, packet->d7anp_addressee->id, d7ap_addressee_id_length(packet->d7anp_addressee->ctrl.id_type)) == 0) {
-        DPRINT("pending dormant session for requester");
-        current_master_session.state = D7ASP_MASTER_SESSION_PENDING_DORMANT_TRIGGERED;
+    d7asp_master_session_t* triggered_session = NULL;
+    for(uint8_t i = 0; i < MODULE_D7AP_FIFO_COUNT; i++)
+    {
+        d7asp_master_session_t* session = &(NG(master_sessions)[i]);
+        if (session->state == D7ASP_MASTER_SESSION_DORMANT &&
+            (!ID_TYPE_IS_BROADCAST(packet->dll_header.control_target_id_type)) &&
+            memcmp(session->config.addressee.id, packet->d7anp_addressee->id, d7ap_addressee_id_length(packet->d7anp_addressee->ctrl.id_type)) == 0) {
+            DPRINT("pending dormant session %d for requester", session->token);
+            session->state = D7ASP_MASTER_SESSION_PENDING_DORMANT_TRIGGERED;
+        }
+
+        if (session->state == D7ASP_MASTER_SESSION_PENDING_DORMANT_TRIGGERED && triggered_session == NULL)
+            triggered_session = session;
     }
 
     /*
@@ -682,7 +786,7 @@ bool d7asp_process_received_packet(packet_t* packet)
      * and a master session is pending
      */
     if ((!ID_TYPE_IS_BROADCAST(packet->dll_header.control_target_id_type)) &&
-        (d7asp_state == D7ASP_STATE_SLAVE) && (current_master_session.state == D7ASP_MASTER_SESSION_PENDING_DORMANT_TRIGGERED))
+        (d7asp_state == D7ASP_STATE_SLAVE) && (triggered_session != NULL))
     {
         packet->d7atp_ctrl.ctrl_is_start = true;
         packet->d7atp_ctrl.ctrl_tl = true;
@@ -702,7 +806,7 @@ bool d7asp_process_received_packet(packet_t* packet)
         // TX duration for dormant session
         estimated_tl += phy_calculate_tx_duration(packet->phy_config.rx.channel_id.channel_header.ch_class,
                                                   packet->phy_config.rx.channel_id.channel_header.ch_coding,
-                                                  current_master_session.requests_lengths[0], false); // TODO assuming 1 queued request for now
+                                                  triggered_session->requests_lengths[0], false); // TODO assuming 1 queued request for now
         DPRINT("Dormant session estimated Tl=%i", estimated_tl);
         packet->d7atp_tl = compress_data(estimated_tl, true);
     }
@@ -736,22 +840,22 @@ static void on_request_completed()
     assert(d7asp_state == D7ASP_STATE_MASTER);
     DPRINT("request completed");
 
-    if(current_master_session.config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED) {
-      memcpy(current_master_session.preferred_addressee.id, current_responder_lowest_lb.id, 8); // TODO assume UID for now
-      current_master_session.preferred_addressee.ctrl.id_type = ID_TYPE_UID;
+    if(current_master_session->config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED) {
+      memcpy(NG(preferred_addressee).id, NG(current_responder_lowest_lb).id, 8); // TODO assume UID for now
+      NG(preferred_addressee).ctrl.id_type = ID_TYPE_UID;
 
-      DPRINT("preferred addressee with LB %i is now:", current_responder_lowest_lb.lb);
-      DPRINT_DATA(current_master_session.preferred_addressee.id, 8);
+      DPRINT("preferred addressee with LB %i is now:", NG(current_responder_lowest_lb).lb);
+      DPRINT_DATA(NG(preferred_addressee).id, 8);
     }
 
-    if (!bitmap_get(current_master_session.progress_bitmap, current_request_id))
+    if (!bitmap_get(current_master_session->progress_bitmap, current_request_id))
     {
-        if(current_master_session.config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED
-          && memcmp(current_master_session.preferred_addressee.id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8) != 0)
+        if(current_master_session->config.qos.qos_resp_mode == SESSION_RESP_MODE_PREFERRED
+          && memcmp(NG(preferred_addressee).id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8) != 0)
         {
             DPRINT("No ack from preferred addressee, switching to bcast");
-            current_responder_lowest_lb.lb = LB_MAX;
-            memcpy(current_master_session.preferred_addressee.id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
+            NG(current_responder_lowest_lb).lb = LB_MAX;
+            memcpy(NG(preferred_addressee).id, (uint8_t[8]){ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, 8);
         }
         current_request_retry_count++;
         // the request may be retransmitted, don't free yet (this will be done in flush_fifo() when failed)
@@ -764,7 +868,7 @@ static void on_request_completed()
         // terminate the dialog if all request handled
         // we need to switch to the state idle otherwise we may receive a new packet before the task flush_fifos is handled
         // in this case, we may assert since the state remains MASTER
-        if (current_request_id == current_master_session.next_request_id - 1)
+        if (current_request_id == current_master_session->next_request_id - 1)
         {
             flush_completed();
             return;
@@ -781,8 +885,8 @@ void d7asp_signal_packet_transmitted(packet_t *packet)
     if (d7asp_state == D7ASP_STATE_MASTER)
     {
         // for the lowest QoS level the packet is ack-ed when CSMA/CA process succeeded
-        if (current_master_session.config.qos.qos_resp_mode == SESSION_RESP_MODE_NO ||
-           current_master_session.config.qos.qos_resp_mode == SESSION_RESP_MODE_NO_RPT)
+        if (current_master_session->config.qos.qos_resp_mode == SESSION_RESP_MODE_NO ||
+           current_master_session->config.qos.qos_resp_mode == SESSION_RESP_MODE_NO_RPT)
         {
             mark_current_request_done();
             mark_current_request_successful();
@@ -816,7 +920,7 @@ void d7asp_signal_transaction_terminated()
     if (d7asp_state == D7ASP_STATE_SLAVE_WAITING_RESPONSE)
     {
         // the time window to respond is expired, so it is not possible to send a response anymore
-        if (current_master_session.state == D7ASP_MASTER_SESSION_ACTIVE)
+        if (current_master_session->state == D7ASP_MASTER_SESSION_ACTIVE)
             switch_state(D7ASP_STATE_SLAVE_PENDING_MASTER);
         else
             switch_state(D7ASP_STATE_SLAVE);
@@ -839,12 +943,9 @@ void d7asp_signal_dialog_terminated()
         current_response_packet = NULL;
     }
 
-    if (current_master_session.state == D7ASP_MASTER_SESSION_PENDING_DORMANT_TRIGGERED) {
-      switch_state(D7ASP_STATE_PENDING_MASTER);
-      schedule_current_session();
-    } else {
-      switch_state(D7ASP_STATE_IDLE);
-    }
+    // continue with the pending sessions, a triggered dormant session first
+    switch_state(D7ASP_STATE_IDLE);
+    start_next_master_session();
 
     d7ap_stack_signal_slave_session_terminated();
 }
@@ -71,10 +71,10 @@ static dae_access_profile_t NGDEF(_active_addressee_access_profile);
 static bool NGDEF(_stop_dialog_after_tx);
 #define stop_dialog_after_tx NG(_stop_dialog_after_tx)
 
-static timer_event d7atp_response_period_expired_timer;
-static timer_event d7atp_execution_delay_expired_timer;
+static timer_event NGDEF(d7atp_response_period_expired_timer);
+static timer_event NGDEF(d7atp_execution_delay_expired_timer);
 
-static bool ctrl_xoff;
+static bool NGDEF(_ctrl_xoff);
 
 typedef enum {
     D7ATP_STATE_STOPPED,
@@ -86,7 +86,7 @@ typedef enum {
     D7ATP_STATE_SLAVE_TRANSACTION_RESPONSE_PERIOD,
 } state_t;
 
-static state_t NGDEF(_d7atp_state) = D7ATP_STATE_STOPPED;
+static state_t NGDEF(_d7atp_state) = NGINIT(D7ATP_STATE_STOPPED);
 #define d7atp_state NG(_d7atp_state)
 
 #define IS_IN_MASTER_TRANSACTION() (d7atp_state == D7ATP_STATE_MASTER_TRANSACTION_REQUEST_PERIOD || \
@@ -151,7 +151,7 @@ static void terminate_dialog()
     stop_dialog_after_tx = false;
 
     // Discard eventually the Tc timer
-    timer_cancel_event(&d7atp_response_period_expired_timer);
+    timer_cancel_event(&NG(d7atp_response_period_expired_timer));
 
     d7asp_signal_dialog_terminated();
     dll_notify_dialog_terminated();
@@ -202,7 +202,7 @@ static void sel_config_modified_callback(uint8_t file_id)
     d7a_segment_filter_options_t segment_filter_options;
     uint32_t length = D7A_FILE_SEL_CONF_SEGMENT_FILTER_SIZE;
     d7ap_fs_read_file(D7A_FILE_SEL_CONF_FILE_ID, D7A_FILE_SEL_CONF_SEGMENT_FILTER_OFFSET, &segment_filter_options.raw, &length, ROOT_AUTH);
-    ctrl_xoff = segment_filter_options.xoff;
+    NG(_ctrl_xoff) = segment_filter_options.xoff;
 }
 
 static void schedule_response_period_timeout_handler(timer_tick_t timeout_ticks)
@@ -211,8 +211,8 @@ static void schedule_response_period_timeout_handler(timer_tick_t timeout_ticks)
 
     DPRINT("Starting response_period timer (%i ticks)", timeout_ticks);
 
-    d7atp_response_period_expired_timer.next_event = timeout_ticks;
-    error_t rtc = timer_add_event(&d7atp_response_period_expired_timer);
+    NG(d7atp_response_period_expired_timer).next_event = timeout_ticks;
+    error_t rtc = timer_add_event(&NG(d7atp_response_period_expired_timer));
     assert(rtc == SUCCESS);
 }
 
@@ -251,7 +251,7 @@ void d7atp_signal_dialog_termination()
     current_transaction_id = NO_ACTIVE_REQUEST_ID;
 
     // Discard eventually the Tc timer
-    timer_cancel_event(&d7atp_response_period_expired_timer);
+    timer_cancel_event(&NG(d7atp_response_period_expired_timer));
 
     if(current_Tl_received == 0) {
       DPRINT("Tl = 0, stop FG scan");
@@ -285,8 +285,8 @@ void d7atp_init()
     current_dialog_id = 0;
     current_Tl_received = 0;
     stop_dialog_after_tx = false;
-    timer_init_event(&d7atp_response_period_expired_timer, &response_period_timeout_handler);
-    timer_init_event(&d7atp_execution_delay_expired_timer, &execution_delay_timeout_handler);
+    timer_init_event(&NG(d7atp_response_period_expired_timer), &response_period_timeout_handler);
+    timer_init_event(&NG(d7atp_execution_delay_expired_timer), &execution_delay_timeout_handler);
 
     d7ap_fs_register_file_modified_callback(D7A_FILE_SEL_CONF_FILE_ID, &sel_config_modified_callback);
     sel_config_modified_callback(D7A_FILE_SEL_CONF_FILE_ID);
@@ -301,8 +301,8 @@ void d7atp_notify_access_profile_file_changed(uint8_t file_id)
 void d7atp_stop()
 {
     d7atp_state = D7ATP_STATE_STOPPED;
-    timer_cancel_event(&d7atp_response_period_expired_timer);
-    timer_cancel_event(&d7atp_execution_delay_expired_timer);
+    timer_cancel_event(&NG(d7atp_response_period_expired_timer));
+    timer_cancel_event(&NG(d7atp_execution_delay_expired_timer));
 }
 
 error_t d7atp_send_request(uint8_t dialog_id, uint8_t transaction_id, bool is_last_transaction,
@@ -420,7 +420,7 @@ error_t d7atp_send_response(packet_t* packet)
     /* 
      * a setting in the SEL_config file should be able to tell the requester this node should not be put as preferred. This XOFF bit indicates that
      */
-    packet->d7atp_ctrl.ctrl_xoff = ctrl_xoff;
+    packet->d7atp_ctrl.ctrl_xoff = NG(_ctrl_xoff);
 
     // we are the slave here, so we don't need to lock the other party on the channel, unless we want to signal a pending dormant session with this addressee
     if (packet->d7atp_ctrl.ctrl_is_start) {
@@ -531,8 +531,8 @@ void d7atp_signal_packet_transmitted(packet_t* packet)
                 {
                     d7anp_set_foreground_scan_timeout(Tc + 2); // we include Tt here for now
 
-                    d7atp_execution_delay_expired_timer.next_event = Te;
-                    timer_add_event(&d7atp_execution_delay_expired_timer);
+                    NG(d7atp_execution_delay_expired_timer).next_event = Te;
+                    timer_add_event(&NG(d7atp_execution_delay_expired_timer));
                     return;
                 }
                 // if the the time passed since transmission is greater than Te, Tc is updated to include Te
@@ -76,7 +76,7 @@ static dae_access_profile_t NGDEF(_remote_access_profile);
 static uint8_t NGDEF(_active_access_class);
 #define active_access_class NG(_active_access_class)
 
-static dll_state_t NGDEF(_dll_state) = DLL_STATE_STOPPED;
+static dll_state_t NGDEF(_dll_state) = NGINIT(DLL_STATE_STOPPED);
 #define dll_state NG(_dll_state)
 
 static packet_t* NGDEF(_current_packet);
@@ -125,13 +125,13 @@ static uint16_t NGDEF(_tsched);
 static bool NGDEF(_guarded_channel);
 #define guarded_channel NG(_guarded_channel)
 
-static timer_tick_t guarded_channel_time_stop;
+static timer_tick_t NGDEF(guarded_channel_time_stop);
 
-static uint8_t noisefl_last_measurements[PHY_STATUS_MAX_CHANNELS][NOISEFL_NUMBER_MEASUREMENTS]; //3 measurement per channel
-static channel_status_t channels[PHY_STATUS_MAX_CHANNELS];
-static uint8_t phy_status_channel_counter = 0;
-static bool reset_noisefl_last_measurements = false;
-static bool phy_status_file_inited = false;
+static uint8_t NGDEF(noisefl_last_measurements)[PHY_STATUS_MAX_CHANNELS][NOISEFL_NUMBER_MEASUREMENTS]; //3 measurement per channel
+static channel_status_t NGDEF(channels)[PHY_STATUS_MAX_CHANNELS];
+static uint8_t NGDEF(phy_status_channel_counter) = NGINIT(0);
+static bool NGDEF(reset_noisefl_last_measurements) = NGINIT(false);
+static bool NGDEF(phy_status_file_inited) = NGINIT(false);
 
 static void execute_cca(void *arg);
 static void execute_csma_ca(void *arg);
@@ -142,27 +142,27 @@ static uint8_t get_position_channel();
 /*!
  * D7A timer used to perform a CCA
  */
-static timer_event dll_cca_timer;
+static timer_event NGDEF(dll_cca_timer);
 
 /*!
  * D7A timer used to perform a CSMA-CA
  */
-static timer_event dll_csma_timer;
+static timer_event NGDEF(dll_csma_timer);
 
 /*!
  * D7A timer used to start the automation scan (foreground)
  */
-static timer_event dll_scan_automation_timer;
+static timer_event NGDEF(dll_scan_automation_timer);
 
 /*!
  * D7A timer used to start a background scan
  */
-static timer_event dll_background_scan_timer;
+static timer_event NGDEF(dll_background_scan_timer);
 
 /*!
  * D7A timer used to delay the processing of a received packet
  */
-static timer_event dll_process_received_packet_timer;
+static timer_event NGDEF(dll_process_received_packet_timer);
 
 static void switch_state(dll_state_t next_state)
 {
@@ -284,13 +284,13 @@ void median_measured_noisefloor(uint8_t position) {
         E_CCA = - current_access_profile.subbands[0].cca;
         return;
     }
-    if(reset_noisefl_last_measurements) {
-        memset(noisefl_last_measurements[position], 0, 3);
-        reset_noisefl_last_measurements = false;
+    if(NG(reset_noisefl_last_measurements)) {
+        memset(NG(noisefl_last_measurements)[position], 0, 3);
+        NG(reset_noisefl_last_measurements) = false;
         DPRINT("reset CCA");
     }
-    if(noisefl_last_measurements[position][0] && noisefl_last_measurements[position][1] && noisefl_last_measurements[position][2]) { //If not default 0 values
-        uint8_t median = noisefl_last_measurements[position][0]>noisefl_last_measurements[position][1]?  ( noisefl_last_measurements[position][2]>noisefl_last_measurements[position][0]? noisefl_last_measurements[position][0] : (noisefl_last_measurements[position][1]>noisefl_last_measurements[position][2]? noisefl_last_measurements[position][1]:noisefl_last_measurements[position][2]) )  :  ( noisefl_last_measurements[position][2]>noisefl_last_measurements[position][1]? noisefl_last_measurements[position][1] : (noisefl_last_measurements[position][0]>noisefl_last_measurements[position][2]? noisefl_last_measurements[position][0]:noisefl_last_measurements[position][2]) );
+    if(NG(noisefl_last_measurements)[position][0] && NG(noisefl_last_measurements)[position][1] && NG(noisefl_last_measurements)[position][2]) { //If not default 0 values
+        uint8_t median = NG(noisefl_last_measurements)[position][0]>NG(noisefl_last_measurements)[position][1]?  ( NG(noisefl_last_measurements)[position][2]>NG(noisefl_last_measurements)[position][0]? NG(noisefl_last_measurements)[position][0] : (NG(noisefl_last_measurements)[position][1]>NG(noisefl_last_measurements)[position][2]? NG(noisefl_last_measurements)[position][1]:NG(noisefl_last_measurements)[position][2]) )  :  ( NG(noisefl_last_measurements)[position][2]>NG(noisefl_last_measurements)[position][1]? NG(noisefl_last_measurements)[position][1] : (NG(noisefl_last_measurements)[position][0]>NG(noisefl_last_measurements)[position][2]? NG(noisefl_last_measurements)[position][0]:NG(noisefl_last_measurements)[position][2]) );
         E_CCA = - median + 6; //Min of last 3 with 6dB offset
     } else
         E_CCA = - current_access_profile.subbands[0].cca;
@@ -301,8 +301,8 @@ void start_background_scan()
     assert(dll_state == DLL_STATE_SCAN_AUTOMATION);
 
     // Start a new tsched timer
-    dll_background_scan_timer.next_event = tsched;
-    timer_add_event(&dll_background_scan_timer);
+    NG(dll_background_scan_timer).next_event = tsched;
+    timer_add_event(&NG(dll_background_scan_timer));
 
     phy_rx_config_t config = {
         .channel_id = current_channel_id,
@@ -314,8 +314,8 @@ void start_background_scan()
         //if current_channel in array of channels AND gotten rssi_thr smaller than pre-programmed Ecca
         if(position != UINT8_MAX && (config.rssi_thr <= - current_access_profile.subbands[0].cca)) {
             //rotate measurements and add new at the end
-            memcpy(noisefl_last_measurements[position], &noisefl_last_measurements[position][1], 2);
-            noisefl_last_measurements[position][2] = - config.rssi_thr;
+            memcpy(NG(noisefl_last_measurements)[position], &NG(noisefl_last_measurements)[position][1], 2);
+            NG(noisefl_last_measurements)[position][2] = - config.rssi_thr;
         }
 
         median_measured_noisefloor(position);
@@ -327,7 +327,7 @@ void dll_stop_background_scan()
 {
     assert(dll_state == DLL_STATE_SCAN_AUTOMATION);
 
-    timer_cancel_event(&dll_background_scan_timer);
+    timer_cancel_event(&NG(dll_background_scan_timer));
     hw_radio_set_idle();
 }
 
@@ -344,7 +344,7 @@ void dll_signal_packet_received(packet_t* packet)
                                                          packet->hw_radio_packet.length + 1, false);
         // If the first transmission duration is greater than or equal to the Guard Interval TG,
         // the channel guard period is extended by TG following the transmission.
-        guarded_channel_time_stop = packet->hw_radio_packet.rx_meta.timestamp + ((tx_duration >= t_g) ? t_g : t_g - tx_duration);
+        NG(guarded_channel_time_stop) = packet->hw_radio_packet.rx_meta.timestamp + ((tx_duration >= t_g) ? t_g : t_g - tx_duration);
         guarded_channel = true;
     }
 
@@ -355,7 +355,7 @@ void dll_signal_packet_received(packet_t* packet)
         // will be invoked again by packet_transmitted() or an CSMA failed.
         DPRINT("Postpone the processing of the received packet after Tx is completed");
         process_received_packets_after_tx = true;
-        dll_process_received_packet_timer.arg = packet;
+        NG(dll_process_received_packet_timer).arg = packet;
         return;
     }
 
@@ -377,15 +377,15 @@ void dll_signal_packet_transmitted(packet_t* packet)
     switch_state(DLL_STATE_TX_FOREGROUND_COMPLETED);
     DPRINT("Transmitted packet @ %i with length = %i", packet->hw_radio_packet.tx_meta.timestamp, packet->hw_radio_packet.length);
   
-    guarded_channel_time_stop = timer_get_counter_value() + ((packet->tx_duration >= t_g) ? t_g : t_g - packet->tx_duration);
+    NG(guarded_channel_time_stop) = timer_get_counter_value() + ((packet->tx_duration >= t_g) ? t_g : t_g - packet->tx_duration);
 
     switch_state(DLL_STATE_IDLE);
     d7anp_signal_packet_transmitted(packet);
 
     if (process_received_packets_after_tx)
     {
-        dll_process_received_packet_timer.next_event = 0;
-        error_t rtc = timer_add_event(&dll_process_received_packet_timer);
+        NG(dll_process_received_packet_timer).next_event = 0;
+        error_t rtc = timer_add_event(&NG(dll_process_received_packet_timer));
         assert(rtc == SUCCESS);
         process_received_packets_after_tx = false;
     }
@@ -410,11 +410,11 @@ static void discard_tx()
 
     if ((dll_state == DLL_STATE_CCA1) || (dll_state == DLL_STATE_CCA2))
     {
-        timer_cancel_event(&dll_cca_timer);
+        timer_cancel_event(&NG(dll_cca_timer));
     }
     else if ((dll_state == DLL_STATE_CCA_FAIL) || (dll_state == DLL_STATE_CSMA_CA_RETRY))
     {
-        timer_cancel_event(&dll_csma_timer);
+        timer_cancel_event(&NG(dll_csma_timer));
     }
     else if (dll_state == DLL_STATE_TX_FOREGROUND_COMPLETED)
     {
@@ -437,8 +437,8 @@ static void cca_rssi_valid(int16_t cur_rssi)
         if((tx_nf_method == D7ADLL_MEDIAN_OF_THREE || rx_nf_method == D7ADLL_MEDIAN_OF_THREE))
         {
             uint8_t position = get_position_channel();
-            memcpy(noisefl_last_measurements[position], &noisefl_last_measurements[position][1], 2);
-            noisefl_last_measurements[position][2] = - cur_rssi;
+            memcpy(NG(noisefl_last_measurements)[position], &NG(noisefl_last_measurements)[position][1], 2);
+            NG(noisefl_last_measurements)[position][2] = - cur_rssi;
             median_measured_noisefloor(position);
         }
         if (dll_state == DLL_STATE_CCA1)
@@ -509,7 +509,7 @@ static void execute_csma_ca(void *arg)
 
     // update guarded channel to check if it's actually still guarded
     guarded_channel = (guarded_channel
-        && (timer_calculate_difference(timer_get_counter_value(), guarded_channel_time_stop) <= t_g));
+        && (timer_calculate_difference(timer_get_counter_value(), NG(guarded_channel_time_stop)) <= t_g));
     /*
      * During the period when the channel is guarded by the Requester, the transmission
      * of a subsequent requests, or a single response to a unicast request on the
@@ -535,7 +535,7 @@ static void execute_csma_ca(void *arg)
             if (current_packet->type == RESPONSE_TO_UNICAST || current_packet->type == RESPONSE_TO_BROADCAST)
                 dll_tc = CT_DECOMPRESS(current_packet->d7atp_tc);
             else
-                dll_tc = ceil((SFc + 1) * current_packet->tx_duration + t_g);
+                dll_tc = (SFc + 1) * current_packet->tx_duration + t_g;
 
             /*
              * Tca = Tc - Ttx - Tg
@@ -595,7 +595,7 @@ static void execute_csma_ca(void *arg)
                 }
                 case CSMA_CA_MODE_RIGD:
                 {
-                    dll_slot_duration = (uint16_t) ((double)dll_tca / 2 );
+                    dll_slot_duration = dll_tca / 2;
                     t_offset = get_rnd() % dll_slot_duration;
                     break;
                 }
@@ -608,15 +608,15 @@ static void execute_csma_ca(void *arg)
             if (t_offset)
             {
                 switch_state(DLL_STATE_CCA1);
-                dll_cca_timer.next_event = t_offset;
-                error_t rtc = timer_add_event(&dll_cca_timer);
+                NG(dll_cca_timer).next_event = t_offset;
+                error_t rtc = timer_add_event(&NG(dll_cca_timer));
                 assert(rtc == SUCCESS);
             }
             else
             {
                 switch_state(DLL_STATE_CCA1);
-                dll_cca_timer.next_event = 0;
-                error_t rtc = timer_add_event(&dll_cca_timer);
+                NG(dll_cca_timer).next_event = 0;
+                error_t rtc = timer_add_event(&NG(dll_cca_timer));
                 assert(rtc == SUCCESS);
             }
 
@@ -631,8 +631,8 @@ static void execute_csma_ca(void *arg)
             {
                 DPRINT("CCA fail because dll_to = %i", dll_to);
                 switch_state(DLL_STATE_CCA_FAIL);
-                dll_csma_timer.next_event = 0;
-                error_t rtc = timer_add_event(&dll_csma_timer);
+                NG(dll_csma_timer).next_event = 0;
+                error_t rtc = timer_add_event(&NG(dll_csma_timer));
                 assert(rtc == SUCCESS);
                 break;
             }
@@ -675,15 +675,15 @@ static void execute_csma_ca(void *arg)
 
             if (t_offset)
             {
-                dll_cca_timer.next_event = t_offset;
+                NG(dll_cca_timer).next_event = t_offset;
             }
             else
             {
-                dll_cca_timer.next_event = 0;
+                NG(dll_cca_timer).next_event = 0;
             }
 
             switch_state(DLL_STATE_CCA1);
-            error_t rtc = timer_add_event(&dll_cca_timer);
+            error_t rtc = timer_add_event(&NG(dll_cca_timer));
             assert(rtc == SUCCESS);
             break;
         }
@@ -694,8 +694,8 @@ static void execute_csma_ca(void *arg)
             d7anp_signal_transmission_failure();
             if (process_received_packets_after_tx)
             {
-                dll_process_received_packet_timer.next_event = 0;
-                error_t rtc = timer_add_event(&dll_process_received_packet_timer);
+                NG(dll_process_received_packet_timer).next_event = 0;
+                error_t rtc = timer_add_event(&NG(dll_process_received_packet_timer));
                 assert(rtc == SUCCESS);
                 process_received_packets_after_tx = false;
             }
@@ -706,7 +706,7 @@ static void execute_csma_ca(void *arg)
                 resume_fg_scan = false;
             }
 
-            reset_noisefl_last_measurements = true;
+            NG(reset_noisefl_last_measurements) = true;
             break;
         }
     }
@@ -723,8 +723,8 @@ static uint8_t get_position_channel() {
         .noise_floor = - E_CCA
     };
     for(position = 0; position < PHY_STATUS_MAX_CHANNELS; position++) {
-        if(((channels[position].raw_channel_status_identifier == 0) && (channels[position].channel_index_lsb == 0)) || 
-           ((channels[position].raw_channel_status_identifier == local_channel.raw_channel_status_identifier) && (channels[position].channel_index_lsb == local_channel.channel_index_lsb)))
+        if(((NG(channels)[position].raw_channel_status_identifier == 0) && (NG(channels)[position].channel_index_lsb == 0)) || 
+           ((NG(channels)[position].raw_channel_status_identifier == local_channel.raw_channel_status_identifier) && (NG(channels)[position].channel_index_lsb == local_channel.channel_index_lsb)))
             return position;
     }
     DPRINT("position of channel out of bound. Increase channels size or delete previous");
@@ -734,20 +734,20 @@ static uint8_t get_position_channel() {
 static void save_noise_floor(uint8_t position) {
     if(position == UINT8_MAX)
         return;
-    if((channels[position].raw_channel_status_identifier == 0) && (channels[position].channel_index_lsb == 0)) { // new channel
-        channels[position] = (channel_status_t) {
+    if((NG(channels)[position].raw_channel_status_identifier == 0) && (NG(channels)[position].channel_index_lsb == 0)) { // new channel
+        NG(channels)[position] = (channel_status_t) {
             .ch_freq_band = current_channel_id.channel_header.ch_freq_band,
             .bandwidth_25kHz = (current_channel_id.channel_header.ch_class == PHY_CLASS_LO_RATE),
             .channel_index_lsb = (current_channel_id.center_freq_index & 0xFF),
             .channel_index_msb = (uint8_t)((current_channel_id.center_freq_index >> 8) & 0x07),
             .noise_floor = - E_CCA
         };
-        phy_status_channel_counter++;
+        NG(phy_status_channel_counter)++;
     } else
-        channels[position].noise_floor = - E_CCA;
+        NG(channels)[position].noise_floor = - E_CCA;
 
-    d7ap_fs_write_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE - 1, &phy_status_channel_counter, sizeof(uint8_t), ROOT_AUTH);
-    d7ap_fs_write_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE, (uint8_t*) channels, phy_status_channel_counter * sizeof(channel_status_t), ROOT_AUTH);
+    d7ap_fs_write_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE - 1, &NG(phy_status_channel_counter), sizeof(uint8_t), ROOT_AUTH);
+    d7ap_fs_write_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE, (uint8_t*) NG(channels), NG(phy_status_channel_counter) * sizeof(channel_status_t), ROOT_AUTH);
 }
 
 void dll_execute_scan_automation()
@@ -757,7 +757,7 @@ void dll_execute_scan_automation()
 
     // first make sure the background scan timer is stopped and the pending task canceled
     // since they might not be necessary for current active class anymore
-    timer_cancel_event(&dll_background_scan_timer);
+    timer_cancel_event(&NG(dll_background_scan_timer));
 
     DPRINT("DLL execute scan autom AC=0x%02x", active_access_class);
 
@@ -837,8 +837,8 @@ void dll_execute_scan_automation()
 
         // If TSCHED > 0, an independent scheduler is set to generate regular scan start events at TSCHED rate.
         DPRINT("Perform a dll background scan at the end of TSCHED (%d ticks)", tsched);
-        dll_background_scan_timer.next_event = tsched;
-        error_t rtc = timer_add_event(&dll_background_scan_timer);
+        NG(dll_background_scan_timer).next_event = tsched;
+        error_t rtc = timer_add_event(&NG(dll_background_scan_timer));
         assert(rtc == SUCCESS);
     }
 
@@ -868,8 +868,8 @@ static void conf_file_changed_callback(uint8_t file_id)
         if (dll_state == DLL_STATE_IDLE || dll_state == DLL_STATE_SCAN_AUTOMATION)
         {
             DPRINT("Re-start the scan automation to apply this change");
-            dll_scan_automation_timer.next_event = 0;
-            int rtc = timer_add_event(&dll_scan_automation_timer);
+            NG(dll_scan_automation_timer).next_event = 0;
+            int rtc = timer_add_event(&NG(dll_scan_automation_timer));
             assert(rtc == SUCCESS);
         }
     }
@@ -888,8 +888,8 @@ void dll_notify_access_profile_file_changed(uint8_t file_id)
         if (dll_state == DLL_STATE_IDLE || dll_state == DLL_STATE_SCAN_AUTOMATION)
         {
             DPRINT("Re-start the scan automation to apply this change");
-            dll_scan_automation_timer.next_event = 0;
-            int rtc = timer_add_event(&dll_scan_automation_timer);
+            NG(dll_scan_automation_timer).next_event = 0;
+            int rtc = timer_add_event(&NG(dll_scan_automation_timer));
             assert(rtc == SUCCESS);
         }
     }
@@ -908,11 +908,11 @@ void dll_init()
     uint8_t nf_ctrl;
 
     // Initialize timers
-    timer_init_event(&dll_cca_timer, &execute_cca);
-    timer_init_event(&dll_csma_timer, &execute_csma_ca);
-    timer_init_event(&dll_scan_automation_timer, &execute_scan_automation);
-    timer_init_event(&dll_background_scan_timer, &start_background_scan);
-    timer_init_event(&dll_process_received_packet_timer, &packet_received);
+    timer_init_event(&NG(dll_cca_timer), &execute_cca);
+    timer_init_event(&NG(dll_csma_timer), &execute_csma_ca);
+    timer_init_event(&NG(dll_scan_automation_timer), &execute_scan_automation);
+    timer_init_event(&NG(dll_background_scan_timer), &start_background_scan);
+    timer_init_event(&NG(dll_process_received_packet_timer), &packet_received);
 
     phy_init();
 
@@ -923,9 +923,9 @@ void dll_init()
         .length = D7A_FILE_PHY_STATUS_SIZE,
         .allocated_length = D7A_FILE_PHY_STATUS_SIZE }; // TODO length for multiple channels
 
-    if(!phy_status_file_inited)
+    if(!NG(phy_status_file_inited))
         assert(d7ap_fs_init_file(D7A_FILE_PHY_STATUS_FILE_ID, &volatile_file_header, NULL) == SUCCESS); // TODO error handling
-    phy_status_file_inited = true;
+    NG(phy_status_file_inited) = true;
 
     uint32_t length = D7A_FILE_DLL_CONF_NF_CTRL_SIZE;
     if (d7ap_fs_read_file(D7A_FILE_DLL_CONF_FILE_ID, D7A_FILE_DLL_CONF_NF_CTRL_OFFSET, &nf_ctrl, &length, ROOT_AUTH) != 0)
@@ -949,11 +949,11 @@ void dll_init()
     engineering_mode_init();
 #endif
     length = D7A_FILE_PHY_STATUS_CHANNEL_COUNT_SIZE;
-    d7ap_fs_read_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE - 1, &phy_status_channel_counter, &length, ROOT_AUTH);
-    if(phy_status_channel_counter && (phy_status_channel_counter < PHY_STATUS_MAX_CHANNELS))
+    d7ap_fs_read_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE - 1, &NG(phy_status_channel_counter), &length, ROOT_AUTH);
+    if(NG(phy_status_channel_counter) && (NG(phy_status_channel_counter) < PHY_STATUS_MAX_CHANNELS))
     {
-        length = phy_status_channel_counter * D7A_FILE_PHY_STATUS_CHANNEL_SIZE;
-        d7ap_fs_read_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE, (uint8_t*) channels, &length, ROOT_AUTH);
+        length = NG(phy_status_channel_counter) * D7A_FILE_PHY_STATUS_CHANNEL_SIZE;
+        d7ap_fs_read_file(D7A_FILE_PHY_STATUS_FILE_ID, D7A_FILE_PHY_STATUS_MINIMUM_SIZE, (uint8_t*) NG(channels), &length, ROOT_AUTH);
     }
 
     // Start immediately the scan automation
@@ -964,11 +964,11 @@ void dll_init()
 void dll_stop()
 {
     dll_state = DLL_STATE_STOPPED;
-    timer_cancel_event(&dll_cca_timer);
-    timer_cancel_event(&dll_csma_timer);
-    timer_cancel_event(&dll_scan_automation_timer);
-    timer_cancel_event(&dll_background_scan_timer);
-    timer_cancel_event(&dll_process_received_packet_timer);
+    timer_cancel_event(&NG(dll_cca_timer));
+    timer_cancel_event(&NG(dll_csma_timer));
+    timer_cancel_event(&NG(dll_scan_automation_timer));
+    timer_cancel_event(&NG(dll_background_scan_timer));
+    timer_cancel_event(&NG(dll_process_received_packet_timer));
 
     d7ap_fs_unregister_file_modified_callback(D7A_FILE_DLL_CONF_FILE_ID);
 
@@ -980,11 +980,11 @@ void dll_stop()
 
 void dll_tx_frame(packet_t* packet)
 {
-    timer_cancel_event(&dll_scan_automation_timer); //enable this code if this costly operation proves to be necessary
+    timer_cancel_event(&NG(dll_scan_automation_timer)); //enable this code if this costly operation proves to be necessary
 
     if (dll_state == DLL_STATE_SCAN_AUTOMATION)
     {
-        timer_cancel_event(&dll_background_scan_timer);
+        timer_cancel_event(&NG(dll_background_scan_timer));
     }
 
     if (dll_state != DLL_STATE_FOREGROUND_SCAN)
@@ -1126,8 +1126,8 @@ void dll_tx_frame(packet_t* packet)
             if (Te > Trpd)
             {
                 Te -= Trpd;
-                dll_csma_timer.next_event = Te;
-                timer_add_event(&dll_csma_timer);
+                NG(dll_csma_timer).next_event = Te;
+                timer_add_event(&NG(dll_csma_timer));
                 return;
             }
             // If the response processing delay TRPD is bigger than TE,
@@ -1144,7 +1144,7 @@ static void start_foreground_scan()
 
     if (dll_state == DLL_STATE_SCAN_AUTOMATION)
     {
-        timer_cancel_event(&dll_background_scan_timer);
+        timer_cancel_event(&NG(dll_background_scan_timer));
         hw_radio_set_idle();
     }
 
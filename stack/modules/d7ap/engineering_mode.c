@@ -22,6 +22,7 @@
 
 #include "d7ap.h"
 #include "log.h"
+#include "ng.h"
 #include "d7ap_fs.h"
 #include "phy.h"
 #include "packet.h"
@@ -50,26 +51,26 @@
 
 typedef struct packet packet_t;
 
-static uint8_t timeout_em = 0;
-static phy_tx_config_t tx_cfg;
-static phy_rx_config_t rx_cfg;
-static bool stop = false;
-
-static uint16_t per_missed_packets_counter = 0;
-static uint16_t per_received_packets_counter = 0;
-static uint16_t per_packet_counter = 0; 
-static uint16_t per_start_index = 65535; //Impossible value to show this is not yet set
-static uint16_t per_packet_limit = 0;
-static uint8_t per_data[PACKET_SIZE] = { [0 ... PACKET_SIZE-1]  = 0 };
-static uint8_t per_fill_data[FILL_DATA_SIZE + 1];
+static uint8_t NGDEF(timeout_em) = NGINIT(0);
+static phy_tx_config_t NGDEF(tx_cfg);
+static phy_rx_config_t NGDEF(rx_cfg);
+static bool NGDEF(stop) = NGINIT(false);
+
+static uint16_t NGDEF(per_missed_packets_counter) = NGINIT(0);
+static uint16_t NGDEF(per_received_packets_counter) = NGINIT(0);
+static uint16_t NGDEF(per_packet_counter) = NGINIT(0); 
+static uint16_t NGDEF(per_start_index) = NGINIT(65535); //Impossible value to show this is not yet set
+static uint16_t NGDEF(per_packet_limit) = NGINIT(0);
+static uint8_t NGDEF(per_data)[PACKET_SIZE];
+static uint8_t NGDEF(per_fill_data)[FILL_DATA_SIZE + 1];
 typedef struct {
   union {
     uint8_t per_packet_buffer[sizeof(hw_radio_packet_t) + 255];
     hw_radio_packet_t hw_radio_packet;
   };
 } per_packet_t;
-static per_packet_t per_packet;
-static engineering_mode_t active_mode = EM_OFF;
+static per_packet_t NGDEF(per_packet);
+static engineering_mode_t NGDEF(active_mode) = NGINIT(EM_OFF);
 
 static void start_mode();
 static void stop_mode();
@@ -79,8 +80,8 @@ static void cont_tx_done_callback(packet_t* packet) {
 }
 
 static void packet_transmitted_callback(packet_t* packet) {
-  DPRINT("packet %i transmitted", per_packet_counter);
-  if(per_packet_counter >= per_packet_limit && per_packet_limit != 25500) { //timeout of 255 = unlimited
+  DPRINT("packet %i transmitted", NG(per_packet_counter));
+  if(NG(per_packet_counter) >= NG(per_packet_limit) && NG(per_packet_limit) != 25500) { //timeout of 255 = unlimited
     DPRINT("PER test done");
     return;
   }
@@ -92,7 +93,7 @@ static void packet_received_em(packet_t* packet) {
   uint16_t crc = __builtin_bswap16(crc_calculate(packet->hw_radio_packet.data, packet->hw_radio_packet.length - 2));
   if(memcmp(&crc, packet->hw_radio_packet.data + packet->hw_radio_packet.length - 2, 2) != 0)
   {
-      per_missed_packets_counter++;
+      NG(per_missed_packets_counter)++;
       DPRINT("##fault##");
   }
   else
@@ -104,25 +105,25 @@ static void packet_received_em(packet_t* packet) {
       memcpy(&msg_counter, packet->hw_radio_packet.data + 1, sizeof(msg_counter));
       memcpy(rx_data, packet->hw_radio_packet.data + 1 + sizeof(msg_counter), data_len);
       
-      if((per_start_index == 65535) || (msg_counter == 1)) {
-          per_start_index = msg_counter - 1;
+      if((NG(per_start_index) == 65535) || (msg_counter == 1)) {
+          NG(per_start_index) = msg_counter - 1;
 
           // just start, assume received all previous counters to reset PER to 0%
-          per_received_packets_counter = 0;
-          per_packet_counter = 0;
-          per_missed_packets_counter = 0;
+          NG(per_received_packets_counter) = 0;
+          NG(per_packet_counter) = 0;
+          NG(per_missed_packets_counter) = 0;
       }
 
-      uint16_t expected_counter = per_packet_counter + 1 + per_start_index;
+      uint16_t expected_counter = NG(per_packet_counter) + 1 + NG(per_start_index);
       if(msg_counter == expected_counter)
       {
-          per_received_packets_counter++;
-          per_packet_counter++;
+          NG(per_received_packets_counter)++;
+          NG(per_packet_counter)++;
       }
       else if(msg_counter > expected_counter)
       {
-          per_missed_packets_counter += msg_counter - expected_counter;
-          per_packet_counter = msg_counter - per_start_index;
+          NG(per_missed_packets_counter) += msg_counter - expected_counter;
+          NG(per_packet_counter) = msg_counter - NG(per_start_index);
       }
       else
       {
@@ -130,9 +131,9 @@ static void packet_received_em(packet_t* packet) {
       }
 
       double per = 0;
-      assert((msg_counter - per_start_index) != 0); 
+      assert((msg_counter - NG(per_start_index)) != 0); 
       if(msg_counter > 0)
-          per = 100.0 - ((double)per_received_packets_counter / (double)(msg_counter - per_start_index)) * 100.0;
+          per = 100.0 - ((double)NG(per_received_packets_counter) / (double)(msg_counter - NG(per_start_index))) * 100.0;
       
       if(msg_counter % 5 == 0) {
         char to_uart_uint[40];
@@ -145,37 +146,37 @@ static void packet_received_em(packet_t* packet) {
 }
 
 static void start_mode() {
-  switch (active_mode)
+  switch (NG(active_mode))
   {
     case EM_OFF:
       hw_reset();
       break;
     case EM_CONTINUOUS_TX:
-      phy_continuous_tx(&tx_cfg, timeout_em, &cont_tx_done_callback);
+      phy_continuous_tx(&NG(tx_cfg), NG(timeout_em), &cont_tx_done_callback);
       break;
     case EM_TRANSIENT_TX:
-      if(!stop) {
+      if(!NG(stop)) {
         timer_post_task_delay(&start_mode, 1200);
 
-        phy_continuous_tx(&tx_cfg, 1, &cont_tx_done_callback);
+        phy_continuous_tx(&NG(tx_cfg), 1, &cont_tx_done_callback);
       }
       break;
     case EM_PER_RX:
-      phy_start_rx(&(rx_cfg.channel_id), rx_cfg.syncword_class, &packet_received_em);
+      phy_start_rx(&(NG(rx_cfg).channel_id), NG(rx_cfg).syncword_class, &packet_received_em);
       break;
     case EM_PER_TX:
       DPRINT("transmitting packet");
 
-      per_packet_counter++;
-      per_data[0] = sizeof(per_packet_counter) + FILL_DATA_SIZE + sizeof(uint16_t); /* CRC is an uint16_t */
-      memcpy(per_data + 1, &per_packet_counter, sizeof(per_packet_counter));
+      NG(per_packet_counter)++;
+      NG(per_data)[0] = sizeof(NG(per_packet_counter)) + FILL_DATA_SIZE + sizeof(uint16_t); /* CRC is an uint16_t */
+      memcpy(NG(per_data) + 1, &NG(per_packet_counter), sizeof(NG(per_packet_counter)));
       /* the CRC calculation shall include all the bytes of the frame including the byte for the length*/
-      memcpy(per_data + 1 + sizeof(per_packet_counter), per_fill_data, FILL_DATA_SIZE);
-      uint16_t crc = __builtin_bswap16(crc_calculate(per_data, per_data[0] + 1 - 2));
-      memcpy(per_data + 1 + sizeof(per_packet_counter) + FILL_DATA_SIZE, &crc, 2);
-      memcpy(&per_packet.hw_radio_packet.data, per_data, sizeof(per_data));
-      per_packet.hw_radio_packet.length = per_data[0] + 1;
-      error_t e = phy_send_packet(&per_packet.hw_radio_packet, &tx_cfg, &packet_transmitted_callback);
+      memcpy(NG(per_data) + 1 + sizeof(NG(per_packet_counter)), NG(per_fill_data), FILL_DATA_SIZE);
+      uint16_t crc = __builtin_bswap16(crc_calculate(NG(per_data), NG(per_data)[0] + 1 - 2));
+      memcpy(NG(per_data) + 1 + sizeof(NG(per_packet_counter)) + FILL_DATA_SIZE, &crc, 2);
+      memcpy(&NG(per_packet).hw_radio_packet.data, NG(per_data), sizeof(NG(per_data)));
+      NG(per_packet).hw_radio_packet.length = NG(per_data)[0] + 1;
+      error_t e = phy_send_packet(&NG(per_packet).hw_radio_packet, &NG(tx_cfg), &packet_transmitted_callback);
       break;
     case EM_CONTINUOUS_STANDBY:
       phy_switch_to_standby_mode();
@@ -184,16 +185,16 @@ static void start_mode() {
 }
 
 static void stop_mode() {
-  switch (active_mode)
+  switch (NG(active_mode))
   {
     case EM_TRANSIENT_TX:
-      stop = true;
+      NG(stop) = true;
       break;
     case EM_CONTINUOUS_STANDBY:
       phy_switch_to_sleep_mode();
       break;
     default:
-      log_print_error_string("we can't 'stop' mode %i", active_mode);
+      log_print_error_string("we can't 'stop' mode %i", NG(active_mode));
       break;
   }
 }
@@ -209,12 +210,12 @@ static void em_file_change_callback(uint8_t file_id) {
     DPRINT("em_file_change_callback");
     DPRINT_DATA(data, D7A_FILE_ENGINEERING_MODE_SIZE);
 
-    rx_cfg.syncword_class = PHY_SYNCWORD_CLASS1;
-    tx_cfg.syncword_class = PHY_SYNCWORD_CLASS1;
+    NG(rx_cfg).syncword_class = PHY_SYNCWORD_CLASS1;
+    NG(tx_cfg).syncword_class = PHY_SYNCWORD_CLASS1;
 
-    timeout_em = em_command->timeout;
+    NG(timeout_em) = em_command->timeout;
 
-    active_mode = em_command->mode;
+    NG(active_mode) = em_command->mode;
 
     switch (em_command->mode)
     {
@@ -224,13 +225,13 @@ static void em_file_change_callback(uint8_t file_id) {
         break;
       case EM_CONTINUOUS_TX:
         DPRINT("EM_MODE_CONTINUOUS_TX\n");
-        memcpy( &(tx_cfg.channel_id), &(em_command->channel_id), sizeof(channel_id_t));
-        tx_cfg.eirp = em_command->eirp;
+        memcpy( &(NG(tx_cfg).channel_id), &(em_command->channel_id), sizeof(channel_id_t));
+        NG(tx_cfg).eirp = em_command->eirp;
 
         DPRINT("Tx: %d seconds, coding: %X \nclass: %X, freq band: %X \nchannel id: %d, syncword class: %X \neirp: %d, flags: %X\n",
-        timeout_em, tx_cfg.channel_id.channel_header.ch_coding, tx_cfg.channel_id.channel_header.ch_class,
-        tx_cfg.channel_id.channel_header.ch_freq_band, tx_cfg.channel_id.center_freq_index,
-        tx_cfg.syncword_class, tx_cfg.eirp, em_command->flags);
+        NG(timeout_em), NG(tx_cfg).channel_id.channel_header.ch_coding, NG(tx_cfg).channel_id.channel_header.ch_class,
+        NG(tx_cfg).channel_id.channel_header.ch_freq_band, NG(tx_cfg).channel_id.center_freq_index,
+        NG(tx_cfg).syncword_class, NG(tx_cfg).eirp, em_command->flags);
 
         /* start the radio */
         //give it time to answer through uart
@@ -238,12 +239,12 @@ static void em_file_change_callback(uint8_t file_id) {
         break;
       case EM_TRANSIENT_TX:
         DPRINT("EM_MODE_TRANSIENT_TX\n");
-        memcpy( &(tx_cfg.channel_id), &(em_command->channel_id), sizeof(channel_id_t));
-        tx_cfg.eirp = em_command->eirp;
+        memcpy( &(NG(tx_cfg).channel_id), &(em_command->channel_id), sizeof(channel_id_t));
+        NG(tx_cfg).eirp = em_command->eirp;
 
-        stop = false;
-        if(timeout_em != 0) {
-          timer_post_task_delay(&stop_mode, timeout_em * TIMER_TICKS_PER_SEC + 500);
+        NG(stop) = false;
+        if(NG(timeout_em) != 0) {
+          timer_post_task_delay(&stop_mode, NG(timeout_em) * TIMER_TICKS_PER_SEC + 500);
         }
 
         //give it time to answer through uart
@@ -251,26 +252,26 @@ static void em_file_change_callback(uint8_t file_id) {
         break;
       case EM_PER_RX:
         DPRINT("EM_MODE_PER_RX\n");
-        per_packet_counter = 0;
-        per_missed_packets_counter = 0;
-        per_received_packets_counter = 0;
-        per_start_index = 65535;
-        rx_cfg.channel_id = em_command->channel_id;
+        NG(per_packet_counter) = 0;
+        NG(per_missed_packets_counter) = 0;
+        NG(per_received_packets_counter) = 0;
+        NG(per_start_index) = 65535;
+        NG(rx_cfg).channel_id = em_command->channel_id;
         sched_post_task(&start_mode);
         break;
       case EM_PER_TX:
         DPRINT("EM_MODE_PER_TX\n");
-        per_packet_counter = 0;
-        tx_cfg.channel_id = em_command->channel_id;
-        tx_cfg.eirp = em_command->eirp;
-        per_packet_limit = timeout_em * 100;
+        NG(per_packet_counter) = 0;
+        NG(tx_cfg).channel_id = em_command->channel_id;
+        NG(tx_cfg).eirp = em_command->eirp;
+        NG(per_packet_limit) = NG(timeout_em) * 100;
         hw_radio_set_idle();
         timer_post_task_delay(&start_mode, 500);
         break;
       case EM_CONTINUOUS_STANDBY:
         DPRINT("EM_MODEM_CONTINUOUS_STANDBY");
-        if(timeout_em != 0) {
-            timer_post_task_delay(&stop_mode, timeout_em * TIMER_TICKS_PER_SEC + 500);
+        if(NG(timeout_em) != 0) {
+            timer_post_task_delay(&stop_mode, NG(timeout_em) * TIMER_TICKS_PER_SEC + 500);
         }
         timer_post_task_delay(&start_mode, 500);
         break;
@@ -23,6 +23,13 @@
 #include "packet.h"
 #include "ng.h"
 #include "log.h"
+#include "d7ap_fs.h"
+#include "errors.h"
+#include "hwatomic.h"
+#include "scheduler.h"
+
+#include <stddef.h>
+#include <string.h>
 
 #if defined(FRAMEWORK_LOG_ENABLED) && defined(MODULE_D7AP_PACKET_LOG_ENABLED)
 #define DPRINT(...) log_print_stack_string(LOG_STACK_FWK, __VA_ARGS__)
@@ -30,6 +37,12 @@
 #define DPRINT(...)
 #endif
 
+#if MODULE_D7AP_PACKET_QUEUE_SIZE >= 0xFF
+#error "MODULE_D7AP_PACKET_QUEUE_SIZE should be less than 255"
+#endif
+
+#define PACKET_QUEUE_SLOT_NONE 0xFF
+
 typedef enum
 {
     PACKET_QUEUE_ELEMENT_STATUS_FREE,       /*! The element is free */
@@ -44,74 +57,166 @@ static packet_t NGDEF(_packet_queue)[MODULE_D7AP_PACKET_QUEUE_SIZE];
 static packet_queue_element_status_t NGDEF(_packet_queue_element_status)[MODULE_D7AP_PACKET_QUEUE_SIZE];
 #define packet_queue_element_status NG(_packet_queue_element_status)
 
+// the free slots form a singly linked list of slot indexes, so alloc and free don't need to scan the queue
+static uint8_t NGDEF(packet_queue_next_free)[MODULE_D7AP_PACKET_QUEUE_SIZE];
+static uint8_t NGDEF(packet_queue_free_head);
+
+static uint8_t NGDEF(packet_queue_in_use);
+static uint8_t NGDEF(packet_queue_high_water_mark);
+static uint16_t NGDEF(packet_queue_alloc_failures);
+
+static bool NGDEF(packet_queue_status_file_inited) = NGINIT(false);
+
+static void write_status_file()
+{
+    if(!NG(packet_queue_status_file_inited))
+        return;
+
+    uint8_t status[D7A_FILE_PACKET_QUEUE_STATUS_SIZE];
+
+    start_atomic();
+    status[0] = MODULE_D7AP_PACKET_QUEUE_SIZE;
+    status[1] = NG(packet_queue_high_water_mark);
+    status[2] = NG(packet_queue_alloc_failures) >> 8;
+    status[3] = NG(packet_queue_alloc_failures) & 0xFF;
+    end_atomic();
+
+    int rc = d7ap_fs_write_file(D7A_FILE_PACKET_QUEUE_STATUS_FILE_ID, 0, status, D7A_FILE_PACKET_QUEUE_STATUS_SIZE, ROOT_AUTH);
+    if(rc != SUCCESS)
+        DPRINT("Writing the packet queue status file failed: %d", rc);
+}
+
+static inline uint8_t get_slot(packet_t* packet)
+{
+    uintptr_t slot = packet - packet_queue;
+    assert(slot < MODULE_D7AP_PACKET_QUEUE_SIZE && packet == &(packet_queue[slot]));
+    return slot;
+}
+
+/*! Resets the metadata of a packet, the payload and raw data buffers are left as is since they
+ * are always overwritten before being used */
+static void reset_packet(packet_t* packet)
+{
+    memset(packet, 0x00, offsetof(packet_t, payload));
+    memset(&packet->phy_config, 0x00, sizeof(phy_config_t));
+    memset(&packet->hw_radio_packet, 0x00, sizeof(hw_radio_packet_t));
+}
+
 void packet_queue_init()
 {
     for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
     {
         packet_init(&(packet_queue[i]));
         packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_FREE;
+        NG(packet_queue_next_free)[i] = (i + 1 < MODULE_D7AP_PACKET_QUEUE_SIZE) ? i + 1 : PACKET_QUEUE_SLOT_NONE;
+    }
+
+    NG(packet_queue_free_head) = 0;
+    NG(packet_queue_in_use) = 0;
+    NG(packet_queue_high_water_mark) = 0;
+    NG(packet_queue_alloc_failures) = 0;
+
+    if(!NG(packet_queue_status_file_inited))
+    {
+        d7ap_fs_file_header_t volatile_file_header = {
+            .file_permissions = (file_permission_t){ .guest_read = true, .user_read = true },
+            .file_properties.storage_class = FS_STORAGE_VOLATILE,
+            .length = D7A_FILE_PACKET_QUEUE_STATUS_SIZE,
+            .allocated_length = D7A_FILE_PACKET_QUEUE_STATUS_SIZE };
+
+        // the file can only exist already when it was defined by the file system image or the application
+        int rc = d7ap_fs_init_file(D7A_FILE_PACKET_QUEUE_STATUS_FILE_ID, &volatile_file_header, NULL);
+        if(rc == -EEXIST)
+        {
+            d7ap_fs_file_header_t file_header;
+            if(d7ap_fs_read_file_header(D7A_FILE_PACKET_QUEUE_STATUS_FILE_ID, &file_header) == SUCCESS
+               && file_header.file_properties.storage_class == FS_STORAGE_VOLATILE
+               && file_header.length == D7A_FILE_PACKET_QUEUE_STATUS_SIZE)
+                rc = SUCCESS;
+        }
+
+        if(rc != SUCCESS)
+            log_print_error_string("Error initialization of packet queue status file: %d", rc);
+
+        NG(packet_queue_status_file_inited) = (rc == SUCCESS);
     }
+
+    sched_register_task(&write_status_file);
+    write_status_file();
 }
 
 packet_t* packet_queue_alloc_packet()
 {
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
+    packet_t* packet = NULL;
+    bool status_changed = false;
+
+    start_atomic();
+    uint8_t slot = NG(packet_queue_free_head);
+    if(slot != PACKET_QUEUE_SLOT_NONE)
     {
-        if(packet_queue_element_status[i] == PACKET_QUEUE_ELEMENT_STATUS_FREE)
+        NG(packet_queue_free_head) = NG(packet_queue_next_free)[slot];
+        packet_queue_element_status[slot] = PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED;
+        packet = &(packet_queue[slot]);
+
+        NG(packet_queue_in_use)++;
+        if(NG(packet_queue_in_use) > NG(packet_queue_high_water_mark))
         {
-            packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED;
-            DPRINT("Packet queue alloc %p slot %i", &(packet_queue[i]), i);
-            return &(packet_queue[i]);
+            NG(packet_queue_high_water_mark) = NG(packet_queue_in_use);
+            status_changed = true;
         }
     }
+    else
+    {
+        NG(packet_queue_alloc_failures)++;
+        status_changed = true;
+    }
+    end_atomic();
+
+    // the status file is only updated when the counters change, since we can be called from the radio ISR
+    if(status_changed)
+        sched_post_task(&write_status_file);
+
+    if(packet == NULL)
+    {
+        // should not happen, possible to small PACKET_QUEUE_SIZE or not always free()-ed correctly?
+        DPRINT("Packet queue full, could not alloc new packet!");
+        return NULL;
+    }
 
-    // should not happen, possible to small PACKET_QUEUE_SIZE or not always free()-ed correctly?
-    DPRINT("Packet queue full, could not alloc new packet!");
-    return NULL;
+    DPRINT("Packet queue alloc %p slot %i", packet, slot);
+    return packet;
 }
 
 void packet_queue_free_packet(packet_t* packet)
 {
     DPRINT("Packet queue mark free %p", packet);
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
-    {
-        if(packet == &(packet_queue[i]))
-        {
-            DPRINT("packet slot %i", i);
-            assert(packet_queue_element_status[i] >= PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED);
-            packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_FREE;
-            packet_init(&(packet_queue[i]));
-            return;
-        }
-    }
+    uint8_t slot = get_slot(packet);
+    DPRINT("packet slot %i", slot);
+    assert(packet_queue_element_status[slot] >= PACKET_QUEUE_ELEMENT_STATUS_ALLOCATED);
+    reset_packet(packet);
 
-    assert(false); // should never happen
+    start_atomic();
+    packet_queue_element_status[slot] = PACKET_QUEUE_ELEMENT_STATUS_FREE;
+    NG(packet_queue_next_free)[slot] = NG(packet_queue_free_head);
+    NG(packet_queue_free_head) = slot;
+    NG(packet_queue_in_use)--;
+    end_atomic();
 }
 
 packet_t* packet_queue_find_packet(hw_radio_packet_t* hw_radio_packet)
 {
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
-    {
-        if(&(packet_queue[i].hw_radio_packet) == hw_radio_packet)
-            return &(packet_queue[i]);
-    }
+    packet_t* packet = (packet_t*)((uint8_t*)hw_radio_packet - offsetof(packet_t, hw_radio_packet));
+    if(packet < packet_queue || packet >= packet_queue + MODULE_D7AP_PACKET_QUEUE_SIZE)
+        return NULL;
 
-    return NULL;
+    return packet;
 }
 
 void packet_queue_mark_processing(packet_t* packet)
 {
     DPRINT("Packet queue mark processing %p", packet);
-    for(uint8_t i = 0; i < MODULE_D7AP_PACKET_QUEUE_SIZE; i++)
-    {
-        if(packet == &(packet_queue[i]))
-        {
-            assert(packet_queue_element_status[i] != PACKET_QUEUE_ELEMENT_STATUS_FREE);
-            DPRINT("Packet slot %i", i);
-            packet_queue_element_status[i] = PACKET_QUEUE_ELEMENT_STATUS_PROCESSING;
-            return;
-        }
-    }
-
-    assert(false);
+    uint8_t slot = get_slot(packet);
+    assert(packet_queue_element_status[slot] != PACKET_QUEUE_ELEMENT_STATUS_FREE);
+    DPRINT("Packet slot %i", slot);
+    packet_queue_element_status[slot] = PACKET_QUEUE_ELEMENT_STATUS_PROCESSING;
 }
@@ -30,10 +30,12 @@
 
 #include "packet.h"
 
-/*! Initializes the packet queue */
+/*! Initializes the packet queue.
+ * The usage of the queue can be read from the D7A_FILE_PACKET_QUEUE_STATUS_FILE_ID system file: the queue size,
+ * the high water mark and the number of failed allocations. */
 void packet_queue_init();
 
-/*! Returns the first free packet buffer in the queue and marks this as used until this is free()-ed again */
+/*! Returns a free packet buffer from the queue and marks this as used until this is free()-ed again. Can be called from interrupt context. */
 packet_t* packet_queue_alloc_packet();
 
 /*! Marks the packet buffer as free again */
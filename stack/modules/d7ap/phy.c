@@ -25,12 +25,13 @@
 #include "stdbool.h"
 #include "string.h"
 #include "types.h"
-#include "math.h"
 
 #include "debug.h"
 #include "log.h"
 #include "scheduler.h"
 #include "timer.h"
+#include "ng.h"
+#include "hwatomic.h"
 
 #include "hwradio.h"
 #include "hwdebug.h"
@@ -39,6 +40,7 @@
 #include "crc.h"
 #include "pn9.h"
 #include "fec.h"
+#include "airtime.h"
 
 #include "packet_queue.h"
 #include "MODULE_D7AP_defs.h"
@@ -129,17 +131,17 @@ typedef enum {
   STATE_CONT_RX
 } state_t;
 
-static hwradio_init_args_t init_args;
+static hwradio_init_args_t NGDEF(init_args);
 
-static phy_tx_packet_callback_t transmitted_callback;
-static phy_rx_packet_callback_t received_callback;
+static phy_tx_packet_callback_t NGDEF(transmitted_callback);
+static phy_rx_packet_callback_t NGDEF(received_callback);
 
-static state_t state = STATE_IDLE;
-static hw_radio_packet_t *current_packet;
-static bool should_rx_after_tx_completed = false;
-static syncword_class_t current_syncword_class = PHY_SYNCWORD_CLASS0;
-static uint16_t current_syncword = 0;
-static phy_rx_config_t pending_rx_cfg;
+static state_t NGDEF(state) = NGINIT(STATE_IDLE);
+static hw_radio_packet_t *NGDEF(current_packet);
+static bool NGDEF(should_rx_after_tx_completed) = NGINIT(false);
+static syncword_class_t NGDEF(current_syncword_class) = NGINIT(PHY_SYNCWORD_CLASS0);
+static uint16_t NGDEF(current_syncword) = NGINIT(0);
+static phy_rx_config_t NGDEF(pending_rx_cfg);
 
 const channel_id_t default_channel_id = {
   .channel_header.ch_coding = PHY_CODING_PN9,
@@ -150,43 +152,65 @@ const channel_id_t default_channel_id = {
 
 #define EMPTY_CHANNEL_ID { .channel_header_raw = 0xFF, .center_freq_index = 0xFF }
 
-static channel_id_t current_channel_id = EMPTY_CHANNEL_ID;
-
-static uint32_t rx_bw_lo_rate;
-static uint32_t rx_bw_normal_rate;
-static uint32_t rx_bw_hi_rate;
-static bool fact_settings_changed = false;
+static channel_id_t NGDEF(current_channel_id) = NGINIT(EMPTY_CHANNEL_ID);
+
+static uint32_t NGDEF(rx_bw_lo_rate);
+static uint32_t NGDEF(rx_bw_normal_rate);
+static uint32_t NGDEF(rx_bw_hi_rate);
+static bool NGDEF(fact_settings_changed) = NGINIT(false);
+
+static uint32_t NGDEF(bitrate_lo_rate);
+static uint32_t NGDEF(fdev_lo_rate);
+static uint32_t NGDEF(bitrate_normal_rate);
+static uint32_t NGDEF(fdev_normal_rate);
+static uint32_t NGDEF(bitrate_hi_rate);
+static uint32_t NGDEF(fdev_hi_rate);
+
+static uint32_t NGDEF(lora_bw);
+static uint8_t NGDEF(_lora_SF);
+#define lora_SF NG(_lora_SF)
+
+static uint8_t NGDEF(preamble_size_lo_rate);
+static uint8_t NGDEF(preamble_size_normal_rate);
+static uint8_t NGDEF(preamble_size_hi_rate);
+static uint8_t NGDEF(preamble_detector_size_lo_rate);
+static uint8_t NGDEF(preamble_detector_size_normal_rate);
+static uint8_t NGDEF(preamble_detector_size_hi_rate);
+static uint8_t NGDEF(preamble_tol_lo_rate);
+static uint8_t NGDEF(preamble_tol_normal_rate);
+static uint8_t NGDEF(preamble_tol_hi_rate);
+
+// The airtime of a byte and the preamble size per channel class (indexed by phy_channel_class_t), derived from the
+// factory settings by init_airtime() so phy_calculate_tx_duration() only needs integer multiplications
+static airtime_rate_t NGDEF(airtime_rate)[4];
+static uint8_t NGDEF(airtime_preamble_size)[4];
+#ifdef USE_SX127X
+static airtime_lora_t NGDEF(lora_airtime);
+#endif
 
-static uint32_t bitrate_lo_rate;
-static uint32_t fdev_lo_rate;
-static uint32_t bitrate_normal_rate;
-static uint32_t fdev_normal_rate;
-static uint32_t bitrate_hi_rate;
-static uint32_t fdev_hi_rate;
+static uint8_t NGDEF(rssi_smoothing);
+static uint8_t NGDEF(rssi_offset);
 
-static uint32_t lora_bw;
-static uint8_t lora_SF;
+static uint16_t NGDEF(total_bg) = NGINIT(0);
+static uint16_t NGDEF(total_rssi_triggers) = NGINIT(0);
+static uint16_t NGDEF(total_fg) = NGINIT(0);
+static uint16_t NGDEF(total_succeeded_fg) = NGINIT(0);
+static uint8_t NGDEF(write_file_counter) = NGINIT(0);
 
-static uint8_t preamble_size_lo_rate;
-static uint8_t preamble_size_normal_rate;
-static uint8_t preamble_size_hi_rate;
-static uint8_t preamble_detector_size_lo_rate;
-static uint8_t preamble_detector_size_normal_rate;
-static uint8_t preamble_detector_size_hi_rate;
-static uint8_t preamble_tol_lo_rate;
-static uint8_t preamble_tol_normal_rate;
-static uint8_t preamble_tol_hi_rate;
+static uint8_t NGDEF(gain_offset) = NGINIT(0);
 
-static uint8_t rssi_smoothing;
-static uint8_t rssi_offset;
+// The radio settings of the channels used since the factory settings were last read, prepared once so switching to one
+// of these channels is a single hw_radio_apply_channel_config(). The oldest entry is replaced when the cache is full.
+#define CHANNEL_CONFIG_CACHE_SIZE 4
 
-static uint16_t total_bg = 0;
-static uint16_t total_rssi_triggers = 0;
-static uint16_t total_fg = 0;
-static uint16_t total_succeeded_fg = 0;
-static uint8_t write_file_counter = 0;
+typedef struct {
+    channel_id_t channel_id;
+    hw_radio_channel_config_t config;
+} channel_config_cache_entry_t;
 
-static uint8_t gain_offset = 0;
+static channel_config_cache_entry_t NGDEF(channel_config_cache)[CHANNEL_CONFIG_CACHE_SIZE];
+static uint8_t NGDEF(channel_config_cache_count) = NGINIT(0);
+static uint8_t NGDEF(channel_config_cache_next) = NGINIT(0);
 
 /*
  * FSK packet handler structure
@@ -198,23 +222,36 @@ typedef struct
     uint8_t FifoThresh;
 }FskPacketHandler_t;
 
-FskPacketHandler_t FskPacketHandler;
+static FskPacketHandler_t NGDEF(_FskPacketHandler);
+#define FskPacketHandler NG(_FskPacketHandler)
 
 /*
  * Background advertising packet handler structure
  */
+// preamble, sync word and a FEC encoded background frame
+#define BG_ADV_PACKET_MAX_SIZE (PREAMBLE_HI_RATE_CLASS + 2 + 2 * (BACKGROUND_FRAME_LENGTH + 2))
+
+// The background frames are prepared ahead in a ring of two halves: a half is prepared by a task while the frames of the
+// other half are sent, so a refill only needs to copy a frame to the FIFO.
+#define BG_ADV_PREPARED_FRAMES 8
+
 typedef struct
 {
     uint8_t dll_header[BACKGROUND_DLL_HEADER_LENGTH];
-    uint8_t packet[24];  // 6 bytes preamble (PREAMBLE_HI_RATE_CLASS) + 2 bytes SYNC word + 16 bytes max for a background frame FEC encoded
-    uint8_t *packet_payload;
+    crc_ctx_t dll_header_crc; // CRC over the DLL header, which is the same for all background frames
+    uint8_t packets[BG_ADV_PREPARED_FRAMES][BG_ADV_PACKET_MAX_SIZE]; // preamble, sync word and background frame
+    uint8_t payload_offset; // the background frame follows the preamble and sync word
     uint8_t packet_size;
-    uint16_t eta;
-    uint16_t tx_duration;
-    timer_tick_t stop_time;
+    uint32_t frame_count; // the number of background frames which fit in the advertising period
+    uint32_t frames_prepared;
+    uint32_t frames_sent;
+    uint32_t next_eta; // ETA of the next frame to prepare, in ticks with AIRTIME_RATE_FRACTIONAL_BITS fractional bits
+    uint32_t frame_duration; // airtime of a background frame including preamble and sync word, idem
+    uint8_t padding[BG_ADV_PACKET_MAX_SIZE]; // preamble bytes to fill the time between the last background frame and the foreground frame
+    uint8_t padding_length;
 }bg_adv_t;
 
-bg_adv_t bg_adv;
+static bg_adv_t NGDEF(bg_adv);
 
 typedef struct
 {
@@ -224,7 +261,7 @@ typedef struct
     bool bg_adv;
 }fg_frame_t;
 
-fg_frame_t fg_frame;
+static fg_frame_t NGDEF(fg_frame);
 
 const uint16_t sync_word_value[2][4] = {
     { 0xE6D0, 0x0000, 0xF498, 0xE6D0 },
@@ -247,13 +284,14 @@ const uint8_t bg_timeout[4] = {
     To_CLASS_HI_RATE
 };
 
-uint16_t end_time;
+static uint16_t NGDEF(end_time);
 /*!
  * D7A timer used to expire the continuous TX
  */
-static timer_event continuous_tx_expiration_timer;
+static timer_event NGDEF(continuous_tx_expiration_timer);
 
 static void fill_in_fifo(uint16_t remaining_bytes_len);
+static void prepare_background_frames(void *arg);
 
 static hw_radio_packet_t* alloc_new_packet(uint16_t length)
 {
@@ -271,30 +309,30 @@ static void release_packet(hw_radio_packet_t* hw_radio_packet)
 void phy_switch_to_standby_mode()
 {
     hw_radio_set_opmode(HW_STATE_STANDBY);
-    state = STATE_IDLE;
+    NG(state) = STATE_IDLE;
 }
 
 void phy_switch_to_sleep_mode()
 {
     hw_radio_set_idle();
-    state = STATE_IDLE;
+    NG(state) = STATE_IDLE;
 }
 
 static void packet_transmitted(timer_tick_t timestamp)
 {
-    assert(state == STATE_TX || state == STATE_CONT_TX);
+    assert(NG(state) == STATE_TX || NG(state) == STATE_CONT_TX);
 
-    current_packet->tx_meta.timestamp = timestamp;
-    DPRINT("Transmitted packet @ %i with length = %i", current_packet->tx_meta.timestamp, current_packet->length);
+    NG(current_packet)->tx_meta.timestamp = timestamp;
+    DPRINT("Transmitted packet @ %i with length = %i", NG(current_packet)->tx_meta.timestamp, NG(current_packet)->length);
 
     phy_switch_to_standby_mode();
 
-    transmitted_callback(packet_queue_find_packet(current_packet));
+    NG(transmitted_callback)(packet_queue_find_packet(NG(current_packet)));
 }
 
 static void packet_received(hw_radio_packet_t* hw_radio_packet)
 {
-    assert(state == STATE_RX || state == STATE_BG_SCAN);
+    assert(NG(state) == STATE_RX || NG(state) == STATE_BG_SCAN);
     // we are in interrupt context here, so mark packet for further processing,
     // schedule it and return
     DPRINT("packet received @ %i , RSSI = %d", hw_radio_packet->rx_meta.timestamp, hw_radio_packet->rx_meta.rssi);
@@ -311,11 +349,11 @@ static void packet_received(hw_radio_packet_t* hw_radio_packet)
     DPRINT_DATA(hw_radio_packet->data, hw_radio_packet->length);
 #endif
 #ifndef HAL_RADIO_USE_HW_FEC
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
         fec_decode_packet(hw_radio_packet->data, hw_radio_packet->length, hw_radio_packet->length);
 #endif
 
-    if (current_syncword_class == PHY_SYNCWORD_CLASS0)
+    if (NG(current_syncword_class) == PHY_SYNCWORD_CLASS0)
     {
         packet->type = BACKGROUND_ADV;
         hw_radio_packet->length = BACKGROUND_FRAME_LENGTH;
@@ -324,20 +362,20 @@ static void packet_received(hw_radio_packet_t* hw_radio_packet)
         hw_radio_packet->length = hw_radio_packet->data[0] + 1;
 
     if(packet->type != BACKGROUND_ADV)
-        total_succeeded_fg++;
+        NG(total_succeeded_fg)++;
 
     DPRINT("RX packet fully decoded <len = %d>", hw_radio_packet->length);
     DPRINT_DATA(hw_radio_packet->data, hw_radio_packet->length);
 
-    packet->phy_config.rx.syncword_class = current_syncword_class;
-    memcpy(&(packet->phy_config.rx.channel_id), &current_channel_id, sizeof(channel_id_t));
+    packet->phy_config.rx.syncword_class = NG(current_syncword_class);
+    memcpy(&(packet->phy_config.rx.channel_id), &NG(current_channel_id), sizeof(channel_id_t));
 
-    if (state == STATE_BG_SCAN)
+    if (NG(state) == STATE_BG_SCAN)
         phy_switch_to_standby_mode();
 
     // in case of FG scan, reception is continuous until upper layer decides to stop it
 
-    received_callback(packet);
+    NG(received_callback)(packet);
 }
 
 static void packet_header_received(uint8_t *data, uint8_t len)
@@ -352,7 +390,7 @@ static void packet_header_received(uint8_t *data, uint8_t len)
     pn9_encode(data, len);
 #endif
 
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
     {
 #ifndef HAL_RADIO_USE_HW_FEC
         fec_decode_packet(data, len, len);
@@ -365,8 +403,8 @@ static void packet_header_received(uint8_t *data, uint8_t len)
     else
         packet_len = data[0] + 1 ;
 
-    if((current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9 && (packet_len > (0xFF * 2))) ||
-       (current_channel_id.channel_header.ch_coding != PHY_CODING_FEC_PN9 && (packet_len > 0xFF)) || (packet_len < 4))
+    if((NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9 && (packet_len > (0xFF * 2))) ||
+       (NG(current_channel_id).channel_header.ch_coding != PHY_CODING_FEC_PN9 && (packet_len > 0xFF)) || (packet_len < 4))
         packet_len = 0;
 
     DPRINT("RX Packet Length: %i ", packet_len);
@@ -382,112 +420,78 @@ bool phy_radio_channel_ids_equal(const channel_id_t* a, const channel_id_t* b)
 
 uint16_t phy_calculate_tx_duration(phy_channel_class_t channel_class, phy_coding_t ch_coding, uint16_t packet_length, bool payload_only)
 {
-    double data_rate = 6.0; // Normal rate: 6.9 bytes/tick
+    uint32_t duration;
 
     if (ch_coding == PHY_CODING_FEC_PN9)
         packet_length = fec_calculated_decoded_length(packet_length);
 
-    if(!payload_only)
-      packet_length += sizeof(uint16_t); // Sync word
-
 #ifdef USE_SX127X
-    if(channel_class == PHY_CLASS_LORA) {
-        // based on http://www.semtech.com/images/datasheet/LoraDesignGuide_STD.pdf
-        // only valid for explicit header, CR4/5, SF9 for now
-        uint16_t payload_symbols = 8 + ceil(2*(packet_length+1)/9)*5;
-        uint16_t lora_duration = ((1 << lora_SF) * 1000) / lora_bw;
-        uint16_t packet_duration = lora_duration * (LORA_T_PREAMBLE_LENGTH + payload_symbols); 
-        return packet_duration;
-    }
+    if(channel_class == PHY_CLASS_LORA)
+        duration = airtime_lora_ticks(&NG(lora_airtime), packet_length);
+    else
 #endif
-
-    switch (channel_class)
     {
-    case PHY_CLASS_LO_RATE:
-        if(!payload_only)
-          packet_length += preamble_size_lo_rate;
-
-        data_rate = 1.2; // Lo Rate 9.6 kbps: 1.2 bytes/tick
-        break;
-    case PHY_CLASS_NORMAL_RATE:
         if(!payload_only)
-          packet_length += preamble_size_normal_rate;
+            packet_length += NG(airtime_preamble_size)[channel_class] + sizeof(uint16_t); // Sync word
 
-        data_rate = 6.9; // Normal Rate 55.555 kbps: 6.94 bytes/tick
-        break;
-    case PHY_CLASS_HI_RATE:
-        if(!payload_only)
-          packet_length += preamble_tol_hi_rate;
-
-        data_rate = 20.8; // High rate 166.667 kbps: 20.83 byte/tick
-        break;
+        // TODO Add the power ramp-up/ramp-down symbols in the packet length?
+        duration = airtime_fsk_ticks(NG(airtime_rate)[channel_class], packet_length) + 1;
     }
 
-    // TODO Add the power ramp-up/ramp-down symbols in the packet length?
-
-    return ceil(packet_length / data_rate) + 1;
+    return duration < UINT16_MAX ? duration : UINT16_MAX;
 }
 
 static void configure_eirp(eirp_t eirp)
 {
-    eirp -= gain_offset;
-    DPRINT("Set Tx power: %d dBm including offset of %i\n", eirp, gain_offset);
+    eirp -= NG(gain_offset);
+    DPRINT("Set Tx power: %d dBm including offset of %i\n", eirp, NG(gain_offset));
 
     hw_radio_set_tx_power(eirp);
 }
 
-static void configure_channel(const channel_id_t* channel) {
-    if(phy_radio_channel_ids_equal(&current_channel_id, channel) && !fact_settings_changed) {
-        return;
-    }
-
-    fact_settings_changed = false;
-
-#ifdef USE_SX127X
-    hw_radio_switch_longRangeMode(channel->channel_header.ch_class == PHY_CLASS_LORA);
-#endif
+static void prepare_channel_config(const channel_id_t* channel, hw_radio_channel_config_t* config) {
+    *config = (hw_radio_channel_config_t){ 0 };
 
     // configure modulation settings
     if(channel->channel_header.ch_class == PHY_CLASS_LO_RATE)
     {
-        hw_radio_set_bitrate(bitrate_lo_rate);
-        if(channel->channel_header.ch_coding != PHY_CODING_CW)
-            hw_radio_set_tx_fdev(fdev_lo_rate);
-        else
-            hw_radio_set_tx_fdev(0);
-        hw_radio_set_rx_bw_hz(rx_bw_lo_rate);
-        hw_radio_set_preamble_size(preamble_size_lo_rate);
-        hw_radio_set_preamble_detector(preamble_detector_size_lo_rate, preamble_tol_lo_rate);
+        config->bitrate = NG(bitrate_lo_rate);
+        config->tx_fdev = NG(fdev_lo_rate);
+        config->rx_bw_hz = NG(rx_bw_lo_rate);
+        config->preamble_size = NG(preamble_size_lo_rate);
+        config->preamble_detector_size = NG(preamble_detector_size_lo_rate);
+        config->preamble_tol = NG(preamble_tol_lo_rate);
     }
     else if(channel->channel_header.ch_class == PHY_CLASS_NORMAL_RATE)
     {
-        hw_radio_set_bitrate(bitrate_normal_rate);
-        if(channel->channel_header.ch_coding != PHY_CODING_CW)
-            hw_radio_set_tx_fdev(fdev_normal_rate);
-        else
-            hw_radio_set_tx_fdev(0);
-        hw_radio_set_rx_bw_hz(rx_bw_normal_rate);
-        hw_radio_set_preamble_size(preamble_size_normal_rate);
-        hw_radio_set_preamble_detector(preamble_detector_size_normal_rate, preamble_tol_normal_rate);
+        config->bitrate = NG(bitrate_normal_rate);
+        config->tx_fdev = NG(fdev_normal_rate);
+        config->rx_bw_hz = NG(rx_bw_normal_rate);
+        config->preamble_size = NG(preamble_size_normal_rate);
+        config->preamble_detector_size = NG(preamble_detector_size_normal_rate);
+        config->preamble_tol = NG(preamble_tol_normal_rate);
     }
     else if(channel->channel_header.ch_class == PHY_CLASS_HI_RATE)
     {
-        hw_radio_set_bitrate(bitrate_hi_rate);
-        if(channel->channel_header.ch_coding != PHY_CODING_CW)
-            hw_radio_set_tx_fdev(fdev_hi_rate);
-        else
-            hw_radio_set_tx_fdev(0);
-        hw_radio_set_rx_bw_hz(rx_bw_hi_rate);
-        hw_radio_set_preamble_size(preamble_size_hi_rate);
-        hw_radio_set_preamble_detector(preamble_detector_size_hi_rate, preamble_tol_hi_rate);
+        config->bitrate = NG(bitrate_hi_rate);
+        config->tx_fdev = NG(fdev_hi_rate);
+        config->rx_bw_hz = NG(rx_bw_hi_rate);
+        config->preamble_size = NG(preamble_size_hi_rate);
+        config->preamble_detector_size = NG(preamble_detector_size_hi_rate);
+        config->preamble_tol = NG(preamble_tol_hi_rate);
     }
 #ifdef USE_SX127X
     else if(channel->channel_header.ch_class == PHY_CLASS_LORA)
     {
-        hw_radio_set_lora_mode(lora_bw, lora_SF);
+        config->lora = true;
+        config->lora_bw = NG(lora_bw);
+        config->lora_SF = lora_SF;
     }
 #endif
 
+    if(channel->channel_header.ch_coding == PHY_CODING_CW)
+        config->tx_fdev = 0;
+
     // TODO regopmode for LF?
 
     uint32_t center_freq = 433.06e6;
@@ -500,23 +504,70 @@ static void configure_channel(const channel_id_t* channel) {
     if(channel->channel_header.ch_class == PHY_CLASS_LO_RATE)
         channel_spacing_half = 12500;
 
-    center_freq += 25000 * channel->center_freq_index + channel_spacing_half;
-    hw_radio_set_center_freq(center_freq);
+    config->center_freq = center_freq + 25000 * channel->center_freq_index + channel_spacing_half;
+
+    hw_radio_prepare_channel_config(config);
+}
+
+static const hw_radio_channel_config_t* get_channel_config(const channel_id_t* channel) {
+    for(uint8_t i = 0; i < NG(channel_config_cache_count); i++)
+    {
+        if(phy_radio_channel_ids_equal(&NG(channel_config_cache)[i].channel_id, channel))
+            return &NG(channel_config_cache)[i].config;
+    }
+
+    channel_config_cache_entry_t* entry = &NG(channel_config_cache)[NG(channel_config_cache_next)];
+    NG(channel_config_cache_next) = (NG(channel_config_cache_next) + 1) % CHANNEL_CONFIG_CACHE_SIZE;
+    if(NG(channel_config_cache_count) < CHANNEL_CONFIG_CACHE_SIZE)
+        NG(channel_config_cache_count)++;
+
+    entry->channel_id = *channel;
+    prepare_channel_config(channel, &entry->config);
+    return &entry->config;
+}
+
+// Only the sx127x driver supports LoRa (class 1), for other radios prepare_channel_config() would leave the modulation
+// of such a channel undefined
+static bool is_channel_supported(const channel_id_t* channel) {
+    switch(channel->channel_header.ch_class)
+    {
+        case PHY_CLASS_LO_RATE:
+        case PHY_CLASS_NORMAL_RATE:
+        case PHY_CLASS_HI_RATE:
+#ifdef USE_SX127X
+        case PHY_CLASS_LORA:
+#endif
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void configure_channel(const channel_id_t* channel) {
+    assert(is_channel_supported(channel));
+
+    if(phy_radio_channel_ids_equal(&NG(current_channel_id), channel) && !NG(fact_settings_changed)) {
+        return;
+    }
 
-    current_channel_id = *channel;
+    NG(fact_settings_changed) = false;
+
+    hw_radio_apply_channel_config(get_channel_config(channel));
+
+    NG(current_channel_id) = *channel;
     DPRINT("set channel_header %i, channel_band %i, center_freq_index %i\n",
-           current_channel_id.channel_header_raw,
-           current_channel_id.channel_header.ch_freq_band,
-           current_channel_id.center_freq_index);
+           NG(current_channel_id).channel_header_raw,
+           NG(current_channel_id).channel_header.ch_freq_band,
+           NG(current_channel_id).center_freq_index);
 }
 
 static void configure_syncword(syncword_class_t syncword_class, const channel_id_t* channel)
 {
-    current_syncword_class = syncword_class;
-    current_syncword = sync_word_value[syncword_class][channel->channel_header.ch_coding ];
+    NG(current_syncword_class) = syncword_class;
+    NG(current_syncword) = sync_word_value[syncword_class][channel->channel_header.ch_coding ];
 
     // DPRINT("sync_word = %04x", sync_word);
-    hw_radio_set_sync_word((uint8_t *)&current_syncword, sizeof(uint16_t));
+    hw_radio_set_sync_word((uint8_t *)&NG(current_syncword), sizeof(uint16_t));
 }
 
 void continuous_tx_expiration()
@@ -525,62 +576,91 @@ void continuous_tx_expiration()
     DPRINT("Continuous TX is now terminated");
 }
 
+static void init_airtime()
+{
+    NG(airtime_rate)[PHY_CLASS_LO_RATE] = airtime_fsk_rate(NG(bitrate_lo_rate), TIMER_TICKS_PER_SEC);
+    NG(airtime_rate)[PHY_CLASS_NORMAL_RATE] = airtime_fsk_rate(NG(bitrate_normal_rate), TIMER_TICKS_PER_SEC);
+    NG(airtime_rate)[PHY_CLASS_HI_RATE] = airtime_fsk_rate(NG(bitrate_hi_rate), TIMER_TICKS_PER_SEC);
+    NG(airtime_preamble_size)[PHY_CLASS_LO_RATE] = NG(preamble_size_lo_rate);
+    NG(airtime_preamble_size)[PHY_CLASS_NORMAL_RATE] = NG(preamble_size_normal_rate);
+    NG(airtime_preamble_size)[PHY_CLASS_HI_RATE] = NG(preamble_size_hi_rate);
+
+#ifdef USE_SX127X
+    // as configured by hw_radio_set_lora_mode(): CR 4/5, explicit header, no CRC and the default preamble length
+    NG(lora_airtime) = (airtime_lora_t){
+        .spreading_factor = lora_SF,
+        .coding_rate = 1,
+        .preamble_length = LORA_T_PREAMBLE_LENGTH,
+        .bandwidth = NG(lora_bw),
+        .implicit_header = false,
+        .crc = false,
+        .low_data_rate_optimize = false
+    };
+    airtime_lora_init(&NG(lora_airtime), TIMER_TICKS_PER_SEC);
+#endif
+}
+
 void fact_settings_file_change_callback(uint8_t file_id)
 {
     uint8_t fact_settings[D7A_FILE_FACTORY_SETTINGS_SIZE];
     uint32_t length = D7A_FILE_FACTORY_SETTINGS_SIZE;
     d7ap_fs_read_file(D7A_FILE_FACTORY_SETTINGS_FILE_ID, 0, fact_settings, &length, ROOT_AUTH);
 
-    gain_offset = (int8_t)fact_settings[0];
-    memcpy(&rx_bw_lo_rate, fact_settings + 1, sizeof(uint32_t));
-    rx_bw_lo_rate = __builtin_bswap32(rx_bw_lo_rate);
-    memcpy(&rx_bw_normal_rate, fact_settings + 5, sizeof(uint32_t));
-    rx_bw_normal_rate = __builtin_bswap32(rx_bw_normal_rate);
-    memcpy(&rx_bw_hi_rate, fact_settings + 9, sizeof(uint32_t));
-    rx_bw_hi_rate = __builtin_bswap32(rx_bw_hi_rate);
-
-
-    memcpy(&bitrate_lo_rate, fact_settings + 13, sizeof(uint32_t));
-    bitrate_lo_rate = __builtin_bswap32(bitrate_lo_rate);
-    memcpy(&fdev_lo_rate, fact_settings + 17, sizeof(uint32_t));
-    fdev_lo_rate = __builtin_bswap32(fdev_lo_rate);
-    memcpy(&bitrate_normal_rate, fact_settings + 21, sizeof(uint32_t));
-    bitrate_normal_rate = __builtin_bswap32(bitrate_normal_rate);
-    memcpy(&fdev_normal_rate, fact_settings + 25, sizeof(uint32_t));
-    fdev_normal_rate = __builtin_bswap32(fdev_normal_rate);
-    memcpy(&bitrate_hi_rate, fact_settings + 29, sizeof(uint32_t));
-    bitrate_hi_rate = __builtin_bswap32(bitrate_hi_rate);
-    memcpy(&fdev_hi_rate, fact_settings + 33, sizeof(uint32_t));
-    fdev_hi_rate = __builtin_bswap32(fdev_hi_rate);
-
-    preamble_size_lo_rate = fact_settings[37];
-    preamble_size_normal_rate = fact_settings[38];
-    preamble_size_hi_rate = fact_settings[39];
-
-    preamble_detector_size_lo_rate = fact_settings[40];
-    preamble_detector_size_normal_rate = fact_settings[41];
-    preamble_detector_size_hi_rate = fact_settings[42];
-    preamble_tol_lo_rate = fact_settings[43];
-    preamble_tol_normal_rate = fact_settings[44];
-    preamble_tol_hi_rate = fact_settings[45];
-
-    rssi_smoothing = fact_settings[46];
-    rssi_offset = fact_settings[47];
-
-    hw_radio_set_rssi_config(rssi_smoothing, rssi_offset);
-
-    memcpy(&lora_bw, fact_settings + 48, sizeof(uint32_t));
-    lora_bw = __builtin_bswap32(lora_bw);
+    NG(gain_offset) = (int8_t)fact_settings[0];
+    memcpy(&NG(rx_bw_lo_rate), fact_settings + 1, sizeof(uint32_t));
+    NG(rx_bw_lo_rate) = __builtin_bswap32(NG(rx_bw_lo_rate));
+    memcpy(&NG(rx_bw_normal_rate), fact_settings + 5, sizeof(uint32_t));
+    NG(rx_bw_normal_rate) = __builtin_bswap32(NG(rx_bw_normal_rate));
+    memcpy(&NG(rx_bw_hi_rate), fact_settings + 9, sizeof(uint32_t));
+    NG(rx_bw_hi_rate) = __builtin_bswap32(NG(rx_bw_hi_rate));
+
+
+    memcpy(&NG(bitrate_lo_rate), fact_settings + 13, sizeof(uint32_t));
+    NG(bitrate_lo_rate) = __builtin_bswap32(NG(bitrate_lo_rate));
+    memcpy(&NG(fdev_lo_rate), fact_settings + 17, sizeof(uint32_t));
+    NG(fdev_lo_rate) = __builtin_bswap32(NG(fdev_lo_rate));
+    memcpy(&NG(bitrate_normal_rate), fact_settings + 21, sizeof(uint32_t));
+    NG(bitrate_normal_rate) = __builtin_bswap32(NG(bitrate_normal_rate));
+    memcpy(&NG(fdev_normal_rate), fact_settings + 25, sizeof(uint32_t));
+    NG(fdev_normal_rate) = __builtin_bswap32(NG(fdev_normal_rate));
+    memcpy(&NG(bitrate_hi_rate), fact_settings + 29, sizeof(uint32_t));
+    NG(bitrate_hi_rate) = __builtin_bswap32(NG(bitrate_hi_rate));
+    memcpy(&NG(fdev_hi_rate), fact_settings + 33, sizeof(uint32_t));
+    NG(fdev_hi_rate) = __builtin_bswap32(NG(fdev_hi_rate));
+
+    NG(preamble_size_lo_rate) = fact_settings[37];
+    NG(preamble_size_normal_rate) = fact_settings[38];
+    NG(preamble_size_hi_rate) = fact_settings[39];
+
+    NG(preamble_detector_size_lo_rate) = fact_settings[40];
+    NG(preamble_detector_size_normal_rate) = fact_settings[41];
+    NG(preamble_detector_size_hi_rate) = fact_settings[42];
+    NG(preamble_tol_lo_rate) = fact_settings[43];
+    NG(preamble_tol_normal_rate) = fact_settings[44];
+    NG(preamble_tol_hi_rate) = fact_settings[45];
+
+    NG(rssi_smoothing) = fact_settings[46];
+    NG(rssi_offset) = fact_settings[47];
+
+    hw_radio_set_rssi_config(NG(rssi_smoothing), NG(rssi_offset));
+
+    memcpy(&NG(lora_bw), fact_settings + 48, sizeof(uint32_t));
+    NG(lora_bw) = __builtin_bswap32(NG(lora_bw));
     lora_SF = (uint8_t)fact_settings[52];
 
-    DPRINT("low rate bitrate %i : fdev %i : rx_bw %i : preamble size %i : preamble detector size %i : tol %i", bitrate_lo_rate, fdev_lo_rate, rx_bw_lo_rate, preamble_size_lo_rate, preamble_detector_size_lo_rate, preamble_tol_lo_rate);
-    DPRINT("normal rate bitrate %i : fdev %i : rx_bw %i : preamble size %i : preamble detector size %i : tol %i", bitrate_normal_rate, fdev_normal_rate, rx_bw_normal_rate, preamble_size_normal_rate, preamble_detector_size_normal_rate, preamble_tol_normal_rate);
-    DPRINT("high rate bitrate %i : fdev %i : rx_bw %i : preamble size %i : preamble detector size %i : tol %i", bitrate_hi_rate, fdev_hi_rate, rx_bw_hi_rate, preamble_size_hi_rate, preamble_detector_size_hi_rate, preamble_tol_hi_rate);
-    DPRINT("rssi smoothing is set to %i with an offset of %i", 2 << rssi_smoothing, rssi_offset);
-    DPRINT("gain offset set to %i\n", gain_offset);
-    DPRINT("set lora bw to %i Hz with SF %i\n", lora_bw, lora_SF);
+    DPRINT("low rate bitrate %i : fdev %i : rx_bw %i : preamble size %i : preamble detector size %i : tol %i", NG(bitrate_lo_rate), NG(fdev_lo_rate), NG(rx_bw_lo_rate), NG(preamble_size_lo_rate), NG(preamble_detector_size_lo_rate), NG(preamble_tol_lo_rate));
+    DPRINT("normal rate bitrate %i : fdev %i : rx_bw %i : preamble size %i : preamble detector size %i : tol %i", NG(bitrate_normal_rate), NG(fdev_normal_rate), NG(rx_bw_normal_rate), NG(preamble_size_normal_rate), NG(preamble_detector_size_normal_rate), NG(preamble_tol_normal_rate));
+    DPRINT("high rate bitrate %i : fdev %i : rx_bw %i : preamble size %i : preamble detector size %i : tol %i", NG(bitrate_hi_rate), NG(fdev_hi_rate), NG(rx_bw_hi_rate), NG(preamble_size_hi_rate), NG(preamble_detector_size_hi_rate), NG(preamble_tol_hi_rate));
+    DPRINT("rssi smoothing is set to %i with an offset of %i", 2 << NG(rssi_smoothing), NG(rssi_offset));
+    DPRINT("gain offset set to %i\n", NG(gain_offset));
+    DPRINT("set lora bw to %i Hz with SF %i\n", NG(lora_bw), lora_SF);
+
+    init_airtime();
 
-    fact_settings_changed = true;
+    // the cached channel settings are derived from the factory settings
+    NG(channel_config_cache_count) = 0;
+    NG(channel_config_cache_next) = 0;
+    NG(fact_settings_changed) = true;
 }
 
 
@@ -588,16 +668,16 @@ error_t phy_init(void) {
 
     error_t ret = SUCCESS;
 
-    state = STATE_IDLE;
+    NG(state) = STATE_IDLE;
 
-    init_args.alloc_packet_cb = alloc_new_packet;
-    init_args.release_packet_cb = release_packet;
-    init_args.rx_packet_cb = packet_received;
-    init_args.tx_packet_cb = packet_transmitted;
-    init_args.rx_packet_header_cb = packet_header_received;
-    init_args.tx_refill_cb = fill_in_fifo;
+    NG(init_args).alloc_packet_cb = alloc_new_packet;
+    NG(init_args).release_packet_cb = release_packet;
+    NG(init_args).rx_packet_cb = packet_received;
+    NG(init_args).tx_packet_cb = packet_transmitted;
+    NG(init_args).rx_packet_header_cb = packet_header_received;
+    NG(init_args).tx_refill_cb = fill_in_fifo;
 
-    hw_radio_init(&init_args);
+    hw_radio_init(&NG(init_args));
 
 #ifdef HAL_RADIO_USE_HW_CRC
     hw_radio_set_crc_on(true);
@@ -633,22 +713,24 @@ error_t phy_init(void) {
     //hw_radio_set_opmode(OPMODE_STANDBY); --> done by the netdev driver
     //while(hw_radio_get_opmode() != OPMODE_STANDBY) {}
 
-    timer_init_event(&continuous_tx_expiration_timer, &continuous_tx_expiration);
+    timer_init_event(&NG(continuous_tx_expiration_timer), &continuous_tx_expiration);
+    sched_register_task(&prepare_background_frames);
 
     return ret;
 }
 
 error_t phy_stop() {
     d7ap_fs_unregister_file_modified_callback(D7A_FILE_FACTORY_SETTINGS_FILE_ID);
-    timer_cancel_event(&continuous_tx_expiration_timer);
+    timer_cancel_event(&NG(continuous_tx_expiration_timer));
 }
 
 void status_write() {
-    write_file_counter++;
-    if(write_file_counter == 100) {
-        write_file_counter = 0;
-        uint16_t bg_trigger_ratio = 1024 * total_rssi_triggers / total_bg;
-        uint16_t scan_timeout_ratio = 1024 * (total_fg - total_succeeded_fg) / total_fg;
+    NG(write_file_counter)++;
+    if(NG(write_file_counter) == 100) {
+        NG(write_file_counter) = 0;
+        // a node may only do one kind of scan
+        uint16_t bg_trigger_ratio = NG(total_bg) ? 1024 * NG(total_rssi_triggers) / NG(total_bg) : 0;
+        uint16_t scan_timeout_ratio = NG(total_fg) ? 1024 * (NG(total_fg) - NG(total_succeeded_fg)) / NG(total_fg) : 0;
         uint8_t buffer[4] = {(uint8_t)(bg_trigger_ratio >> 8), (uint8_t)(bg_trigger_ratio & 0xFF), (uint8_t)(scan_timeout_ratio >> 8), (uint8_t)(scan_timeout_ratio & 0xFF)};
         d7ap_fs_write_file(D7A_FILE_DLL_STATUS_FILE_ID, 8, buffer, 4, ROOT_AUTH);
         DPRINT("wrote to file 0x%02X the bg trigger ratio %d and scan timeout ratio %d", D7A_FILE_DLL_STATUS_FILE_ID, bg_trigger_ratio, scan_timeout_ratio);
@@ -656,16 +738,19 @@ void status_write() {
 }
 
 error_t phy_start_rx(channel_id_t* channel, syncword_class_t syncword_class, phy_rx_packet_callback_t rx_cb) {
-    received_callback = rx_cb;
-    // TODO error handling EINVAL, EOFF
+    if(!is_channel_supported(channel))
+        return EINVAL;
+
+    NG(received_callback) = rx_cb;
+    // TODO error handling EOFF
 
     // if we are currently transmitting wait until TX completed before entering RX
     // we return now and go into RX when TX is completed
-    if(state == STATE_TX)
+    if(NG(state) == STATE_TX)
     {
-        should_rx_after_tx_completed = true;
-        pending_rx_cfg.channel_id = *channel;
-        pending_rx_cfg.syncword_class = syncword_class;
+        NG(should_rx_after_tx_completed) = true;
+        NG(pending_rx_cfg).channel_id = *channel;
+        NG(pending_rx_cfg).syncword_class = syncword_class;
         return SUCCESS;
     }
 
@@ -679,11 +764,11 @@ error_t phy_start_rx(channel_id_t* channel, syncword_class_t syncword_class, phy
     DEBUG_RX_START();
     DEBUG_FG_START();    
 
-    total_fg++;
+    NG(total_fg)++;
 
     status_write();
 
-    state = STATE_RX;
+    NG(state) = STATE_RX;
     hw_radio_set_opmode(HW_STATE_RX);
 
     return SUCCESS;
@@ -692,14 +777,17 @@ error_t phy_start_rx(channel_id_t* channel, syncword_class_t syncword_class, phy
 error_t phy_start_energy_scan(channel_id_t* channel, rssi_valid_callback_t rssi_cb, int16_t scan_duration)
 {
     // We should not initiate a RSSI measurement before TX is completed
-    assert(state != STATE_TX);
+    assert(NG(state) != STATE_TX);
+
+    if(!is_channel_supported(channel))
+        return EINVAL;
 
     configure_channel(channel);
     //configure_syncword(syncword_class, channel);
     hw_radio_set_payload_length(0x00); // unlimited length mode
 
     // switch to RX since the RSSI measurement is done in RX mode
-    state = STATE_RX;
+    NG(state) = STATE_RX;
 
     //FIXME support asynchronous RSSI and scan duration
     //uint8_t rssi_samples = scan_duration
@@ -725,7 +813,7 @@ static uint16_t encode_packet(hw_radio_packet_t* packet, uint8_t* encoded_packet
     memcpy(encoded_packet, packet->data, packet->length);
 
 #ifndef HAL_RADIO_USE_HW_FEC
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
         encoded_len = fec_encode(encoded_packet, packet->length);
 #endif
 
@@ -743,18 +831,21 @@ error_t phy_send_packet(hw_radio_packet_t* packet, phy_tx_config_t* config, phy_
 {
     assert(packet->length <= PACKET_MAX_SIZE);
 
-    transmitted_callback = tx_callback;
+    NG(transmitted_callback) = tx_callback;
 
     if(packet->length == 0)
         return ESIZE;
 
-    current_packet = packet;
+    if(!is_channel_supported(&config->channel_id))
+        return EINVAL;
 
-    if(state == STATE_RX)
+    NG(current_packet) = packet;
+
+    if(NG(state) == STATE_RX)
     {
-        pending_rx_cfg.channel_id = current_channel_id;
-        pending_rx_cfg.syncword_class = current_syncword_class;
-        should_rx_after_tx_completed = true;
+        NG(pending_rx_cfg).channel_id = NG(current_channel_id);
+        NG(pending_rx_cfg).syncword_class = NG(current_syncword_class);
+        NG(should_rx_after_tx_completed) = true;
         phy_switch_to_standby_mode();
     }
 
@@ -762,68 +853,102 @@ error_t phy_send_packet(hw_radio_packet_t* packet, phy_tx_config_t* config, phy_
     configure_eirp(config->eirp);
     configure_syncword(config->syncword_class, &config->channel_id);
 
-    state = STATE_TX;
+    NG(state) = STATE_TX;
 
     DPRINT("BEFORE ENCODING TX len=%i", packet->length);
     DPRINT_DATA(packet->data, packet->length);
 
     // Encode the packet if not supported by xcvr
     // uint8_t encoded_packet[(PACKET_MAX_SIZE + 1)*2]; // bufer sized for FEC encoding
-    fg_frame.encoded_length = encode_packet(packet, fg_frame.encoded_packet);
+    NG(fg_frame).encoded_length = encode_packet(packet, NG(fg_frame).encoded_packet);
 
-    DPRINT("AFTER ENCODING TX len=%i\n", fg_frame.encoded_length);
-    DPRINT_DATA(fg_frame.encoded_packet, fg_frame.encoded_length);
+    DPRINT("AFTER ENCODING TX len=%i\n", NG(fg_frame).encoded_length);
+    DPRINT_DATA(NG(fg_frame).encoded_packet, NG(fg_frame).encoded_length);
 
     DEBUG_RX_END();
     DEBUG_TX_START();
 
     DPRINT("start sending @ %i\n", timer_get_counter_value());
 
-    hw_radio_send_payload(fg_frame.encoded_packet, fg_frame.encoded_length);
+    hw_radio_send_payload(NG(fg_frame).encoded_packet, NG(fg_frame).encoded_length);
 
     return SUCCESS; // TODO other return codes
 }
 
-static uint8_t assemble_background_payload()
+static uint8_t assemble_background_payload(uint8_t* payload, uint16_t eta)
 {
     uint16_t crc, swap_eta;
     uint8_t payload_len;
 
     /*
-     * Build the next advertising frame.
+     * Build an advertising frame.
      * In order to flood the channel with advertising frames without discontinuity,
      * the FIFO is refilled with the next frames within the same TX.
      * For that, the preamble and the sync word are explicitly inserted before each
      * subsequent advertising frame.
      */
 
-    memcpy(bg_adv.packet_payload, bg_adv.dll_header, BACKGROUND_DLL_HEADER_LENGTH);
+    memcpy(payload, NG(bg_adv).dll_header, BACKGROUND_DLL_HEADER_LENGTH);
 
     // add ETA for background frames
-    //DPRINT("eta %i", bg_adv.eta);
-    swap_eta = __builtin_bswap16(bg_adv.eta);
-    memcpy(&bg_adv.packet_payload[BACKGROUND_DLL_HEADER_LENGTH], &swap_eta, sizeof(uint16_t));
+    //DPRINT("eta %i", eta);
+    swap_eta = __builtin_bswap16(eta);
+    memcpy(&payload[BACKGROUND_DLL_HEADER_LENGTH], &swap_eta, sizeof(uint16_t));
 
-    // add CRC
-    crc = __builtin_bswap16(crc_calculate(bg_adv.packet_payload, 4));
-    memcpy(&bg_adv.packet_payload[BACKGROUND_DLL_HEADER_LENGTH + sizeof(uint16_t)], &crc, 2);
+    // add CRC, only the ETA needs to be added to the CRC of the DLL header
+    crc_ctx_t crc_ctx = NG(bg_adv).dll_header_crc;
+    crc_update(&crc_ctx, (uint8_t*)&swap_eta, sizeof(uint16_t));
+    crc = __builtin_bswap16(crc_final(&crc_ctx));
+    memcpy(&payload[BACKGROUND_DLL_HEADER_LENGTH + sizeof(uint16_t)], &crc, 2);
 
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
     {
-        payload_len = fec_encode(bg_adv.packet_payload, BACKGROUND_FRAME_LENGTH);
-        pn9_encode(bg_adv.packet_payload, payload_len);
+        payload_len = fec_encode(payload, BACKGROUND_FRAME_LENGTH);
+        pn9_encode(payload, payload_len);
     }
     else
     {
         //DPRINT("assemble payload %d", BACKGROUND_FRAME_LENGTH);
-        //DPRINT_DATA(bg_adv.packet_payload, BACKGROUND_FRAME_LENGTH);
-        pn9_encode(bg_adv.packet_payload, BACKGROUND_FRAME_LENGTH);
+        //DPRINT_DATA(payload, BACKGROUND_FRAME_LENGTH);
+        pn9_encode(payload, BACKGROUND_FRAME_LENGTH);
         payload_len = BACKGROUND_FRAME_LENGTH;
     }
 
     return payload_len;
 }
 
+/*
+ * Prepares the next background frame in the ring. The ETA of a frame follows from the ETA of the first frame and the
+ * number of frames before it, not from the current time.
+ */
+static void prepare_background_frame(void)
+{
+    uint8_t* packet = NG(bg_adv).packets[NG(bg_adv).frames_prepared % BG_ADV_PREPARED_FRAMES];
+    assemble_background_payload(packet + NG(bg_adv).payload_offset, NG(bg_adv).next_eta >> AIRTIME_RATE_FRACTIONAL_BITS);
+    NG(bg_adv).next_eta -= NG(bg_adv).frame_duration;
+    NG(bg_adv).frames_prepared++;
+}
+
+/*
+ * Prepares background frames until the ring is full or all frames of the advertising period are prepared. Each frame
+ * is prepared atomically, since fill_in_fifo() runs in the FIFO level interrupt of the radio and prepares the frame
+ * itself when this task is late.
+ */
+static void prepare_background_frames(void *arg)
+{
+    (void)arg;
+    bool done = false;
+    while (!done)
+    {
+        start_atomic();
+        done = NG(bg_adv).frames_prepared == NG(bg_adv).frame_count
+               || NG(bg_adv).frames_prepared - NG(bg_adv).frames_sent == BG_ADV_PREPARED_FRAMES;
+        if (!done)
+            prepare_background_frame();
+        end_atomic();
+    }
+}
+
 /** \brief Send a packet using background advertising
  *
  * Start a background frame flooding until expiration of the advertising period, followed by transmission
@@ -836,14 +961,17 @@ static uint8_t assemble_background_payload()
 error_t phy_send_packet_with_advertising(hw_radio_packet_t* packet, phy_tx_config_t* config,
                                          uint8_t dll_header_bg_frame[2], uint16_t eta, phy_tx_packet_callback_t tx_callback)
 {   
-    transmitted_callback = tx_callback;
+    if(!is_channel_supported(&config->channel_id))
+        return EINVAL;
+
+    NG(transmitted_callback) = tx_callback;
     DPRINT("Start the bg advertising for ad-hoc sync before transmitting the FG frame");
 
     configure_syncword(PHY_SYNCWORD_CLASS0, &config->channel_id);
     configure_channel(&config->channel_id);
     configure_eirp(config->eirp);
 
-    current_packet = packet;
+    NG(current_packet) = packet;
 
     // During the advertising flooding, use the infinite packet length mode
     hw_radio_set_payload_length(0x00); // unlimited length mode
@@ -852,59 +980,68 @@ error_t phy_send_packet_with_advertising(hw_radio_packet_t* packet, phy_tx_confi
     hw_radio_enable_preloading(true);
 
     // Prepare the subsequent background frames which include the preamble and the sync word
-    uint8_t preamble_len = (current_channel_id.channel_header.ch_class ==  PHY_CLASS_HI_RATE ? PREAMBLE_HI_RATE_CLASS : PREAMBLE_LOW_RATE_CLASS);
-    memset(bg_adv.packet, 0xAA, preamble_len); // preamble length is given in number of bytes
-    uint16_t sync_word = __builtin_bswap16(sync_word_value[PHY_SYNCWORD_CLASS0][current_channel_id.channel_header.ch_coding]);
-    memcpy(&bg_adv.packet[preamble_len], &sync_word, 2);
+    uint8_t preamble_len = (NG(current_channel_id).channel_header.ch_class ==  PHY_CLASS_HI_RATE ? PREAMBLE_HI_RATE_CLASS : PREAMBLE_LOW_RATE_CLASS);
+    uint16_t sync_word = __builtin_bswap16(sync_word_value[PHY_SYNCWORD_CLASS0][NG(current_channel_id).channel_header.ch_coding]);
+    for (uint8_t i = 0; i < BG_ADV_PREPARED_FRAMES; i++)
+    {
+        memset(NG(bg_adv).packets[i], 0xAA, preamble_len); // preamble length is given in number of bytes
+        memcpy(&NG(bg_adv).packets[i][preamble_len], &sync_word, 2);
+    }
 
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
-        bg_adv.packet_size = preamble_len + 2 + fec_calculated_decoded_length(BACKGROUND_FRAME_LENGTH);
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
+        NG(bg_adv).packet_size = preamble_len + 2 + fec_calculated_decoded_length(BACKGROUND_FRAME_LENGTH);
     else
-        bg_adv.packet_size = preamble_len + 2 + BACKGROUND_FRAME_LENGTH;
+        NG(bg_adv).packet_size = preamble_len + 2 + BACKGROUND_FRAME_LENGTH;
 
-    bg_adv.packet_payload = bg_adv.packet + preamble_len + 2 ;
+    NG(bg_adv).payload_offset = preamble_len + 2;
 
     // Backup the DLL header
-    memcpy(bg_adv.dll_header, dll_header_bg_frame, BACKGROUND_DLL_HEADER_LENGTH);
+    memcpy(NG(bg_adv).dll_header, dll_header_bg_frame, BACKGROUND_DLL_HEADER_LENGTH);
+    crc_init(&NG(bg_adv).dll_header_crc);
+    crc_update(&NG(bg_adv).dll_header_crc, NG(bg_adv).dll_header, BACKGROUND_DLL_HEADER_LENGTH);
     DPRINT("DLL header followed by ETA %i", eta);
-    DPRINT_DATA(bg_adv.dll_header, BACKGROUND_DLL_HEADER_LENGTH);
-
-    bg_adv.eta = eta;
-    bg_adv.tx_duration = phy_calculate_tx_duration(current_channel_id.channel_header.ch_class,
-                                                   current_channel_id.channel_header.ch_coding,
-                                                   BACKGROUND_FRAME_LENGTH, false);
+    DPRINT_DATA(NG(bg_adv).dll_header, BACKGROUND_DLL_HEADER_LENGTH);
+
+    // The ETA of the first frame is the time from its end until the foreground frame, every next frame is sent one frame
+    // duration later. As many frames are sent as fit in the ETA of the first frame, the remaining time, plus the time
+    // receivers need to start the foreground scan (Tadv = Tsched + Ttx + Tfg_startup + Tcalc), is padded with preamble.
+    NG(bg_adv).frame_duration = NG(airtime_rate)[NG(current_channel_id).channel_header.ch_class] * NG(bg_adv).packet_size;
+    assert(NG(bg_adv).frame_duration > 0); // no background advertising on LoRa
+    uint32_t eta_fixed_point = (uint32_t)eta << AIRTIME_RATE_FRACTIONAL_BITS;
+    NG(bg_adv).frame_count = 1 + eta_fixed_point / NG(bg_adv).frame_duration;
+    NG(bg_adv).frames_prepared = 0;
+    NG(bg_adv).frames_sent = 0;
+    NG(bg_adv).next_eta = eta_fixed_point;
+
+    uint32_t padding_duration = eta_fixed_point % NG(bg_adv).frame_duration
+                                + ((FG_SCAN_STARTUP_TIME + 4) << AIRTIME_RATE_FRACTIONAL_BITS);
+    uint32_t padding_length = padding_duration / NG(airtime_rate)[NG(current_channel_id).channel_header.ch_class];
+    NG(bg_adv).padding_length = padding_length < sizeof(NG(bg_adv).padding) ? padding_length : sizeof(NG(bg_adv).padding);
+    memset(NG(bg_adv).padding, 0xAA, NG(bg_adv).padding_length);
+    DPRINT("BG Tadv %i: %lu frames followed by %i preamble bytes", eta, (unsigned long)NG(bg_adv).frame_count, NG(bg_adv).padding_length);
 
     // prepare the foreground frame, so we can transmit this immediately
     DPRINT("Original payload with ETA %i", eta);
     DPRINT_DATA(packet->data, packet->length);
 
-    DPRINT("tx_duration_bg_frame %i", bg_adv.tx_duration);
-    fg_frame.bg_adv = true;
-    memset(fg_frame.encoded_packet, 0xAA, preamble_len);
-    sync_word = __builtin_bswap16(sync_word_value[PHY_SYNCWORD_CLASS1][current_channel_id.channel_header.ch_coding]);
-    memcpy(&fg_frame.encoded_packet[preamble_len], &sync_word, 2);
-    fg_frame.encoded_length = encode_packet(packet, &fg_frame.encoded_packet[preamble_len + 2]);
-    fg_frame.encoded_length += preamble_len + 2; // add preamble + syncword
+    NG(fg_frame).bg_adv = true;
+    memset(NG(fg_frame).encoded_packet, 0xAA, preamble_len);
+    sync_word = __builtin_bswap16(sync_word_value[PHY_SYNCWORD_CLASS1][NG(current_channel_id).channel_header.ch_coding]);
+    memcpy(&NG(fg_frame).encoded_packet[preamble_len], &sync_word, 2);
+    NG(fg_frame).encoded_length = encode_packet(packet, &NG(fg_frame).encoded_packet[preamble_len + 2]);
+    NG(fg_frame).encoded_length += preamble_len + 2; // add preamble + syncword
 
-    uint8_t payload_len;
-    payload_len = assemble_background_payload();
+    prepare_background_frames(NULL);
 
     // For the first advertising frame, transmit directly the payload since the preamble and the sync word are directly managed by the xcv
+    uint8_t payload_len = NG(bg_adv).packet_size - NG(bg_adv).payload_offset;
     DPRINT("Transmit packet: %d", payload_len);
-    DPRINT_DATA(bg_adv.packet_payload, payload_len);
-
-    hw_radio_send_payload(bg_adv.packet_payload, payload_len); // in preloading mode
-
-    // prepare the next advertising frame, insert the preamble and the SYNC word
-    bg_adv.eta -= bg_adv.tx_duration; // the next ETA is the time remaining after the end transmission time of the D7AAdvP frame
-    assemble_background_payload();
+    DPRINT_DATA(NG(bg_adv).packets[0] + NG(bg_adv).payload_offset, payload_len);
 
-    // start Tx
-    timer_tick_t start = timer_get_counter_value();
-    bg_adv.stop_time = start + eta + bg_adv.tx_duration + FG_SCAN_STARTUP_TIME + 4; // Tadv = Tsched + Ttx + Tfg_startup + Tcalc
-    DPRINT("BG Tadv %i (start time @ %i stop time @ %i)", eta + bg_adv.tx_duration, start, bg_adv.stop_time);
+    hw_radio_send_payload(NG(bg_adv).packets[0] + NG(bg_adv).payload_offset, payload_len); // in preloading mode
+    NG(bg_adv).frames_sent = 1;
 
-    state = STATE_TX;
+    NG(state) = STATE_TX;
     DEBUG_RX_END();
     DEBUG_TX_START();
     DEBUG_BG_START();
@@ -916,95 +1053,70 @@ error_t phy_send_packet_with_advertising(hw_radio_packet_t* packet, phy_tx_confi
 
 static void fill_in_fifo(uint16_t remaining_bytes_len)
 {
-    // To update the ETA, we take into account the number of remaining bytes still to be transmitted
-    // Also, at the time we calculate ETA here we will only insert the previously crafted packet (containing the prev ETA) in the
-    // FIFO. So we will need to take this into account as well.
-
-    // TODO adapt how we calculate ETA. There is no reason to use current time for each ETA update, we can just use the BG frame duration
-    // and a frame counter to determine this.
-
-    if (fg_frame.bg_adv)
+    if (NG(fg_frame).bg_adv)
     {
         DEBUG_BG_END();
-        timer_tick_t current = timer_get_counter_value();
-        // DPRINT("fill in fifo, bg adv, currently %d untill %d\n", current, bg_adv.stop_time);
-
-        // calculate the time needed to flush the remaining bytes in the TX
-        uint16_t flush_duration = phy_calculate_tx_duration(current_channel_id.channel_header.ch_class,
-                                                            PHY_CODING_PN9, // override FEC, we need the time for the BG_THRESHOLD bytes in the fifo, regardless of coding
-                                                            remaining_bytes_len, true); // don't take syncword and preamble into account
-
-        if (bg_adv.stop_time > current + 2 * bg_adv.tx_duration + flush_duration)
-            bg_adv.eta = (bg_adv.stop_time - current) - 2 * bg_adv.tx_duration; // ETA is updated according the real current time
-        else if(bg_adv.stop_time > current + bg_adv.tx_duration + flush_duration)
-            bg_adv.eta = 1; // Send last background frame with ETA which we calculated and assembled previous loop.
-        else
-            //TODO avoid stop time being elapsed
-            bg_adv.eta = 0;
-
-        DPRINT("ts after tx %d, new ETA %d\n", current + bg_adv.tx_duration, bg_adv.eta);
-
-        /*
-         * When no more advertising background frames can be fully transmitted before
-         * the start of D7ANP, the last background frame is extended by padding preamble
-         * symbols after the end of the background packet, in order to guarantee no silence period.
-         * The FIFO level allows to write enough padding preamble bytes without overflow
-         */
-        if(bg_adv.eta)
+
+        if (NG(bg_adv).frames_sent < NG(bg_adv).frame_count)
         {
             DEBUG_BG_START();
+            if (NG(bg_adv).frames_sent == NG(bg_adv).frames_prepared)
+                prepare_background_frame(); // the preparation task did not run in time, only prepare the frame to send now
+
             // Fill up the TX FIFO with the full packet including the preamble and the SYNC word
-            hw_radio_send_payload(bg_adv.packet, bg_adv.packet_size);
+            hw_radio_send_payload(NG(bg_adv).packets[NG(bg_adv).frames_sent % BG_ADV_PREPARED_FRAMES], NG(bg_adv).packet_size);
+            NG(bg_adv).frames_sent++;
 
-            // Prepare the next frame
-            assemble_background_payload();
+            // prepare the next half of the ring while the frames in this half are being transmitted
+            if (NG(bg_adv).frames_prepared < NG(bg_adv).frame_count
+                && NG(bg_adv).frames_prepared - NG(bg_adv).frames_sent <= BG_ADV_PREPARED_FRAMES / 2)
+                sched_post_task_prio(&prepare_background_frames, MAX_PRIORITY + 1, NULL);
         }
         else
         {
-            // not enough time for sending another BG frame, send the FG frame,
-            // prepend with preamble bytes if necessary
-            uint16_t preamble_len = 0;
-            uint8_t preamble[24];
-
-            preamble_len = (bg_adv.stop_time - current) * (bg_adv.packet_size / (float)bg_adv.tx_duration); // TODO instead of current we should use the timestamp
-            DPRINT("ETA %d, packet size %d, tx_duration %d, current time %d\n", bg_adv.eta, bg_adv.packet_size, bg_adv.tx_duration, timer_get_counter_value());
-
-            DPRINT("Add preamble_bytes: %d\n", preamble_len);
-            memset(preamble, 0xAA, preamble_len);
-            hw_radio_send_payload(preamble, preamble_len);
+            /*
+             * When no more advertising background frames can be fully transmitted before
+             * the start of D7ANP, the last background frame is extended by padding preamble
+             * symbols after the end of the background packet, in order to guarantee no silence period.
+             * The FIFO level allows to write enough padding preamble bytes without overflow
+             */
+            DPRINT("Add preamble_bytes: %d\n", NG(bg_adv).padding_length);
+            hw_radio_send_payload(NG(bg_adv).padding, NG(bg_adv).padding_length);
             DEBUG_BG_END();
 
-            bg_adv.eta = 0;
-            fg_frame.bg_adv = false;
+            NG(fg_frame).bg_adv = false;
         }
     }
     else
     {
         // Disable the refill event since this is the last chunk of data to transmit
-        if (state != STATE_CONT_TX) 
+        if (NG(state) != STATE_CONT_TX) 
             hw_radio_enable_refill(false);
         DEBUG_FG_START();
-        hw_radio_send_payload(fg_frame.encoded_packet, fg_frame.encoded_length);
+        hw_radio_send_payload(NG(fg_frame).encoded_packet, NG(fg_frame).encoded_length);
     }
 }
 
 error_t phy_start_background_scan(phy_rx_config_t* config, phy_rx_packet_callback_t rx_cb)
 {
+    if(!is_channel_supported(&config->channel_id))
+        return EINVAL;
+
     DEBUG_BG_START();
-    received_callback = rx_cb;
+    NG(received_callback) = rx_cb;
     uint8_t packet_len;
 
     //DPRINT("START BG scan @ %i", timer_get_counter_value());
 
     // We should not initiate a background scan before TX is completed
-    assert(state != STATE_TX);
+    assert(NG(state) != STATE_TX);
 
-    state = STATE_BG_SCAN;
+    NG(state) = STATE_BG_SCAN;
 
     configure_syncword(PHY_SYNCWORD_CLASS0, &config->channel_id);
     configure_channel(&config->channel_id);
 
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
         packet_len = fec_calculated_decoded_length(BACKGROUND_FRAME_LENGTH);
     else
         packet_len = BACKGROUND_FRAME_LENGTH;
@@ -1012,7 +1124,7 @@ error_t phy_start_background_scan(phy_rx_config_t* config, phy_rx_packet_callbac
     // set PayloadLength to the length of the expected Background frame (fixed length packet format is used)
     hw_radio_set_payload_length(packet_len);
 
-    total_bg++;
+    NG(total_bg)++;
 
     DEBUG_RX_START();
 
@@ -1031,14 +1143,14 @@ error_t phy_start_background_scan(phy_rx_config_t* config, phy_rx_packet_callbac
     config->rssi_thr = rssi;
     DEBUG_BG_END();
 
-    total_rssi_triggers++;
+    NG(total_rssi_triggers)++;
 
     status_write();
 
     DPRINT("rssi %i, waiting for BG frame\n", rssi);
 
     // the device has a period of To to successfully detect the sync word
-    hw_radio_set_rx_timeout(bg_timeout[current_channel_id.channel_header.ch_class] + 40); //TO DO: OPTIMISE THIS TIMEOUT
+    hw_radio_set_rx_timeout(bg_timeout[NG(current_channel_id).channel_header.ch_class] + 40); //TO DO: OPTIMISE THIS TIMEOUT
     DEBUG_BG_START();
     hw_radio_set_opmode(HW_STATE_RX);
 
@@ -1047,14 +1159,20 @@ error_t phy_start_background_scan(phy_rx_config_t* config, phy_rx_packet_callbac
 
 void phy_continuous_tx(phy_tx_config_t const* tx_cfg, uint8_t time_period, phy_tx_packet_callback_t tx_cb)
 {
-    transmitted_callback = tx_cb;
+    if(!is_channel_supported(&tx_cfg->channel_id))
+    {
+        DPRINT("Continuous tx not supported on channel class %i", tx_cfg->channel_id.channel_header.ch_class);
+        return;
+    }
+
+    NG(transmitted_callback) = tx_cb;
     DPRINT("Continuous tx\n");
 
-    if(state == STATE_RX)
+    if(NG(state) == STATE_RX)
     {
-        pending_rx_cfg.channel_id = current_channel_id;
-        pending_rx_cfg.syncword_class = current_syncword_class;
-        should_rx_after_tx_completed = true;
+        NG(pending_rx_cfg).channel_id = NG(current_channel_id);
+        NG(pending_rx_cfg).syncword_class = NG(current_syncword_class);
+        NG(should_rx_after_tx_completed) = true;
         phy_switch_to_standby_mode();
     }
 
@@ -1063,38 +1181,38 @@ void phy_continuous_tx(phy_tx_config_t const* tx_cfg, uint8_t time_period, phy_t
     configure_syncword(tx_cfg->syncword_class, &tx_cfg->channel_id);
     hw_radio_enable_refill(true);
 
-    state = STATE_CONT_TX;
+    NG(state) = STATE_CONT_TX;
     if(time_period) {
-        continuous_tx_expiration_timer.next_event = time_period * 1024;
-        timer_add_event(&continuous_tx_expiration_timer);
+        NG(continuous_tx_expiration_timer).next_event = time_period * 1024;
+        timer_add_event(&NG(continuous_tx_expiration_timer));
     }
 
-    fg_frame.bg_adv = false;
-    if (current_channel_id.channel_header.ch_coding == PHY_CODING_FEC_PN9)
+    NG(fg_frame).bg_adv = false;
+    if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_FEC_PN9)
     {
         uint8_t payload_len = 32;
-        fg_frame.encoded_packet[0] = payload_len;
+        NG(fg_frame).encoded_packet[0] = payload_len;
         for (uint8_t i = 0; i < payload_len; i++)
-            fg_frame.encoded_packet[i+1] = i;
+            NG(fg_frame).encoded_packet[i+1] = i;
 
-        fg_frame.encoded_length = fec_encode(fg_frame.encoded_packet, payload_len);
-        pn9_encode(fg_frame.encoded_packet, fg_frame.encoded_length);
+        NG(fg_frame).encoded_length = fec_encode(NG(fg_frame).encoded_packet, payload_len);
+        pn9_encode(NG(fg_frame).encoded_packet, NG(fg_frame).encoded_length);
     }
-    else if (current_channel_id.channel_header.ch_coding == PHY_CODING_PN9)
+    else if (NG(current_channel_id).channel_header.ch_coding == PHY_CODING_PN9)
     {
         uint8_t payload_len = 63;
-        fg_frame.encoded_packet[0] = payload_len;
+        NG(fg_frame).encoded_packet[0] = payload_len;
         for (uint8_t i = 0; i < payload_len; i++)
-            fg_frame.encoded_packet[i+1] = 0xAA;
+            NG(fg_frame).encoded_packet[i+1] = 0xAA;
 
-        pn9_encode(fg_frame.encoded_packet, payload_len);
-        fg_frame.encoded_length = payload_len;
+        pn9_encode(NG(fg_frame).encoded_packet, payload_len);
+        NG(fg_frame).encoded_length = payload_len;
     } else {
         uint8_t payload_len = 0xFF;
-        fg_frame.encoded_packet[0] = payload_len;
+        NG(fg_frame).encoded_packet[0] = payload_len;
         for (uint8_t i = 1; i < payload_len; i++)
-            fg_frame.encoded_packet[i+1] = i;
-        fg_frame.encoded_length = payload_len;
+            NG(fg_frame).encoded_packet[i+1] = i;
+        NG(fg_frame).encoded_length = payload_len;
     }
-    hw_radio_send_payload(fg_frame.encoded_packet, fg_frame.encoded_length);
+    hw_radio_send_payload(NG(fg_frame).encoded_packet, NG(fg_frame).encoded_length);
 }
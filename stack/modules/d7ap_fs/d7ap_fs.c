@@ -26,6 +26,7 @@
 #include "framework_defs.h"
 #include "string.h"
 #include "debug.h"
+#include "ng.h"
 #include "fs.h"
 #include "d7ap.h"
 #include "d7ap_fs.h"
@@ -64,10 +65,89 @@
 #define IS_SYSTEM_FILE(file_id) (file_id <= 0x3F)
 
 #define FILE_SIZE_MAX (MODULE_D7AP_FS_FILE_SIZE_MAX + sizeof(d7ap_fs_file_header_t))
-static uint8_t file_buffer[FILE_SIZE_MAX]; // statically allocated buffer used during file operations, to prevent stack overflow at runtime
+static uint8_t NGDEF(file_buffer)[FILE_SIZE_MAX]; // statically allocated buffer used during file operations, to prevent stack overflow at runtime
+
+static d7ap_fs_modified_file_callback_t NGDEF(file_modified_callbacks)[FRAMEWORK_FS_FILE_COUNT]; // TODO limit to lower number so save RAM?
+static d7ap_fs_modifying_file_callback_t NGDEF(file_modifying_callbacks)[FRAMEWORK_FS_FILE_COUNT];
+
+#if MODULE_D7AP_FS_HEADER_CACHE_SIZE > 0
+// write-through cache of decoded file headers, the least recently used entry is replaced when full
+typedef struct {
+  d7ap_fs_file_header_t header; // native byte order
+  uint32_t last_used;
+  uint8_t file_id;
+  bool valid;
+} header_cache_entry_t;
+
+static header_cache_entry_t NGDEF(header_cache)[MODULE_D7AP_FS_HEADER_CACHE_SIZE];
+static uint32_t NGDEF(header_cache_clock) = NGINIT(0);
+#endif
+
+static uint32_t NGDEF(header_cache_hits) = NGINIT(0);
+static uint32_t NGDEF(header_cache_misses) = NGINIT(0);
+
+static bool header_cache_get(uint8_t file_id, d7ap_fs_file_header_t* file_header)
+{
+#if MODULE_D7AP_FS_HEADER_CACHE_SIZE > 0
+  for(uint8_t i = 0; i < MODULE_D7AP_FS_HEADER_CACHE_SIZE; i++)
+  {
+    if(NG(header_cache)[i].valid && NG(header_cache)[i].file_id == file_id)
+    {
+      NG(header_cache)[i].last_used = ++NG(header_cache_clock);
+      memcpy(file_header, &NG(header_cache)[i].header, sizeof(d7ap_fs_file_header_t));
+      NG(header_cache_hits)++;
+      return true;
+    }
+  }
+#endif
+
+  NG(header_cache_misses)++;
+  return false;
+}
+
+static void header_cache_put(uint8_t file_id, const d7ap_fs_file_header_t* file_header)
+{
+#if MODULE_D7AP_FS_HEADER_CACHE_SIZE > 0
+  header_cache_entry_t* entry = &NG(header_cache)[0];
+  for(uint8_t i = 0; i < MODULE_D7AP_FS_HEADER_CACHE_SIZE; i++)
+  {
+    if(NG(header_cache)[i].valid && NG(header_cache)[i].file_id == file_id)
+    {
+      entry = &NG(header_cache)[i];
+      break;
+    }
+
+    if(!NG(header_cache)[i].valid)
+      entry = &NG(header_cache)[i];
+    else if(entry->valid && NG(header_cache)[i].last_used < entry->last_used)
+      entry = &NG(header_cache)[i];
+  }
+
+  memcpy(&entry->header, file_header, sizeof(d7ap_fs_file_header_t));
+  entry->file_id = file_id;
+  entry->last_used = ++NG(header_cache_clock);
+  entry->valid = true;
+#endif
+}
 
-static d7ap_fs_modified_file_callback_t file_modified_callbacks[FRAMEWORK_FS_FILE_COUNT] = { NULL }; // TODO limit to lower number so save RAM?
-static d7ap_fs_modifying_file_callback_t file_modifying_callbacks[FRAMEWORK_FS_FILE_COUNT] = { NULL };
+static void header_cache_invalidate(uint8_t file_id)
+{
+#if MODULE_D7AP_FS_HEADER_CACHE_SIZE > 0
+  for(uint8_t i = 0; i < MODULE_D7AP_FS_HEADER_CACHE_SIZE; i++)
+  {
+    if(NG(header_cache)[i].file_id == file_id)
+      NG(header_cache)[i].valid = false;
+  }
+#endif
+}
+
+static void header_cache_clear()
+{
+#if MODULE_D7AP_FS_HEADER_CACHE_SIZE > 0
+  memset(NG(header_cache), 0, sizeof(NG(header_cache)));
+  NG(header_cache_clock) = 0;
+#endif
+}
 
 static inline bool is_file_defined(uint8_t file_id)
 {
@@ -91,11 +171,11 @@ static int execute_d7a_action_protocol(uint8_t action_file_id, uint8_t interface
   uint32_t action_len = d7ap_fs_get_file_length(action_file_id);
   if(action_len > FILE_SIZE_MAX)
     return -EFBIG;
-  rc = fs_read_file(action_file_id, sizeof(d7ap_fs_file_header_t), file_buffer, action_len);
+  rc = fs_read_file(action_file_id, sizeof(d7ap_fs_file_header_t), NG(file_buffer), action_len);
   if(rc != SUCCESS)
     return rc;
 
-  alp_layer_process_d7aactp(&itf_cfg, file_buffer, action_len);
+  alp_layer_process_d7aactp(&itf_cfg, NG(file_buffer), action_len);
   return SUCCESS;
 }
 #endif // defined(MODULE_ALP) && defined(MODULE_D7AP)
@@ -104,6 +184,7 @@ void d7ap_fs_init()
 {
   //init fs with the D7A specific system files
   fs_init();
+  header_cache_clear();
 
   // TODO platform specific
   // TODO set FW version
@@ -151,16 +232,22 @@ int d7ap_fs_init_file_on_blockdevice(
     file_header_big_endian.length = __builtin_bswap32(file_header_big_endian.length);
     file_header_big_endian.allocated_length = __builtin_bswap32(file_header_big_endian.allocated_length);
     
-    memcpy(file_buffer, (uint8_t *)&file_header_big_endian, sizeof (d7ap_fs_file_header_t));
+    memcpy(NG(file_buffer), (uint8_t *)&file_header_big_endian, sizeof (d7ap_fs_file_header_t));
     uint32_t length = sizeof(d7ap_fs_file_header_t);
     if(initial_data != NULL) {
         length += file_header->length;
         if(length > FILE_SIZE_MAX)
           return -EFBIG;
-        memcpy(file_buffer + sizeof(d7ap_fs_file_header_t), initial_data, file_header->length);
+        memcpy(NG(file_buffer) + sizeof(d7ap_fs_file_header_t), initial_data, file_header->length);
     }
        
-    return fs_init_file(file_id, blockdevice_index, (const uint8_t *)file_buffer, length, sizeof(d7ap_fs_file_header_t) + file_header->allocated_length);
+    int rtc = fs_init_file(file_id, blockdevice_index, (const uint8_t *)NG(file_buffer), length, sizeof(d7ap_fs_file_header_t) + file_header->allocated_length);
+    if(rtc == 0)
+      header_cache_put(file_id, file_header);
+    else
+      header_cache_invalidate(file_id);
+
+    return rtc;
 }
 
 int d7ap_fs_read_file(uint8_t file_id, uint32_t offset, uint8_t* buffer, uint32_t* length, authentication_t auth)
@@ -211,6 +298,9 @@ int d7ap_fs_read_file_header(uint8_t file_id, d7ap_fs_file_header_t* file_header
   int rtc;
   if(!is_file_defined(file_id)) return -ENOENT;
 
+  if(header_cache_get(file_id, file_header))
+    return 0;
+
   rtc = fs_read_file(file_id, 0, (uint8_t *)file_header, sizeof(d7ap_fs_file_header_t));
   if (rtc != 0)
     return rtc;
@@ -221,6 +311,7 @@ int d7ap_fs_read_file_header(uint8_t file_id, d7ap_fs_file_header_t* file_header
   file_header->allocated_length = __builtin_bswap32(file_header->allocated_length);
 #endif
 
+  header_cache_put(file_id, file_header);
   return 0;
 }
 
@@ -237,13 +328,21 @@ int d7ap_fs_write_file_header(uint8_t file_id, d7ap_fs_file_header_t* file_heade
     return -EACCES;
 #endif
 
+  memcpy(&header, file_header, sizeof(d7ap_fs_file_header_t));
+
   // Input of data shall be in big-endian ordering
 #if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
   file_header->length = __builtin_bswap32(file_header->length);
   file_header->allocated_length = __builtin_bswap32(file_header->allocated_length);
 #endif
 
-  return (fs_write_file(file_id, 0, (const uint8_t*)file_header, sizeof(d7ap_fs_file_header_t)));
+  int rtc = fs_write_file(file_id, 0, (const uint8_t*)file_header, sizeof(d7ap_fs_file_header_t));
+  if(rtc == 0)
+    header_cache_put(file_id, &header);
+  else
+    header_cache_invalidate(file_id);
+
+  return rtc;
 }
 
 int d7ap_fs_write_file(uint8_t file_id, uint32_t offset, const uint8_t* buffer, uint32_t length, authentication_t auth)
@@ -272,8 +371,8 @@ int d7ap_fs_write_file_with_callback(uint8_t file_id, uint32_t offset, const uin
     return -EACCES;
 #endif
     
-  if (file_modifying_callbacks[file_id])
-      if (!file_modifying_callbacks[file_id](file_id, offset, buffer, length))
+  if (NG(file_modifying_callbacks)[file_id])
+      if (!NG(file_modifying_callbacks)[file_id](file_id, offset, buffer, length))
           return -EILSEQ;
 
   rtc = fs_write_file(file_id, sizeof(d7ap_fs_file_header_t) + offset, buffer, length);
@@ -291,8 +390,8 @@ int d7ap_fs_write_file_with_callback(uint8_t file_id, uint32_t offset, const uin
   }
 #endif // defined(MODULE_ALP) && defined(MODULE_D7AP)
 
-  if (file_modified_callbacks[file_id] && trigger_modified_cb)
-      file_modified_callbacks[file_id](file_id);
+  if (NG(file_modified_callbacks)[file_id] && trigger_modified_cb)
+      NG(file_modified_callbacks)[file_id](file_id);
 
   return 0;
 }
@@ -471,8 +570,8 @@ int d7ap_fs_change_file_length(uint8_t file_id, uint32_t length)
 }
 
 bool d7ap_fs_unregister_file_modified_callback(uint8_t file_id) {
-    if(file_modified_callbacks[file_id]) {
-        file_modified_callbacks[file_id] = NULL;
+    if(NG(file_modified_callbacks)[file_id]) {
+        NG(file_modified_callbacks)[file_id] = NULL;
         return true;
     } else
         return false;
@@ -483,16 +582,16 @@ bool d7ap_fs_register_file_modified_callback(uint8_t file_id, d7ap_fs_modified_f
     if(!fs_file_stat(file_id))
         return false;
 
-    if(file_modified_callbacks[file_id])
+    if(NG(file_modified_callbacks)[file_id])
         return false; // already registered
 
-    file_modified_callbacks[file_id] = callback;
+    NG(file_modified_callbacks)[file_id] = callback;
     return true;
 }
 
 bool d7ap_fs_unregister_file_modifying_callback(uint8_t file_id) {
-    if(file_modifying_callbacks[file_id]) {
-        file_modifying_callbacks[file_id] = NULL;
+    if(NG(file_modifying_callbacks)[file_id]) {
+        NG(file_modifying_callbacks)[file_id] = NULL;
         return true;
     } else
         return false;
@@ -503,9 +602,15 @@ bool d7ap_fs_register_file_modifying_callback(uint8_t file_id, d7ap_fs_modifying
     if(!fs_file_stat(file_id))
         return false;
 
-    if(file_modifying_callbacks[file_id])
+    if(NG(file_modifying_callbacks)[file_id])
         return false; // already registered
 
-    file_modifying_callbacks[file_id] = callback;
+    NG(file_modifying_callbacks)[file_id] = callback;
     return true;
 }
+
+void d7ap_fs_get_header_cache_stats(uint32_t* hits, uint32_t* misses)
+{
+  *hits = NG(header_cache_hits);
+  *misses = NG(header_cache_misses);
+}
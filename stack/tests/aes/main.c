@@ -209,8 +209,26 @@ static const unsigned char ctr_ct[CTR_TEST_VECTORS_NB][36] =
 
 static const int ctr_len[CTR_TEST_VECTORS_NB] = { 16, 32, 36 };
 
+/*
+ * AES-ECB test vector from FIPS-197, appendix C.1
+ */
+static const uint8_t ecb_key[AES_BLOCK_SIZE] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+
+static const uint8_t ecb_pt[AES_BLOCK_SIZE] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+
+static const uint8_t ecb_ct[AES_BLOCK_SIZE] = {
+    0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30,
+    0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A };
+
 int main(int argc, char *argv[])
 {
+    aes128_ctx_t ecb_ctx;
+    aes128_ctx_t ctr_ctx[CTR_TEST_VECTORS_NB];
+    uint8_t block[AES_BLOCK_SIZE];
     int i;
     error_t ret;
     uint8_t ctr[AES_BLOCK_SIZE];
@@ -222,6 +240,28 @@ int main(int argc, char *argv[])
     // TODO set a minimal platform configuration to enable the AES hardware module
 #endif
 
+    /* test AES-ECB mode */
+    AES128_ctx_init(&ecb_ctx, ecb_key);
+    AES128_ECB_encrypt_ctx(&ecb_ctx, ecb_pt, block);
+    if (memcmp(block, ecb_ct, AES_BLOCK_SIZE) != 0)
+    {
+        DPRINT("AES-ECB encryption output \n");
+        DPRINT_DATA(block, AES_BLOCK_SIZE);
+        DPRINT("AES-ECB encryption failed\n");
+        return -1;
+    }
+
+    AES128_ECB_decrypt_ctx(&ecb_ctx, block, block);
+    if (memcmp(block, ecb_pt, AES_BLOCK_SIZE) != 0)
+    {
+        DPRINT("AES-ECB decryption output \n");
+        DPRINT_DATA(block, AES_BLOCK_SIZE);
+        DPRINT("AES-ECB decryption failed\n");
+        return -1;
+    }
+
+    DPRINT("AES-ECB test vector passed\n");
+
     /* test AES-CTR mode*/
     for (i = 0; i < CTR_TEST_VECTORS_NB; i++)
     {
@@ -254,6 +294,27 @@ int main(int argc, char *argv[])
         DPRINT("AES-CTR test vector #%d passed\n", i + 1);
     }
 
+    /* test AES-CTR mode with all the keys in use at the same time */
+    for (i = 0; i < CTR_TEST_VECTORS_NB; i++)
+        AES128_ctx_init(&ctr_ctx[i], ctr_key[i]);
+
+    for (i = 0; i < CTR_TEST_VECTORS_NB; i++)
+    {
+        memcpy(payload, ctr_pt[i], ctr_len[i]);
+        memcpy(ctr, ctr_blk[i], AES_BLOCK_SIZE);
+
+        AES128_CTR_encrypt_ctx(&ctr_ctx[i], payload, payload, ctr_len[i], ctr);
+        if (memcmp(payload, ctr_ct[i], ctr_len[i] ) != 0)
+        {
+            DPRINT("AES-CTR encryption output \n");
+            DPRINT_DATA(payload, ctr_len[i]);
+            DPRINT("AES-CTR encryption with context #%d failed", i + 1 );
+            return -1;
+        }
+    }
+
+    DPRINT("AES-CTR with multiple contexts passed\n");
+
     // The key is the same for all the ccm test vectors */
     AES128_init(ccm_key);
 
@@ -290,6 +351,59 @@ int main(int argc, char *argv[])
         DPRINT("AES-CCM test vector #%d passed\n", i + 1);
     }
 
+    /* test single pass AES-CCM with the data split over several segments */
+    aes128_ctx_t ccm_ctx;
+    AES128_ctx_init(&ccm_ctx, ccm_key);
+
+    for (i = 0; i < CCM_TEST_VECTORS_NB; i++)
+    {
+        uint8_t tag[CCM_AUTH_LEN];
+        uint8_t add_buf[sizeof(ad)];
+        aes_sg_t add_sg[2] = {
+            { .data = add_buf, .len = 3 },
+            { .data = add_buf + 3, .len = add_len[i] - 3 }
+        };
+        aes_sg_t payload_sg[3] = {
+            { .data = payload, .len = 5 },
+            { .data = payload + 5, .len = 13 },
+            { .data = payload + 18, .len = ccm_len[i] - 18 }
+        };
+
+        memcpy(add_buf, ad, sizeof(ad));
+        memcpy(payload, ccm_pt + ccm_offset[i], ccm_len[i]);
+
+        ret = AES128_CCM_encrypt_sg(&ccm_ctx, ccm_iv[i], ccm_ctr[i], add_sg, 2, payload_sg, 3, tag, CCM_AUTH_LEN);
+        if (ret != 0 || memcmp(payload, ccm_ct[i], ccm_len[i]) != 0
+            || memcmp(tag, ccm_ct[i] + ccm_len[i], CCM_AUTH_LEN) != 0)
+        {
+            DPRINT("AES-CCM encryption output \n");
+            DPRINT_DATA(payload, ccm_len[i]);
+            DPRINT_DATA(tag, CCM_AUTH_LEN);
+            DPRINT("AES-CCM scatter-gather encryption #%d failed\n", i + 1);
+            return -1;
+        }
+
+        ret = AES128_CCM_decrypt_sg(&ccm_ctx, ccm_iv[i], ccm_ctr[i], add_sg, 2, payload_sg, 3, tag, CCM_AUTH_LEN);
+        if (ret != 0 || memcmp(payload, ccm_pt + ccm_offset[i], ccm_len[i]) != 0)
+        {
+            DPRINT("AES-CCM decryption output \n");
+            DPRINT_DATA(payload, ccm_len[i]);
+            DPRINT("AES-CCM scatter-gather decryption #%d failed\n", i + 1);
+            return -1;
+        }
+
+        /* a modified tag shall be rejected */
+        tag[CCM_AUTH_LEN - 1] ^= 0x01;
+        memcpy(payload, ccm_ct[i], ccm_len[i]);
+        if (AES128_CCM_decrypt_sg(&ccm_ctx, ccm_iv[i], ccm_ctr[i], add_sg, 2, payload_sg, 3, tag, CCM_AUTH_LEN) == 0)
+        {
+            DPRINT("AES-CCM scatter-gather #%d accepted a wrong tag\n", i + 1);
+            return -1;
+        }
+
+        DPRINT("AES-CCM scatter-gather test vector #%d passed\n", i + 1);
+    }
+
     DPRINT("AES all unit tests OK !\n");
     return 0;
 }
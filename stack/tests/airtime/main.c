@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the integer airtime calculations against the same calculations in floating point, for both timer
+ * resolutions. The fixed point rates are rounded up, by less than one tick per 2^16 bytes or quarter symbols, so the
+ * result may be one tick more than the floating point result when the exact airtime is just below a whole number of
+ * ticks. Also compares the FSK airtime against the floating point model phy used before, which assumed 1 ms ticks.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "airtime.h"
+#include "test_assert.h"
+
+#define MAX_LENGTH 1024
+
+static const uint32_t ticks_per_sec[] = { 1024, 32768 };
+static const uint32_t bitrates[] = { 9600, 55555, 166667 };
+static const double legacy_bytes_per_tick[] = { 1.2, 6.9, 20.8 };
+static const uint32_t lora_bandwidths[] = { 7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000 };
+
+static void check_ticks(uint32_t ticks, double exact_ticks, uint32_t count, const char* description)
+{
+    uint32_t expected = ceil(exact_ticks);
+    if(ticks == expected || ticks == ceil(exact_ticks + (double)count / (1 << AIRTIME_RATE_FRACTIONAL_BITS)))
+        return;
+
+    printf("%s: %u ticks, expected %u (%f)\n", description, ticks, expected, exact_ticks);
+    check(false, description);
+}
+
+static void test_fsk(void)
+{
+    for(uint8_t t = 0; t < sizeof(ticks_per_sec) / sizeof(ticks_per_sec[0]); t++)
+    {
+        for(uint8_t b = 0; b < sizeof(bitrates) / sizeof(bitrates[0]); b++)
+        {
+            airtime_rate_t rate = airtime_fsk_rate(bitrates[b], ticks_per_sec[t]);
+            for(uint16_t length = 0; length <= MAX_LENGTH; length++)
+            {
+                double exact_ticks = (double)length * 8 * ticks_per_sec[t] / bitrates[b];
+                check_ticks(airtime_fsk_ticks(rate, length), exact_ticks, length, "FSK airtime");
+            }
+        }
+    }
+}
+
+// the previous model used a fixed number of bytes per tick per class, as if a tick lasted 1 ms instead of 1/1024 s,
+// which underestimates the airtime by about 2 %
+static void test_fsk_legacy(void)
+{
+    for(uint8_t b = 0; b < sizeof(bitrates) / sizeof(bitrates[0]); b++)
+    {
+        airtime_rate_t rate = airtime_fsk_rate(bitrates[b], 1024);
+        for(uint16_t length = 0; length <= MAX_LENGTH; length++)
+        {
+            uint32_t legacy_ticks = ceil(length / legacy_bytes_per_tick[b]);
+            uint32_t ticks = airtime_fsk_ticks(rate, length);
+            check(ticks >= legacy_ticks && ticks <= legacy_ticks * 1.03 + 1, "FSK airtime close to the previous model");
+        }
+    }
+}
+
+static double lora_reference(const airtime_lora_t* lora, uint16_t length, uint32_t ticks_per_sec, uint32_t* quarter_symbols)
+{
+    double symbol_ticks = (double)(1 << lora->spreading_factor) / lora->bandwidth * ticks_per_sec;
+    double payload_blocks = ceil((8.0 * length - 4 * lora->spreading_factor + 28 + 16 * lora->crc - 20 * lora->implicit_header)
+                                 / (4 * (lora->spreading_factor - 2 * lora->low_data_rate_optimize)));
+    double payload_symbols = 8 + fmax(payload_blocks * (lora->coding_rate + 4), 0);
+    *quarter_symbols = 4 * (lora->preamble_length + payload_symbols) + 17;
+    return (lora->preamble_length + 4.25 + payload_symbols) * symbol_ticks;
+}
+
+static void test_lora(void)
+{
+    for(uint8_t t = 0; t < sizeof(ticks_per_sec) / sizeof(ticks_per_sec[0]); t++)
+    {
+        for(uint8_t b = 0; b < sizeof(lora_bandwidths) / sizeof(lora_bandwidths[0]); b++)
+        {
+            for(uint8_t sf = 7; sf <= 12; sf++)
+            {
+                for(uint8_t options = 0; options < 32; options++)
+                {
+                    airtime_lora_t lora = {
+                        .spreading_factor = sf,
+                        .coding_rate = 1 + options % 4,
+                        .preamble_length = 8,
+                        .bandwidth = lora_bandwidths[b],
+                        .implicit_header = options & 0x04,
+                        .crc = options & 0x08,
+                        .low_data_rate_optimize = options & 0x10
+                    };
+                    airtime_lora_init(&lora, ticks_per_sec[t]);
+                    for(uint16_t length = 0; length <= 255; length++)
+                    {
+                        uint32_t quarter_symbols;
+                        double exact_ticks = lora_reference(&lora, length, ticks_per_sec[t], &quarter_symbols);
+                        check_ticks(airtime_lora_ticks(&lora, length), exact_ticks, quarter_symbols, "LoRa airtime");
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    test_fsk();
+    test_fsk_legacy();
+    test_lora();
+
+    // SF9, 125 kHz, CR 4/5, explicit header, CRC, 8 symbols preamble and 16 bytes: 40.25 symbols of 4.096 ms
+    airtime_lora_t lora = { .spreading_factor = 9, .coding_rate = 1, .preamble_length = 8, .bandwidth = 125000, .crc = true };
+    airtime_lora_init(&lora, 32768);
+    check(airtime_lora_ticks(&lora, 16) == 5403, "LoRa airtime of a known packet");
+
+    printf("all airtime tests passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks the memory mapped file blockdevice: creating a file with and without initial data, programming and erasing,
+ * and finding the contents back after a "restart", by initializing a second blockdevice on the same file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "blockdevice_mmap.h"
+#include "errors.h"
+#include "test_assert.h"
+
+#define SIZE (40 * 1024)
+
+static char path[] = "/tmp/test_blockdevice_mmap_XXXXXX";
+static uint8_t initial_data[SIZE];
+static uint8_t data[SIZE];
+
+static void remove_file(void)
+{
+    unlink(path);
+}
+
+static void init_blockdevice(blockdevice_mmap_t* bd, blockdevice_mmap_sync_t sync, const uint8_t* initial)
+{
+    *bd = (blockdevice_mmap_t){
+        .base.driver = &blockdevice_driver_mmap,
+        .base.size = SIZE,
+        .path = path,
+        .sync = sync,
+        .initial_data = initial
+    };
+    blockdevice_init(&bd->base);
+}
+
+static bool is_erased(const uint8_t* buffer, uint32_t size)
+{
+    for(uint32_t i = 0; i < size; i++)
+        if(buffer[i] != 0xFF)
+            return false;
+
+    return true;
+}
+
+static void test_create_erased(void)
+{
+    blockdevice_mmap_t bd;
+    init_blockdevice(&bd, BLOCKDEVICE_MMAP_SYNC_NONE, NULL);
+    check(blockdevice_read(&bd.base, data, 0, SIZE) == SUCCESS, "read new file");
+    check(is_erased(data, SIZE), "new file without initial data is erased");
+}
+
+static void test_program_and_restart(void)
+{
+    static blockdevice_mmap_t bd; // stays in the list of blockdevices synced on idle
+    init_blockdevice(&bd, BLOCKDEVICE_MMAP_SYNC_ON_IDLE, initial_data);
+    blockdevice_mmap_sync_idle(); // the initial data
+    uint8_t record[] = { 0x01, 0x02, 0x03, 0x04 };
+    check(blockdevice_program(&bd.base, record, 100, sizeof(record)) == SUCCESS, "program");
+    check(blockdevice_program(&bd.base, record, SIZE - 2, sizeof(record)) == -ESIZE, "program beyond the end");
+    check(bd.dirty_start == 100 && bd.dirty_end == 104, "programmed range is pending for the idle sync");
+    blockdevice_mmap_sync_idle();
+    check(bd.dirty_start == bd.dirty_end, "idle sync clears the pending range");
+
+    // an existing file keeps its contents, the initial data only applies to a new file
+    blockdevice_mmap_t restarted;
+    init_blockdevice(&restarted, BLOCKDEVICE_MMAP_SYNC_WRITE_THROUGH, initial_data);
+    check(blockdevice_read(&restarted.base, data, 96, 8) == SUCCESS, "read after restart");
+    check(is_erased(data, 4) && memcmp(data + 4, record, sizeof(record)) == 0, "contents survive a restart");
+}
+
+static void test_erase(void)
+{
+    blockdevice_mmap_t bd;
+    memset(initial_data, 0x00, SIZE);
+    unlink(path);
+    init_blockdevice(&bd, BLOCKDEVICE_MMAP_SYNC_WRITE_THROUGH, initial_data);
+    check(blockdevice_read(&bd.base, data, 0, SIZE) == SUCCESS && memcmp(data, initial_data, SIZE) == 0,
+          "new file with initial data");
+
+    check(blockdevice_erase_sector4k(&bd.base, 0x1234) == SUCCESS, "erase sector");
+    check(blockdevice_read(&bd.base, data, 0, SIZE) == SUCCESS, "read after erasing a sector");
+    check(data[0x0FFF] == 0x00 && is_erased(data + 0x1000, 0x1000) && data[0x2000] == 0x00,
+          "the 4K sector containing the address is erased");
+
+    check(blockdevice_erase_block32k(&bd.base, 0x9000) == SUCCESS, "erase last block");
+    check(blockdevice_read(&bd.base, data, 0, SIZE) == SUCCESS, "read after erasing a block");
+    check(data[0x7FFF] == 0x00 && is_erased(data + 0x8000, SIZE - 0x8000),
+          "the 32K block containing the address is erased, up to the end of the device");
+    check(blockdevice_erase_block32k(&bd.base, 2 * 0x8000) == -ESIZE, "erase beyond the end");
+
+    check(blockdevice_erase_chip(&bd.base, 0) == SUCCESS, "erase chip");
+    check(blockdevice_read(&bd.base, data, 0, SIZE) == SUCCESS && is_erased(data, SIZE), "chip is erased");
+}
+
+int main(void)
+{
+    int fd = mkstemp(path);
+    check(fd >= 0, "create temporary file");
+    close(fd);
+    unlink(path); // only the name is used, the blockdevice creates the file
+    atexit(&remove_file); // also when a check fails
+
+    for(uint32_t i = 0; i < SIZE; i++)
+        initial_data[i] = (i < 100 || i >= 104) ? 0xFF : i;
+
+    test_create_erased();
+    unlink(path);
+    test_program_and_restart();
+    test_erase();
+
+    printf("all blockdevice_mmap tests passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "crc.h"
+#include "assert.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define BUFFER_SIZE 1024
+
+// reference implementation: CRC16 CCITT, bit by bit
+static uint16_t crc_reference(const uint8_t* data, uint16_t length)
+{
+    uint16_t crc = 0xFFFF;
+    for(uint16_t i = 0; i < length; i++)
+    {
+        crc ^= data[i] << 8;
+        for(uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+void test_check_value()
+{
+    const uint8_t check[] = "123456789";
+    assert(crc_calculate(check, 9) == 0x29B1);
+}
+
+void test_lengths()
+{
+    uint8_t buffer[BUFFER_SIZE];
+    for(int i = 0; i < BUFFER_SIZE; i++)
+        buffer[i] = rand();
+
+    for(int len = 0; len <= BUFFER_SIZE; len++)
+        assert(crc_calculate(buffer, len) == crc_reference(buffer, len));
+}
+
+void test_incremental()
+{
+    uint8_t buffer[BUFFER_SIZE];
+    for(int i = 0; i < BUFFER_SIZE; i++)
+        buffer[i] = rand();
+
+    uint16_t expected = crc_reference(buffer, BUFFER_SIZE);
+    for(int chunk = 1; chunk < 37; chunk++)
+    {
+        crc_ctx_t ctx;
+        crc_init(&ctx);
+        for(int offset = 0; offset < BUFFER_SIZE; offset += chunk)
+            crc_update(&ctx, buffer + offset, (BUFFER_SIZE - offset) < chunk ? (BUFFER_SIZE - offset) : chunk);
+
+        assert(crc_final(&ctx) == expected);
+    }
+}
+
+int main()
+{
+    printf("Testing check value ... ");
+    test_check_value();
+    printf("Success!\n");
+
+    printf("Testing lengths ... ");
+    test_lengths();
+    printf("Success!\n");
+
+    printf("Testing incremental update ... ");
+    test_incremental();
+    printf("Success!\n");
+    return 0;
+}
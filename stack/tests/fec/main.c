@@ -21,156 +21,209 @@
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
+#include <assert.h>
 #include "fec.h"
 
-#define BINARY 0
+#define TRELLIS_TERMINATOR 0x0B
+#define MAX_LENGTH 255
+#define BENCHMARK_LENGTH 128
+#define BENCHMARK_ITERATIONS 20000
 
+const static uint8_t fec_lut[16] = {0, 3, 1, 2, 3, 0, 2, 1, 3, 0, 2, 1, 0, 3, 1, 2};
 
-const char *byte_to_binary(uint8_t x)
+// reference implementation: bit by bit convolutional encoder followed by the interleaver
+static uint16_t fec_encode_reference(const uint8_t* data, uint16_t nbytes, uint8_t* output)
 {
-    static char b[9];
-    b[0] = '\0';
-
-    uint8_t z;
-    for (z = 128; z > 0; z >>= 1)
-    {
-        strcat(b, ((x & z) == z) ? "1" : "0");
-    }
-
-    return b;
+	uint8_t input[MAX_LENGTH + 3];
+	uint16_t total = nbytes + 2 + nbytes % 2;
+	unsigned int encstate = 0;
+	uint16_t length = 0;
+
+	memcpy(input, data, nbytes);
+	memset(input + nbytes, TRELLIS_TERMINATOR, total - nbytes);
+
+	for(uint16_t n = 0; n < total; n += 2)
+	{
+		uint8_t fecbuffer[4] = {0, 0, 0, 0};
+		for(int b = 0; b < 16; b++)
+		{
+			encstate = (encstate << 1) | ((input[n + b / 8] >> (7 - b % 8)) & 1);
+			fecbuffer[b / 4] |= fec_lut[encstate & 0x0F] << (6 - 2 * (b % 4));
+		}
+
+		for(int i = 0; i < 4; i++)
+			output[length++] = ((fecbuffer[0] >> 2 * i) & 0x03) | (((fecbuffer[1] >> 2 * i) & 0x03) << 2) |
+							   (((fecbuffer[2] >> 2 * i) & 0x03) << 4) | (((fecbuffer[3] >> 2 * i) & 0x03) << 6);
+	}
+
+	return length;
 }
 
-unsigned char Partab[] = { 0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0
-,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1
-,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0,};
+static void random_data(uint8_t* data, uint16_t length)
+{
+	for(uint16_t i = 0; i < length; i++)
+		data[i] = rand();
+}
 
-#define TRELLIS_TERMINATOR 0x0B
-const static uint8_t fec_lut[16] = {0, 3, 1, 2, 3, 0, 2, 1, 3, 0, 2, 1, 0, 3, 1, 2};
+void test_encode()
+{
+	uint8_t input[MAX_LENGTH];
+	uint8_t encoded[2 * MAX_LENGTH + 6];
+	uint8_t expected[2 * MAX_LENGTH + 6];
+
+	for(uint16_t len = 0; len <= MAX_LENGTH; len++)
+	{
+		random_data(input, len);
+		uint16_t expected_length = fec_encode_reference(input, len, expected);
+
+		memcpy(encoded, input, len);
+		assert(fec_encode(encoded, len) == expected_length);
+		assert(memcmp(encoded, expected, expected_length) == 0);
+	}
+}
 
+void test_decode()
+{
+	uint8_t input[MAX_LENGTH];
+	uint8_t encoded[2 * MAX_LENGTH + 6];
+	fec_decoder_t decoder;
+
+	for(uint16_t len = 1; len <= MAX_LENGTH; len++)
+	{
+		random_data(input, len);
+		memcpy(encoded, input, len);
+		uint16_t encoded_length = fec_encode(encoded, len);
+
+		// without errors, in place, receiving the length phy expects which drops the last terminator bytes for odd lengths
+		uint8_t decoded[2 * MAX_LENGTH + 6];
+		uint16_t received_length = fec_calculated_decoded_length(len);
+		memcpy(decoded, encoded, received_length);
+		assert(fec_decode_packet(decoded, received_length, received_length) == received_length / 2);
+		assert(memcmp(decoded, input, len) == 0);
+
+		// a single bit error in every 8 received bytes
+		memcpy(decoded, encoded, encoded_length);
+		for(uint16_t i = 0; i < encoded_length; i += 8)
+			decoded[i + rand() % (encoded_length - i < 8 ? encoded_length - i : 8)] ^= 1 << (rand() % 8);
+
+		assert(fec_decode(&decoder, decoded, encoded_length, decoded) == encoded_length / 2);
+		assert(memcmp(decoded, input, len) == 0);
+	}
+}
 
+static void to_samples(const uint8_t* data, uint16_t length, uint8_t* samples, int noise)
+{
+	for(uint16_t i = 0; i < length * 8; i++)
+	{
+		int sample = ((data[i / 8] >> (7 - i % 8)) & 1) ? 255 : 0;
+		sample += (rand() % (2 * noise + 1)) - noise;
+		samples[i] = sample < 0 ? 0 : (sample > 255 ? 255 : sample);
+	}
+}
 
-void test_interleaver()
+void test_decode_soft()
 {
-	uint8_t fecbuffer[4] = {0xFF,0x00,0xAB,0x00};
-	uint8_t buffer[4]= {0,0,0,0};
-	uint8_t buffer2[4]= {0,0,0,0};
-	uint8_t *output = buffer;
-	uint8_t *input = buffer;
-
-	*output++ = ((fecbuffer[0] & 0x03)) |\
-				((fecbuffer[1] & 0x03) << 2) |\
-				((fecbuffer[2] & 0x03) << 4) |\
-				((fecbuffer[3] & 0x03) << 6);
-	*output++ = (((fecbuffer[0] >> 2) & 0x03)) |\
-					(((fecbuffer[1] >> 2) & 0x03) << 2) |\
-					(((fecbuffer[2] >> 2) & 0x03) << 4) |\
-					(((fecbuffer[3] >> 2) & 0x03) << 6);
-	*output++ = (((fecbuffer[0] >> 4) & 0x03)) |\
-					(((fecbuffer[1] >> 4) & 0x03) << 2) |\
-					(((fecbuffer[2] >> 4) & 0x03) << 4) |\
-					(((fecbuffer[3] >> 4) & 0x03) << 6);
-	*output++ = (((fecbuffer[0] >> 6) & 0x03)) |\
-					(((fecbuffer[1] >> 6) & 0x03) << 2) |\
-					(((fecbuffer[2] >> 6) & 0x03) << 4) |\
-					(((fecbuffer[3] >> 6) & 0x03) << 6);
-
-	printf("Input : "); print_array((uint8_t*) fecbuffer, 4, BINARY); printf("\n");
-	printf("Interl: "); print_array((uint8_t*) buffer, 4, BINARY); printf("\n");
-
-	fecbuffer[0] = ((input[0] & 0x03)) |\
-				((input[1] & 0x03) << 2) |\
-				((input[2] & 0x03) << 4) |\
-				((input[3] & 0x03) << 6);
-	fecbuffer[1] = (((input[0] >> 2) & 0x03)) |\
-					(((input[1] >> 2) & 0x03) << 2) |\
-					(((input[2] >> 2) & 0x03) << 4) |\
-					(((input[3] >> 2) & 0x03) << 6);
-	fecbuffer[2] = (((input[0] >> 4) & 0x03)) |\
-					(((input[1] >> 4) & 0x03) << 2) |\
-					(((input[2] >> 4) & 0x03) << 4) |\
-					(((input[3] >> 4) & 0x03) << 6);
-	fecbuffer[3] = (((input[0] >> 6) & 0x03)) |\
-					(((input[1] >> 6) & 0x03) << 2) |\
-					(((input[2] >> 6) & 0x03) << 4) |\
-					(((input[3] >> 6) & 0x03) << 6);
-
-
-	printf("Deint : "); print_array((uint8_t*) fecbuffer, 4, BINARY); printf("\n");
+	uint8_t input[MAX_LENGTH];
+	uint8_t encoded[2 * MAX_LENGTH + 6];
+	uint8_t decoded[MAX_LENGTH + 3];
+	static uint8_t samples[(2 * MAX_LENGTH + 6) * 8];
+	fec_decoder_t decoder;
+
+	for(uint16_t len = 1; len <= MAX_LENGTH; len++)
+	{
+		random_data(input, len);
+		memcpy(encoded, input, len);
+		uint16_t encoded_length = fec_encode(encoded, len);
+
+		// noisy samples
+		to_samples(encoded, encoded_length, samples, 120);
+		assert(fec_decode_soft(&decoder, samples, encoded_length, decoded) == encoded_length / 2);
+		assert(memcmp(decoded, input, len) == 0);
+
+		// a burst of 3 bits with low confidence on the wrong side of the decision threshold in every 8 received bytes,
+		// which is more than hard decision decoding can correct
+		to_samples(encoded, encoded_length, samples, 60);
+		for(uint16_t i = 0; i + 8 <= encoded_length; i += 8)
+		{
+			uint16_t bit = i * 8 + rand() % 61;
+			for(uint16_t j = bit; j < bit + 3; j++)
+				samples[j] = samples[j] < 128 ? 150 : 105;
+		}
+
+		assert(fec_decode_soft(&decoder, samples, encoded_length, decoded) == encoded_length / 2);
+		assert(memcmp(decoded, input, len) == 0);
+	}
+}
 
+static double elapsed_ns(struct timespec* start, struct timespec* end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
 
+void benchmark()
+{
+	uint8_t input[BENCHMARK_LENGTH];
+	uint8_t encoded[2 * BENCHMARK_LENGTH + 6];
+	static uint8_t samples[(2 * BENCHMARK_LENGTH + 6) * 8];
+	uint16_t encoded_length = 0;
+	fec_decoder_t decoder;
+	struct timespec start, end;
+	volatile uint8_t sink = 0;
+
+	random_data(input, BENCHMARK_LENGTH);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(int i = 0; i < BENCHMARK_ITERATIONS; i++)
+	{
+		memcpy(encoded, input, BENCHMARK_LENGTH);
+		encoded_length = fec_encode(encoded, BENCHMARK_LENGTH);
+		sink ^= encoded[i % encoded_length];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double encode_ns = elapsed_ns(&start, &end) / BENCHMARK_ITERATIONS;
+
+	uint8_t decoded[2 * BENCHMARK_LENGTH + 6];
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(int i = 0; i < BENCHMARK_ITERATIONS; i++)
+	{
+		fec_decode(&decoder, encoded, encoded_length, decoded);
+		sink ^= decoded[i % BENCHMARK_LENGTH];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double decode_ns = elapsed_ns(&start, &end) / BENCHMARK_ITERATIONS;
+
+	to_samples(encoded, encoded_length, samples, 100);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(int i = 0; i < BENCHMARK_ITERATIONS; i++)
+	{
+		fec_decode_soft(&decoder, samples, encoded_length, decoded);
+		sink ^= decoded[i % BENCHMARK_LENGTH];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double decode_soft_ns = elapsed_ns(&start, &end) / BENCHMARK_ITERATIONS;
+
+	printf("%d byte frame:\n", BENCHMARK_LENGTH);
+	printf("  encode:      %8.0f ns/frame %8.2f MB/s\n", encode_ns, BENCHMARK_LENGTH * 1e3 / encode_ns);
+	printf("  decode:      %8.0f ns/frame %8.2f MB/s\n", decode_ns, BENCHMARK_LENGTH * 1e3 / decode_ns);
+	printf("  decode soft: %8.0f ns/frame %8.2f MB/s\n", decode_soft_ns, BENCHMARK_LENGTH * 1e3 / decode_soft_ns);
 }
 
 int main(int argc, char *argv[])
 {
-	//test_interleaver();
-	uint8_t input[] = {0x19,0x00,0x80,0x00,0x0B,0x57,0x00,0x00,0x07,0x8C,0x63,0x20,0x00,0x0B,0x57,0x00,0x00,0x07,0x8F,0x52,0x41,0x07,0x00,0x00,0xD0,0x81};
-	uint8_t input_length = sizeof(input);
-	uint8_t encoded[255];
-	uint8_t decoded[255];
-	uint8_t errors[255];
-
-	memset(errors, 0, 255);
-
-
-	printf("Input: %d ", input_length);
-	print_array(input, input_length, BINARY);
-	printf("\n");
-
-	memcpy(encoded, input, input_length);
-
-	uint16_t lenght_encoded = fec_encode(encoded, input_length);
-
-	printf("Encoded: %d ", lenght_encoded);
-	print_array(encoded, lenght_encoded, BINARY);
-	printf("\n");
-
-	memcpy(decoded, encoded, lenght_encoded);
-
+	srand(time(NULL));
 
-	uint8_t length_decoded =  fec_decode_packet(decoded, lenght_encoded, 255);
+	printf("Testing encoder ... ");
+	test_encode();
+	printf("Success!\n");
 
-	printf("Decoded: %d ", length_decoded);
-	print_array(decoded, length_decoded, BINARY);
-	printf("\n");
+	printf("Testing decoder ... ");
+	test_decode();
+	printf("Success!\n");
 
-	int nr_errors = 1;
-	int notrecovered = 0;
-	srand(time(NULL));
+	printf("Testing soft decision decoder ... ");
+	test_decode_soft();
+	printf("Success!\n");
 
-//	while (notrecovered < 1)
-//	{
-//		int r = rand() % (lenght_encoded * 8);
-//		//printf("Rand: %d\n", r);
-//
-//		encoded[r/8] ^= 1 << r % 8;
-//		errors[r/8] ^= 1 << r % 8;
-//		printf("Errors %d - BER %d%%\n", nr_errors, (nr_errors * 100) / (lenght_encoded * 8));
-//		printf("Error: ");
-//		print_array(errors, lenght_encoded);
-//		printf("\n");
-//		printf("Enc. error: ");
-//		print_array(encoded, lenght_encoded);
-//		printf("\n");
-//
-//		length_decoded =  fec_decode_packet(encoded, lenght_encoded, decoded, 255);
-//
-//		printf("Decoded: ");
-//		print_array(decoded, length_decoded);
-//		printf("\n");
-//
-//		if (memcmp(input, decoded, input_length) == 0)
-//		{
-//			printf("ok\n");
-//		}
-//		else
-//		{
-//			printf("error\n");
-//			notrecovered++;
-//		}
-//
-//		nr_errors++;
-//	}
-
-
-    return 0;
+	benchmark();
+	return 0;
 }
@@ -17,9 +17,11 @@
  * limitations under the License.
  */
 #include "fifo.h"
+#include "spsc_ring.h"
 #include "assert.h"
 #include "errors.h"
 #include "stdio.h"
+#include "string.h"
 
 #define BUFFER_SIZE 10
 
@@ -254,6 +256,80 @@ void test_pop_empty()
     assert(fifo_get_size(&test_fifo) == 0);
 }
 
+void test_spsc_ring()
+{
+    spsc_ring_t ring;
+    spsc_ring_span_t spans[2];
+    uint8_t buffer[8];
+    uint8_t data[8] = {0,1,2,3,4,5,6,7};
+    uint8_t tmp[8] = {0};
+
+    assert(spsc_ring_init(&ring, buffer, 10) == EINVAL);
+    assert(spsc_ring_init(&ring, buffer, sizeof(buffer)) == SUCCESS);
+    assert(spsc_ring_get_size(&ring) == 0);
+    assert(spsc_ring_get_space(&ring) == 8);
+    assert(spsc_ring_peek_spans(&ring, spans) == 0);
+    assert(spans[0].len == 0 && spans[1].len == 0);
+
+    // fill completely, all-or-nothing put
+    assert(spsc_ring_put(&ring, data, 6) == SUCCESS);
+    assert(spsc_ring_put(&ring, data, 3) == ESIZE);
+    assert(spsc_ring_put_byte(&ring, 6) == SUCCESS);
+    assert(spsc_ring_put_byte(&ring, 7) == SUCCESS);
+    assert(spsc_ring_put_byte(&ring, 8) == ESIZE);
+    assert(spsc_ring_get_size(&ring) == 8);
+    assert(spsc_ring_get_space(&ring) == 0);
+
+    assert(spsc_ring_pop(&ring, tmp, 5) == SUCCESS);
+    assert(memcmp(tmp, data, 5) == 0);
+
+    // wrap around the end of the buffer, the data is returned as two spans
+    assert(spsc_ring_put(&ring, data, 4) == SUCCESS);
+    assert(spsc_ring_peek_spans(&ring, spans) == 7);
+    assert(spans[0].len == 3 && spans[0].data == buffer + 5);
+    assert(spans[1].len == 4 && spans[1].data == buffer);
+    assert(memcmp(spans[0].data, data + 5, 3) == 0);
+    assert(memcmp(spans[1].data, data, 4) == 0);
+
+    assert(spsc_ring_peek(&ring, tmp, 2, 3) == SUCCESS);
+    assert(tmp[0] == 7 && tmp[1] == 0 && tmp[2] == 1);
+    assert(spsc_ring_peek(&ring, tmp, 5, 3) == ESIZE);
+
+    // a fifo view parses the wrapped data in place
+    fifo_t view;
+    assert(spsc_ring_init_fifo_view(&ring, &view, 1, 5) == SUCCESS);
+    assert(fifo_get_size(&view) == 5);
+    assert(fifo_pop(&view, tmp, 5) == SUCCESS);
+    assert(tmp[0] == 6 && tmp[1] == 7 && tmp[2] == 0 && tmp[4] == 2);
+    assert(fifo_put(&view, data, 1) == EINVAL);
+    assert(spsc_ring_get_size(&ring) == 7);
+
+    assert(spsc_ring_commit(&ring, 8) == ESIZE);
+    assert(spsc_ring_commit(&ring, 3) == SUCCESS);
+    assert(spsc_ring_peek_spans(&ring, spans) == 4);
+    assert(spans[0].len == 4 && spans[1].len == 0);
+
+    // write in place, as done by DMA
+    assert(spsc_ring_get_write_spans(&ring, spans) == 4);
+    assert(spans[0].data == buffer + 4 && spans[0].len == 4 && spans[1].len == 0);
+    memcpy(spans[0].data, data, 2);
+    assert(spsc_ring_produce(&ring, 2) == SUCCESS);
+    assert(spsc_ring_produce(&ring, 3) == ESIZE);
+    assert(spsc_ring_get_size(&ring) == 6);
+
+    spsc_ring_flush(&ring);
+    assert(spsc_ring_get_size(&ring) == 0);
+    assert(spsc_ring_get_space(&ring) == 8);
+
+    // free running indices survive 16 bit overflow
+    ring.head = ring.tail = 0xFFFE;
+    assert(spsc_ring_put(&ring, data, 8) == SUCCESS);
+    assert(spsc_ring_get_size(&ring) == 8);
+    assert(spsc_ring_pop(&ring, tmp, 8) == SUCCESS);
+    assert(memcmp(tmp, data, 8) == 0);
+    assert(spsc_ring_get_size(&ring) == 0);
+}
+
 int main(int argc, char *argv[])
 {
     printf("Testing fifo_peek ... ");
@@ -284,4 +360,8 @@ int main(int argc, char *argv[])
     test_pop_empty();
     printf("Success!\n");
 
+    printf("Testing spsc_ring ... ");
+    test_spsc_ring();
+    printf("Success!\n");
+
 }
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks how the windowed receive path of the modem interface handles the frame counter of the peer: duplicates,
+ * missing frames, and a counter which restarts because the peer or this side rebooted. The modem interface is
+ * compiled into the test with a TX window, the UART, the scheduler and the timer are stubbed. Frames are fed byte by
+ * byte to the UART RX callback, the ACK or NACK the receive path queues is read from its state.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "framework_defs.h"
+
+// the test needs the windowed mode, without DMA or interrupt lines, whatever the framework is configured with
+#undef FRAMEWORK_MODEM_INTERFACE_TX_WINDOW_SIZE
+#define FRAMEWORK_MODEM_INTERFACE_TX_WINDOW_SIZE 4
+#undef FRAMEWORK_MODEM_INTERFACE_USE_DMA
+#undef FRAMEWORK_MODEM_INTERFACE_USE_INTERRUPT_LINES
+
+#include "modem_interface.c"
+
+#include "test_assert.h"
+
+static uint8_t dispatched[32];
+static uint8_t dispatched_count = 0;
+static uint8_t rebooted_count = 0;
+
+uart_handle_t* uart_init(uint8_t port_idx, uint32_t baudrate, uint8_t pins) { return (uart_handle_t*)rx_buffer; }
+bool uart_enable(uart_handle_t* uart) { return true; }
+bool uart_disable(uart_handle_t* uart) { return true; }
+void uart_pull_down_rx(uart_handle_t* uart) {}
+error_t uart_rx_interrupt_enable(uart_handle_t* uart) { return SUCCESS; }
+void uart_rx_interrupt_disable(uart_handle_t* uart) {}
+void uart_set_rx_interrupt_callback(uart_handle_t* uart, uart_rx_inthandler_t rx_handler) {}
+void uart_set_error_callback(uart_handle_t* uart, uart_error_handler_t error_handler) {}
+void uart_send_bytes(uart_handle_t* uart, void const *data, size_t length) {}
+error_t sched_register_task(task_t task) { return SUCCESS; }
+error_t sched_post_task_prio(task_t task, uint8_t priority, void *arg) { return SUCCESS; }
+error_t timer_post_task_prio(task_t task, timer_tick_t time, uint8_t priority, timer_tick_t period, void *arg) { return SUCCESS; }
+error_t timer_cancel_task(task_t task) { return SUCCESS; }
+timer_tick_t timer_get_counter_value(void) { return 0; }
+error_t hw_gpio_set(pin_id_t pin_id) { return SUCCESS; }
+void start_atomic(void) {}
+void end_atomic(void) {}
+system_reboot_reason_t hw_system_reboot_reason(void) { return REBOOT_REASON_POR; }
+#ifdef MODULE_ALP
+void alp_layer_free_commands() {}
+#endif
+#ifdef FRAMEWORK_LOG_ENABLED
+void log_print_string(char* format, ...) {}
+void log_print_data(uint8_t* message, uint32_t length) {}
+void log_print_error_string(char* format, ...) {}
+#endif
+
+extern inline error_t timer_post_task_prio_delay(task_t task, timer_tick_t delay, uint8_t priority);
+extern inline error_t timer_post_task_delay(task_t task, timer_tick_t delay);
+
+static void alp_received(fifo_t* cmd_fifo)
+{
+    check(dispatched_count < sizeof(dispatched), "too many frames dispatched");
+    fifo_pop(cmd_fifo, &dispatched[dispatched_count++], 1);
+}
+
+static void target_rebooted(system_reboot_reason_t reboot_reason)
+{
+    rebooted_count++;
+}
+
+// receives a frame of the peer with a single byte payload, which is the counter of the frame for an ALP frame
+static void receive(uint8_t counter, serial_message_type_t type)
+{
+    uint8_t frame[SERIAL_FRAME_HEADER_SIZE + 1];
+    uint8_t header_size;
+    uint8_t payload = type == SERIAL_MESSAGE_TYPE_REBOOTED ? REBOOT_REASON_POR : counter;
+    fill_header(frame, &header_size, counter, type, 1, crc_calculate(&payload, 1));
+    frame[header_size] = payload;
+    for(uint8_t i = 0; i <= header_size; i++)
+        uart_rx_cb(frame[i]);
+
+    process_rx_fifo(NULL);
+}
+
+static void receive_alp(uint8_t counter)
+{
+    receive(counter, SERIAL_MESSAGE_TYPE_ALP_DATA);
+}
+
+static void check_ack(serial_message_type_t type, uint8_t counter, const char* description)
+{
+    check(ack_pending && ack_type == type && ack_counter == counter, description);
+    ack_pending = false;
+}
+
+static void check_dispatched(uint8_t count, uint8_t last_counter, const char* description)
+{
+    check(dispatched_count == count && dispatched[count - 1] == last_counter, description);
+}
+
+// a reboot of this side restarts the receive state with the counter at 0
+static void reboot_locally(void)
+{
+    packet_down_counter = 0;
+    rx_nack_sent = false;
+}
+
+static void test_in_order_and_duplicates(void)
+{
+    receive_alp(1);
+    receive_alp(2);
+    receive_alp(3);
+    check_dispatched(3, 3, "frames in order are dispatched");
+    check_ack(SERIAL_MESSAGE_TYPE_ACK, 3, "frames in order are acknowledged at once");
+
+    receive_alp(2);
+    check_dispatched(3, 3, "a retransmitted frame is not dispatched again");
+    check_ack(SERIAL_MESSAGE_TYPE_ACK, 3, "a retransmitted frame is acknowledged again");
+}
+
+static void test_missing_frame(void)
+{
+    receive_alp(5);
+    check_ack(SERIAL_MESSAGE_TYPE_NACK, 4, "a missing frame is requested");
+    receive_alp(6);
+    check(!ack_pending, "a missing frame is only requested once");
+    check_dispatched(3, 3, "frames following a missing frame are dropped");
+
+    receive_alp(4);
+    receive_alp(5);
+    receive_alp(6);
+    check_dispatched(6, 6, "the retransmitted frames are dispatched");
+    check_ack(SERIAL_MESSAGE_TYPE_ACK, 6, "the retransmitted frames are acknowledged");
+}
+
+static void test_peer_reboot(void)
+{
+    // the peer restarts its counter at 1 with a REBOOTED frame, which is within the window behind our counter
+    receive(1, SERIAL_MESSAGE_TYPE_REBOOTED);
+    check(rebooted_count == 1, "the REBOOTED frame of the peer is dispatched");
+    receive_alp(2);
+    check_dispatched(7, 2, "the frames following the REBOOTED frame are dispatched");
+    check_ack(SERIAL_MESSAGE_TYPE_ACK, 2, "the frames after the reboot are acknowledged");
+
+    // the peer reboots after a long time and its REBOOTED frame is lost, the counter is far behind
+    packet_down_counter = 100;
+    receive_alp(2);
+    check_dispatched(8, 2, "a frame far behind the window is dispatched");
+    receive_alp(3);
+    check_dispatched(9, 3, "the frames following a resync are dispatched");
+    check_ack(SERIAL_MESSAGE_TYPE_ACK, 3, "the frames after a resync are acknowledged");
+}
+
+static void test_local_reboot(void)
+{
+    // the counter of the peer is far ahead
+    reboot_locally();
+    receive_alp(57);
+    check_dispatched(10, 57, "a frame far ahead of the window is dispatched");
+    check_ack(SERIAL_MESSAGE_TYPE_ACK, 57, "a frame far ahead of the window is acknowledged");
+
+    // the counter of the peer is within the window ahead, it can't retransmit the frames we request
+    reboot_locally();
+    receive_alp(3);
+    check_ack(SERIAL_MESSAGE_TYPE_NACK, 1, "the first frame is requested");
+    receive_alp(4);
+    check_dispatched(10, 57, "the frames are dropped while waiting for the retransmission");
+    receive_alp(3);
+    receive_alp(4);
+    check_dispatched(12, 4, "the frames are dispatched when the peer retransmits without the requested frame");
+    check_ack(SERIAL_MESSAGE_TYPE_ACK, 4, "the frames after the resync are acknowledged");
+    receive_alp(5);
+    check_dispatched(13, 5, "the frames following the resync are dispatched");
+}
+
+int main(void)
+{
+    modem_interface_init(0, 115200, 0, 0);
+    modem_interface_register_handler(&alp_received, SERIAL_MESSAGE_TYPE_ALP_DATA);
+    modem_interface_set_target_rebooted_callback(&target_rebooted);
+
+    test_in_order_and_duplicates();
+    test_missing_frame();
+    test_peer_reboot();
+    test_local_reboot();
+
+    printf("all modem interface tests passed\n");
+    return EXIT_SUCCESS;
+}
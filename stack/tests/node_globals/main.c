@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the events per second of a network simulation with the node global variables of 64 modules, shaped like
+ * the state of the stack: a few small variables per module which are used on every event and a larger part which is
+ * not. Every event selects a random node, like the simulator switching to the node with the next event, and passes
+ * through 16 modules. Built once per layout of the node global variables (see ng.h), for comparison.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ng.h"
+
+#define MODULE_COUNT        64
+#define EVENT_MODULE_COUNT  16
+#define HOT_SIZE            16
+#define COLD_SIZE           96
+#define EVENT_COUNT         (1 << 21)
+
+#define REPEAT8(m, p)   m(p##0) m(p##1) m(p##2) m(p##3) m(p##4) m(p##5) m(p##6) m(p##7)
+#define REPEAT64(m)     REPEAT8(m, 0) REPEAT8(m, 1) REPEAT8(m, 2) REPEAT8(m, 3) \
+                        REPEAT8(m, 4) REPEAT8(m, 5) REPEAT8(m, 6) REPEAT8(m, 7)
+
+// the state of a module, the counter starts from the same value on every node
+#define MODULE_STATE(n) \
+    static uint8_t NGDEF(_state_##n); \
+    static uint32_t NGDEF(_counter_##n) = NGINIT(1); \
+    static uint8_t NGDEF(_hot_##n)[HOT_SIZE]; \
+    static uint8_t NGDEF(_cold_##n)[COLD_SIZE];
+
+#define MODULE_FUNCTIONS(n) \
+    static void handle_##n(void) \
+    { \
+        NG(_state_##n) = (NG(_state_##n) + 1) & 0x03; \
+        NG(_hot_##n)[NG(_counter_##n) % HOT_SIZE] ^= NG(_state_##n); \
+        NG(_counter_##n)++; \
+    } \
+    static uint32_t get_counter_##n(void) { return NG(_counter_##n); }
+
+#define HANDLER_ENTRY(n) &handle_##n,
+#define COUNTER_ENTRY(n) &get_counter_##n,
+
+REPEAT64(MODULE_STATE)
+REPEAT64(MODULE_FUNCTIONS)
+
+static void (*const handlers[MODULE_COUNT])(void) = { REPEAT64(HANDLER_ENTRY) };
+static uint32_t (*const counters[MODULE_COUNT])(void) = { REPEAT64(COUNTER_ENTRY) };
+
+static const uint32_t node_counts[] = { 1, 10, 100, 1000 };
+static uint32_t events_per_node[NODE_GLOBALS_MAX_NODES];
+static uint64_t rng = 1;
+
+static uint32_t get_random(void)
+{
+    // xorshift64
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (uint32_t)rng;
+}
+
+static double run_events(uint32_t node_count)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(uint32_t event = 0; event < EVENT_COUNT; event++)
+    {
+        uint32_t node = get_random() % node_count;
+        set_node_global_id(node);
+        events_per_node[node]++;
+
+        // a packet passes through consecutive modules of the stack
+        uint32_t first = event % MODULE_COUNT;
+        for(uint32_t i = 0; i < EVENT_MODULE_COUNT; i++)
+            handlers[(first + i) % MODULE_COUNT]();
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// every node only counted its own events
+static bool check_nodes(uint32_t node_count)
+{
+    for(uint32_t node = 0; node < node_count; node++)
+    {
+        set_node_global_id(node);
+        uint64_t handled = 0;
+        for(uint32_t i = 0; i < MODULE_COUNT; i++)
+            handled += counters[i]() - 1;
+
+        if(handled != (uint64_t)events_per_node[node] * EVENT_MODULE_COUNT)
+        {
+            printf("node %u handled %lu module events, expected %lu\n", node, (unsigned long)handled,
+                   (unsigned long)events_per_node[node] * EVENT_MODULE_COUNT);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(void)
+{
+#ifdef NODE_GLOBALS_GROUPED
+    printf("node globals grouped per node\n");
+#else
+    printf("node globals in one array per variable\n");
+#endif
+
+    for(uint32_t i = 0; i < sizeof(node_counts) / sizeof(node_counts[0]); i++)
+    {
+        uint32_t node_count = node_counts[i];
+        double time = run_events(node_count);
+        printf("%4u nodes: %.1f M events/s\n", node_count, EVENT_COUNT / time / 1e6);
+        if(!check_nodes(node_count))
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
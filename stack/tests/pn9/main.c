@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "pn9.h"
+#include "assert.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define BUFFER_SIZE 1100 // more than 2 periods of the keystream
+
+// reference implementation: step the LFSR bit by bit
+static void pn9_reference(uint8_t* data, uint16_t length)
+{
+    uint16_t pn9 = PN9_INITIALIZER;
+    for(uint16_t i = 0; i < length; i++)
+    {
+        data[i] ^= pn9;
+        for(uint8_t bit = 0; bit < 8; bit++)
+            pn9 = (((((pn9 & 0x20) >> 5) ^ pn9) << 8) | ((pn9 >> 1) & 0xff)) & 0x1ff;
+    }
+}
+
+void test_lengths()
+{
+    uint8_t data[BUFFER_SIZE + 8];
+    uint8_t expected[BUFFER_SIZE];
+    for(int i = 0; i < BUFFER_SIZE; i++)
+        expected[i] = rand();
+
+    // also check all alignments of the data buffer
+    for(int align = 0; align < 8; align++)
+    {
+        for(int len = 0; len <= BUFFER_SIZE; len++)
+        {
+            memcpy(data + align, expected, len);
+            pn9_encode(data + align, len);
+            pn9_reference(data + align, len);
+            assert(memcmp(data + align, expected, len) == 0);
+        }
+    }
+}
+
+void test_offset()
+{
+    uint8_t buffer[BUFFER_SIZE];
+    uint8_t expected[BUFFER_SIZE];
+    for(int i = 0; i < BUFFER_SIZE; i++)
+        buffer[i] = rand();
+
+    memcpy(expected, buffer, BUFFER_SIZE);
+    pn9_reference(expected, BUFFER_SIZE);
+
+    for(int chunk = 1; chunk < 37; chunk++)
+    {
+        uint8_t data[BUFFER_SIZE];
+        memcpy(data, buffer, BUFFER_SIZE);
+        for(int offset = 0; offset < BUFFER_SIZE; offset += chunk)
+            pn9_encode_at(data + offset, (BUFFER_SIZE - offset) < chunk ? (BUFFER_SIZE - offset) : chunk, offset);
+
+        assert(memcmp(data, expected, BUFFER_SIZE) == 0);
+    }
+}
+
+int main()
+{
+    printf("Testing lengths ... ");
+    test_lengths();
+    printf("Success!\n");
+
+    printf("Testing offset ... ");
+    test_offset();
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Assertion helpers shared by the host unit tests. The stack calls __assert_func() of the embedded C library when an
+ * assert() fails (see debug.h); the tests replace it to print the failed expression and exit with EXIT_FAILURE.
+ */
+
+#ifndef TEST_ASSERT_H_
+#define TEST_ASSERT_H_
+
+void __assert_func(const char *file, int line, const char *func, const char *failedexpr);
+
+// like assert(), but also evaluated when NDEBUG is defined and reported with a description instead of the expression
+#define check(condition, description) ((condition) ? (void)0 : __assert_func(__FILE__, __LINE__, __func__, description))
+
+#endif // TEST_ASSERT_H_
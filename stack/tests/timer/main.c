@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark of the framework timer on NATIVE.
+ *
+ * The timer is linked against instrumented stubs of the HAL timer, the scheduler and the atomic section
+ * functions. For a growing number of concurrently scheduled timers it reports how long the interrupts
+ * would be disabled while posting and cancelling an event. Build once with and once without
+ * FRAMEWORK_TIMER_USE_HEAP and increase FRAMEWORK_TIMER_STACK_SIZE to compare both timer backends.
+ * Before benchmarking, the order in which the events fire and the coalescing of events with slack are verified.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "timer.h"
+#include "hwtimer.h"
+#include "hwatomic.h"
+#include "errors.h"
+#include "log.h"
+
+#define ITERATIONS 2000
+#define MAX_DEADLINE 60000 // stay below the 16 bit hw timer range, overflows are not simulated
+
+static hwtimer_tick_t hw_counter = 0;
+static hwtimer_tick_t hw_compare = 0;
+static bool hw_scheduled = false;
+static uint32_t hw_schedule_count = 0;
+static timer_callback_t compare_cb = NULL;
+static const hwtimer_info_t hw_info = { .min_delay_ticks = 2 };
+
+// the scheduler handles limit the number of distinct tasks which can be fired
+#if FRAMEWORK_TIMER_STACK_SIZE < SCHED_INVALID_TASK_ID
+    #define FIRE_ORDER_TASKS FRAMEWORK_TIMER_STACK_SIZE
+#else
+    #define FIRE_ORDER_TASKS (SCHED_INVALID_TASK_ID - 1)
+#endif
+
+static uint32_t fired_tasks[FIRE_ORDER_TASKS];
+static uint32_t fired_count = 0;
+
+static uint32_t atomic_nesting = 0;
+static struct timespec atomic_start;
+static uint64_t atomic_max_ns = 0;
+static uint64_t atomic_total_ns = 0;
+static uint32_t atomic_sections = 0;
+
+error_t hw_timer_init(hwtimer_id_t timer_id, uint8_t frequency, timer_callback_t compare_callback, timer_callback_t overflow_callback)
+{
+    compare_cb = compare_callback;
+    return SUCCESS;
+}
+
+const hwtimer_info_t* hw_timer_get_info(hwtimer_id_t timer_id) { return &hw_info; }
+hwtimer_tick_t hw_timer_getvalue(hwtimer_id_t timer_id) { return hw_counter; }
+bool hw_timer_is_overflow_pending(hwtimer_id_t id) { return false; }
+
+error_t hw_timer_schedule(hwtimer_id_t timer_id, hwtimer_tick_t tick)
+{
+    hw_compare = tick;
+    hw_scheduled = true;
+    hw_schedule_count++;
+    return SUCCESS;
+}
+
+error_t hw_timer_cancel(hwtimer_id_t timer_id)
+{
+    hw_scheduled = false;
+    return SUCCESS;
+}
+
+error_t sched_register_task(task_t task) { return SUCCESS; }
+
+// the stubbed scheduler uses the index of the task as handle
+static uint32_t index_for(task_t task)
+{
+    return ((uintptr_t)task - 0x1000) / 4;
+}
+
+sched_task_id_t sched_get_task_id(task_t task)
+{
+    return index_for(task) < FIRE_ORDER_TASKS ? index_for(task) : SCHED_INVALID_TASK_ID;
+}
+
+error_t sched_post_task_prio(task_t task, uint8_t priority, void *arg)
+{
+    return sched_post_task_by_id(sched_get_task_id(task), priority, arg);
+}
+
+error_t sched_post_task_by_id(sched_task_id_t task_id, uint8_t priority, void *arg)
+{
+    if(task_id == SCHED_INVALID_TASK_ID)
+        return EINVAL;
+
+    if(fired_count < FIRE_ORDER_TASKS)
+        fired_tasks[fired_count++] = task_id;
+
+    return SUCCESS;
+}
+
+error_t sched_cancel_task(task_t task) { return SUCCESS; }
+
+#ifdef FRAMEWORK_LOG_ENABLED
+// the log component is not linked, the timer only uses it to report events which fire too early or too late
+void log_print_error_string(char* format, ...) {}
+#endif
+
+void start_atomic(void)
+{
+    if(atomic_nesting++ == 0)
+        clock_gettime(CLOCK_MONOTONIC, &atomic_start);
+}
+
+void end_atomic(void)
+{
+    // the timer ends the atomic section itself before programming the hw timer, also when called from the ISR
+    if(atomic_nesting == 0)
+        return;
+
+    if(--atomic_nesting == 0)
+    {
+        struct timespec stop;
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        uint64_t duration = (stop.tv_sec - atomic_start.tv_sec) * 1000000000ULL + stop.tv_nsec - atomic_start.tv_nsec;
+        if(duration > atomic_max_ns)
+            atomic_max_ns = duration;
+
+        atomic_total_ns += duration;
+        atomic_sections++;
+    }
+}
+
+static void reset_atomic_stats()
+{
+    atomic_max_ns = 0;
+    atomic_total_ns = 0;
+    atomic_sections = 0;
+}
+
+// the tasks are never executed since the scheduler is stubbed, so any unique address will do
+static task_t task_for(uint32_t i)
+{
+    return (task_t)(uintptr_t)(0x1000 + 4 * i);
+}
+
+static timer_tick_t deadline_for(task_t task)
+{
+    return 100 + (((uintptr_t)task * 2654435761u) >> 4) % (MAX_DEADLINE - 100);
+}
+
+static void cancel_all(uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++)
+        timer_cancel_task(task_for(i));
+}
+
+static bool test_fire_order()
+{
+    hw_counter = 0;
+    fired_count = 0;
+    for(uint32_t i = 0; i < FIRE_ORDER_TASKS; i++)
+    {
+        if(timer_post_task_prio(task_for(i), deadline_for(task_for(i)), DEFAULT_PRIORITY, 0, NULL) != SUCCESS)
+            return false;
+    }
+
+    if(FIRE_ORDER_TASKS == FRAMEWORK_TIMER_STACK_SIZE
+       && timer_post_task_prio(task_for(FRAMEWORK_TIMER_STACK_SIZE), 100, DEFAULT_PRIORITY, 0, NULL) != ENOMEM)
+        return false;
+
+    // cancel the first event and re-post it at another time to exercise the update paths as well
+    timer_cancel_task(task_for(0));
+    timer_post_task_prio(task_for(0), deadline_for(task_for(0)), DEFAULT_PRIORITY, 0, NULL);
+    timer_post_task_prio(task_for(1), deadline_for(task_for(1)) / 2, DEFAULT_PRIORITY, 0, NULL);
+
+    // let time advance to every programmed compare value
+    while(hw_scheduled)
+    {
+        hw_scheduled = false;
+        hw_counter = hw_compare;
+        compare_cb();
+    }
+
+    if(fired_count != FIRE_ORDER_TASKS)
+        return false;
+
+    timer_tick_t previous = 0;
+    for(uint32_t i = 0; i < fired_count; i++)
+    {
+        task_t task = task_for(fired_tasks[i]);
+        timer_tick_t deadline = deadline_for(task);
+        if(fired_tasks[i] == 1)
+            deadline /= 2;
+
+        if(deadline < previous || timer_is_task_scheduled(task))
+            return false;
+
+        previous = deadline;
+    }
+
+    hw_counter = 0;
+    return true;
+}
+
+static bool test_slack()
+{
+    hw_counter = 0;
+    fired_count = 0;
+    // windows: 0 [1000, 1000], 1 [900, 1100], 2 [1100, 1150], 3 [950, 1050]
+    timer_post_task_prio_slack(task_for(0), 1000, 0, DEFAULT_PRIORITY, 0, NULL);
+    timer_post_task_prio_slack(task_for(1), 900, 200, DEFAULT_PRIORITY, 0, NULL);
+    timer_post_task_prio_slack(task_for(2), 1100, 50, DEFAULT_PRIORITY, 0, NULL);
+    timer_post_task_prio_slack(task_for(3), 950, 100, DEFAULT_PRIORITY, 0, NULL);
+
+    // postponing within the scheduled window keeps the deadline and does not reprogram the hw timer
+    uint32_t schedule_count = hw_schedule_count;
+    timer_post_task_prio_slack(task_for(1), 950, 500, DEFAULT_PRIORITY, 0, NULL);
+    if(hw_schedule_count != schedule_count)
+        return false;
+
+    // the first wake-up at the deadline of task 0 fires tasks 0, 1 and 3, the second one task 2 at its deadline
+    uint32_t wake_ups = 0;
+    timer_tick_t wake_up_times[2];
+    while(hw_scheduled)
+    {
+        hw_scheduled = false;
+        hw_counter = hw_compare;
+        if(wake_ups < 2)
+            wake_up_times[wake_ups] = hw_counter;
+
+        wake_ups++;
+        compare_cb();
+    }
+
+    if(wake_ups != 2 || wake_up_times[0] != 1000 || wake_up_times[1] != 1150 || fired_count != 4 || fired_tasks[3] != 2)
+        return false;
+
+    hw_counter = 0;
+    return true;
+}
+
+static void benchmark(uint32_t scheduled)
+{
+    for(uint32_t i = 0; i < scheduled; i++)
+        timer_post_task_prio(task_for(i), deadline_for(task_for(i)), DEFAULT_PRIORITY, 0, NULL);
+
+    task_t task = task_for(scheduled);
+    timer_tick_t time = deadline_for(task);
+
+    reset_atomic_stats();
+    for(uint32_t i = 0; i < ITERATIONS; i++)
+        timer_post_task_prio(task, time + (i % 1000), DEFAULT_PRIORITY, 0, NULL);
+
+    uint64_t post_avg = atomic_total_ns / atomic_sections;
+    uint64_t post_max = atomic_max_ns;
+
+    reset_atomic_stats();
+    for(uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        timer_post_task_prio(task, time, DEFAULT_PRIORITY, 0, NULL);
+        timer_cancel_task(task);
+    }
+
+    printf("%9u | %13llu | %13llu | %18llu | %18llu\n", scheduled,
+           (unsigned long long)post_avg, (unsigned long long)post_max,
+           (unsigned long long)(atomic_total_ns / atomic_sections), (unsigned long long)atomic_max_ns);
+
+    cancel_all(scheduled);
+}
+
+int main(int argc, char *argv[])
+{
+    timer_init();
+
+#ifdef FRAMEWORK_TIMER_USE_HEAP
+    printf("timer backend: heap, FRAMEWORK_TIMER_STACK_SIZE %u\n", FRAMEWORK_TIMER_STACK_SIZE);
+#else
+    printf("timer backend: linear, FRAMEWORK_TIMER_STACK_SIZE %u\n", FRAMEWORK_TIMER_STACK_SIZE);
+#endif
+
+    printf("Testing fire order ... ");
+    if(!test_fire_order())
+    {
+        printf("Failed!\n");
+        return 1;
+    }
+    printf("Success!\n");
+
+    printf("Testing slack ... ");
+    if(!test_slack())
+    {
+        printf("Failed!\n");
+        return 1;
+    }
+    printf("Success!\n");
+
+    printf("scheduled | post avg (ns) | post max (ns) | post+cancel avg (ns) | post+cancel max (ns)\n");
+    for(uint32_t scheduled = 1; scheduled < FRAMEWORK_TIMER_STACK_SIZE; scheduled *= 2)
+        benchmark(scheduled);
+
+    benchmark(FRAMEWORK_TIMER_STACK_SIZE - 1);
+    return 0;
+}
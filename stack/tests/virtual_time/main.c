@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+ *
+ * This file is part of Sub-IoT.
+ * See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs the scheduler and the framework timer on the virtual clock of the NATIVE platform (see native_timer.c).
+ * Events far beyond the range of the 16 bit hardware timer, periodic events and events which expire while the
+ * MCU is busy are checked to fire at the expected tick, while the simulated hours take only milliseconds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "scheduler.h"
+#include "timer.h"
+#include "hwsystem.h"
+#include "native_time.h"
+#include "errors.h"
+#include "log.h"
+
+#define SHORT_DELAY     (10 * TIMER_TICKS_PER_SEC)
+#define LONG_DELAY      TIMER_TICKS_PER_HOUR
+#define PERIOD          1000
+#define PERIOD_COUNT    5
+#define BUSY_TIME_US    20000
+#define END_DELAY       (2 * TIMER_TICKS_PER_HOUR)
+
+static timer_tick_t short_fired = 0;
+static timer_tick_t long_fired = 0;
+static timer_tick_t periodic_fired[PERIOD_COUNT];
+static uint8_t periodic_count = 0;
+static timer_tick_t busy_end = 0;
+static timer_tick_t late_fired = 0;
+static bool success = true;
+
+static void check(bool condition, const char* description)
+{
+    if(!condition)
+    {
+        printf("%s failed\n", description);
+        success = false;
+    }
+}
+
+void start_atomic(void) {}
+void end_atomic(void) {}
+void __watchdog_init(void) {}
+void hw_watchdog_feed(void) {}
+uint8_t hw_watchdog_get_timeout(void) { return 30; }
+error_t power_tracking_register_run_time(timer_tick_t time) { return SUCCESS; }
+#ifdef FRAMEWORK_LOG_ENABLED
+// the log component is not linked, the timer only uses it to report the late event this test provokes
+void log_print_error_string(char* format, ...) {}
+#endif
+
+static void short_task(void* arg) { short_fired = timer_get_counter_value(); }
+
+static void long_task(void* arg) { long_fired = timer_get_counter_value(); }
+
+static void periodic_task(void* arg)
+{
+    periodic_fired[periodic_count++] = timer_get_counter_value();
+    if(periodic_count == PERIOD_COUNT)
+        timer_cancel_task(&periodic_task);
+}
+
+static void late_task(void* arg) { late_fired = timer_get_counter_value(); }
+
+static void busy_task(void* arg)
+{
+    hw_busy_wait(BUSY_TIME_US);
+    busy_end = timer_get_counter_value();
+}
+
+static void end_task(void* arg)
+{
+    check(short_fired == SHORT_DELAY, "short delay");
+    check(long_fired == LONG_DELAY, "long delay");
+    check(periodic_count == PERIOD_COUNT, "periodic count");
+    for(uint8_t i = 0; i < periodic_count; i++)
+        check(periodic_fired[i] == (i + 1) * PERIOD, "period");
+
+    // the late task expired during the busy wait, so it runs as soon as the MCU is idle
+    check(busy_end == (timer_tick_t)(BUSY_TIME_US * TIMER_TICKS_PER_SEC / 1000000), "busy wait");
+    check(late_fired == busy_end, "late task");
+    check(native_time_get_ticks() == END_DELAY, "virtual time");
+
+    printf("simulated %lu s in %lu ms: %s\n", (unsigned long)(END_DELAY / TIMER_TICKS_PER_SEC),
+           (unsigned long)(clock() * 1000 / CLOCKS_PER_SEC), success ? "Success!" : "Failed!");
+    exit(success ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    scheduler_init();
+    timer_init();
+
+    task_t tasks[] = { &short_task, &long_task, &periodic_task, &late_task, &busy_task, &end_task };
+    for(uint8_t i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++)
+        sched_register_task(tasks[i]);
+
+    timer_post_task_delay(&short_task, SHORT_DELAY);
+    timer_post_task_delay(&long_task, LONG_DELAY);
+    timer_post_task_prio(&periodic_task, PERIOD, DEFAULT_PRIORITY, PERIOD, NULL);
+    timer_post_task_delay(&late_task, 2);
+    sched_post_task(&busy_task);
+    timer_post_task_delay(&end_task, END_DELAY);
+
+    scheduler_run();
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+##
+## Copyright (c) 2015-2021 University of Antwerp, Aloxy NV.
+##
+## This file is part of Sub-IoT.
+## See https://github.com/Sub-IoT/Sub-IoT-Stack for further info.
+##
+## Licensed under the Apache License, Version 2.0 (the "License");
+## you may not use this file except in compliance with the License.
+## You may obtain a copy of the License at
+##
+##     http://www.apache.org/licenses/LICENSE-2.0
+##
+## Unless required by applicable law or agreed to in writing, software
+## distributed under the License is distributed on an "AS IS" BASIS,
+## WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+## See the License for the specific language governing permissions and
+## limitations under the License.
+##
+
+# Decodes the output of a firmware built with FRAMEWORK_LOG_BINARY enabled back to text.
+# The format strings are read from the ELF file of the same build. See framework/components/log/log.c for the
+# record format. Bytes which are not part of a binary record are passed through unchanged.
+#
+# usage: log_decoder.py <elf> [-i <file>] [-s <serial port> -b <baudrate>]
+
+import argparse
+import re
+import struct
+import sys
+
+FORMAT_BASE = b"SUB-IoT binary log format base\0"
+SYNC_BYTE = 0xDB
+
+RECORD_STRING = 0x01
+RECORD_STACK_STRING = 0x02
+RECORD_DATA = 0x03
+RECORD_DATA_CONTINUED = 0x04
+RECORD_ERROR_STRING = 0x05
+RECORD_DROPPED = 0x06
+RECORD_COUNTER_RESET = 0x07
+
+SPECIFIER = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|j|z|t|L)?([diuxXocpsfFeEgGaAn%])")
+
+ERROR_START = "\x1b[4;41m"
+ERROR_END = "\x1b[0m"
+
+
+class FormatTable:
+  """Resolves format IDs using the allocated sections of an ELF file (32 or 64 bit, little endian)"""
+
+  def __init__(self, path):
+    with open(path, "rb") as f:
+      elf = f.read()
+
+    if elf[:4] != b"\x7fELF" or elf[5] != 1:
+      raise ValueError("{} is not a little endian ELF file".format(path))
+
+    if elf[4] == 1:
+      shoff, = struct.unpack_from("<I", elf, 0x20)
+      shentsize, shnum = struct.unpack_from("<HH", elf, 0x2E)
+      section_format = "<IIIIII"
+    else:
+      shoff, = struct.unpack_from("<Q", elf, 0x28)
+      shentsize, shnum = struct.unpack_from("<HH", elf, 0x3A)
+      section_format = "<IIQQQQ"
+
+    self.sections = []
+    for i in range(shnum):
+      _, sh_type, sh_flags, sh_addr, sh_offset, sh_size = struct.unpack_from(section_format, elf, shoff + i * shentsize)
+      if (sh_flags & 0x2) and sh_type != 8:  # SHF_ALLOC and not SHT_NOBITS
+        self.sections.append((sh_addr, elf[sh_offset:sh_offset + sh_size]))
+
+    self.base = None
+    for addr, data in self.sections:
+      offset = data.find(FORMAT_BASE)
+      if offset >= 0:
+        self.base = addr + offset
+        break
+
+    if self.base is None:
+      raise ValueError("{} was not built with FRAMEWORK_LOG_BINARY enabled".format(path))
+
+  def lookup(self, format_id):
+    addr = self.base + format_id
+    for section_addr, data in self.sections:
+      if section_addr <= addr < section_addr + len(data):
+        end = data.find(b"\0", addr - section_addr)
+        return data[addr - section_addr:end].decode("utf-8", "replace")
+
+    return None
+
+
+def format_string(fmt, args):
+  """Formats the raw arguments, walking the conversion specifiers in the same way as the firmware"""
+  values = []
+  python_fmt = []
+  pos = 0
+  last = 0
+  for m in SPECIFIER.finditer(fmt):
+    python_fmt.append(fmt[last:m.start()].replace("%", "%%"))
+    last = m.end()
+    flags, width, precision, length, conversion = m.groups()
+    if conversion == "%":
+      python_fmt.append("%%")
+      continue
+
+    for star in (width, precision):
+      if star == "*":
+        value, = struct.unpack_from("<i", args, pos) if pos + 4 <= len(args) else (0,)
+        values.append(value)
+        pos += 4
+
+    spec = "%" + flags + (width or "") + ("." + precision if precision is not None else "")
+    if conversion in "diuxXoc":
+      size = 8 if length in ("ll", "j") else 4
+      signed = conversion in "di"
+      if pos + size > len(args):
+        python_fmt.append("?")
+        pos += size
+        continue
+
+      value, = struct.unpack_from(("<q" if signed else "<Q") if size == 8 else ("<i" if signed else "<I"), args, pos)
+      pos += size
+      values.append(value)
+      python_fmt.append(spec + {"i": "d", "u": "d"}.get(conversion, conversion))
+    elif conversion == "p":
+      value, = struct.unpack_from("<I", args, pos) if pos + 4 <= len(args) else (0,)
+      pos += 4
+      values.append(value)
+      python_fmt.append("0x%x")
+    elif conversion in "fFeEgGaA":
+      value, = struct.unpack_from("<d", args, pos) if pos + 8 <= len(args) else (float("nan"),)
+      pos += 8
+      values.append(value)
+      python_fmt.append(spec + {"a": "e", "A": "E"}.get(conversion, conversion))
+    elif conversion == "s":
+      length = args[pos] if pos < len(args) else 0
+      values.append(args[pos + 1:pos + 1 + length].decode("utf-8", "replace"))
+      pos += 1 + length
+      python_fmt.append(spec + "s")
+
+  python_fmt.append(fmt[last:].replace("%", "%%"))
+  try:
+    return "".join(python_fmt) % tuple(values)
+  except (TypeError, ValueError):
+    return fmt + " " + args.hex()
+
+
+class Decoder:
+  def __init__(self, formats, out):
+    self.formats = formats
+    self.out = out
+    self.counter = 0
+    self.buffer = bytearray()
+
+  def line(self, text, error=False):
+    prefix = "[{:03d}]".format(self.counter)
+    if error:
+      prefix = ERROR_START + prefix + ERROR_END
+
+    self.out.write("\n" + prefix + " " + text)
+    self.counter += 1
+
+  def record(self, record_type, payload):
+    if record_type in (RECORD_STRING, RECORD_STACK_STRING, RECORD_ERROR_STRING):
+      if record_type == RECORD_STACK_STRING:
+        payload = payload[1:]  # the stack layer is not printed, as in text mode
+
+      if len(payload) < 4:
+        return False
+
+      format_id, = struct.unpack_from("<i", payload)
+      fmt = self.formats.lookup(format_id)
+      if fmt is None:
+        return False
+
+      self.line(format_string(fmt, bytes(payload[4:])), record_type == RECORD_ERROR_STRING)
+    elif record_type == RECORD_DATA:
+      self.out.write("\n[{:03d}]".format(self.counter) + "".join(" {:02X}".format(b) for b in payload))
+      self.counter += 1
+    elif record_type == RECORD_DATA_CONTINUED:
+      self.out.write("".join(" {:02X}".format(b) for b in payload))
+    elif record_type == RECORD_DROPPED and len(payload) == 2:
+      dropped, = struct.unpack("<H", payload)
+      self.out.write("\n" + ERROR_START + "*** {} log records dropped, buffer full ***".format(dropped) + ERROR_END)
+      self.counter += dropped
+    elif record_type == RECORD_COUNTER_RESET:
+      self.counter = 0
+    else:
+      return False
+
+    return True
+
+  def feed(self, data):
+    self.buffer += data
+    while self.buffer:
+      sync = self.buffer.find(bytes([SYNC_BYTE]))
+      if sync != 0:
+        # pass through text which is not logged using the log component
+        text = self.buffer if sync < 0 else self.buffer[:sync]
+        self.out.write(text.decode("utf-8", "replace"))
+        del self.buffer[:len(text)]
+        continue
+
+      if len(self.buffer) < 3 or len(self.buffer) < 2 + self.buffer[1]:
+        break  # wait for the rest of the record
+
+      length = self.buffer[1]
+      if length == 0 or not self.record(self.buffer[2], self.buffer[3:2 + length]):
+        # not a valid record, skip the sync byte
+        del self.buffer[:1]
+        continue
+
+      del self.buffer[:2 + length]
+
+    self.out.flush()
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description="Decodes binary log output (FRAMEWORK_LOG_BINARY) to text.")
+  parser.add_argument("elf", help="the ELF file of the application which generated the logs")
+  parser.add_argument("-i", "--input", help="file containing the log output (default: stdin)")
+  parser.add_argument("-s", "--serial", help="serial port to read the log output from")
+  parser.add_argument("-b", "--baudrate", help="baudrate of the serial port", type=int, default=115200)
+  config = parser.parse_args()
+
+  decoder = Decoder(FormatTable(config.elf), sys.stdout)
+  if config.serial:
+    import serial
+    port = serial.Serial(config.serial, config.baudrate)
+    read = lambda: port.read(max(1, port.in_waiting))
+  else:
+    stream = open(config.input, "rb") if config.input else sys.stdin.buffer
+    read = lambda: stream.read1(4096) if hasattr(stream, "read1") else stream.read(4096)
+
+  try:
+    while True:
+      data = read()
+      if not data:
+        break
+      decoder.feed(data)
+  except KeyboardInterrupt:
+    pass
+
+  sys.stdout.write("\n")